@@ -1,80 +1,76 @@
-#include "Symboltable.h"
+#include "SymbolTable.h"
 #include <iostream>
 
-SymbolTable symbolTable;
-
-SymbolTable::SymbolTable()
+SymbolTable::SymbolTable(std::ostream &diagnostics, const Interner &names)
+    : diag(&diagnostics), names(&names)
 {
     enterScope(); // Start with global scope
 }
 
 void SymbolTable::enterScope()
 {
-    scopes.emplace_back(); // New empty scope
+    scopeStarts.push_back(symbols.size()); // New empty scope
+    ++scopesOpened;
 }
 
 void SymbolTable::exitScope()
 {
-    if (scopes.empty())
+    if (scopeStarts.empty())
     {
         throw std::runtime_error("No scope to exit.");
     }
-    scopes.pop_back();
-}
+    size_t start = scopeStarts.back();
+    scopeStarts.pop_back();
 
-void SymbolTable::declare(const std::string &name, const std::string &type, int line)
-{
-    if (scopes.empty()) {
-        std::cout<<"we are empty (declare)\n";
-    }
-    auto &currentScope = scopes.back();
-    if (currentScope.count(name) > 0)
+    // Undo the scope's declarations, re-exposing whatever they shadowed
+    while (symbols.size() > start)
     {
-        std::cout<<"Error at line no "<<line<<": ";
-        //throw std::runtime_error("Variable '" + name + "' already declared in this scope.");
-        std::cerr<<"Variable '" + name + "' already declared in this scope.\n";
+        const Symbol &sym = symbols.back();
+        visible[sym.name] = sym.shadowed;
+        symbols.pop_back();
     }
-    currentScope.emplace(name, Symbol(name, type, line));
 }
 
-const Symbol &SymbolTable::lookup(const std::string &name) const
+uint32_t SymbolTable::declare(IdentId name, TypeId type, int line)
 {
-    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
+    if (name >= visible.size())
+        visible.resize(names->size() > name ? names->size() : name + 1, -1);
+
+    int32_t previous = visible[name];
+    if (previous >= 0 && static_cast<size_t>(previous) >= scopeStarts.back())
     {
-        auto found = it->find(name);
-        if (found != it->end())
-        {
-            return found->second;
-        }
+        error()<<"Error at line no "<<line<<": ";
+        *diag<<"Variable '" << names->name(name) << "' already declared in this scope.\n";
     }
-    throw std::runtime_error("Variable '" + name + "' not declared.");
+    visible[name] = static_cast<int32_t>(symbols.size());
+    symbols.emplace_back(name, type, line, previous, nextSlot);
+    return nextSlot++;
 }
 
-bool SymbolTable::isDeclared(const std::string &name) const
+const Symbol *SymbolTable::lookup(IdentId name) const
 {
-    if (scopes.empty()) {
-        std::cout<<"we are empty (isDeclared) \n"<<name<<"\n";
-    }
-    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
-    {
-        if (it->count(name) > 0)
-        {
-            return true;
-        }
-    }
-    return false;
+    ++lookups;
+    if (name >= visible.size() || visible[name] < 0)
+        return nullptr;
+    return &symbols[visible[name]];
+}
+
+bool SymbolTable::isDeclared(IdentId name) const
+{
+    return lookup(name) != nullptr;
 }
 
 void SymbolTable::print() const
 {
     std::cout << "Symbol Table (from global to inner scopes):\n";
-    for (size_t i = 0; i < scopes.size(); ++i)
+    for (size_t scope = 0; scope < scopeStarts.size(); ++scope)
     {
-        std::cout << "  Scope " << i << ":\n";
-        for (const auto &pair : scopes[i])
+        std::cout << "  Scope " << scope << ":\n";
+        size_t end = scope + 1 < scopeStarts.size() ? scopeStarts[scope + 1] : symbols.size();
+        for (size_t i = scopeStarts[scope]; i < end; ++i)
         {
-            const auto &sym = pair.second;
-            std::cout << "    " << sym.name << " : " << sym.type
+            const auto &sym = symbols[i];
+            std::cout << "    " << names->name(sym.name) << " : " << sym.type.name()
                       << " (line " << sym.lineDeclared << ")\n";
         }
     }
@@ -92,4 +88,3 @@ void SymbolTable::exitLoop() {
 bool SymbolTable::isInsideLoop() const {
     return loopDepth > 0;
 }
-
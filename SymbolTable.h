@@ -1,9 +1,11 @@
 #pragma once
-#include <unordered_map>
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <stdexcept>
 #include <iostream>
+#include "interner.h"
+#include "types.h"
 
 // Forward declarations (no need to include ast.h here)
 class ASTNode;
@@ -13,19 +15,27 @@ class BinaryExprNode;
 class Symbol
 {
 public:
-    std::string name;
-    std::string type;
+    IdentId name;
+    TypeId type;
     int lineDeclared;
+    int32_t shadowed; // Declaration of the same name this one hides, or -1
+    uint32_t slot;    // Storage slot, unique per declaration in the program
 
-    Symbol(const std::string &name, const std::string &type, int lineDeclared)
-        : name(name), type(type), lineDeclared(lineDeclared) {}
+    Symbol(IdentId name, TypeId type, int lineDeclared, int32_t shadowed, uint32_t slot)
+        : name(name), type(type), lineDeclared(lineDeclared), shadowed(shadowed), slot(slot) {}
 };
 
-// Symbol table supporting nested scopes
+// Symbol table supporting nested scopes.
+//
+// All live declarations sit in one vector that doubles as the undo log:
+// entering a scope records its length and leaving truncates back to it.
+// `visible` maps an interned name straight to its innermost declaration,
+// and each declaration links to the one it shadows, so a lookup is a single
+// index and scope changes never allocate once the vectors have grown.
 class SymbolTable
 {
 public:
-    SymbolTable();
+    SymbolTable(std::ostream &diagnostics, const Interner &names);
 
     void enterScope(); // Push a new scope
     void exitScope();  // Pop the current scope
@@ -35,17 +45,41 @@ public:
     bool isInsideLoop() const;
 
 
-    void declare(const std::string &name, const std::string &type, int line);
-    const Symbol &lookup(const std::string &name) const;
-    bool isDeclared(const std::string &name) const;
+    // Returns the slot the declaration's value lives in
+    uint32_t declare(IdentId name, TypeId type, int line);
+    const Symbol *lookup(IdentId name) const; // nullptr if not declared
+    bool isDeclared(IdentId name) const;
 
     void print() const;
 
     int loopDepth = 0; // For tracking loop depth
 
+    // Where semantic errors of this compilation are reported
+    std::ostream &diagnostics() const { return *diag; }
+
+    // Stream for a semantic error; counts it so later phases can bail out
+    std::ostream &error()
+    {
+        ++errors;
+        return *diag;
+    }
+    int errorCount() const { return errors; }
+
+    // Number of slots handed out so far, i.e. variables in the program
+    uint32_t slotCount() const { return nextSlot; }
+
+    // For --time-report
+    uint64_t lookupCount() const { return lookups; }
+    uint64_t scopesEntered() const { return scopesOpened; }
+
 private:
-    std::vector<std::unordered_map<std::string, Symbol>> scopes;
+    std::vector<Symbol> symbols;       // Live declarations, innermost last
+    std::vector<size_t> scopeStarts;   // symbols.size() when each scope began
+    std::vector<int32_t> visible;      // IdentId -> index into symbols, or -1
+    std::ostream *diag;
+    const Interner *names;
+    uint32_t nextSlot = 0;
+    int errors = 0;
+    mutable uint64_t lookups = 0;
+    uint64_t scopesOpened = 0;
 };
-
-// Global instance of the symbol table
-extern SymbolTable symbolTable;
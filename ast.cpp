@@ -1,403 +1,1145 @@
-#include "ast.h"
-#include "ast_interface.h"
-#include "SymbolTable.h"
-
-#include <iostream>
-#include <memory>
-
-#include <iostream>
-
-// Global AST root
-std::unique_ptr<ProgramNode> astRoot = nullptr;
-
-// -------------------- Literal Builders --------------------
-std::unique_ptr<LiteralNode> makeIntLiteral(int value, int line)
-{
-    auto node = std::make_unique<LiteralNode>(LiteralNode::Type::Int, std::to_string(value));
-    node->lineNumber = line;
-
-    return node;
-}
-
-std::unique_ptr<LiteralNode> makeFloatLiteral(float value, int line)
-{
-    auto node = std::make_unique<LiteralNode>(LiteralNode::Type::Float, std::to_string(value));
-    node->lineNumber = line;
-    return node;
-}
-
-std::unique_ptr<LiteralNode> makeStringLiteral(const std::string &value, int line)
-{
-    auto node = std::make_unique<LiteralNode>(LiteralNode::Type::String, value);
-    node->lineNumber = line;
-    return node;
-}
-
-std::unique_ptr<LiteralNode> makeCharLiteral(char value, int line)
-{
-    auto node = std::make_unique<LiteralNode>(LiteralNode::Type::Char, std::string(1, value));
-    node->lineNumber = line;
-    return node;
-}
-
-std::unique_ptr<LiteralNode> makeBoolLiteral(bool value, int line)
-{
-    auto node = std::make_unique<LiteralNode>(LiteralNode::Type::Bool, value ? "true" : "false");
-    node->lineNumber = line;
-    return node;
-}
-
-// -------------------- Identifier --------------------
-std::unique_ptr<IdentifierNode> makeIdentifier(const std::string &name, int line)
-{
-    auto node = std::make_unique<IdentifierNode>(name);
-    node->lineNumber = line;
-    return node;
-}
-
-// -------------------- Expressions --------------------
-std::unique_ptr<BinaryExprNode> makeBinaryExpr(
-    std::unique_ptr<ASTNode> left,
-    BinaryExprNode::Op op,
-    std::unique_ptr<ASTNode> right,
-    int line)
-{
-    auto node = std::make_unique<BinaryExprNode>(std::move(left), op, std::move(right));
-    node->lineNumber = line;
-    return node;
-}
-
-std::unique_ptr<UnaryExprNode> makeUnaryExpr(UnaryExprNode::Op op, std::unique_ptr<ASTNode> operand, int line)
-{
-    auto node = std::make_unique<UnaryExprNode>(op, std::move(operand));
-    node->lineNumber = line;
-    return node;
-}
-
-// -------------------- Statements --------------------
-std::unique_ptr<DeclarationNode> makeDeclaration(
-    const std::string &type,
-    const std::string &name,
-    std::unique_ptr<ASTNode> expr,
-    int line)
-{
-    auto node = std::make_unique<DeclarationNode>(type, name, std::move(expr));
-    node->lineNumber = line;
-    //std::cout << "d line no is" << line << std::endl;
-    return node;
-}
-
-std::unique_ptr<PrintStmtNode> makePrintStmt(std::unique_ptr<ASTNode> expr, int line)
-{
-    auto node = std::make_unique<PrintStmtNode>(std::move(expr));
-    node->lineNumber = line;
-    return node;
-}
-
-std::unique_ptr<ReturnStmtNode> makeReturnStmt(std::unique_ptr<ASTNode> expr, int line)
-{
-    auto node = std::make_unique<ReturnStmtNode>(std::move(expr));
-    node->lineNumber = line;
-    return node;
-}
-
-std::unique_ptr<IfStmtNode> makeIfStmt(
-    std::unique_ptr<ASTNode> condition,
-    std::unique_ptr<ASTNode> thenBlock,
-    std::unique_ptr<ASTNode> elseBlock,
-    int line)
-{
-    auto node = std::make_unique<IfStmtNode>(std::move(condition), std::move(thenBlock), std::move(elseBlock));
-    node->lineNumber = line;
-    return node;
-}
-
-std::unique_ptr<RepeatStmtNode> makeRepeatStmt(
-    std::unique_ptr<ASTNode> condition,
-    std::unique_ptr<ASTNode> body,
-    int line)
-{
-    auto node = std::make_unique<RepeatStmtNode>(std::move(condition), std::move(body));
-    node->lineNumber = line;
-    return node;
-}
-
-// -------------------- Assignment --------------------
-std::unique_ptr<ASTNode> makeAssignment(const std::string &name, std::unique_ptr<ASTNode> expr, int line)
-{
-    auto node = std::make_unique<AssignmentNode>(name, std::move(expr));
-    node->lineNumber = line;
-    return node;
-}
-
-// -------------------- Block --------------------
-std::unique_ptr<BlockNode> makeBlock(std::unique_ptr<std::vector<std::unique_ptr<ASTNode>>> statements, int line)
-{
-    auto node = std::make_unique<BlockNode>(std::move(statements));
-    node->lineNumber = line;
-    return node;
-}
-
-void addToBlock(BlockNode *block, std::unique_ptr<ASTNode> stmt)
-{
-    block->statements.push_back(std::move(stmt));
-}
-
-// -------------------- Program --------------------
-std::unique_ptr<ProgramNode> makeProgram()
-{
-    auto node = std::make_unique<ProgramNode>();
-    // node->lineNumber = line;
-    return node;
-}
-
-void addToProgram(std::unique_ptr<ASTNode> stmt)
-{
-    if (!stmt)
-        return;
-    if (!astRoot)
-        astRoot = std::make_unique<ProgramNode>();
-    astRoot->statements.push_back(std::move(stmt));
-}
-
-// -------------------- Break/Continue --------------------
-std::unique_ptr<BreakNode> makeBreak(int line)
-{
-    auto node = std::make_unique<BreakNode>(line);
-    node->lineNumber = line;
-    return node;
-}
-
-std::unique_ptr<ContinueNode> makeContinue(int line)
-{
-    auto node = std::make_unique<ContinueNode>(line);
-    node->lineNumber = line;
-    return node;
-}
-
-// -------------------- Builtin Call --------------------
-std::unique_ptr<BuiltinCallNode> makeBuiltinCall(const std::string &name, std::vector<ASTNodePtr> args, int line)
-{
-    auto node = std::make_unique<BuiltinCallNode>(name, std::move(args));
-    node->lineNumber = line;
-    return node;
-}
-
-
-
-
-//---Symanitc Analysis---
-
-std::string BreakNode::analyze(SymbolTable &symbols) const
-{
-    if (symbols.loopDepth == 0) {
-        std::cerr << "Semantic Error at line " << line << ": 'stop' used outside of loop.\n";
-    }
-    return "void";
-}
-
-std::string ContinueNode::analyze(SymbolTable &symbols) const
-{
-    if (symbols.loopDepth == 0) {
-        std::cerr << "Semantic Error at line " << line << ": 'skip' used outside of loop.\n";
-    }
-    return "void";
-}
-
-std::string LiteralNode::analyze(SymbolTable &symbols) const
-{
-    switch (type)
-    {
-    case Type::Int:
-        return "int";
-    case Type::Float:
-        return "float";
-    case Type::String:
-        return "string";
-    case Type::Char:
-        return "char";
-    case Type::Bool:
-        return "bool";
-    }
-    return "unknown";
-}
-
-std::string IdentifierNode::analyze(SymbolTable &symbols) const
-{
-    try{
-        const Symbol &result = symbols.lookup(name);
-        return result.type;
-    }
-    catch (const std::runtime_error &e)
-    {
-        std::cerr << "Error: " << e.what() << "\n";
-        return "error";
-    }
-}
-
-std::string DeclarationNode::analyze(SymbolTable &symbols) const
-{
-    std::string exprType = expr->analyze(symbols);
-    if (exprType != typeName)
-    {
-        std::cerr << "Type mismatch in declaration of '" << identifier
-                  << "': expected " << typeName << ", got " << exprType << "\n";
-    }
-    symbols.declare(identifier, typeName, lineNumber);
-    return "void";
-}
-
-std::string AssignmentNode::analyze(SymbolTable &symbols) const
-{
-    try
-    {
-        const Symbol &declaredSymbol = symbols.lookup(name);
-        std::string valueType = value->analyze(symbols);
-
-        if (declaredSymbol.type != valueType)
-        {
-            std::cerr << "Type mismatch in assignment to '" << name
-                      << "': expected " << declaredSymbol.type << ", got " << valueType << "\n";
-        }
-
-        return "void";
-    }
-    catch (const std::runtime_error &e)
-    {
-        std::cerr << "Error: " << e.what() << "\n";
-        return "error";
-    }
-}
-
-std::string BinaryExprNode::analyze(SymbolTable &symbols) const
-{
-    std::string leftType = left->analyze(symbols);
-    std::string rightType = right->analyze(symbols);
-
-    if (leftType != rightType)
-    {
-        std::cerr << "Type mismatch in binary expression: " << leftType << " vs " << rightType << "\n";
-        return "error";
-    }
-
-    switch (op)
-    {
-    case Op::Add:
-    case Op::Sub:
-    case Op::Mul:
-    case Op::Div:
-        return (leftType == "int" || leftType == "float") ? leftType : "error";
-
-    case Op::Eq:
-    case Op::Neq:
-    case Op::Lt:
-    case Op::Gt:
-    case Op::Leq:
-    case Op::Geq:
-        return "bool";
-
-    case Op::And:
-    case Op::Or:
-        if (leftType != "bool")
-            std::cerr << "Logical operators require boolean types\n";
-        return "bool";
-    }
-    return "error";
-}
-
-std::string UnaryExprNode::analyze(SymbolTable &symbols) const
-{
-    std::string operandType = operand->analyze(symbols);
-    if (op == Op::Not && operandType != "bool")
-    {
-        std::cerr << "Error: 'not' operator requires a boolean operand\n";
-        return "error";
-    }
-    if (op == Op::Minus && operandType != "int" && operandType != "float")
-    {
-        std::cerr << "Error: '-' operator requires an integer or float operand\n";
-        return "error";
-    }
-    return operandType;
-}
-
-std::string BlockNode::analyze(SymbolTable &symbols) const
-{
-    symbols.enterScope();
-    for (const auto &stmt : statements)
-    {
-        stmt->analyze(symbols);
-    }
-    symbols.exitScope();
-    return "void";
-}
-
-std::string ProgramNode::analyze(SymbolTable &symbols) const
-{
-    //symbols.enterScope();
-    for (const auto &stmt : statements)
-    {
-        stmt->analyze(symbols);
-    }
-    //symbols.exitScope();
-    return "void";
-}
-
-std::string IfStmtNode::analyze(SymbolTable &symbols) const
-{
-    std::string condType = condition->analyze(symbols);
-    if (condType != "bool")
-    {
-        std::cerr << "Line " << lineNumber << ": Condition in if statement must be of type 'bool', got '" << condType << "'\n";
-    }
-
-    //symbols.enterScope();
-    thenBlock->analyze(symbols);
-    //symbols.exitScope();
-
-    if (elseBlock)
-    {
-        //symbols.enterScope();
-        elseBlock->analyze(symbols);
-        //symbols.exitScope();
-    }
-
-    return "void";
-}
-
-std::string RepeatStmtNode::analyze(SymbolTable &symbols) const
-{
-    std::string condType = condition->analyze(symbols);
-    if (condType != "bool")
-    {
-        std::cerr << "Line " << lineNumber << ": Condition in repeat statement must be of type 'bool', got '" << condType << "'\n";
-    }
-    
-    symbolTable.enterLoop();
-    //symbols.enterScope();
-    body->analyze(symbols);
-    //symbols.exitScope();
-    symbolTable.exitLoop();
-
-    return "void";
-}
-
-std::string ReturnStmtNode::analyze(SymbolTable &symbols) const
-{
-    std::string exprType = expr->analyze(symbols);
-    std::cout << "Line " << lineNumber << ": return " << exprType << "\n";
-    // You can extend this later with function return type checking.
-    return exprType;
-}
-
-std::string PrintStmtNode::analyze(SymbolTable &symbols) const
-{
-    expr->analyze(symbols); // Analyze the expression being printed
-    return "void";
-}
-
-std::string BuiltinCallNode::analyze(SymbolTable &symbols) const
-{
-
-    return "unknown"; // You can update this later with proper return types
-}
+#include "ast.h"
+#include "ast_interface.h"
+#include "SymbolTable.h"
+
+#include <algorithm>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <iostream>
+
+// -------------------- Literal Builders --------------------
+LiteralNode *makeIntLiteral(AstArena &arena, int value, int line)
+{
+    auto node = arena.make<LiteralNode>(LiteralNode::Type::Int);
+    node->intValue = value;
+    node->lineNumber = line;
+
+    return node;
+}
+
+LiteralNode *makeFloatLiteral(AstArena &arena, float value, int line)
+{
+    auto node = arena.make<LiteralNode>(LiteralNode::Type::Float);
+    node->floatValue = value;
+    node->lineNumber = line;
+    return node;
+}
+
+LiteralNode *makeStringLiteral(AstArena &arena, std::string_view value, int line)
+{
+    auto node = arena.make<LiteralNode>(LiteralNode::Type::String);
+    node->stringValue = value;
+    node->lineNumber = line;
+    return node;
+}
+
+LiteralNode *makeCharLiteral(AstArena &arena, char value, int line)
+{
+    auto node = arena.make<LiteralNode>(LiteralNode::Type::Char);
+    node->charValue = value;
+    node->lineNumber = line;
+    return node;
+}
+
+LiteralNode *makeBoolLiteral(AstArena &arena, bool value, int line)
+{
+    auto node = arena.make<LiteralNode>(LiteralNode::Type::Bool);
+    node->boolValue = value;
+    node->lineNumber = line;
+    return node;
+}
+
+// -------------------- Identifier --------------------
+IdentifierNode *makeIdentifier(AstArena &arena, IdentId id, std::string_view name, int line)
+{
+    auto node = arena.make<IdentifierNode>(id, name);
+    node->lineNumber = line;
+    return node;
+}
+
+// One more than the deepest of the children; null ones are skipped
+static uint32_t depthAbove(std::initializer_list<const ASTNode *> children)
+{
+    uint32_t deepest = 0;
+    for (const ASTNode *child : children)
+        if (child && child->depth > deepest)
+            deepest = child->depth;
+    return deepest + 1;
+}
+
+// -------------------- Expressions --------------------
+ArrayLiteralNode *makeArrayLiteral(AstArena &arena, NodeList *elements, int line)
+{
+    auto node = arena.make<ArrayLiteralNode>(*elements);
+    node->lineNumber = line;
+    for (const ASTNode *element : node->elements)
+        node->depth = std::max(node->depth, element->depth + 1);
+    return node;
+}
+
+IndexExprNode *makeIndexExpr(AstArena &arena, IdentId id, std::string_view name, ASTNode *index, int line)
+{
+    auto node = arena.make<IndexExprNode>(id, name, index);
+    node->lineNumber = line;
+    node->depth = depthAbove({index});
+    return node;
+}
+
+BinaryExprNode *makeBinaryExpr(
+    AstArena &arena,
+    ASTNode *left,
+    BinaryExprNode::Op op,
+    ASTNode *right,
+    int line)
+{
+    auto node = arena.make<BinaryExprNode>(left, op, right);
+    node->lineNumber = line;
+    node->depth = depthAbove({left, right});
+    return node;
+}
+
+UnaryExprNode *makeUnaryExpr(AstArena &arena, UnaryExprNode::Op op, ASTNode *operand, int line)
+{
+    auto node = arena.make<UnaryExprNode>(op, operand);
+    node->lineNumber = line;
+    node->depth = depthAbove({operand});
+    return node;
+}
+
+// -------------------- Statements --------------------
+DeclarationNode *makeDeclaration(
+    AstArena &arena,
+    TypeId type,
+    IdentId id,
+    std::string_view name,
+    ASTNode *expr,
+    int line)
+{
+    auto node = arena.make<DeclarationNode>(type, id, name, expr);
+    node->lineNumber = line;
+    node->depth = depthAbove({expr});
+    //std::cout << "d line no is" << line << std::endl;
+    return node;
+}
+
+PrintStmtNode *makePrintStmt(AstArena &arena, ASTNode *expr, int line)
+{
+    auto node = arena.make<PrintStmtNode>(expr);
+    node->lineNumber = line;
+    node->depth = depthAbove({expr});
+    return node;
+}
+
+ReturnStmtNode *makeReturnStmt(AstArena &arena, ASTNode *expr, int line)
+{
+    auto node = arena.make<ReturnStmtNode>(expr);
+    node->lineNumber = line;
+    node->depth = depthAbove({expr});
+    return node;
+}
+
+IfStmtNode *makeIfStmt(
+    AstArena &arena,
+    ASTNode *condition,
+    ASTNode *thenBlock,
+    ASTNode *elseBlock,
+    int line)
+{
+    auto node = arena.make<IfStmtNode>(condition, thenBlock, elseBlock);
+    node->lineNumber = line;
+    node->depth = depthAbove({condition, thenBlock, elseBlock});
+    return node;
+}
+
+RepeatStmtNode *makeRepeatStmt(
+    AstArena &arena,
+    ASTNode *condition,
+    ASTNode *body,
+    int line)
+{
+    auto node = arena.make<RepeatStmtNode>(condition, body);
+    node->lineNumber = line;
+    node->depth = depthAbove({condition, body});
+    return node;
+}
+
+ParallelRepeatNode *makeParallelRepeat(
+    AstArena &arena,
+    IdentId id,
+    std::string_view name,
+    ASTNode *start,
+    ASTNode *end,
+    NodeList *reductions,
+    ASTNode *body,
+    int line)
+{
+    auto node = arena.make<ParallelRepeatNode>(id, name, start, end, *reductions, body);
+    node->lineNumber = line;
+    node->depth = depthAbove({start, end, body});
+    return node;
+}
+
+// -------------------- Assignment --------------------
+ASTNode *makeAssignment(AstArena &arena, IdentId id, std::string_view name, ASTNode *expr, int line)
+{
+    auto node = arena.make<AssignmentNode>(id, name, nullptr, expr);
+    node->lineNumber = line;
+    node->depth = depthAbove({expr});
+    return node;
+}
+
+ASTNode *makeElementAssignment(AstArena &arena, IdentId id, std::string_view name, ASTNode *index, ASTNode *expr,
+                               int line)
+{
+    auto node = arena.make<AssignmentNode>(id, name, index, expr);
+    node->lineNumber = line;
+    node->depth = depthAbove({index, expr});
+    return node;
+}
+
+// -------------------- Block --------------------
+NodeList *makeStatementList(AstArena &arena)
+{
+    return arena.make<NodeList>();
+}
+
+BlockNode *makeBlock(AstArena &arena, NodeList *statements, int line)
+{
+    auto node = arena.make<BlockNode>(*statements);
+    node->lineNumber = line;
+    for (const ASTNode *stmt : node->statements)
+        node->depth = std::max(node->depth, stmt->depth + 1);
+    return node;
+}
+
+void addToBlock(AstArena &arena, BlockNode *block, ASTNode *stmt)
+{
+    block->statements.push_back(arena, stmt);
+    block->depth = std::max(block->depth, stmt->depth + 1);
+}
+
+// -------------------- Program --------------------
+ProgramNode *makeProgram(AstArena &arena)
+{
+    auto node = arena.make<ProgramNode>();
+    // node->lineNumber = line;
+    return node;
+}
+
+void addToProgram(AstArena &arena, ProgramNode *program, ASTNode *stmt)
+{
+    if (!stmt)
+        return;
+    program->addStatement(arena, stmt);
+    program->depth = std::max(program->depth, stmt->depth + 1);
+}
+
+// -------------------- Break/Continue --------------------
+BreakNode *makeBreak(AstArena &arena, int line)
+{
+    auto node = arena.make<BreakNode>(line);
+    node->lineNumber = line;
+    return node;
+}
+
+ContinueNode *makeContinue(AstArena &arena, int line)
+{
+    auto node = arena.make<ContinueNode>(line);
+    node->lineNumber = line;
+    return node;
+}
+
+// -------------------- Builtin Call --------------------
+BuiltinCallNode *makeBuiltinCall(AstArena &arena, std::string_view name, NodeList args, int line)
+{
+    auto node = arena.make<BuiltinCallNode>(arena.copyString(name), args);
+    node->lineNumber = line;
+    for (const ASTNode *arg : node->args)
+        node->depth = std::max(node->depth, arg->depth + 1);
+    return node;
+}
+
+
+
+
+//---Symanitc Analysis---
+//
+// Every node records its result in its `type`, so later phases read types
+// off the tree instead of re-deriving them; a node's checks run once its
+// children's types are in. An operand of type Error has already been
+// reported, so its parents stay quiet and propagate Error rather than
+// cascading diagnostics.
+
+TypeId ASTNode::analyze(SymbolTable &symbols)
+{
+    walkTree(this, [&](ASTNode *node, unsigned stage) { return node->analyzeStep(symbols, stage); });
+    return type;
+}
+
+void ASTNode::print(std::ostream &out) const
+{
+    walkTree(this, [&](const ASTNode *node, unsigned stage) { return node->printStep(out, stage); });
+}
+
+ASTNode *BreakNode::analyzeStep(SymbolTable &symbols, unsigned)
+{
+    if (symbols.loopDepth == 0) {
+        symbols.error() << "Semantic Error at line " << line << ": 'stop' used outside of loop.\n";
+    }
+    type = TypeId::Void;
+    return nullptr;
+}
+
+ASTNode *ContinueNode::analyzeStep(SymbolTable &symbols, unsigned)
+{
+    if (symbols.loopDepth == 0) {
+        symbols.error() << "Semantic Error at line " << line << ": 'skip' used outside of loop.\n";
+    }
+    type = TypeId::Void;
+    return nullptr;
+}
+
+ASTNode *LiteralNode::analyzeStep(SymbolTable &, unsigned)
+{
+    switch (literalType)
+    {
+    case Type::Int:
+        type = TypeId::Int;
+        break;
+    case Type::Float:
+        type = TypeId::Float;
+        break;
+    case Type::String:
+        type = TypeId::String;
+        break;
+    case Type::Char:
+        type = TypeId::Char;
+        break;
+    case Type::Bool:
+        type = TypeId::Bool;
+        break;
+    }
+    return nullptr;
+}
+
+ASTNode *IdentifierNode::analyzeStep(SymbolTable &symbols, unsigned)
+{
+    const Symbol *result = symbols.lookup(id);
+    if (!result)
+    {
+        symbols.error() << "Error: Variable '" << name << "' not declared.\n";
+        type = TypeId::Error;
+        return nullptr;
+    }
+    slot = result->slot;
+    type = result->type;
+    return nullptr;
+}
+
+// Checks a[index], its index analyzed, against the declaration of a, whose
+// type is arrayType. A constant index has to be in range; any other is
+// checked at run time.
+static bool checkIndex(SymbolTable &symbols, ASTNode *index, std::string_view name, TypeId arrayType, int line)
+{
+    TypeId indexType = index->type;
+    if (arrayType.isError())
+        return false;
+    if (!arrayType.isArray())
+    {
+        symbols.error() << "Line " << line << ": '" << name << "' is a " << arrayType.name()
+                        << ", not an array\n";
+        return false;
+    }
+    if (indexType.isError())
+        return false;
+    if (indexType != TypeId::Int)
+    {
+        symbols.error() << "Line " << line << ": array index must be of type 'int', got '" << indexType.name()
+                        << "'\n";
+        return false;
+    }
+    auto constant = dynCast<LiteralNode>(index);
+    if (constant && (constant->intValue < 0 || static_cast<uint32_t>(constant->intValue) >= arrayType.length()))
+    {
+        symbols.error() << "Line " << line << ": index " << constant->intValue << " is out of range for '" << name
+                        << "' (" << arrayType.name() << ")\n";
+        return false;
+    }
+    return true;
+}
+
+// Each element is checked as soon as it is analyzed, and the first that
+// does not fit ends the analysis. Until the last element is in, `type`
+// holds the type of the first good one.
+ASTNode *ArrayLiteralNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    if (stage == 0)
+        type = TypeId::Unknown;
+    else if (TypeId t = elements[stage - 1]->type; !t.isError())
+    {
+        if (!t.isNumeric())
+        {
+            symbols.error() << "Line " << lineNumber << ": array elements must be int or float, got '" << t.name()
+                            << "'\n";
+            type = TypeId::Error;
+            return nullptr;
+        }
+        if (type == TypeId::Unknown)
+            type = t;
+        else if (t != type)
+        {
+            symbols.error() << "Line " << lineNumber << ": array elements must all have one type, got '"
+                            << type.name() << "' and '" << t.name() << "'\n";
+            type = TypeId::Error;
+            return nullptr;
+        }
+    }
+    if (stage < elements.size())
+        return elements[stage];
+
+    TypeId elementType = type;
+    type = TypeId::Error;
+    for (const ASTNode *element : elements)
+        if (element->type.isError())
+            return nullptr;
+    if (elements.size() > TypeId::MaxArrayLength)
+    {
+        symbols.error() << "Line " << lineNumber << ": array literal has " << elements.size()
+                        << " elements, more than " << TypeId::MaxArrayLength << "\n";
+        return nullptr;
+    }
+    type = TypeId::array(elementType, static_cast<int>(elements.size()));
+    return nullptr;
+}
+
+// Until the index is in, `type` holds the array's, or Error if there is none
+ASTNode *IndexExprNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    if (stage == 0)
+    {
+        const Symbol *array = symbols.lookup(id);
+        if (!array)
+        {
+            symbols.error() << "Error: Variable '" << name << "' not declared.\n";
+            type = TypeId::Error;
+            return index;
+        }
+        slot = array->slot;
+        type = array->type;
+        return index;
+    }
+    if (!type.isError())
+        type = checkIndex(symbols, index, name, type, lineNumber) ? type.element() : TypeId::Error;
+    return nullptr;
+}
+
+// An expression whose type comes from where it is used (input() without a
+// type hint) takes the type of the variable it initialises or assigns.
+static TypeId adoptContextType(ASTNode *expr, TypeId exprType, TypeId expected)
+{
+    if (exprType == TypeId::Unknown)
+        return expr->type = expected;
+    return exprType;
+}
+
+// What an array can be set from: an array of its own type, or one value of
+// its element type that every element gets. input() reads a single value,
+// so it cannot set a whole array.
+static bool checkArrayValue(SymbolTable &symbols, const char *what, std::string_view name, TypeId arrayType,
+                            TypeId valueType)
+{
+    if (valueType == TypeId::Unknown)
+    {
+        symbols.error() << "Error: input() reads one value and cannot " << what << " array '" << name
+                        << "'; read its elements one at a time\n";
+        return false;
+    }
+    if (valueType != arrayType && valueType != arrayType.element() && !valueType.isError())
+    {
+        symbols.error() << "Type mismatch in " << what << " of '" << name << "': expected " << arrayType.name()
+                        << " or " << arrayType.element().name() << ", got " << valueType.name() << "\n";
+        return false;
+    }
+    return true;
+}
+
+ASTNode *DeclarationNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    if (stage == 0)
+        return expr;
+    type = TypeId::Void;
+    if (declType.isArray())
+    {
+        TypeId exprType = expr->type;
+        if (declType.length() == 0)
+            symbols.error() << "Error at line no " << lineNumber << ": array '" << identifier << "' must have 1 to "
+                            << TypeId::MaxArrayLength << " elements\n";
+        else
+            checkArrayValue(symbols, "declaration", identifier, declType, exprType);
+        slot = symbols.declare(id, declType, lineNumber);
+        return nullptr;
+    }
+
+    TypeId exprType = adoptContextType(expr, expr->type, declType);
+    if (exprType != declType && !exprType.isError())
+    {
+        symbols.error() << "Type mismatch in declaration of '" << identifier
+                  << "': expected " << declType.name() << ", got " << exprType.name() << "\n";
+    }
+    slot = symbols.declare(id, declType, lineNumber);
+    return nullptr;
+}
+
+// Until the value is in, `type` holds what the value has to be, or Error if
+// the variable or the index is wrong; the value is then only analyzed for
+// its own errors
+ASTNode *AssignmentNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    if (stage == 0)
+    {
+        const Symbol *declaredSymbol = symbols.lookup(id);
+        if (!declaredSymbol)
+        {
+            symbols.error() << "Error: Variable '" << name << "' not declared.\n";
+            type = TypeId::Error;
+            return value;
+        }
+        slot = declaredSymbol->slot;
+        type = declaredSymbol->type;
+        return index ? index : value;
+    }
+    if (type.isError())
+        return nullptr;
+    if (stage == 1 && index)
+    {
+        // a[i] = value sets one element, so it takes what the element does
+        type = checkIndex(symbols, index, name, type, lineNumber) ? type.element() : TypeId::Error;
+        return value;
+    }
+
+    TypeId declaredType = type;
+    type = TypeId::Void;
+    if (declaredType.isArray())
+    {
+        checkArrayValue(symbols, "assignment", name, declaredType, value->type);
+        return nullptr;
+    }
+    TypeId valueType = adoptContextType(value, value->type, declaredType);
+    if (declaredType != valueType && !valueType.isError())
+    {
+        symbols.error() << "Type mismatch in assignment to '" << name
+                  << "': expected " << declaredType.name() << ", got " << valueType.name() << "\n";
+    }
+    return nullptr;
+}
+
+ASTNode *BinaryExprNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    switch (stage)
+    {
+    case 0:
+        return left;
+    case 1:
+        return right;
+    default:
+        analyzeOperator(left->type, right->type, symbols);
+        return nullptr;
+    }
+}
+
+TypeId BinaryExprNode::analyzeOperator(TypeId leftType, TypeId rightType, SymbolTable &symbols)
+{
+    if (leftType.isError() || rightType.isError())
+        return type = TypeId::Error;
+
+    // Arithmetic on arrays goes element by element, and a value of the
+    // element type on one side stands for an array of copies of itself
+    if (leftType.isArray() || rightType.isArray())
+    {
+        TypeId arrayType = leftType.isArray() ? leftType : rightType;
+        TypeId otherType = leftType.isArray() ? rightType : leftType;
+        if (op != Op::Add && op != Op::Sub && op != Op::Mul && op != Op::Div)
+        {
+            symbols.error() << "Error: Only arithmetic operators apply to arrays, got " << arrayType.name() << "\n";
+            return type = TypeId::Error;
+        }
+        if (otherType != arrayType && otherType != arrayType.element())
+        {
+            symbols.error() << "Type mismatch in binary expression: " << leftType.name() << " vs " << rightType.name() << "\n";
+            return type = TypeId::Error;
+        }
+        return type = arrayType;
+    }
+
+    if (leftType != rightType)
+    {
+        symbols.error() << "Type mismatch in binary expression: " << leftType.name() << " vs " << rightType.name() << "\n";
+        return type = TypeId::Error;
+    }
+
+    switch (op)
+    {
+    case Op::Add:
+        if (leftType == TypeId::String)
+            return type = leftType; // Concatenation
+        [[fallthrough]];
+    case Op::Sub:
+    case Op::Mul:
+    case Op::Div:
+        if (!leftType.isNumeric())
+        {
+            symbols.error() << "Error: Arithmetic operators require int or float operands, got " << leftType.name() << "\n";
+            return type = TypeId::Error;
+        }
+        return type = leftType;
+
+    case Op::Eq:
+    case Op::Neq:
+    case Op::Lt:
+    case Op::Gt:
+    case Op::Leq:
+    case Op::Geq:
+        return type = TypeId::Bool;
+
+    case Op::And:
+    case Op::Or:
+        if (leftType != TypeId::Bool)
+            symbols.error() << "Logical operators require boolean types\n";
+        return type = TypeId::Bool;
+    }
+    return type = TypeId::Error;
+}
+
+ASTNode *UnaryExprNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    if (stage == 0)
+        return operand;
+    analyzeOperator(operand->type, symbols);
+    return nullptr;
+}
+
+TypeId UnaryExprNode::analyzeOperator(TypeId operandType, SymbolTable &symbols)
+{
+    if (operandType.isError())
+        return type = TypeId::Error;
+    if (op == Op::Not && operandType != TypeId::Bool)
+    {
+        symbols.error() << "Error: 'not' operator requires a boolean operand\n";
+        return type = TypeId::Error;
+    }
+    if (op == Op::Minus && !operandType.isNumeric() && !operandType.isArray())
+    {
+        symbols.error() << "Error: '-' operator requires an integer or float operand\n";
+        return type = TypeId::Error;
+    }
+    return type = operandType;
+}
+
+static const char *operatorText(BinaryExprNode::Op op)
+{
+    switch (op)
+    {
+    case BinaryExprNode::Op::Add:
+        return " + ";
+    case BinaryExprNode::Op::Sub:
+        return " - ";
+    case BinaryExprNode::Op::Mul:
+        return " * ";
+    case BinaryExprNode::Op::Div:
+        return " / ";
+    case BinaryExprNode::Op::Eq:
+        return " == ";
+    case BinaryExprNode::Op::Neq:
+        return " != ";
+    case BinaryExprNode::Op::Lt:
+        return " < ";
+    case BinaryExprNode::Op::Gt:
+        return " > ";
+    case BinaryExprNode::Op::Leq:
+        return " <= ";
+    case BinaryExprNode::Op::Geq:
+        return " >= ";
+    case BinaryExprNode::Op::And:
+        return " and ";
+    case BinaryExprNode::Op::Or:
+        return " or ";
+    }
+    return " ? ";
+}
+
+// Binary operators print as (left + right), unary ones as Unary(-operand)
+const ASTNode *BinaryExprNode::printStep(std::ostream &out, unsigned stage) const
+{
+    switch (stage)
+    {
+    case 0:
+        out << "(";
+        return left;
+    case 1:
+        out << operatorText(op);
+        return right;
+    default:
+        out << ")";
+        return nullptr;
+    }
+}
+
+const ASTNode *UnaryExprNode::printStep(std::ostream &out, unsigned stage) const
+{
+    if (stage == 0)
+    {
+        out << (op == Op::Not ? "Unary(not " : "Unary(-");
+        return operand;
+    }
+    out << ")";
+    return nullptr;
+}
+
+ASTNode *BlockNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    if (stage == 0)
+        symbols.enterScope();
+    if (stage < statements.size())
+        return statements[stage];
+    symbols.exitScope();
+    type = TypeId::Void;
+    return nullptr;
+}
+
+ASTNode *ProgramNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    if (stage < statements.size())
+        return statements[stage];
+    slotCount = symbols.slotCount();
+    type = TypeId::Void;
+    return nullptr;
+}
+
+ASTNode *IfStmtNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    switch (stage)
+    {
+    case 0:
+        return condition;
+    case 1:
+        if (condition->type != TypeId::Bool && !condition->type.isError())
+        {
+            symbols.error() << "Line " << lineNumber << ": Condition in if statement must be of type 'bool', got '" << condition->type.name() << "'\n";
+        }
+        return thenBlock;
+    case 2:
+        if (elseBlock)
+            return elseBlock;
+        break;
+    }
+    type = TypeId::Void;
+    return nullptr;
+}
+
+ASTNode *RepeatStmtNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    switch (stage)
+    {
+    case 0:
+        return condition;
+    case 1:
+        if (condition->type != TypeId::Bool && !condition->type.isError())
+        {
+            symbols.error() << "Line " << lineNumber << ": Condition in repeat statement must be of type 'bool', got '" << condition->type.name() << "'\n";
+        }
+        symbols.enterLoop();
+        return body;
+    }
+    symbols.exitLoop();
+    type = TypeId::Void;
+    return nullptr;
+}
+
+namespace
+{
+
+// What keeps the iterations of a parallel repeat independent, so that they
+// can run at once and in any order: nothing from outside the body changes
+// but the reductions, each only as r = r + e, r - e or r * e and never read
+// otherwise, and elements of arrays at the loop index, which no other
+// iteration reads; no input or output, and no stop out of the loop. Runs
+// over the analyzed body, whose slots below the loop variable's are the
+// variables from outside, while the loop's scope is still open.
+class ParallelBodyCheck
+{
+public:
+    ParallelBodyCheck(SymbolTable &symbols, const ParallelRepeatNode &loop)
+        : symbols(symbols), loop(loop), updates(loop.reductions.size(), Unused)
+    {
+    }
+
+    void run()
+    {
+        walkTree(static_cast<const ASTNode *>(loop.body),
+                 [this](const ASTNode *node, unsigned stage) { return step(node, stage); });
+        for (const ArrayUse &use : otherUses)
+            if (std::find(written.begin(), written.end(), use.slot) != written.end())
+            {
+                symbols.error() << "Line " << use.line << ": array '" << use.name
+                                << "' is set at index '" << loop.name << "' in this parallel repeat, so it can"
+                                << " only be read at '" << loop.name << "' in it too\n";
+                return;
+            }
+    }
+
+    // Bit r set: reduction r is updated by *
+    uint32_t products() const
+    {
+        uint32_t mask = 0;
+        for (size_t r = 0; r < updates.size(); ++r)
+            if (updates[r] == Product)
+                mask |= 1u << r;
+        return mask;
+    }
+
+private:
+    enum Update
+    {
+        Unused,
+        Sum, // + and -
+        Product
+    };
+
+    struct ArrayUse
+    {
+        uint32_t slot;
+        std::string_view name;
+        int line;
+    };
+
+    SymbolTable &symbols;
+    const ParallelRepeatNode &loop;
+    std::vector<Update> updates;     // By reduction
+    std::vector<uint32_t> written;   // Arrays from outside set at the loop index
+    std::vector<ArrayUse> otherUses; // ... and used other than at it
+    int loops = 0;                   // repeat loops inside the body around the node
+
+    bool isShared(uint32_t slot) const { return slot < loop.slot; }
+
+    bool isLoopIndex(const ASTNode *index) const
+    {
+        auto ident = dynCast<IdentifierNode>(index);
+        return ident && ident->slot == loop.slot;
+    }
+
+    // Index into loop.reductions, or -1
+    int reduction(uint32_t slot) const
+    {
+        for (size_t r = 0; r < loop.reductions.size(); ++r)
+            if (static_cast<const IdentifierNode *>(loop.reductions[r])->slot == slot)
+                return static_cast<int>(r);
+        return -1;
+    }
+
+    void sharedArray(uint32_t slot, std::string_view name, const ASTNode *index, int line)
+    {
+        if (!isLoopIndex(index))
+            otherUses.push_back({slot, name, line});
+    }
+
+    // The check at a node, as a step of walkTree
+    const ASTNode *step(const ASTNode *node, unsigned stage)
+    {
+        switch (node->kind)
+        {
+        case NodeKind::Literal:
+        case NodeKind::Continue:
+        case NodeKind::Program:
+            return nullptr;
+        case NodeKind::Identifier:
+        {
+            auto ident = static_cast<const IdentifierNode *>(node);
+            if (reduction(ident->slot) >= 0)
+                misusedReduction(ident->name, ident->lineNumber);
+            else if (isShared(ident->slot) && ident->type.isArray())
+                sharedArray(ident->slot, ident->name, nullptr, ident->lineNumber);
+            return nullptr;
+        }
+        case NodeKind::IndexExpr:
+        {
+            auto index = static_cast<const IndexExprNode *>(node);
+            if (stage == 0)
+                return index->index;
+            if (isShared(index->slot))
+                sharedArray(index->slot, index->name, index->index, index->lineNumber);
+            return nullptr;
+        }
+        case NodeKind::BinaryExpr:
+        {
+            auto bin = static_cast<const BinaryExprNode *>(node);
+            return stage == 0 ? bin->left : stage == 1 ? bin->right : nullptr;
+        }
+        case NodeKind::UnaryExpr:
+            return stage == 0 ? static_cast<const UnaryExprNode *>(node)->operand : nullptr;
+        case NodeKind::ArrayLiteral:
+        {
+            auto &elements = static_cast<const ArrayLiteralNode *>(node)->elements;
+            return stage < elements.size() ? elements[stage] : nullptr;
+        }
+        case NodeKind::BuiltinCall:
+        {
+            auto call = static_cast<const BuiltinCallNode *>(node);
+            if (stage == 0 && call->funcName == "input")
+                symbols.error() << "Line " << call->lineNumber << ": input() cannot be used in a parallel repeat\n";
+            return stage < call->args.size() ? call->args[stage] : nullptr;
+        }
+        case NodeKind::Declaration:
+            return stage == 0 ? static_cast<const DeclarationNode *>(node)->expr : nullptr;
+        case NodeKind::Assignment:
+            return assignment(static_cast<const AssignmentNode *>(node), stage);
+        case NodeKind::PrintStmt:
+            symbols.error() << "Line " << node->lineNumber
+                            << ": print() cannot be used in a parallel repeat; reduce the results and print"
+                            << " them after it\n";
+            return nullptr;
+        case NodeKind::ReturnStmt:
+            return stage == 0 ? static_cast<const ReturnStmtNode *>(node)->expr : nullptr;
+        case NodeKind::IfStmt:
+        {
+            auto ifStmt = static_cast<const IfStmtNode *>(node);
+            return stage == 0 ? ifStmt->condition : stage == 1 ? ifStmt->thenBlock : stage == 2 ? ifStmt->elseBlock : nullptr;
+        }
+        case NodeKind::RepeatStmt:
+        {
+            auto repeat = static_cast<const RepeatStmtNode *>(node);
+            switch (stage)
+            {
+            case 0:
+                ++loops;
+                return repeat->body;
+            case 1:
+                return repeat->condition;
+            }
+            --loops;
+            return nullptr;
+        }
+        case NodeKind::ParallelRepeat:
+            symbols.error() << "Line " << node->lineNumber << ": a parallel repeat cannot be nested in another\n";
+            return nullptr;
+        case NodeKind::Block:
+        {
+            auto &statements = static_cast<const BlockNode *>(node)->statements;
+            return stage < statements.size() ? statements[stage] : nullptr;
+        }
+        case NodeKind::Break:
+            if (loops == 0)
+                symbols.error() << "Line " << node->lineNumber << ": 'stop' cannot leave a parallel repeat\n";
+            return nullptr;
+        }
+        return nullptr;
+    }
+
+    // The check of an assignment, as a step
+    const ASTNode *assignment(const AssignmentNode *assign, unsigned stage)
+    {
+        if (!isShared(assign->slot) && assign->slot != loop.slot)
+        {
+            if (assign->index && stage == 0)
+                return assign->index;
+            return stage == (assign->index ? 1u : 0u) ? assign->value : nullptr;
+        }
+        // What follows checks the assignment itself, and goes through at
+        // most one child
+        if (stage > 0)
+            return nullptr;
+        if (assign->slot == loop.slot)
+        {
+            symbols.error() << "Line " << assign->lineNumber << ": cannot assign to '" << assign->name
+                            << "', the variable of the parallel repeat\n";
+            return nullptr;
+        }
+
+        int r = reduction(assign->slot);
+        if (r >= 0)
+        {
+            // r = r op e, where e does not read r
+            auto update = dynCast<BinaryExprNode>(assign->value);
+            auto self = update ? dynCast<IdentifierNode>(update->left) : nullptr;
+            if (assign->index || !self || self->slot != assign->slot ||
+                (update->op != BinaryExprNode::Op::Add && update->op != BinaryExprNode::Op::Sub &&
+                 update->op != BinaryExprNode::Op::Mul))
+            {
+                misusedReduction(assign->name, assign->lineNumber);
+                return nullptr;
+            }
+            Update kind = update->op == BinaryExprNode::Op::Mul ? Product : Sum;
+            if (updates[r] != Unused && updates[r] != kind)
+                symbols.error() << "Line " << assign->lineNumber << ": reduction variable '" << assign->name
+                                << "' is updated both by + or - and by * in one parallel repeat\n";
+            updates[r] = kind;
+            return update->right;
+        }
+
+        if (assign->index && isLoopIndex(assign->index))
+        {
+            written.push_back(assign->slot);
+            return assign->value;
+        }
+        // Still in the loop's scope, where the name means what it does here
+        const Symbol *target = symbols.lookup(assign->id);
+        std::ostream &out = symbols.error() << "Line " << assign->lineNumber << ": ";
+        if (target && target->type.isArray())
+            out << "array '" << assign->name << "' is shared by every iteration of the parallel repeat and can"
+                << " only be set at index '" << loop.name << "'\n";
+        else
+            out << "cannot assign to '" << assign->name << "' in a parallel repeat: it is shared by every"
+                << " iteration. Declare it in the loop, or list it after reduce to add or multiply into it\n";
+        return nullptr;
+    }
+
+    void misusedReduction(std::string_view name, int line)
+    {
+        symbols.error() << "Line " << line << ": reduction variable '" << name << "' can only be updated, as "
+                        << name << " = " << name << " + ..., " << name << " - ... or " << name << " * ..., "
+                        << "in a parallel repeat\n";
+    }
+};
+
+} // namespace
+
+ASTNode *ParallelRepeatNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    switch (stage)
+    {
+    case 0:
+        // Any error here would leave slots the body check cannot trust
+        errorsBefore = symbols.errorCount();
+        return start;
+    case 1:
+    case 2:
+    {
+        TypeId boundType = (stage == 1 ? start : end)->type;
+        if (boundType != TypeId::Int && !boundType.isError())
+            symbols.error() << "Line " << lineNumber << ": bounds of a parallel repeat must be of type 'int', got '"
+                            << boundType.name() << "'\n";
+        if (stage == 1)
+            return end;
+        break;
+    }
+    default:
+        symbols.exitLoop();
+        if (symbols.errorCount() == errorsBefore)
+        {
+            ParallelBodyCheck check(symbols, *this);
+            check.run();
+            products = check.products();
+        }
+        symbols.exitScope();
+        type = TypeId::Void;
+        return nullptr;
+    }
+
+    if (reductions.size() > MaxReductions)
+        symbols.error() << "Line " << lineNumber << ": a parallel repeat takes at most " << MaxReductions
+                        << " reduction variables, got " << reductions.size() << "\n";
+    for (size_t r = 0; r < reductions.size(); ++r)
+    {
+        auto var = static_cast<IdentifierNode *>(reductions[r]);
+        var->analyzeStep(symbols, 0);
+        TypeId varType = var->type;
+        if (varType.isError())
+            continue;
+        if (varType != TypeId::Int && varType != TypeId::Float)
+            symbols.error() << "Line " << var->lineNumber << ": reduction variable '" << var->name
+                            << "' must be an int or a float, got '" << varType.name() << "'\n";
+        for (size_t q = 0; q < r; ++q)
+            if (static_cast<IdentifierNode *>(reductions[q])->slot == var->slot)
+                symbols.error() << "Line " << var->lineNumber << ": '" << var->name << "' is listed twice after reduce\n";
+    }
+
+    // The loop variable is the body's: a fresh int in a scope around it
+    symbols.enterScope();
+    slot = symbols.declare(id, TypeId::Int, lineNumber);
+    symbols.enterLoop();
+    return body;
+}
+
+ASTNode *ReturnStmtNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    if (stage == 0)
+        return expr;
+    symbols.diagnostics() << "Line " << lineNumber << ": return " << expr->type.name() << "\n";
+    // You can extend this later with function return type checking.
+    type = expr->type;
+    return nullptr;
+}
+
+ASTNode *PrintStmtNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    if (stage == 0)
+        return expr;
+    // A bare input() is read as int
+    TypeId exprType = adoptContextType(expr, expr->type, TypeId::Int);
+    if (exprType.isArray())
+        symbols.error() << "Line " << lineNumber << ": print() takes a single value, got '" << exprType.name()
+                        << "'; print an element or a reduction such as sum()\n";
+    type = TypeId::Void;
+    return nullptr;
+}
+
+// The result of a call, its arguments analyzed
+static TypeId builtinCallType(const BuiltinCallNode &call, SymbolTable &symbols)
+{
+    const NodeList &args = call.args;
+    std::string_view funcName = call.funcName;
+    int lineNumber = call.lineNumber;
+
+    // sum, min and max reduce an array to one value of its element type
+    if (funcName == "sum" || funcName == "min" || funcName == "max")
+    {
+        if (args.size() != 1)
+        {
+            symbols.error() << "Line " << lineNumber << ": " << funcName << "() takes one array, got "
+                            << args.size() << " arguments\n";
+            return TypeId::Error;
+        }
+        TypeId argType = args[0]->type;
+        if (argType.isError())
+            return TypeId::Error;
+        if (!argType.isArray())
+        {
+            symbols.error() << "Line " << lineNumber << ": " << funcName << "() takes an array, got '"
+                            << argType.name() << "'\n";
+            return TypeId::Error;
+        }
+        return argType.element();
+    }
+    if (funcName != "input")
+    {
+        symbols.error() << "Line " << lineNumber << ": unknown function '" << funcName << "'\n";
+        return TypeId::Error;
+    }
+
+    // input("float") names its type; a bare input() is typed by the
+    // variable it feeds, see adoptContextType
+    if (!args.empty())
+    {
+        auto hint = dynCast<LiteralNode>(args[0]);
+        if (args.size() == 1 && hint && hint->literalType == LiteralNode::Type::String)
+        {
+            for (TypeId candidate : {TypeId::Int, TypeId::Float, TypeId::String, TypeId::Bool})
+                if (hint->stringValue == candidate.name())
+                    return candidate;
+        }
+        symbols.error() << "Line " << lineNumber
+                        << ": input() takes the type to read: \"int\", \"float\", \"string\" or \"bool\"\n";
+        return TypeId::Error;
+    }
+    return TypeId::Unknown;
+}
+
+ASTNode *BuiltinCallNode::analyzeStep(SymbolTable &symbols, unsigned stage)
+{
+    if (stage < args.size())
+        return args[stage];
+    type = builtinCallType(*this, symbols);
+    return nullptr;
+}
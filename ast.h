@@ -1,402 +1,658 @@
-// ast.h
-#pragma once
-#include <string>
-#include <memory>
-#include <vector>
-#include <iostream>
-#include "SymbolTable.h"
-
-// Base class for all AST nodes
-class ASTNode
-{
-public:
-    virtual ~ASTNode() = default;
-    virtual void print() const = 0;
-    virtual std::string analyze(SymbolTable &symbols) const = 0; // For expressions and type-checking
-    int lineNumber;
-};
-
-using ASTNodePtr = std::unique_ptr<ASTNode>;
-
-// ===== Expression Nodes =====
-
-class LiteralNode : public ASTNode
-{
-public:
-    enum class Type
-    {
-        Int,
-        Float,
-        String,
-        Char,
-        Bool
-    };
-    Type type;
-    std::string value;
-
-    LiteralNode(Type t, const std::string &val) : type(t), value(val) {}
-
-    void print() const override
-    {
-        std::cout << "Literal(" << value << ")";
-    }
-    std::string analyze(SymbolTable &symbols) const override;
-};
-
-class IdentifierNode : public ASTNode
-{
-public:
-    std::string name;
-
-    IdentifierNode(const std::string &id) : name(id) {}
-
-    std::string analyze(SymbolTable &symbols) const override;
-
-    void print() const override
-    {
-        std::cout << "Identifier(" << name << ")";
-    }
-};
-
-class BinaryExprNode : public ASTNode
-{
-public:
-    enum class Op
-    {
-        Add,
-        Sub,
-        Mul,
-        Div,
-        Eq,
-        Neq,
-        Lt,
-        Gt,
-        Leq,
-        Geq,
-        And,
-        Or
-    };
-    ASTNodePtr left;
-    ASTNodePtr right;
-    Op op;
-
-    BinaryExprNode(ASTNodePtr lhs, Op oper, ASTNodePtr rhs)
-        : left(std::move(lhs)), op(oper), right(std::move(rhs)) {}
-
-    std::string analyze(SymbolTable &symbols) const override;
-
-    void print() const override
-    {
-        std::cout << "(";
-        left->print();
-        switch (op)
-        {
-        case Op::Add:
-            std::cout << " + ";
-            break;
-        case Op::Sub:
-            std::cout << " - ";
-            break;
-        case Op::Mul:
-            std::cout << " * ";
-            break;
-        case Op::Div:
-            std::cout << " / ";
-            break;
-        case Op::Eq:
-            std::cout << " == ";
-            break;
-        case Op::Neq:
-            std::cout << " != ";
-            break;
-        case Op::Lt:
-            std::cout << " < ";
-            break;
-        case Op::Gt:
-            std::cout << " > ";
-            break;
-        case Op::Leq:
-            std::cout << " <= ";
-            break;
-        case Op::Geq:
-            std::cout << " >= ";
-            break;
-        case Op::And:
-            std::cout << " and ";
-            break;
-        case Op::Or:
-            std::cout << " or ";
-            break;
-        }
-        right->print();
-        std::cout << ")";
-    }
-};
-
-class UnaryExprNode : public ASTNode
-{
-public:
-    enum class Op
-    {
-        Not,
-        Minus
-    };
-
-    Op op;
-    ASTNodePtr operand;
-
-    UnaryExprNode(Op o, ASTNodePtr expr)
-        : op(o), operand(std::move(expr)) {}
-
-    void print() const override
-    {
-        std::cout << "Unary(";
-        switch (op)
-        {
-        case Op::Not:
-            std::cout << "not ";
-            break;
-        case Op::Minus:
-            std::cout << "-";
-            break;
-        }
-        operand->print();
-        std::cout << ")";
-    }
-    std::string analyze(SymbolTable &symbols) const override;
-};
-
-// ===== Statement Nodes =====
-
-class DeclarationNode : public ASTNode
-{
-public:
-    std::string typeName;
-    std::string identifier;
-    ASTNodePtr expr;
-
-    DeclarationNode(const std::string &type, const std::string &id, ASTNodePtr e)
-        : typeName(type), identifier(id), expr(std::move(e)) {}
-
-    std::string analyze(SymbolTable &symbols) const override;
-
-    void print() const override
-    {
-        std::cout << "Declare(" << typeName << " " << identifier << " = ";
-        expr->print();
-        std::cout << ")";
-    }
-};
-
-class PrintStmtNode : public ASTNode
-{
-public:
-    ASTNodePtr expr;
-
-    PrintStmtNode(ASTNodePtr e) : expr(std::move(e)) {}
-
-    std::string analyze(SymbolTable &symbols) const override;
-
-    void print() const override
-    {
-        std::cout << "Print(";
-        expr->print();
-        std::cout << ")";
-    }
-};
-
-class ReturnStmtNode : public ASTNode
-{
-public:
-    ASTNodePtr expr;
-
-    ReturnStmtNode(ASTNodePtr e) : expr(std::move(e)) {}
-
-    std::string analyze(SymbolTable &symbols) const override;
-
-    void print() const override
-    {
-        std::cout << "Return(";
-        expr->print();
-        std::cout << ")";
-    }
-};
-
-class IfStmtNode : public ASTNode
-{
-public:
-    ASTNodePtr condition;
-    ASTNodePtr thenBlock;
-    ASTNodePtr elseBlock; // optional
-
-    IfStmtNode(ASTNodePtr cond, ASTNodePtr thenBlk, ASTNodePtr elseBlk = nullptr)
-        : condition(std::move(cond)), thenBlock(std::move(thenBlk)), elseBlock(std::move(elseBlk)) {}
-
-    std::string analyze(SymbolTable &symbols) const override;
-
-    void print() const override
-    {
-        std::cout << "If(";
-        condition->print();
-        std::cout << ") Then ";
-        thenBlock->print();
-        if (elseBlock)
-        {
-            std::cout << " Else ";
-            elseBlock->print();
-        }
-    }
-};
-
-class RepeatStmtNode : public ASTNode
-{
-public:
-    ASTNodePtr condition;
-    ASTNodePtr body;
-
-    RepeatStmtNode(ASTNodePtr cond, ASTNodePtr blk)
-        : condition(std::move(cond)), body(std::move(blk)) {}
-
-    std::string analyze(SymbolTable &symbols) const override;
-
-    void print() const override
-    {
-        std::cout << "Repeat(";
-        condition->print();
-        std::cout << ") ";
-        body->print();
-    }
-};
-
-class AssignmentNode : public ASTNode
-{
-public:
-    std::string name;
-    std::unique_ptr<ASTNode> value;
-
-    AssignmentNode(std::string name, std::unique_ptr<ASTNode> value)
-        : name(std::move(name)), value(std::move(value)) {}
-
-    std::string analyze(SymbolTable &symbols) const override;
-
-    void print() const override
-    {
-        std::cout << "Assignment(" << name << " = ";
-        value->print();
-        std::cout << ")";
-    }
-};
-
-class BlockNode : public ASTNode
-{
-public:
-    std::vector<std::unique_ptr<ASTNode>> statements;
-
-    BlockNode(std::unique_ptr<std::vector<std::unique_ptr<ASTNode>>> stmts)
-        : statements(std::move(*stmts)) {} // move vector contents
-
-    std::string analyze(SymbolTable &symbols) const override;
-
-    void print() const override
-    {
-        std::cout << "{ ";
-        for (const auto &stmt : statements)
-        {
-            stmt->print();
-            std::cout << "; ";
-        }
-        std::cout << "}";
-    }
-};
-
-/*class BlockNode : public ASTNode
-{
-public:
-    std::vector<ASTNodePtr> statements;
-
-    void addStatement(ASTNodePtr stmt)
-    {
-        statements.push_back(std::move(stmt));
-    }
-
-    void print() const override
-    {
-        std::cout << "{ ";
-        for (const auto &stmt : statements)
-        {
-            stmt->print();
-            std::cout << "; ";
-        }
-        std::cout << "}";
-    }
-};*/
-
-// ===== Program Node (Root) =====
-
-class ProgramNode : public ASTNode
-{
-public:
-    std::vector<ASTNodePtr> statements;
-
-    void addStatement(ASTNodePtr stmt)
-    {
-        statements.push_back(std::move(stmt));
-    }
-
-    void print() const override
-    {
-        std::cout << "Program:\n";
-        for (const auto &stmt : statements)
-        {
-            stmt->print();
-            std::cout << "\n";
-        }
-    }
-    std::string analyze(SymbolTable &symbols) const override;
-};
-
-class BreakNode : public ASTNode {
-    public:
-        int line;
-        BreakNode(int line) : line(line) {}
-        std::string analyze(SymbolTable & analyzer) const override;
-        void print() const override
-        {
-            std::cout << " {stop}  ";
-        }
-    };
-    
-class ContinueNode : public ASTNode {
-    public:
-        int line;
-        ContinueNode(int line) : line(line) {}
-        std::string analyze(SymbolTable & analyzer) const override;
-        void print() const override
-        {
-            std::cout << " {skip}  ";
-        }
-    };
-    
-
-class BuiltinCallNode : public ASTNode
-{
-public:
-    std::string funcName;
-    std::vector<ASTNodePtr> args;
-
-    BuiltinCallNode(const std::string &name, std::vector<ASTNodePtr> arguments)
-        : funcName(name), args(std::move(arguments)) {}
-
-    void print() const override
-    {
-        std::cout << "BuiltinCall(" << funcName << "(";
-        for (size_t i = 0; i < args.size(); ++i)
-        {
-            args[i]->print();
-            if (i + 1 < args.size())
-                std::cout << ", ";
-        }
-        std::cout << "))";
-    }
-    std::string analyze(SymbolTable &symbols) const override;
-};
+// ast.h
+#pragma once
+#include <string>
+#include <string_view>
+#include <iostream>
+#include <vector>
+#include "SymbolTable.h"
+#include "ast_arena.h"
+#include "interner.h"
+#include "types.h"
+
+// Concrete node type, stored in every node so passes can dispatch with a
+// switch instead of probing with dynamic_cast.
+enum class NodeKind : uint8_t
+{
+    Literal,
+    Identifier,
+    BinaryExpr,
+    UnaryExpr,
+    BuiltinCall,
+    ArrayLiteral,
+    IndexExpr,
+    Declaration,
+    Assignment,
+    PrintStmt,
+    ReturnStmt,
+    IfStmt,
+    RepeatStmt,
+    ParallelRepeat,
+    Block,
+    Break,
+    Continue,
+    Program
+};
+
+// Base class for all AST nodes. Nodes live in the compilation's AstArena and
+// only point at each other and at arena strings, so they are never deleted
+// individually.
+class ASTNode
+{
+public:
+    // Prints the tree rooted here
+    void print(std::ostream &out) const;
+    // Type-checks the tree rooted here, records each node's result in its
+    // `type` and returns this one's
+    TypeId analyze(SymbolTable &symbols);
+
+    // What print and analyze do at a node, as steps of walkTree: the node's
+    // own part at `stage`, returning the child to go through next, or
+    // nullptr once the node is done
+    virtual const ASTNode *printStep(std::ostream &out, unsigned stage) const = 0;
+    virtual ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) = 0;
+
+    int lineNumber;
+    TypeId type = TypeId::Unknown; // Set by analyze; Void for statements
+    const NodeKind kind;
+    // Height of the subtree rooted here (a leaf is 1), set by the make*
+    // functions; see CompileSession::maxNesting
+    uint32_t depth = 1;
+
+protected:
+    explicit ASTNode(NodeKind kind) : kind(kind) {}
+    ~ASTNode() = default;
+};
+
+// Kind-checked downcast: the node as a T, or nullptr if it is something else
+template <class T>
+T *dynCast(ASTNode *node)
+{
+    return node && node->kind == T::Kind ? static_cast<T *>(node) : nullptr;
+}
+
+template <class T>
+const T *dynCast(const ASTNode *node)
+{
+    return node && node->kind == T::Kind ? static_cast<const T *>(node) : nullptr;
+}
+
+// Runs a pass over the tree below `root` from a work list instead of the
+// call stack, so however deep the tree nests the walk costs heap, not
+// stack. The pass is `step(node, stage)`: called with stage 0 when the walk
+// reaches a node, and with 1, 2, ... each time the child it returned last
+// is done, it returns the next child to walk, or nullptr once the node is.
+// What the children work out, a pass keeps on a stack of its own or on the
+// nodes, as sema does in `type`. A leaf (depth 1) is done at stage 0, so
+// it gets that one step without a place on the list.
+template <class Node, class Step>
+void walkTree(Node *root, Step &&step)
+{
+    struct Pending
+    {
+        Node *node;
+        unsigned stage;
+    };
+    std::vector<Pending> work{{root, 0}};
+    while (!work.empty())
+    {
+        Pending &next = work.back();
+        if (Node *child = step(next.node, next.stage++))
+        {
+            if (child->depth == 1)
+                step(child, 0);
+            else
+                work.push_back({child, 0});
+        }
+        else
+            work.pop_back();
+    }
+}
+
+using ASTNodePtr = ASTNode *;
+using NodeList = ArenaList<ASTNode *>;
+
+// ===== Expression Nodes =====
+
+class LiteralNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::Literal;
+
+    enum class Type
+    {
+        Int,
+        Float,
+        String,
+        Char,
+        Bool
+    };
+    Type literalType;
+    union
+    {
+        int intValue;
+        float floatValue;
+        char charValue;
+        bool boolValue;
+    };
+    std::string_view stringValue; // Into the source or arena, only for Type::String
+
+    explicit LiteralNode(Type t) : ASTNode(Kind), literalType(t), intValue(0) {}
+
+    const ASTNode *printStep(std::ostream &out, unsigned) const override
+    {
+        out << "Literal(";
+        switch (literalType)
+        {
+        case Type::Int:
+            out << intValue;
+            break;
+        case Type::Float:
+            out << std::to_string(floatValue);
+            break;
+        case Type::String:
+            out << stringValue;
+            break;
+        case Type::Char:
+            out << charValue;
+            break;
+        case Type::Bool:
+            out << (boolValue ? "true" : "false");
+            break;
+        }
+        out << ")";
+        return nullptr;
+    }
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+};
+
+class IdentifierNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::Identifier;
+
+    IdentId id;
+    std::string_view name;
+    uint32_t slot = 0; // Declaration this name resolves to, set by analyze
+
+    IdentifierNode(IdentId id, std::string_view name) : ASTNode(Kind), id(id), name(name) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+
+    const ASTNode *printStep(std::ostream &out, unsigned) const override
+    {
+        out << "Identifier(" << name << ")";
+        return nullptr;
+    }
+};
+
+class BinaryExprNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::BinaryExpr;
+
+    enum class Op
+    {
+        Add,
+        Sub,
+        Mul,
+        Div,
+        Eq,
+        Neq,
+        Lt,
+        Gt,
+        Leq,
+        Geq,
+        And,
+        Or
+    };
+    ASTNodePtr left;
+    ASTNodePtr right;
+    Op op;
+
+    BinaryExprNode(ASTNodePtr lhs, Op oper, ASTNodePtr rhs)
+        : ASTNode(Kind), left(lhs), right(rhs), op(oper) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+    // Records and returns the type of this operator applied to operands of
+    // these types, which analyze works out first
+    TypeId analyzeOperator(TypeId leftType, TypeId rightType, SymbolTable &symbols);
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override;
+};
+
+class UnaryExprNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::UnaryExpr;
+
+    enum class Op
+    {
+        Not,
+        Minus
+    };
+
+    Op op;
+    ASTNodePtr operand;
+
+    UnaryExprNode(Op o, ASTNodePtr expr)
+        : ASTNode(Kind), op(o), operand(expr) {}
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override;
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+    TypeId analyzeOperator(TypeId operandType, SymbolTable &symbols);
+};
+
+// [a, b, c]: an array of as many elements as it lists
+class ArrayLiteralNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::ArrayLiteral;
+
+    NodeList elements;
+
+    explicit ArrayLiteralNode(NodeList elements) : ASTNode(Kind), elements(elements) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        if (stage == 0)
+            out << "Array(";
+        else if (stage < elements.size())
+            out << ", ";
+        if (stage < elements.size())
+            return elements[stage];
+        out << ")";
+        return nullptr;
+    }
+};
+
+// a[i]: one element of an array variable
+class IndexExprNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::IndexExpr;
+
+    IdentId id;
+    std::string_view name;
+    ASTNodePtr index;
+    uint32_t slot = 0; // Set by analyze
+
+    IndexExprNode(IdentId id, std::string_view name, ASTNodePtr index)
+        : ASTNode(Kind), id(id), name(name), index(index) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        if (stage == 0)
+        {
+            out << "Index(" << name << ", ";
+            return index;
+        }
+        out << ")";
+        return nullptr;
+    }
+};
+
+// ===== Statement Nodes =====
+
+class DeclarationNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::Declaration;
+
+    TypeId declType;
+    IdentId id;
+    std::string_view identifier;
+    ASTNodePtr expr;
+    uint32_t slot = 0; // Set by analyze
+
+    DeclarationNode(TypeId declType, IdentId id, std::string_view name, ASTNodePtr e)
+        : ASTNode(Kind), declType(declType), id(id), identifier(name), expr(e) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        if (stage == 0)
+        {
+            out << "Declare(" << declType.name() << " " << identifier << " = ";
+            return expr;
+        }
+        out << ")";
+        return nullptr;
+    }
+};
+
+class PrintStmtNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::PrintStmt;
+
+    ASTNodePtr expr;
+
+    PrintStmtNode(ASTNodePtr e) : ASTNode(Kind), expr(e) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        if (stage == 0)
+        {
+            out << "Print(";
+            return expr;
+        }
+        out << ")";
+        return nullptr;
+    }
+};
+
+class ReturnStmtNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::ReturnStmt;
+
+    ASTNodePtr expr;
+
+    ReturnStmtNode(ASTNodePtr e) : ASTNode(Kind), expr(e) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        if (stage == 0)
+        {
+            out << "Return(";
+            return expr;
+        }
+        out << ")";
+        return nullptr;
+    }
+};
+
+class IfStmtNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::IfStmt;
+
+    ASTNodePtr condition;
+    ASTNodePtr thenBlock;
+    ASTNodePtr elseBlock; // optional
+
+    IfStmtNode(ASTNodePtr cond, ASTNodePtr thenBlk, ASTNodePtr elseBlk = nullptr)
+        : ASTNode(Kind), condition(cond), thenBlock(thenBlk), elseBlock(elseBlk) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        switch (stage)
+        {
+        case 0:
+            out << "If(";
+            return condition;
+        case 1:
+            out << ") Then ";
+            return thenBlock;
+        case 2:
+            if (elseBlock)
+                out << " Else ";
+            return elseBlock;
+        default:
+            return nullptr;
+        }
+    }
+};
+
+class RepeatStmtNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::RepeatStmt;
+
+    ASTNodePtr condition;
+    ASTNodePtr body;
+
+    RepeatStmtNode(ASTNodePtr cond, ASTNodePtr blk)
+        : ASTNode(Kind), condition(cond), body(blk) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        switch (stage)
+        {
+        case 0:
+            out << "Repeat(";
+            return condition;
+        case 1:
+            out << ") ";
+            return body;
+        default:
+            return nullptr;
+        }
+    }
+};
+
+// parallel repeat (i = start, end) reduce (a, b) { body }: the body once
+// for each i from start up to end - 1, in no particular order, spread over
+// the runtime's worker threads. Of the variables from outside, the body may
+// only update the ones listed after reduce, each by + and - or by *, and
+// set elements of arrays at index i; see analyze.
+class ParallelRepeatNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::ParallelRepeat;
+
+    static constexpr size_t MaxReductions = 32; // A bit each in `products`
+
+    IdentId id; // The loop variable
+    std::string_view name;
+    ASTNodePtr start;
+    ASTNodePtr end;
+    NodeList reductions; // IdentifierNodes
+    ASTNodePtr body;
+    // The loop variable's slot, set by analyze. Slots are handed out in
+    // declaration order, so every slot below it is a variable from outside.
+    uint32_t slot = 0;
+    uint32_t products = 0; // Bit r set: reduction r is updated by *, set by analyze
+    int errorsBefore = 0;  // symbols.errorCount() when analyze reached the loop
+
+    ParallelRepeatNode(IdentId id, std::string_view name, ASTNodePtr start, ASTNodePtr end, NodeList reductions,
+                       ASTNodePtr body)
+        : ASTNode(Kind), id(id), name(name), start(start), end(end), reductions(reductions), body(body) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+
+    bool isProduct(size_t reduction) const { return products >> reduction & 1; }
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        switch (stage)
+        {
+        case 0:
+            out << "ParallelRepeat(" << name << " = ";
+            return start;
+        case 1:
+            out << ", ";
+            return end;
+        case 2:
+            out << ") ";
+            if (!reductions.empty())
+            {
+                // Identifiers, printed in a single step each
+                out << "Reduce(";
+                for (size_t i = 0; i < reductions.size(); ++i)
+                {
+                    reductions[i]->printStep(out, 0);
+                    if (i + 1 < reductions.size())
+                        out << ", ";
+                }
+                out << ") ";
+            }
+            return body;
+        default:
+            return nullptr;
+        }
+    }
+};
+
+class AssignmentNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::Assignment;
+
+    IdentId id;
+    std::string_view name;
+    ASTNodePtr index; // a[index] = value assigns one element; null for the whole variable
+    ASTNodePtr value;
+    uint32_t slot = 0; // Set by analyze
+
+    AssignmentNode(IdentId id, std::string_view name, ASTNodePtr index, ASTNodePtr value)
+        : ASTNode(Kind), id(id), name(name), index(index), value(value) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        if (stage == 0)
+        {
+            out << "Assignment(" << name;
+            if (index)
+            {
+                out << "[";
+                return index;
+            }
+        }
+        else if (stage > 1 || !index)
+        {
+            out << ")";
+            return nullptr;
+        }
+        out << (index ? "] = " : " = ");
+        return value;
+    }
+};
+
+class BlockNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::Block;
+
+    NodeList statements;
+
+    BlockNode(NodeList stmts)
+        : ASTNode(Kind), statements(stmts) {}
+
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        out << (stage == 0 ? "{ " : "; ");
+        if (stage < statements.size())
+            return statements[stage];
+        out << "}";
+        return nullptr;
+    }
+};
+
+/*class BlockNode : public ASTNode
+{
+public:
+    std::vector<ASTNodePtr> statements;
+
+    void addStatement(ASTNodePtr stmt)
+    {
+        statements.push_back(std::move(stmt));
+    }
+
+    void print(std::ostream &out) const override
+    {
+        out << "{ ";
+        for (const auto &stmt : statements)
+        {
+            stmt->print(out);
+            out << "; ";
+        }
+        out << "}";
+    }
+};*/
+
+// ===== Program Node (Root) =====
+
+class ProgramNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::Program;
+
+    NodeList statements;
+    uint32_t slotCount = 0; // Variables declared anywhere, set by analyze
+
+    ProgramNode() : ASTNode(Kind) {}
+
+    void addStatement(AstArena &arena, ASTNodePtr stmt)
+    {
+        statements.push_back(arena, stmt);
+    }
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        out << (stage == 0 ? "Program:\n" : "\n");
+        return stage < statements.size() ? statements[stage] : nullptr;
+    }
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+};
+
+class BreakNode : public ASTNode {
+    public:
+        static constexpr NodeKind Kind = NodeKind::Break;
+
+        int line;
+        BreakNode(int line) : ASTNode(Kind), line(line) {}
+        ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+        const ASTNode *printStep(std::ostream &out, unsigned) const override
+        {
+            out << " {stop}  ";
+            return nullptr;
+        }
+    };
+    
+class ContinueNode : public ASTNode {
+    public:
+        static constexpr NodeKind Kind = NodeKind::Continue;
+
+        int line;
+        ContinueNode(int line) : ASTNode(Kind), line(line) {}
+        ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+        const ASTNode *printStep(std::ostream &out, unsigned) const override
+        {
+            out << " {skip}  ";
+            return nullptr;
+        }
+    };
+    
+
+class BuiltinCallNode : public ASTNode
+{
+public:
+    static constexpr NodeKind Kind = NodeKind::BuiltinCall;
+
+    std::string_view funcName;
+    NodeList args;
+
+    BuiltinCallNode(std::string_view name, NodeList arguments)
+        : ASTNode(Kind), funcName(name), args(arguments) {}
+
+    const ASTNode *printStep(std::ostream &out, unsigned stage) const override
+    {
+        if (stage == 0)
+            out << "BuiltinCall(" << funcName << "(";
+        else if (stage < args.size())
+            out << ", ";
+        if (stage < args.size())
+            return args[stage];
+        out << "))";
+        return nullptr;
+    }
+    ASTNode *analyzeStep(SymbolTable &symbols, unsigned stage) override;
+};
@@ -0,0 +1,119 @@
+// ast_arena.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator owning every AST node and string of one compilation.
+// Nodes are laid out back to back in large chunks in the order the parser
+// creates them and are never destroyed one by one: the whole tree goes away
+// when the arena releases its chunks.
+class AstArena
+{
+public:
+    AstArena() = default;
+    AstArena(const AstArena &) = delete;
+    AstArena &operator=(const AstArena &) = delete;
+
+    void *allocate(size_t size, size_t align)
+    {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t)(align - 1);
+        if (aligned + size > reinterpret_cast<uintptr_t>(limit))
+        {
+            grow(size + align);
+            aligned = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t)(align - 1);
+        }
+        cursor = reinterpret_cast<char *>(aligned + size);
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    // Nodes must not own heap memory, otherwise dropping the arena would leak
+    template <typename T, typename... Args>
+    T *make(Args &&...args)
+    {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "arena objects are released without running destructors");
+        ++objectCount;
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T *allocateArray(size_t count)
+    {
+        return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // Copy a string into the arena; the view stays valid as long as the arena
+    std::string_view copyString(std::string_view text)
+    {
+        char *storage = allocateArray<char>(text.size() + 1);
+        std::memcpy(storage, text.data(), text.size());
+        storage[text.size()] = '\0';
+        return std::string_view(storage, text.size());
+    }
+
+    size_t nodeCount() const { return objectCount; }
+    size_t bytesReserved() const { return reserved; }
+
+private:
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    void grow(size_t minimum)
+    {
+        size_t size = minimum > ChunkSize ? minimum : ChunkSize;
+        chunks.emplace_back(new char[size]);
+        cursor = chunks.back().get();
+        limit = cursor + size;
+        reserved += size;
+    }
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char *cursor = nullptr;
+    char *limit = nullptr;
+    size_t objectCount = 0;
+    size_t reserved = 0;
+};
+
+// Arena-backed list of child nodes (block statements, call arguments)
+template <typename T>
+class ArenaList
+{
+public:
+    void push_back(AstArena &arena, T item)
+    {
+        if (count == capacity)
+        {
+            uint32_t newCapacity = capacity ? capacity * 2 : 4;
+            T *grown = arena.allocateArray<T>(newCapacity);
+            if (count)
+                std::memcpy(grown, items, sizeof(T) * count);
+            items = grown;
+            capacity = newCapacity;
+        }
+        items[count++] = item;
+    }
+
+    T *begin() const { return items; }
+    T *end() const { return items + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T &operator[](size_t i) const { return items[i]; }
+
+    // Drop every item from index `newSize` on; the storage stays reserved
+    void truncate(size_t newSize)
+    {
+        if (newSize < count)
+            count = static_cast<uint32_t>(newSize);
+    }
+
+private:
+    T *items = nullptr;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+};
@@ -1,68 +1,114 @@
 #pragma once
 #include "ast.h"
-#include <memory>
+#include "ast_arena.h"
+#include <cstdint>
+#include <string_view>
 
-// The root of the AST will be stored here
-extern std::unique_ptr<ProgramNode> astRoot;
+// String literal text as the lexers hand it to the parser: a view into the
+// session's source or arena. Trivial so it can live in the Bison %union.
+struct TokenText
+{
+    const char *data;
+    uint32_t size;
 
-// Functions to build AST nodes — called from parser actions
-std::unique_ptr<LiteralNode> makeIntLiteral(int value, int line);
-std::unique_ptr<LiteralNode> makeFloatLiteral(float value, int line);
-std::unique_ptr<LiteralNode> makeStringLiteral(const std::string &value, int line);
-std::unique_ptr<LiteralNode> makeCharLiteral(char value, int line);
-std::unique_ptr<LiteralNode> makeBoolLiteral(bool value, int line);
+    std::string_view view() const { return std::string_view(data, size); }
+};
 
-std::unique_ptr<IdentifierNode> makeIdentifier(const std::string &name, int line);
+// Functions to build AST nodes — called from parser actions.
+// Every node is allocated in the compilation's arena.
+LiteralNode *makeIntLiteral(AstArena &arena, int value, int line);
+LiteralNode *makeFloatLiteral(AstArena &arena, float value, int line);
+// `value` is not copied: it must live as long as the tree, as the lexers'
+// TokenText does
+LiteralNode *makeStringLiteral(AstArena &arena, std::string_view value, int line);
+LiteralNode *makeCharLiteral(AstArena &arena, char value, int line);
+LiteralNode *makeBoolLiteral(AstArena &arena, bool value, int line);
 
-std::unique_ptr<BinaryExprNode> makeBinaryExpr(
-    std::unique_ptr<ASTNode> left,
+// Identifier names are interned by the lexer; `name` is the interned spelling
+IdentifierNode *makeIdentifier(AstArena &arena, IdentId id, std::string_view name, int line);
+
+ArrayLiteralNode *makeArrayLiteral(AstArena &arena, NodeList *elements, int line);
+IndexExprNode *makeIndexExpr(AstArena &arena, IdentId id, std::string_view name, ASTNode *index, int line);
+
+BinaryExprNode *makeBinaryExpr(
+    AstArena &arena,
+    ASTNode *left,
     BinaryExprNode::Op op,
-    std::unique_ptr<ASTNode> right,
+    ASTNode *right,
     int line);
 
-std::unique_ptr<UnaryExprNode> makeUnaryExpr(
+UnaryExprNode *makeUnaryExpr(
+    AstArena &arena,
     UnaryExprNode::Op op,
-    std::unique_ptr<ASTNode> operand,
+    ASTNode *operand,
     int line);
 
-std::unique_ptr<DeclarationNode> makeDeclaration(
-    const std::string &type,
-    const std::string &name,
-    std::unique_ptr<ASTNode> expr,
+DeclarationNode *makeDeclaration(
+    AstArena &arena,
+    TypeId type,
+    IdentId id,
+    std::string_view name,
+    ASTNode *expr,
     int line);
 
-std::unique_ptr<PrintStmtNode> makePrintStmt(std::unique_ptr<ASTNode> expr, int line);
-std::unique_ptr<ReturnStmtNode> makeReturnStmt(std::unique_ptr<ASTNode> expr, int line);
+PrintStmtNode *makePrintStmt(AstArena &arena, ASTNode *expr, int line);
+ReturnStmtNode *makeReturnStmt(AstArena &arena, ASTNode *expr, int line);
+
+IfStmtNode *makeIfStmt(
+    AstArena &arena,
+    ASTNode *condition,
+    ASTNode *thenBlock,
+    ASTNode *elseBlock,
+    int line);
 
-std::unique_ptr<IfStmtNode> makeIfStmt(
-    std::unique_ptr<ASTNode> condition,
-    std::unique_ptr<ASTNode> thenBlock,
-    std::unique_ptr<ASTNode> elseBlock,
+RepeatStmtNode *makeRepeatStmt(
+    AstArena &arena,
+    ASTNode *condition,
+    ASTNode *body,
     int line);
 
-std::unique_ptr<RepeatStmtNode> makeRepeatStmt(
-    std::unique_ptr<ASTNode> condition,
-    std::unique_ptr<ASTNode> body,
+// parallel repeat (name = start, end) reduce (reductions) body, where
+// reductions holds IdentifierNodes and may be empty
+ParallelRepeatNode *makeParallelRepeat(
+    AstArena &arena,
+    IdentId id,
+    std::string_view name,
+    ASTNode *start,
+    ASTNode *end,
+    NodeList *reductions,
+    ASTNode *body,
     int line);
 
-std::unique_ptr<ASTNode> makeAssignment(
-    const std::string &name,
-    std::unique_ptr<ASTNode> expr,
+ASTNode *makeAssignment(
+    AstArena &arena,
+    IdentId id,
+    std::string_view name,
+    ASTNode *expr,
     int line);
 
-std::unique_ptr<BlockNode> makeBlock(
-    std::unique_ptr<std::vector<std::unique_ptr<ASTNode>>> stmts,
+// name[index] = expr
+ASTNode *makeElementAssignment(
+    AstArena &arena,
+    IdentId id,
+    std::string_view name,
+    ASTNode *index,
+    ASTNode *expr,
     int line);
 
-void addToBlock(BlockNode *block, std::unique_ptr<ASTNode> stmt);
+NodeList *makeStatementList(AstArena &arena);
+
+BlockNode *makeBlock(AstArena &arena, NodeList *stmts, int line);
+
+void addToBlock(AstArena &arena, BlockNode *block, ASTNode *stmt);
 
-std::unique_ptr<ProgramNode> makeProgram();
-void addToProgram(std::unique_ptr<ASTNode> stmt);
+ProgramNode *makeProgram(AstArena &arena);
+void addToProgram(AstArena &arena, ProgramNode *program, ASTNode *stmt);
 
-std::unique_ptr<BreakNode> makeBreak(int line);
-std::unique_ptr<ContinueNode> makeContinue(int line);
+BreakNode *makeBreak(AstArena &arena, int line);
+ContinueNode *makeContinue(AstArena &arena, int line);
 
-std::unique_ptr<BuiltinCallNode> makeBuiltinCall(
-    const std::string &name,
-    std::vector<ASTNodePtr> args,
+BuiltinCallNode *makeBuiltinCall(
+    AstArena &arena,
+    std::string_view name,
+    NodeList args,
     int line);
@@ -0,0 +1,625 @@
+// ast_optimizer.cpp
+#include "ast_optimizer.h"
+#include "ast_interface.h"
+
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+bool isIntLiteral(const ASTNode *node, int value)
+{
+    auto lit = dynCast<LiteralNode>(node);
+    return lit && lit->literalType == LiteralNode::Type::Int && lit->intValue == value;
+}
+
+bool isFloatLiteral(const ASTNode *node, float value)
+{
+    auto lit = dynCast<LiteralNode>(node);
+    return lit && lit->literalType == LiteralNode::Type::Float && lit->floatValue == value;
+}
+
+bool isStringLiteral(const ASTNode *node, std::string_view value)
+{
+    auto lit = dynCast<LiteralNode>(node);
+    return lit && lit->literalType == LiteralNode::Type::String && lit->stringValue == value;
+}
+
+bool isBoolLiteral(const ASTNode *node, bool value)
+{
+    auto lit = dynCast<LiteralNode>(node);
+    return lit && lit->literalType == LiteralNode::Type::Bool && lit->boolValue == value;
+}
+
+// Float compares follow codegen's fcmp u*: true when either side is NaN
+bool compareFloat(BinaryExprNode::Op op, float a, float b, bool &result)
+{
+    bool unordered = std::isnan(a) || std::isnan(b);
+    switch (op)
+    {
+    case BinaryExprNode::Op::Eq:
+        result = unordered || a == b;
+        return true;
+    case BinaryExprNode::Op::Neq:
+        result = unordered || a != b;
+        return true;
+    case BinaryExprNode::Op::Lt:
+        result = unordered || a < b;
+        return true;
+    case BinaryExprNode::Op::Gt:
+        result = unordered || a > b;
+        return true;
+    case BinaryExprNode::Op::Leq:
+        result = unordered || a <= b;
+        return true;
+    case BinaryExprNode::Op::Geq:
+        result = unordered || a >= b;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Signed integer compares, shared by int and char operands
+bool compareInt(BinaryExprNode::Op op, int a, int b, bool &result)
+{
+    switch (op)
+    {
+    case BinaryExprNode::Op::Eq:
+        result = a == b;
+        return true;
+    case BinaryExprNode::Op::Neq:
+        result = a != b;
+        return true;
+    case BinaryExprNode::Op::Lt:
+        result = a < b;
+        return true;
+    case BinaryExprNode::Op::Gt:
+        result = a > b;
+        return true;
+    case BinaryExprNode::Op::Leq:
+        result = a <= b;
+        return true;
+    case BinaryExprNode::Op::Geq:
+        result = a >= b;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Goes through the tree with walkTree. Every node, once its children are
+// done, pushes onto `results` what stays in its place (nullptr for a
+// statement that disappears), and takes its children's off it.
+class AstOptimizer
+{
+public:
+    explicit AstOptimizer(AstArena &arena) : arena(arena) {}
+
+    ASTNode *step(ASTNode *node, unsigned stage);
+    AstOptStats stats;
+
+private:
+    ASTNode *listStep(NodeList &statements, unsigned stage);
+    ASTNode *ifStep(IfStmtNode *ifStmt, unsigned stage);
+    ASTNode *binaryDone(BinaryExprNode *bin);
+    ASTNode *unaryDone(UnaryExprNode *un);
+    ASTNode *foldBinary(const BinaryExprNode *bin);
+    ASTNode *simplifyBinary(const BinaryExprNode *bin);
+    ASTNode *foldUnary(const UnaryExprNode *un);
+    bool isPure(const ASTNode *node);
+    bool endsInJump(const ASTNode *stmt);
+
+    ASTNode *pop()
+    {
+        ASTNode *result = results.back();
+        results.pop_back();
+        return result;
+    }
+    // The children in `list` are done: takes their results back into it
+    void popInto(NodeList &list)
+    {
+        for (size_t i = list.size(); i-- > 0;)
+            list[i] = pop();
+    }
+    // The node is done and stays in place
+    ASTNode *keep(ASTNode *node)
+    {
+        results.push_back(node);
+        return nullptr;
+    }
+
+    ASTNode *intLiteral(int value, int line)
+    {
+        LiteralNode *lit = makeIntLiteral(arena, value, line);
+        lit->type = TypeId::Int;
+        return lit;
+    }
+    ASTNode *floatLiteral(float value, int line)
+    {
+        LiteralNode *lit = makeFloatLiteral(arena, value, line);
+        lit->type = TypeId::Float;
+        return lit;
+    }
+    ASTNode *boolLiteral(bool value, int line)
+    {
+        LiteralNode *lit = makeBoolLiteral(arena, value, line);
+        lit->type = TypeId::Bool;
+        return lit;
+    }
+    ASTNode *stringLiteral(std::string_view value, int line)
+    {
+        LiteralNode *lit = makeStringLiteral(arena, arena.copyString(value), line);
+        lit->type = TypeId::String;
+        return lit;
+    }
+
+    AstArena &arena;
+    std::vector<ASTNode *> results;
+    std::vector<const ASTNode *> pending; // isPure's and endsInJump's
+};
+
+// True if evaluating the expression can be skipped without anyone noticing:
+// no input() and no integer division, which may trap
+bool AstOptimizer::isPure(const ASTNode *node)
+{
+    pending.clear(); // Right operands still to check
+    for (;;)
+    {
+        switch (node->kind)
+        {
+        case NodeKind::Literal:
+        case NodeKind::Identifier:
+            if (pending.empty())
+                return true;
+            node = pending.back();
+            pending.pop_back();
+            break;
+        case NodeKind::BinaryExpr:
+        {
+            auto bin = static_cast<const BinaryExprNode *>(node);
+            if (bin->op == BinaryExprNode::Op::Div && bin->type != TypeId::Float)
+                return false;
+            pending.push_back(bin->right);
+            node = bin->left;
+            break;
+        }
+        case NodeKind::UnaryExpr:
+            node = static_cast<const UnaryExprNode *>(node)->operand;
+            break;
+        default:
+            return false;
+        }
+    }
+}
+
+// A statement after which control never falls through to the next one
+bool AstOptimizer::endsInJump(const ASTNode *stmt)
+{
+    pending.clear(); // Else arms still to check
+    for (;;)
+    {
+        switch (stmt->kind)
+        {
+        case NodeKind::Break:
+        case NodeKind::Continue:
+            if (pending.empty())
+                return true;
+            stmt = pending.back();
+            pending.pop_back();
+            break;
+        case NodeKind::Block:
+        {
+            auto block = static_cast<const BlockNode *>(stmt);
+            if (block->statements.empty())
+                return false;
+            stmt = block->statements[block->statements.size() - 1];
+            break;
+        }
+        case NodeKind::IfStmt:
+        {
+            auto ifStmt = static_cast<const IfStmtNode *>(stmt);
+            if (!ifStmt->elseBlock)
+                return false;
+            pending.push_back(ifStmt->elseBlock);
+            stmt = ifStmt->thenBlock;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+}
+
+// Optimizes each statement in place, dropping the ones that disappear and
+// everything after a statement that always jumps away. At `stage`, that many
+// statements are done.
+ASTNode *AstOptimizer::listStep(NodeList &statements, unsigned stage)
+{
+    bool jumped = stage > 0 && results.back() && endsInJump(results.back());
+    if (!jumped && stage < statements.size())
+        return statements[stage];
+
+    stats.deadStatements += statements.size() - stage;
+    size_t first = results.size() - stage, kept = 0;
+    for (size_t i = first; i < results.size(); ++i)
+    {
+        if (results[i])
+            statements[kept++] = results[i];
+        else
+            ++stats.deadStatements;
+    }
+    results.resize(first);
+    statements.truncate(kept);
+    return nullptr;
+}
+
+ASTNode *AstOptimizer::ifStep(IfStmtNode *ifStmt, unsigned stage)
+{
+    switch (stage)
+    {
+    case 0:
+        return ifStmt->condition;
+    case 1:
+        ifStmt->condition = pop();
+        if (auto cond = dynCast<LiteralNode>(ifStmt->condition))
+        {
+            // The taken arm keeps its own block, so its scope is unchanged
+            ASTNode *taken = cond->boolValue ? ifStmt->thenBlock : ifStmt->elseBlock;
+            return taken ? taken : keep(nullptr);
+        }
+        return ifStmt->thenBlock;
+    case 2:
+        // What the taken arm left stands for the whole if
+        if (ifStmt->condition->kind == NodeKind::Literal)
+            return nullptr;
+        ifStmt->thenBlock = pop();
+        return ifStmt->elseBlock ? ifStmt->elseBlock : keep(ifStmt);
+    default:
+        ifStmt->elseBlock = pop();
+        return keep(ifStmt);
+    }
+}
+
+ASTNode *AstOptimizer::step(ASTNode *node, unsigned stage)
+{
+    switch (node->kind)
+    {
+    case NodeKind::Declaration:
+    {
+        auto decl = static_cast<DeclarationNode *>(node);
+        if (stage == 0)
+            return decl->expr;
+        decl->expr = pop();
+        return keep(decl);
+    }
+    case NodeKind::Assignment:
+    {
+        auto assign = static_cast<AssignmentNode *>(node);
+        if (stage == 0 && assign->index)
+            return assign->index;
+        if (stage == (assign->index ? 1u : 0u))
+            return assign->value;
+        assign->value = pop();
+        if (assign->index)
+            assign->index = pop();
+        return keep(assign);
+    }
+    case NodeKind::PrintStmt:
+    {
+        auto print = static_cast<PrintStmtNode *>(node);
+        if (stage == 0)
+            return print->expr;
+        print->expr = pop();
+        return keep(print);
+    }
+    case NodeKind::ReturnStmt:
+    {
+        auto ret = static_cast<ReturnStmtNode *>(node);
+        if (stage == 0)
+            return ret->expr;
+        ret->expr = pop();
+        return keep(ret);
+    }
+    case NodeKind::IfStmt:
+        return ifStep(static_cast<IfStmtNode *>(node), stage);
+    case NodeKind::RepeatStmt:
+    {
+        auto repeat = static_cast<RepeatStmtNode *>(node);
+        // The body runs before the first test, so even repeat (false) stays
+        switch (stage)
+        {
+        case 0:
+            return repeat->condition;
+        case 1:
+            repeat->condition = pop();
+            return repeat->body;
+        }
+        repeat->body = pop();
+        return keep(repeat);
+    }
+    case NodeKind::ParallelRepeat:
+    {
+        auto loop = static_cast<ParallelRepeatNode *>(node);
+        switch (stage)
+        {
+        case 0:
+            return loop->start;
+        case 1:
+            return loop->end;
+        case 2:
+            return loop->body;
+        }
+        loop->body = pop();
+        loop->end = pop();
+        loop->start = pop();
+        return keep(loop);
+    }
+    case NodeKind::Block:
+        if (ASTNode *next = listStep(static_cast<BlockNode *>(node)->statements, stage))
+            return next;
+        return keep(node);
+    case NodeKind::Program:
+        return listStep(static_cast<ProgramNode *>(node)->statements, stage);
+    case NodeKind::BinaryExpr:
+    {
+        auto bin = static_cast<BinaryExprNode *>(node);
+        switch (stage)
+        {
+        case 0:
+            return bin->left;
+        case 1:
+            return bin->right;
+        }
+        bin->right = pop();
+        bin->left = pop();
+        return keep(binaryDone(bin));
+    }
+    case NodeKind::UnaryExpr:
+    {
+        auto un = static_cast<UnaryExprNode *>(node);
+        if (stage == 0)
+            return un->operand;
+        un->operand = pop();
+        return keep(unaryDone(un));
+    }
+    case NodeKind::IndexExpr:
+    {
+        auto index = static_cast<IndexExprNode *>(node);
+        if (stage == 0)
+            return index->index;
+        index->index = pop();
+        return keep(index);
+    }
+    case NodeKind::ArrayLiteral:
+    {
+        NodeList &elements = static_cast<ArrayLiteralNode *>(node)->elements;
+        if (stage < elements.size())
+            return elements[stage];
+        popInto(elements);
+        return keep(node);
+    }
+    case NodeKind::BuiltinCall:
+    {
+        NodeList &args = static_cast<BuiltinCallNode *>(node)->args;
+        if (stage < args.size())
+            return args[stage];
+        popInto(args);
+        return keep(node);
+    }
+    default:
+        return keep(node);
+    }
+}
+
+// What replaces a binary expression whose operands are optimized
+ASTNode *AstOptimizer::binaryDone(BinaryExprNode *bin)
+{
+    if (ASTNode *folded = foldBinary(bin))
+    {
+        ++stats.folded;
+        return folded;
+    }
+    if (ASTNode *simplified = simplifyBinary(bin))
+    {
+        ++stats.simplified;
+        return simplified;
+    }
+    return bin;
+}
+
+ASTNode *AstOptimizer::unaryDone(UnaryExprNode *un)
+{
+    if (ASTNode *folded = foldUnary(un))
+    {
+        ++stats.folded;
+        return folded;
+    }
+    // not not x, - -x
+    auto inner = dynCast<UnaryExprNode>(un->operand);
+    if (inner && inner->op == un->op)
+    {
+        ++stats.simplified;
+        return inner->operand;
+    }
+    return un;
+}
+
+// Both operands literal: compute the result the way the backends would
+ASTNode *AstOptimizer::foldBinary(const BinaryExprNode *bin)
+{
+    using Op = BinaryExprNode::Op;
+    auto l = dynCast<LiteralNode>(bin->left);
+    auto r = dynCast<LiteralNode>(bin->right);
+    if (!l || !r || l->literalType != r->literalType)
+        return nullptr;
+
+    int line = bin->lineNumber;
+    bool result = false;
+    switch (l->literalType)
+    {
+    case LiteralNode::Type::Int:
+    {
+        // Wrapping arithmetic, like the IR's add/sub/mul without nsw
+        uint32_t a = static_cast<uint32_t>(l->intValue), b = static_cast<uint32_t>(r->intValue);
+        switch (bin->op)
+        {
+        case Op::Add:
+            return intLiteral(static_cast<int32_t>(a + b), line);
+        case Op::Sub:
+            return intLiteral(static_cast<int32_t>(a - b), line);
+        case Op::Mul:
+            return intLiteral(static_cast<int32_t>(a * b), line);
+        case Op::Div:
+            // These trap (or are undefined) at run time; leave them there
+            if (r->intValue == 0 || (l->intValue == INT_MIN && r->intValue == -1))
+                return nullptr;
+            return intLiteral(l->intValue / r->intValue, line);
+        default:
+            return compareInt(bin->op, l->intValue, r->intValue, result) ? boolLiteral(result, line) : nullptr;
+        }
+    }
+    case LiteralNode::Type::Float:
+    {
+        float a = l->floatValue, b = r->floatValue;
+        switch (bin->op)
+        {
+        case Op::Add:
+            return floatLiteral(a + b, line);
+        case Op::Sub:
+            return floatLiteral(a - b, line);
+        case Op::Mul:
+            return floatLiteral(a * b, line);
+        case Op::Div:
+            return floatLiteral(a / b, line);
+        default:
+            return compareFloat(bin->op, a, b, result) ? boolLiteral(result, line) : nullptr;
+        }
+    }
+    case LiteralNode::Type::Char:
+        return compareInt(bin->op, static_cast<signed char>(l->charValue),
+                          static_cast<signed char>(r->charValue), result)
+                   ? boolLiteral(result, line)
+                   : nullptr;
+    case LiteralNode::Type::Bool:
+        // Ordering compares on i1 are signed in the IR; only fold the obvious ones
+        switch (bin->op)
+        {
+        case Op::And:
+            return boolLiteral(l->boolValue && r->boolValue, line);
+        case Op::Or:
+            return boolLiteral(l->boolValue || r->boolValue, line);
+        case Op::Eq:
+            return boolLiteral(l->boolValue == r->boolValue, line);
+        case Op::Neq:
+            return boolLiteral(l->boolValue != r->boolValue, line);
+        default:
+            return nullptr;
+        }
+    case LiteralNode::Type::String:
+    {
+        // Byte-wise as unsigned, the shorter first on a tie: bl_str_compare
+        std::string_view a = l->stringValue, b = r->stringValue;
+        if (bin->op == Op::Add)
+            return stringLiteral(std::string(a).append(b), line);
+        int order = a.compare(b);
+        return compareInt(bin->op, order, 0, result) ? boolLiteral(result, line) : nullptr;
+    }
+    }
+    return nullptr;
+}
+
+// One operand is an identity or absorbing element. and/or evaluate both
+// sides, so an absorbed operand is only dropped when it is pure.
+ASTNode *AstOptimizer::simplifyBinary(const BinaryExprNode *bin)
+{
+    using Op = BinaryExprNode::Op;
+    ASTNode *l = bin->left, *r = bin->right;
+    bool isFloat = bin->type == TypeId::Float;
+    // a * 0 is an array of zeros, not the scalar 0
+    if (bin->type.isArray())
+        return nullptr;
+    switch (bin->op)
+    {
+    case Op::Add:
+        if (isStringLiteral(r, ""))
+            return l;
+        if (isStringLiteral(l, ""))
+            return r;
+        // x + 0.0 is not x for x = -0.0
+        if (!isFloat && isIntLiteral(r, 0))
+            return l;
+        if (!isFloat && isIntLiteral(l, 0))
+            return r;
+        return nullptr;
+    case Op::Sub:
+        return isIntLiteral(r, 0) || isFloatLiteral(r, 0.0f) ? l : nullptr;
+    case Op::Mul:
+        if (isIntLiteral(r, 1) || isFloatLiteral(r, 1.0f))
+            return l;
+        if (isIntLiteral(l, 1) || isFloatLiteral(l, 1.0f))
+            return r;
+        if (isIntLiteral(r, 0) && isPure(l))
+            return r;
+        if (isIntLiteral(l, 0) && isPure(r))
+            return l;
+        return nullptr;
+    case Op::Div:
+        return isIntLiteral(r, 1) || isFloatLiteral(r, 1.0f) ? l : nullptr;
+    case Op::And:
+        if (isBoolLiteral(r, true))
+            return l;
+        if (isBoolLiteral(l, true))
+            return r;
+        if (isBoolLiteral(r, false) && isPure(l))
+            return r;
+        if (isBoolLiteral(l, false) && isPure(r))
+            return l;
+        return nullptr;
+    case Op::Or:
+        if (isBoolLiteral(r, false))
+            return l;
+        if (isBoolLiteral(l, false))
+            return r;
+        if (isBoolLiteral(r, true) && isPure(l))
+            return r;
+        if (isBoolLiteral(l, true) && isPure(r))
+            return l;
+        return nullptr;
+    default:
+        return nullptr;
+    }
+}
+
+ASTNode *AstOptimizer::foldUnary(const UnaryExprNode *un)
+{
+    auto lit = dynCast<LiteralNode>(un->operand);
+    if (!lit)
+        return nullptr;
+    int line = un->lineNumber;
+    if (un->op == UnaryExprNode::Op::Not)
+        return lit->literalType == LiteralNode::Type::Bool ? boolLiteral(!lit->boolValue, line) : nullptr;
+    switch (lit->literalType)
+    {
+    case LiteralNode::Type::Int:
+        return intLiteral(static_cast<int32_t>(0u - static_cast<uint32_t>(lit->intValue)), line);
+    case LiteralNode::Type::Float:
+        return floatLiteral(-lit->floatValue, line);
+    default:
+        return nullptr;
+    }
+}
+
+} // namespace
+
+AstOptStats optimizeAst(ProgramNode *root, AstArena &arena)
+{
+    AstOptimizer optimizer(arena);
+    walkTree(static_cast<ASTNode *>(root), [&](ASTNode *node, unsigned stage) { return optimizer.step(node, stage); });
+    return optimizer.stats;
+}
@@ -0,0 +1,26 @@
+// ast_optimizer.h
+#pragma once
+
+#include "ast.h"
+#include "ast_arena.h"
+
+// Tree-level clean-up between semantic analysis and code generation, so
+// every backend gets a smaller tree: constant folding, algebraic identities
+// (x*1, x+0, not not x, ...), ifs with a constant condition, and
+// statements after stop/skip. Folded values follow the backends' semantics
+// (wrapping int arithmetic, unordered float compares); anything that could
+// behave differently at run time, like a division by zero or an input()
+// call, is left in place.
+
+struct AstOptStats
+{
+    unsigned folded = 0;         // Expressions replaced by a literal
+    unsigned simplified = 0;     // Identities rewritten to one operand
+    unsigned deadStatements = 0; // Statements removed as unreachable or no-ops
+
+    unsigned total() const { return folded + simplified + deadStatements; }
+};
+
+// Rewrites the analyzed tree in place. New literals come from `arena` and
+// carry their type, so codegen can run on the result directly.
+AstOptStats optimizeAst(ProgramNode *root, AstArena &arena);
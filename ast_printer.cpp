@@ -3,23 +3,8 @@
 #include <iostream>
 #include <memory>
 
-extern std::unique_ptr<ProgramNode> astRoot;
-
 // Print any given AST
-void printAST(const ProgramNode &program)
-{
-    program.print();
-}
-// Print the global AST
-void printGlobalAST()
+void printAST(const ProgramNode &program, std::ostream &out)
 {
-    if (astRoot)
-    {
-        std::cout << "Printing the AST:\n";
-        printAST(*astRoot);
-    }
-    else
-    {
-        std::cout << "AST is empty or not generated yet.\n";
-    }
+    program.print(out);
 }
@@ -1,6 +1,6 @@
 #pragma once
 
 #include "ast.h"
+#include <iostream>
 
-void printAST(const ProgramNode &program);
-void printGlobalAST(); // Optional utility to print the global AST
+void printAST(const ProgramNode &program, std::ostream &out = std::cout);
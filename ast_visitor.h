@@ -0,0 +1,85 @@
+// ast_visitor.h
+#pragma once
+#include "ast.h"
+
+// Switch-based visitor over the node kind tag. Derived classes override the
+// visitX methods they care about (statically, no virtual calls); anything not
+// overridden falls through to visitNode. Args are passed through to each
+// visitX, e.g. the stage of a walkTree step.
+//
+//   class Counter : public ConstASTVisitor<Counter, int> { ... };
+template <class Derived, class R = void, class... Args>
+class ConstASTVisitor
+{
+public:
+    R visit(const ASTNode *node, Args... args)
+    {
+        switch (node->kind)
+        {
+        case NodeKind::Literal:
+            return self().visitLiteral(static_cast<const LiteralNode *>(node), args...);
+        case NodeKind::Identifier:
+            return self().visitIdentifier(static_cast<const IdentifierNode *>(node), args...);
+        case NodeKind::BinaryExpr:
+            return self().visitBinaryExpr(static_cast<const BinaryExprNode *>(node), args...);
+        case NodeKind::UnaryExpr:
+            return self().visitUnaryExpr(static_cast<const UnaryExprNode *>(node), args...);
+        case NodeKind::BuiltinCall:
+            return self().visitBuiltinCall(static_cast<const BuiltinCallNode *>(node), args...);
+        case NodeKind::ArrayLiteral:
+            return self().visitArrayLiteral(static_cast<const ArrayLiteralNode *>(node), args...);
+        case NodeKind::IndexExpr:
+            return self().visitIndexExpr(static_cast<const IndexExprNode *>(node), args...);
+        case NodeKind::Declaration:
+            return self().visitDeclaration(static_cast<const DeclarationNode *>(node), args...);
+        case NodeKind::Assignment:
+            return self().visitAssignment(static_cast<const AssignmentNode *>(node), args...);
+        case NodeKind::PrintStmt:
+            return self().visitPrintStmt(static_cast<const PrintStmtNode *>(node), args...);
+        case NodeKind::ReturnStmt:
+            return self().visitReturnStmt(static_cast<const ReturnStmtNode *>(node), args...);
+        case NodeKind::IfStmt:
+            return self().visitIfStmt(static_cast<const IfStmtNode *>(node), args...);
+        case NodeKind::RepeatStmt:
+            return self().visitRepeatStmt(static_cast<const RepeatStmtNode *>(node), args...);
+        case NodeKind::ParallelRepeat:
+            return self().visitParallelRepeat(static_cast<const ParallelRepeatNode *>(node), args...);
+        case NodeKind::Block:
+            return self().visitBlock(static_cast<const BlockNode *>(node), args...);
+        case NodeKind::Break:
+            return self().visitBreak(static_cast<const BreakNode *>(node), args...);
+        case NodeKind::Continue:
+            return self().visitContinue(static_cast<const ContinueNode *>(node), args...);
+        case NodeKind::Program:
+            return self().visitProgram(static_cast<const ProgramNode *>(node), args...);
+        }
+        return self().visitNode(node, args...);
+    }
+
+    R visitNode(const ASTNode *, Args...) { return R(); }
+
+    R visitLiteral(const LiteralNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitIdentifier(const IdentifierNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitBinaryExpr(const BinaryExprNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitUnaryExpr(const UnaryExprNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitBuiltinCall(const BuiltinCallNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitArrayLiteral(const ArrayLiteralNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitIndexExpr(const IndexExprNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitDeclaration(const DeclarationNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitAssignment(const AssignmentNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitPrintStmt(const PrintStmtNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitReturnStmt(const ReturnStmtNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitIfStmt(const IfStmtNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitRepeatStmt(const RepeatStmtNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitParallelRepeat(const ParallelRepeatNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitBlock(const BlockNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitBreak(const BreakNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitContinue(const ContinueNode *node, Args... args) { return self().visitNode(node, args...); }
+    R visitProgram(const ProgramNode *node, Args... args) { return self().visitNode(node, args...); }
+
+protected:
+    ~ConstASTVisitor() = default;
+
+private:
+    Derived &self() { return static_cast<Derived &>(*this); }
+};
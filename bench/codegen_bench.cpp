@@ -0,0 +1,149 @@
+// bench/codegen_bench.cpp
+//
+// Codegen throughput: parses and analyzes one large generated program once,
+// then times LLVMCodeGen::generate over the same tree several times and
+// reports AST nodes lowered per second. A second section isolates node
+// dispatch by walking the tree with the dynamic_cast chain codegen used to
+// have and with the kind-tag visitor it uses now.
+//
+//   codegen_bench [statements] [iterations]
+#include "ast_visitor.h"
+#include "compile_session.h"
+#include "llvm_codegen.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+// Straight-line arithmetic with an if every 10 statements and a loop every
+// 50, so every kind of node codegen dispatches on shows up.
+static std::string generateProgram(int statements)
+{
+    std::ostringstream src;
+    src << "int v0 = 1;\n";
+    for (int i = 1; i < statements; ++i)
+    {
+        src << "int v" << i << " = " << i % 97 << " + v" << i - 1 << " * 2 - (v" << i - 1 << " / 3);\n";
+        if (i % 10 == 0)
+            src << "if (v" << i << " > 3 and not (v" << i << " == 7)) { v" << i << " = v" << i
+                << " - 1; } else { print(v" << i << "); }\n";
+        if (i % 50 == 0)
+            src << "repeat (v" << i << " < 100) { v" << i << " = v" << i << " + 7; }\n";
+    }
+    return src.str();
+}
+
+// Node count via a dynamic_cast chain in the order the old codegen probed
+static size_t castWalk(const ASTNode *node)
+{
+    if (dynamic_cast<const LiteralNode *>(node) || dynamic_cast<const IdentifierNode *>(node))
+        return 1;
+    if (auto call = dynamic_cast<const BuiltinCallNode *>(node))
+        return 1 + call->args.size();
+    if (auto bin = dynamic_cast<const BinaryExprNode *>(node))
+        return 1 + castWalk(bin->left) + castWalk(bin->right);
+    if (auto un = dynamic_cast<const UnaryExprNode *>(node))
+        return 1 + castWalk(un->operand);
+    if (auto decl = dynamic_cast<const DeclarationNode *>(node))
+        return 1 + castWalk(decl->expr);
+    if (auto print = dynamic_cast<const PrintStmtNode *>(node))
+        return 1 + castWalk(print->expr);
+    if (auto assign = dynamic_cast<const AssignmentNode *>(node))
+        return 1 + castWalk(assign->value);
+    if (auto ifStmt = dynamic_cast<const IfStmtNode *>(node))
+        return 1 + castWalk(ifStmt->condition) + castWalk(ifStmt->thenBlock) +
+               (ifStmt->elseBlock ? castWalk(ifStmt->elseBlock) : 0);
+    if (auto repeat = dynamic_cast<const RepeatStmtNode *>(node))
+        return 1 + castWalk(repeat->condition) + castWalk(repeat->body);
+    if (auto block = dynamic_cast<const BlockNode *>(node))
+    {
+        size_t count = 1;
+        for (const ASTNode *stmt : block->statements)
+            count += castWalk(stmt);
+        return count;
+    }
+    return 1;
+}
+
+// The same count through the kind-tag visitor
+class KindWalker : public ConstASTVisitor<KindWalker, size_t>
+{
+public:
+    size_t visitNode(const ASTNode *) { return 1; }
+    size_t visitBuiltinCall(const BuiltinCallNode *call) { return 1 + call->args.size(); }
+    size_t visitBinaryExpr(const BinaryExprNode *bin) { return 1 + visit(bin->left) + visit(bin->right); }
+    size_t visitUnaryExpr(const UnaryExprNode *un) { return 1 + visit(un->operand); }
+    size_t visitDeclaration(const DeclarationNode *decl) { return 1 + visit(decl->expr); }
+    size_t visitPrintStmt(const PrintStmtNode *print) { return 1 + visit(print->expr); }
+    size_t visitAssignment(const AssignmentNode *assign) { return 1 + visit(assign->value); }
+    size_t visitIfStmt(const IfStmtNode *ifStmt)
+    {
+        return 1 + visit(ifStmt->condition) + visit(ifStmt->thenBlock) +
+               (ifStmt->elseBlock ? visit(ifStmt->elseBlock) : 0);
+    }
+    size_t visitRepeatStmt(const RepeatStmtNode *repeat) { return 1 + visit(repeat->condition) + visit(repeat->body); }
+    size_t visitBlock(const BlockNode *block)
+    {
+        size_t count = 1;
+        for (const ASTNode *stmt : block->statements)
+            count += visit(stmt);
+        return count;
+    }
+};
+
+template <class Walk>
+static double bestOf(int iterations, const ProgramNode *root, Walk walk, size_t &visited)
+{
+    double best = 1e300;
+    for (int i = 0; i < iterations; ++i)
+    {
+        Clock::time_point start = Clock::now();
+        visited = 0;
+        for (const ASTNode *stmt : root->statements)
+            visited += walk(stmt);
+        best = std::min(best, msSince(start));
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int statements = argc > 1 ? std::atoi(argv[1]) : 50000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    CompileSession session(generateProgram(statements));
+    if (!session.parse() || !session.analyze())
+    {
+        std::fprintf(stderr, "codegen_bench: generated program did not compile\n");
+        return 1;
+    }
+    size_t nodes = session.arena.nodeCount();
+
+    double best = 1e300, total = 0;
+    for (int i = 0; i < iterations; ++i)
+    {
+        Clock::time_point start = Clock::now();
+        LLVMCodeGen codegen;
+        codegen.generate(session.astRoot);
+        double ms = msSince(start);
+        best = std::min(best, ms);
+        total += ms;
+    }
+
+    std::printf("codegen: %d statements, %zu nodes, %d iterations\n", statements, nodes, iterations);
+    std::printf("  best %.2f ms, mean %.2f ms, %.2f M nodes/s\n",
+                best, total / iterations, nodes / best / 1000.0);
+
+    size_t castNodes = 0, kindNodes = 0;
+    KindWalker walker;
+    double castMs = bestOf(iterations * 4, session.astRoot, castWalk, castNodes);
+    double kindMs = bestOf(iterations * 4, session.astRoot,
+                           [&](const ASTNode *stmt) { return walker.visit(stmt); }, kindNodes);
+    std::printf("dispatch only (%zu nodes walked):\n", kindNodes);
+    std::printf("  dynamic_cast chain %.2f ms (%.1f ns/node)\n", castMs, castMs * 1e6 / castNodes);
+    std::printf("  kind switch        %.2f ms (%.1f ns/node)\n", kindMs, kindMs * 1e6 / kindNodes);
+    return 0;
+}
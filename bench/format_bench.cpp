@@ -0,0 +1,132 @@
+// bench/format_bench.cpp
+//
+// Number formatting throughput without the I/O: the runtime's formatters
+// against snprintf and std::to_chars on the same values, in ns per value,
+// for ints of every length and for floats both as programs compute them
+// and made of random bits. Each value is checked once, untimed:
+// bl_format_i32 and bl_format_f32_fixed must give snprintf's "%d" and "%f"
+// text byte for byte, and bl_format_f32 must read back as the same float
+// with as many significant digits as to_chars's shortest form. The
+// mismatches are counted per kind, and any makes the exit status 1.
+//
+//   format_bench [values] [iterations]
+#include "runtime.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Best time of `iterations` runs of format over every value, in ns per value
+template <typename T, typename Format>
+static double time(const std::vector<T> &values, int iterations, Format format)
+{
+    char text[64];
+    double best = 1e300;
+    size_t total = 0;
+    for (int i = 0; i < iterations; ++i)
+    {
+        Clock::time_point start = Clock::now();
+        for (T value : values)
+            total += format(text, value);
+        best = std::min(best, msSince(start));
+    }
+    volatile size_t sink = total; // Keeps the work from being optimised out
+    (void)sink;
+    return best * 1e6 / values.size();
+}
+
+// Significant digits of a number in fixed or scientific notation
+static size_t digitCount(const char *text, size_t length)
+{
+    std::string digits;
+    for (size_t i = 0; i < length && text[i] != 'e'; ++i)
+        if (text[i] >= '0' && text[i] <= '9')
+            digits += text[i];
+    size_t first = digits.find_first_not_of('0');
+    return first == std::string::npos ? 0 : digits.find_last_not_of('0') + 1 - first;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned count = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : 2000000;
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+
+    // Integers of every length and sign; floats as programs compute them
+    // (small fractions) and from random bits (any exponent)
+    std::mt19937 rng(1);
+    std::vector<int32_t> ints(count);
+    std::vector<float> computed(count), randomBits;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        ints[i] = static_cast<int32_t>(rng()) >> (rng() % 31);
+        computed[i] = static_cast<float>(static_cast<int32_t>(rng() % 2000001) - 1000000) / 1024.0f;
+    }
+    while (randomBits.size() < count)
+    {
+        uint32_t bits = static_cast<uint32_t>(rng());
+        float value;
+        std::memcpy(&value, &bits, sizeof value);
+        if (std::isfinite(value))
+            randomBits.push_back(value);
+    }
+
+    auto viaPrintfInt = [](char *out, int32_t v) { return static_cast<size_t>(std::snprintf(out, 64, "%d", v)); };
+    auto viaPrintfFixed = [](char *out, float v) {
+        return static_cast<size_t>(std::snprintf(out, 64, "%f", static_cast<double>(v)));
+    };
+    auto viaPrintfShort = [](char *out, float v) {
+        return static_cast<size_t>(std::snprintf(out, 64, "%.9g", static_cast<double>(v)));
+    };
+    auto viaToCharsInt = [](char *out, int32_t v) {
+        return static_cast<size_t>(std::to_chars(out, out + 64, v).ptr - out);
+    };
+    auto viaToCharsShort = [](char *out, float v) {
+        return static_cast<size_t>(std::to_chars(out, out + 64, v, std::chars_format::scientific).ptr - out);
+    };
+
+    // Checks, untimed
+    unsigned intErrors = 0, fixedErrors = 0, shortErrors = 0;
+    char text[64], expected[64];
+    for (int32_t v : ints)
+    {
+        size_t length = bl_format_i32(text, v);
+        intErrors += length != viaPrintfInt(expected, v) || std::memcmp(text, expected, length) != 0;
+    }
+    for (const std::vector<float> *values : {&computed, &randomBits})
+    {
+        for (float v : *values)
+        {
+            size_t length = bl_format_f32_fixed(text, v);
+            fixedErrors += length != viaPrintfFixed(expected, v) || std::memcmp(text, expected, length) != 0;
+
+            length = bl_format_f32(text, v);
+            text[length] = '\0';
+            size_t shortest = viaToCharsShort(expected, v);
+            shortErrors +=
+                std::strtof(text, nullptr) != v || digitCount(text, length) != digitCount(expected, shortest);
+        }
+    }
+
+    std::printf("format: %u values, best of %d\n", count, iterations);
+    std::printf("%-19s %12s %12s %12s\n", "kind", "snprintf ns", "to_chars ns", "runtime ns");
+    std::printf("%-19s %12.1f %12.1f %12.1f\n", "int", time(ints, iterations, viaPrintfInt),
+                time(ints, iterations, viaToCharsInt), time(ints, iterations, bl_format_i32));
+    for (const auto &[name, values] : {std::pair{"float", &computed}, std::pair{"float bits", &randomBits}})
+    {
+        std::printf("%-19s %12.1f %12s %12.1f\n", (std::string(name) + " fixed").c_str(),
+                    time(*values, iterations, viaPrintfFixed), "-", time(*values, iterations, bl_format_f32_fixed));
+        std::printf("%-19s %12.1f %12.1f %12.1f\n", (std::string(name) + " shortest").c_str(),
+                    time(*values, iterations, viaPrintfShort), time(*values, iterations, viaToCharsShort),
+                    time(*values, iterations, bl_format_f32));
+    }
+    std::printf("errors: %u int, %u fixed float, %u shortest float\n", intErrors, fixedErrors, shortErrors);
+    return intErrors + fixedErrors + shortErrors ? 1 : 0;
+}
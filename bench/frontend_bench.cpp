@@ -0,0 +1,143 @@
+// bench/frontend_bench.cpp
+//
+// Front-end throughput per stage on the generated program shapes of
+// program_gen.h: parsing (yyparse pulling tokens from the default lexer),
+// ProgramNode::analyze and LLVMCodeGen::generate, in source lines and AST
+// nodes per second. Each iteration compiles a fresh session after one
+// untimed warm-up run; the median is reported with the fastest run and the
+// relative standard deviation, so a change can be told from noise. The
+// programs depend only on the arguments, so runs are comparable across
+// machines and commits.
+//
+//   frontend_bench [statements] [iterations] [depth] [shape|all] [seed]
+#include "compile_session.h"
+#include "llvm_codegen.h"
+#include "program_gen.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Summary
+{
+    double median = 0;
+    double best = 0;
+    double relStddev = 0; // Percent of the mean
+};
+
+static Summary summarize(std::vector<double> samples)
+{
+    Summary s;
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    s.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    s.best = samples.front();
+    double mean = 0;
+    for (double x : samples)
+        mean += x;
+    mean /= n;
+    double variance = 0;
+    for (double x : samples)
+        variance += (x - mean) * (x - mean);
+    s.relStddev = n > 1 && mean > 0 ? std::sqrt(variance / (n - 1)) / mean * 100 : 0;
+    return s;
+}
+
+enum Stage
+{
+    Parse,
+    Analyze,
+    Generate,
+    StageCount
+};
+
+static const char *const stageNames[StageCount] = {"parse", "analyze", "codegen"};
+
+// One full front-end pass; false if the program does not compile
+static bool compileOnce(const std::string &program, double (&ms)[StageCount], size_t &nodes)
+{
+    CompileSession session(program);
+
+    Clock::time_point start = Clock::now();
+    bool parsed = session.parse();
+    ms[Parse] = msSince(start);
+    if (!parsed)
+        return false;
+    nodes = session.arena.nodeCount();
+
+    start = Clock::now();
+    bool analyzed = session.analyze();
+    ms[Analyze] = msSince(start);
+    if (!analyzed)
+        return false;
+
+    LLVMCodeGen codegen;
+    start = Clock::now();
+    codegen.generate(session.astRoot);
+    ms[Generate] = msSince(start);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    ProgramSpec spec;
+    spec.statements = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : 20000;
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 7;
+    spec.depth = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 8;
+    const char *only = argc > 4 ? argv[4] : "all";
+    spec.seed = argc > 5 ? static_cast<uint32_t>(std::strtoul(argv[5], nullptr, 10)) : 1;
+
+    std::vector<ProgramShape> shapes;
+    ProgramShape shape;
+    if (std::strcmp(only, "all") == 0)
+        shapes.assign(std::begin(AllProgramShapes), std::end(AllProgramShapes));
+    else if (parseProgramShape(only, shape))
+        shapes.push_back(shape);
+    else
+    {
+        std::fprintf(stderr, "frontend_bench: unknown shape %s (decls, exprs, nested, prints, mixed or all)\n", only);
+        return 1;
+    }
+
+    std::printf("frontend: %u statements, depth %u, seed %u, %d iterations; median (best, +-stddev)\n",
+                spec.statements, spec.depth, spec.seed, iterations);
+    std::printf("%-7s %9s %9s  %-8s %10s %10s %7s %10s %10s\n", "shape", "lines", "nodes", "stage", "median ms",
+                "best ms", "+-%", "Mlines/s", "Mnodes/s");
+
+    for (ProgramShape current : shapes)
+    {
+        spec.shape = current;
+        std::string program = generateProgram(spec);
+        size_t lines = std::count(program.begin(), program.end(), '\n');
+
+        double ms[StageCount];
+        size_t nodes = 0;
+        if (!compileOnce(program, ms, nodes)) // Warm-up, and checks the generator
+        {
+            std::fprintf(stderr, "frontend_bench: generated %s program did not compile\n", programShapeName(current));
+            return 1;
+        }
+
+        std::vector<double> samples[StageCount];
+        for (int i = 0; i < iterations; ++i)
+        {
+            compileOnce(program, ms, nodes);
+            for (int stage = 0; stage < StageCount; ++stage)
+                samples[stage].push_back(ms[stage]);
+        }
+
+        for (int stage = 0; stage < StageCount; ++stage)
+        {
+            Summary s = summarize(samples[stage]);
+            std::printf("%-7s %9zu %9zu  %-8s %10.2f %10.2f %7.1f %10.2f %10.2f\n", programShapeName(current), lines,
+                        nodes, stageNames[stage], s.median, s.best, s.relStddev, lines / s.median / 1e3,
+                        nodes / s.median / 1e3);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,31 @@
+// bench/genprog.cpp
+//
+// Writes a synthetic BitLang program to stdout, the same ones
+// frontend_bench measures, for profiling the compiler on them directly:
+//
+//   genprog <decls|exprs|nested|prints|mixed> [statements] [depth] [seed] > big.prog
+//   ./compiler --time-report big.prog
+#include "program_gen.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    ProgramSpec spec;
+    if (argc < 2 || !parseProgramShape(argv[1], spec.shape))
+    {
+        std::fprintf(stderr, "Usage: genprog <decls|exprs|nested|prints|mixed> [statements] [depth] [seed]\n");
+        return 1;
+    }
+    if (argc > 2)
+        spec.statements = static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10));
+    if (argc > 3)
+        spec.depth = static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10));
+    if (argc > 4)
+        spec.seed = static_cast<uint32_t>(std::strtoul(argv[4], nullptr, 10));
+
+    std::cout << generateProgram(spec);
+    return std::cout ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+// bench/input_bench.cpp
+//
+// Input throughput of the runtime's readers against the scanf calls
+// generated code used to make, one value per call as input() does. The
+// values are written to a file first and read back from it directly (the
+// runtime maps it) and through a pipe from a child process (the runtime
+// reads it in blocks). In each case the values the runtime reads must add
+// up to exactly what scanf's do; the bench prints both sums when they
+// differ and exits with status 1.
+//
+//   input_bench [values] [iterations] [data-directory]
+#include "runtime.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Values of every sign and length, as print_bench prints them
+static int32_t intValue(unsigned i)
+{
+    return static_cast<int32_t>(i * 2654435761u) >> (i % 24);
+}
+
+static float floatValue(unsigned i)
+{
+    return static_cast<float>(intValue(i)) / 1024.0f;
+}
+
+// One value per line, as a BitLang program would have printed them
+static bool writeData(const std::string &path, unsigned count, bool floats)
+{
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+    char text[BL_FORMAT_MAX + 1];
+    for (unsigned i = 0; i < count; ++i)
+    {
+        size_t length = floats ? bl_format_f32(text, floatValue(i)) : bl_format_i32(text, intValue(i));
+        text[length] = '\n';
+        std::fwrite(text, 1, length + 1, file);
+    }
+    return std::fclose(file) == 0;
+}
+
+// A descriptor reading the file, or a pipe that a child process fills from it
+static int openData(const std::string &path, bool throughPipe, pid_t &writer)
+{
+    int file = open(path.c_str(), O_RDONLY);
+    writer = -1;
+    int ends[2];
+    if (file < 0 || !throughPipe || pipe(ends) != 0)
+        return file;
+    writer = fork();
+    if (writer == 0)
+    {
+        close(ends[0]);
+        static char block[1 << 16];
+        ssize_t got;
+        while ((got = read(file, block, sizeof block)) > 0)
+            for (ssize_t sent = 0, n; sent < got; sent += n)
+                if ((n = write(ends[1], block + sent, static_cast<size_t>(got - sent))) <= 0)
+                    _exit(1);
+        _exit(0);
+    }
+    close(ends[1]);
+    close(file);
+    return ends[0];
+}
+
+// Sum of the values, read with fscanf (what scanf does, on another FILE)
+static double viaScanf(int fd, unsigned count, bool floats)
+{
+    FILE *in = fdopen(fd, "r");
+    double sum = 0;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        int intRead;
+        float floatRead;
+        if (floats ? std::fscanf(in, "%f", &floatRead) != 1 : std::fscanf(in, "%d", &intRead) != 1)
+            break;
+        sum += floats ? floatRead : intRead;
+    }
+    std::fclose(in);
+    return sum;
+}
+
+// Sum of the values, read by the runtime from standard input
+static double viaRuntime(int fd, unsigned count, bool floats)
+{
+    dup2(fd, STDIN_FILENO);
+    close(fd);
+    bl_set_input(nullptr, 0);
+    double sum = 0;
+    for (unsigned i = 0; i < count; ++i)
+        sum += floats ? bl_input_f32() : bl_input_i32();
+    bl_set_input(nullptr, 0);
+    return sum;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned count = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : 10000000;
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+    std::string directory = argc > 3 ? argv[3] : std::getenv("TMPDIR") ? std::getenv("TMPDIR") : "/tmp";
+
+    std::printf("input: %u values per run, best of %d\n", count, iterations);
+    std::printf("%-11s %11s %11s %11s %11s %8s\n", "kind", "scanf ms", "runtime ms", "scanf ns", "runtime ns",
+                "speedup");
+    int errors = 0;
+    for (bool floats : {false, true})
+    {
+        std::string path = directory + "/input_bench." + std::to_string(getpid()) + (floats ? ".float" : ".int");
+        if (!writeData(path, count, floats))
+        {
+            std::fprintf(stderr, "input_bench: cannot write %s\n", path.c_str());
+            return 1;
+        }
+        for (bool throughPipe : {false, true})
+        {
+            double scanfMs = 1e300, runtimeMs = 1e300, scanfSum = 0, runtimeSum = 0;
+            for (int i = 0; i < iterations; ++i)
+            {
+                pid_t writer;
+                int fd = openData(path, throughPipe, writer);
+                Clock::time_point start = Clock::now();
+                scanfSum = viaScanf(fd, count, floats);
+                scanfMs = std::min(scanfMs, msSince(start));
+                if (writer > 0)
+                    waitpid(writer, nullptr, 0);
+
+                fd = openData(path, throughPipe, writer);
+                start = Clock::now();
+                runtimeSum = viaRuntime(fd, count, floats);
+                runtimeMs = std::min(runtimeMs, msSince(start));
+                if (writer > 0)
+                    waitpid(writer, nullptr, 0);
+            }
+            std::string kind = std::string(floats ? "float" : "int") + (throughPipe ? " pipe" : " file");
+            std::printf("%-11s %11.2f %11.2f %11.1f %11.1f %7.2fx\n", kind.c_str(), scanfMs, runtimeMs,
+                        scanfMs * 1e6 / count, runtimeMs * 1e6 / count, scanfMs / runtimeMs);
+            if (scanfSum != runtimeSum)
+            {
+                std::printf("  sums differ: scanf %.17g, runtime %.17g\n", scanfSum, runtimeSum);
+                ++errors;
+            }
+        }
+        std::remove(path.c_str());
+    }
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+// bench/lexer_bench.cpp
+//
+// Lexer throughput on a generated multi-megabyte program: the flex scanner
+// from lexer.l against FastLexer reading a mapped file, token loop only and
+// then a full parse with each. The two token streams (kinds, lines and
+// values) are checksummed and must agree.
+//
+//   lexer_bench [megabytes] [iterations]
+#include "compile_session.h"
+#include "fast_lexer.h"
+#include "source_file.h"
+#include "parser.tab.h"
+#include "lex.yy.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// Statements in the shapes real programs use: nested blocks with
+// indentation, long and short names, every literal kind, strings with and
+// without escapes
+static std::string generateProgram(size_t bytes)
+{
+    std::string program;
+    program.reserve(bytes + 256);
+    unsigned seed = 12345;
+    auto next = [&seed] { return seed = seed * 1103515245u + 12345u, (seed >> 16) & 0x7fff; };
+
+    for (int n = 0; program.size() < bytes; ++n)
+    {
+        std::string v = "value_" + std::to_string(n);
+        program += "int " + v + " = " + std::to_string(next()) + ";\n";
+        program += "float ratio_" + std::to_string(n) + " = " + std::to_string(next()) + "." +
+                   std::to_string(next() % 1000) + ";\n";
+        program += "string label_" + std::to_string(n) +
+                   (next() % 4 == 0 ? " = \"line\\tone\\n\";\n" : " = \"a plain string literal of some length\";\n");
+        program += "if (" + v + " > 100 and not (" + v + " == 4096)) {\n";
+        program += "    repeat (" + v + " >= 10) {\n";
+        program += "        " + v + " = " + v + " / 2 - 1;\n";
+        program += "        if (" + v + " != 7) { skip; }\n";
+        program += "    }\n";
+        program += "    print(" + v + " * 3 + (" + v + " - 1) * ratio_" + std::to_string(n) + ");\n";
+        program += "} else {\n";
+        program += "    bool flag_" + std::to_string(n) + " = true or false;\n";
+        program += "    print(label_" + std::to_string(n) + ");\n";
+        program += "}\n\n";
+    }
+    return program;
+}
+
+struct TokenStats
+{
+    uint64_t tokens = 0;
+    uint64_t checksum = 0;
+
+    void add(int token, const YYSTYPE &value, const YYLTYPE &location, const Interner &interner)
+    {
+        uint64_t h = uint64_t(token) * 0x9E3779B97F4A7C15ull ^ uint64_t(location.first_line);
+        switch (token)
+        {
+        case INTEGER_LITERAL: h ^= uint64_t(uint32_t(value.ival)) << 20; break;
+        case FLOAT_LITERAL: { uint32_t bits; std::memcpy(&bits, &value.fval, sizeof(bits)); h ^= uint64_t(bits) << 20; break; }
+        case IDENTIFIER: h ^= std::hash<std::string_view>()(interner.name(value.ident)); break;
+        case STRING_LITERAL: h ^= std::hash<std::string_view>()(value.sval.view()); break;
+        default: break;
+        }
+        checksum = checksum * 31 + h;
+        ++tokens;
+    }
+};
+
+static TokenStats lexWithFlex(std::string_view source)
+{
+    CompileSession session{std::string()};
+    yyscan_t scanner;
+    yylex_init_extra(&session, &scanner);
+    YY_BUFFER_STATE buffer = yy_scan_bytes(source.data(), static_cast<int>(source.size()), scanner);
+    yyset_lineno(1, scanner);
+
+    TokenStats stats;
+    YYSTYPE value;
+    YYLTYPE location = {1, 1, 1, 1};
+    while (int token = yylex(&value, &location, scanner))
+        stats.add(token, value, location, session.interner);
+
+    yy_delete_buffer(buffer, scanner);
+    yylex_destroy(scanner);
+    return stats;
+}
+
+static TokenStats lexWithFast(const std::string &path)
+{
+    CompileSession session{std::string()};
+    std::unique_ptr<SourceFile> file = SourceFile::open(path);
+    FastLexer lexer(file->text(), session.arena, session.interner);
+
+    TokenStats stats;
+    YYSTYPE value;
+    YYLTYPE location = {1, 1, 1, 1};
+    while (int token = lexer.next(value, location))
+        stats.add(token, value, location, session.interner);
+    return stats;
+}
+
+static bool parseWith(const std::string &path, LexerKind lexer)
+{
+    CompileSession session(SourceFile::open(path));
+    session.lexer = lexer;
+    return session.parse();
+}
+
+template <class Run>
+static double bestOf(int iterations, Run run)
+{
+    double best = 1e300;
+    for (int i = 0; i < iterations; ++i)
+    {
+        Clock::time_point start = Clock::now();
+        run();
+        best = std::min(best, msSince(start));
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    std::string program = generateProgram(megabytes * 1024 * 1024);
+    std::string path = "lexer_bench_input.prog";
+    std::ofstream(path, std::ios::binary) << program;
+
+    // The flex scanner is given bytes already in memory, as the driver used
+    // to; FastLexer gets the mapped file, so its times include the mapping
+    TokenStats flexStats, fastStats;
+    double flexMs = bestOf(iterations, [&] { flexStats = lexWithFlex(program); });
+    double fastMs = bestOf(iterations, [&] { fastStats = lexWithFast(path); });
+    bool parsed = true;
+    double flexParseMs = bestOf(iterations, [&] { parsed &= parseWith(path, LexerKind::Flex); });
+    double fastParseMs = bestOf(iterations, [&] { parsed &= parseWith(path, LexerKind::Fast); });
+    std::remove(path.c_str());
+
+    double mb = program.size() / (1024.0 * 1024.0);
+    std::printf("input: %.1f MiB, %llu tokens\n", mb, static_cast<unsigned long long>(fastStats.tokens));
+    std::printf("%-6s %10s %14s %10s %12s\n", "lexer", "lex ms", "Mtokens/s", "MiB/s", "parse ms");
+    std::printf("%-6s %10.1f %14.1f %10.1f %12.1f\n", "flex", flexMs, flexStats.tokens / flexMs / 1e3, mb / flexMs * 1e3,
+                flexParseMs);
+    std::printf("%-6s %10.1f %14.1f %10.1f %12.1f\n", "fast", fastMs, fastStats.tokens / fastMs / 1e3, mb / fastMs * 1e3,
+                fastParseMs);
+    std::printf("speedup: %.1fx lexing, %.1fx parsing\n", flexMs / fastMs, flexParseMs / fastParseMs);
+
+    if (flexStats.tokens != fastStats.tokens || flexStats.checksum != fastStats.checksum)
+    {
+        std::fprintf(stderr, "lexer_bench: token streams differ (%llu vs %llu tokens)\n",
+                     static_cast<unsigned long long>(flexStats.tokens),
+                     static_cast<unsigned long long>(fastStats.tokens));
+        return 1;
+    }
+    if (!parsed)
+    {
+        std::fprintf(stderr, "lexer_bench: generated program did not parse\n");
+        return 1;
+    }
+    return 0;
+}
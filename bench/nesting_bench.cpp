@@ -0,0 +1,91 @@
+// bench/nesting_bench.cpp
+//
+// How the front end scales with nesting depth: a left-deep operator chain,
+// right-deep parentheses and nested ifs, from 10 levels up to a million.
+// Each program is compiled on a CompileStackSize stack, as the driver
+// does, and parse, analyze and codegen are timed
+// (best of the iterations). Time per level should stay flat as the depth
+// grows; a program that crashes here would crash the compiler.
+//
+//   nesting_bench [max-depth] [iterations] [parser: bison|rd]
+#include "compile_session.h"
+#include "large_stack.h"
+#include "llvm_codegen.h"
+#include "program_gen.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+struct StageTimes
+{
+    double parse = 1e300, analyze = 1e300, codegen = 1e300;
+};
+
+static bool compileOnce(const std::string &program, unsigned maxNesting, ParserKind parser, StageTimes &best)
+{
+    CompileSession session(program);
+    session.maxNesting = maxNesting;
+    session.parser = parser;
+
+    Clock::time_point start = Clock::now();
+    if (!session.parse())
+        return false;
+    best.parse = std::min(best.parse, msSince(start));
+
+    start = Clock::now();
+    if (!session.analyze())
+        return false;
+    best.analyze = std::min(best.analyze, msSince(start));
+
+    LLVMCodeGen codegen;
+    start = Clock::now();
+    codegen.generate(session.astRoot);
+    best.codegen = std::min(best.codegen, msSince(start));
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned maxDepth = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : 1000000;
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+    ParserKind parser = ParserKind::Bison;
+    if (argc > 3 && !parseParserKind(argv[3], parser))
+    {
+        std::fprintf(stderr, "nesting_bench: unknown parser %s\n", argv[3]);
+        return 1;
+    }
+
+    std::printf("nesting: best of %d, %s parser\n", iterations, parser == ParserKind::Bison ? "bison" : "rd");
+    std::printf("%-7s %9s %11s %11s %11s %10s %10s %10s\n", "shape", "depth", "parse ms", "analyze ms", "codegen ms",
+                "parse ns", "analyze ns", "codegen ns");
+
+    for (NestingShape shape : AllNestingShapes)
+    {
+        for (unsigned depth = 10; depth <= maxDepth; depth *= 10)
+        {
+            std::string program = generateNestedProgram(shape, depth);
+            unsigned maxNesting = nestingLevels(shape, depth);
+            StageTimes best;
+            bool ok = true;
+            runWithStack(CompileStackSize, [&] {
+                for (int i = 0; i < iterations && ok; ++i)
+                    ok = compileOnce(program, maxNesting, parser, best);
+            });
+            if (!ok)
+            {
+                std::fprintf(stderr, "nesting_bench: %s program %u deep did not compile\n", nestingShapeName(shape),
+                             depth);
+                return 1;
+            }
+            std::printf("%-7s %9u %11.2f %11.2f %11.2f %10.1f %10.1f %10.1f\n", nestingShapeName(shape), depth,
+                        best.parse, best.analyze, best.codegen, best.parse * 1e6 / depth,
+                        best.analyze * 1e6 / depth, best.codegen * 1e6 / depth);
+            if (depth > maxDepth / 10)
+                break;
+        }
+    }
+    return 0;
+}
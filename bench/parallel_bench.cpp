@@ -0,0 +1,114 @@
+// bench/parallel_bench.cpp
+//
+// Scaling of the runtime's parallel repeat. The body is what compiled
+// BitLang code hands bl_parallel_repeat: one chunk of iterations, a float
+// sum and an int count reduced into the chunk's partial. It is run with 1
+// worker up to the number of cores (or the count given), on a uniform
+// loop, where every iteration costs the same, and on a skewed one, where
+// the cost grows with the index so the threads that start on the last
+// chunks run out of their own work last and the others steal from them.
+// The combined results must come out the same for every worker count, bit
+// for bit, as the runtime splits the loop into the same chunks whatever
+// runs them.
+//
+//   parallel_bench [iterations] [max workers] [repeats]
+#include "runtime.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+struct Partial
+{
+    float sum;
+    int32_t count;
+};
+
+struct Context
+{
+    int32_t work;  // Inner steps per iteration
+    bool skewed;   // ... times i / work, for the skewed loop
+};
+
+// A bit of float arithmetic per inner step, so the loop is bound by the
+// cores and not by memory
+static int32_t body(void *context, int32_t begin, int32_t end, void *partial, int32_t *)
+{
+    const Context &job = *static_cast<const Context *>(context);
+    Partial result = {0.0f, 0};
+    for (int32_t i = begin; i < end; ++i)
+    {
+        int32_t steps = job.skewed ? 1 + i / job.work : job.work;
+        float x = static_cast<float>(i % 97) * 0.01f;
+        for (int32_t s = 0; s < steps; ++s)
+            x = x * 0.999f + 0.5f;
+        result.sum = result.sum + x;
+        if (x > 250.0f)
+            result.count = result.count + 1;
+    }
+    std::memcpy(partial, &result, sizeof result);
+    return 0;
+}
+
+// The loop's sum and count, folded in chunk order as generated code does
+static Partial run(const Context &job, int32_t iterations, std::vector<Partial> &partials)
+{
+    int32_t error[2];
+    bl_parallel_repeat(body, const_cast<Context *>(&job), 0, iterations, partials.data(), sizeof(Partial), error);
+    Partial total = {0.0f, 0};
+    for (int32_t k = 0; k < bl_parallel_chunks(0, iterations); ++k)
+    {
+        total.sum = total.sum + partials[k].sum;
+        total.count = total.count + partials[k].count;
+    }
+    return total;
+}
+
+int main(int argc, char **argv)
+{
+    int32_t iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 200000;
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    unsigned maxWorkers = argc > 2 ? std::max(1, std::atoi(argv[2])) : cores;
+    int repeats = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+    int errors = 0;
+
+    std::vector<Partial> partials(BL_PARALLEL_CHUNKS);
+    std::printf("parallel repeat over %d iterations, %u cores, best of %d\n", iterations, cores, repeats);
+    for (bool skewed : {false, true})
+    {
+        Context job = {skewed ? iterations / 2000 + 1 : 1000, skewed};
+        std::printf("%s\n%8s %12s %10s %14s %10s\n", skewed ? "skewed: cost grows with i" : "uniform",
+                    "workers", "ms", "speedup", "sum", "count");
+        double serialMs = 0;
+        Partial expected = {0.0f, 0};
+        for (unsigned workers = 1; workers <= maxWorkers; workers = workers < 4 ? workers + 1 : workers * 2)
+        {
+            bl_parallel_set_workers(workers);
+            run(job, iterations, partials); // Starts the threads
+            double best = 1e300;
+            Partial result = {0.0f, 0};
+            for (int i = 0; i < repeats; ++i)
+            {
+                Clock::time_point start = Clock::now();
+                result = run(job, iterations, partials);
+                best = std::min(best, msSince(start));
+            }
+            if (workers == 1)
+            {
+                serialMs = best;
+                expected = result;
+            }
+            std::printf("%8u %12.2f %9.2fx %14.6g %10d\n", workers, best, serialMs / best, result.sum, result.count);
+            if (std::memcmp(&result.sum, &expected.sum, sizeof(float)) != 0 || result.count != expected.count)
+            {
+                std::printf("  result differs from 1 worker's\n");
+                ++errors;
+            }
+        }
+    }
+    return errors ? 1 : 0;
+}
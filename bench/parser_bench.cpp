@@ -0,0 +1,109 @@
+// bench/parser_bench.cpp
+//
+// Parse throughput of the Bison parser against the hand-written
+// recursive-descent one on a large generated program heavy on nested
+// expressions and blocks. Both read tokens from the same lexer; a
+// token-only pass is timed too so the parsers' own share can be read off.
+// The two trees are compared node by node before anything is timed.
+//
+//   parser_bench [statements] [iterations]
+#include "compile_session.h"
+#include "fast_lexer.h"
+#include "rd_parser.h"
+#include "parser.tab.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+// Every precedence level, unary operators, parentheses and nested blocks
+static std::string generateProgram(int statements)
+{
+    std::ostringstream src;
+    src << "int v0 = 1;\nfloat f = 0.5;\n";
+    for (int i = 1; i < statements; ++i)
+    {
+        int p = i - 1;
+        src << "int v" << i << " = -v" << p << " * 3 + (v" << p << " - " << i % 13 << ") / 2 - -" << i % 7
+            << ";\n";
+        if (i % 4 == 0)
+            src << "if (v" << i << " > 3 and not (v" << i << " == 7) or v" << p << " <= -2) {\n"
+                << "    v" << i << " = v" << i << " - 1;\n"
+                << "    repeat (v" << i << " < 100 and v" << p << " != 0) { v" << i << " = v" << i
+                << " + 7 * (2 + v" << p << "); if (v" << i << " >= 50) { stop; } }\n"
+                << "} else {\n"
+                << "    print(\"value\"); print(v" << i << " * f);\n"
+                << "}\n";
+    }
+    return src.str();
+}
+
+static size_t countTokens(const std::string &source)
+{
+    CompileSession session{std::string()};
+    FastLexer lexer(source, session.arena, session.interner);
+    YYSTYPE value;
+    YYLTYPE location = {1, 1, 1, 1};
+    size_t tokens = 0;
+    while (lexer.next(value, location))
+        ++tokens;
+    return tokens;
+}
+
+static bool parseWith(const std::string &source, ParserKind parser)
+{
+    CompileSession session(source);
+    session.parser = parser;
+    return session.parse();
+}
+
+template <class Run>
+static double bestOf(int iterations, Run run)
+{
+    double best = 1e300;
+    for (int i = 0; i < iterations; ++i)
+    {
+        Clock::time_point start = Clock::now();
+        run();
+        best = std::min(best, msSince(start));
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int statements = argc > 1 ? std::atoi(argv[1]) : 200000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+    std::string program = generateProgram(statements);
+
+    std::ostringstream report;
+    if (!compareParsers(program, LexerKind::Fast, report))
+    {
+        std::fprintf(stderr, "parser_bench: %s", report.str().c_str());
+        return 1;
+    }
+
+    size_t tokens = 0;
+    bool ok = true;
+    double lexMs = bestOf(iterations, [&] { tokens = countTokens(program); });
+    double bisonMs = bestOf(iterations, [&] { ok &= parseWith(program, ParserKind::Bison); });
+    double rdMs = bestOf(iterations, [&] { ok &= parseWith(program, ParserKind::RecursiveDescent); });
+    if (!ok)
+    {
+        std::fprintf(stderr, "parser_bench: generated program did not parse\n");
+        return 1;
+    }
+
+    double mb = program.size() / (1024.0 * 1024.0);
+    std::printf("input: %.1f MiB, %zu tokens; lexing alone %.1f ms\n", mb, tokens, lexMs);
+    std::printf("%-6s %10s %12s %14s %18s\n", "parser", "parse ms", "MiB/s", "Mtokens/s", "minus lexing ms");
+    std::printf("%-6s %10.1f %12.1f %14.1f %18.1f\n", "bison", bisonMs, mb / bisonMs * 1e3, tokens / bisonMs / 1e3,
+                bisonMs - lexMs);
+    std::printf("%-6s %10.1f %12.1f %14.1f %18.1f\n", "rd", rdMs, mb / rdMs * 1e3, tokens / rdMs / 1e3, rdMs - lexMs);
+    std::printf("speedup: %.2fx overall, %.2fx excluding lexing\n", bisonMs / rdMs,
+                (bisonMs - lexMs) / std::max(rdMs - lexMs, 1e-9));
+    return 0;
+}
@@ -0,0 +1,127 @@
+// bench/print_bench.cpp
+//
+// Output throughput of the runtime's print entry points against the printf
+// calls generated code used to make, one value and a newline per call as a
+// print statement does; shortest floats against "%.9g", printf's way of
+// printing a float so that it reads back the same. Standard output is
+// pointed at /dev/null (or the given file) for both, so what is timed is
+// formatting, buffering and the write calls rather than a terminal. The
+// report goes to the original standard output.
+//
+//   print_bench [prints] [iterations] [output-file]
+#include "runtime.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Values of every sign and length, the same for both paths
+static int32_t intValue(unsigned i)
+{
+    return static_cast<int32_t>(i * 2654435761u) >> (i % 24);
+}
+
+static float floatValue(unsigned i)
+{
+    return static_cast<float>(intValue(i)) / 1024.0f;
+}
+
+struct Case
+{
+    const char *name;
+    void (*viaPrintf)(unsigned count);
+    void (*viaRuntime)(unsigned count);
+};
+
+static const Case cases[] = {
+    {"int",
+     [](unsigned count) {
+         for (unsigned i = 0; i < count; ++i)
+             std::printf("%d\n", intValue(i));
+     },
+     [](unsigned count) {
+         for (unsigned i = 0; i < count; ++i)
+             bl_print_i32(intValue(i));
+     }},
+    {"float",
+     [](unsigned count) {
+         for (unsigned i = 0; i < count; ++i)
+             std::printf("%.9g\n", static_cast<double>(floatValue(i)));
+     },
+     [](unsigned count) {
+         for (unsigned i = 0; i < count; ++i)
+             bl_print_f32(floatValue(i));
+     }},
+    {"fixed",
+     [](unsigned count) {
+         for (unsigned i = 0; i < count; ++i)
+             std::printf("%f\n", static_cast<double>(floatValue(i)));
+     },
+     [](unsigned count) {
+         for (unsigned i = 0; i < count; ++i)
+             bl_print_f32_fixed(floatValue(i));
+     }},
+    {"string",
+     [](unsigned count) {
+         for (unsigned i = 0; i < count; ++i)
+             std::printf("%s\n", "a line of program output");
+     },
+     [](unsigned count) {
+         static const char text[] = "a line of program output";
+         bl_str line;
+         bl_str_make(&line, text, sizeof text - 1);
+         for (unsigned i = 0; i < count; ++i)
+             bl_print_str(&line);
+     }},
+    {"bool",
+     [](unsigned count) {
+         for (unsigned i = 0; i < count; ++i)
+             std::printf("%d\n", static_cast<int>(i & 1));
+     },
+     [](unsigned count) {
+         for (unsigned i = 0; i < count; ++i)
+             bl_print_bool(static_cast<int32_t>(i & 1));
+     }},
+};
+
+int main(int argc, char **argv)
+{
+    unsigned prints = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : 10000000;
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+    const char *target = argc > 3 ? argv[3] : "/dev/null";
+
+    FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+    int sink = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (!report || sink < 0 || dup2(sink, STDOUT_FILENO) < 0)
+    {
+        std::fprintf(stderr, "print_bench: cannot write to %s\n", target);
+        return 1;
+    }
+    close(sink);
+
+    std::fprintf(report, "print: %u prints per run, best of %d, output to %s\n", prints, iterations, target);
+    std::fprintf(report, "%-7s %11s %11s %11s %11s %8s\n", "kind", "printf ms", "runtime ms", "printf ns", "runtime ns",
+                 "speedup");
+    for (const Case &c : cases)
+    {
+        double viaPrintf = 1e300, viaRuntime = 1e300;
+        for (int i = 0; i < iterations; ++i)
+        {
+            Clock::time_point start = Clock::now();
+            c.viaPrintf(prints);
+            std::fflush(stdout);
+            viaPrintf = std::min(viaPrintf, msSince(start));
+
+            start = Clock::now();
+            c.viaRuntime(prints);
+            bl_flush();
+            viaRuntime = std::min(viaRuntime, msSince(start));
+        }
+        std::fprintf(report, "%-7s %11.2f %11.2f %11.1f %11.1f %7.2fx\n", c.name, viaPrintf, viaRuntime,
+                     viaPrintf * 1e6 / prints, viaRuntime * 1e6 / prints, viaPrintf / viaRuntime);
+    }
+    return 0;
+}
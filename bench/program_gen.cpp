@@ -0,0 +1,277 @@
+// bench/program_gen.cpp
+#include "program_gen.h"
+
+#include <random>
+#include <vector>
+
+const char *programShapeName(ProgramShape shape)
+{
+    switch (shape)
+    {
+    case ProgramShape::Declarations: return "decls";
+    case ProgramShape::DeepExpressions: return "exprs";
+    case ProgramShape::NestedBlocks: return "nested";
+    case ProgramShape::Prints: return "prints";
+    case ProgramShape::Mixed: return "mixed";
+    }
+    return "?";
+}
+
+bool parseProgramShape(std::string_view name, ProgramShape &shape)
+{
+    for (ProgramShape candidate : AllProgramShapes)
+    {
+        if (name == programShapeName(candidate))
+        {
+            shape = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// Variables are only ever read after their declaration at the top level,
+// so every reference resolves whatever statement it lands in. Names carry
+// a running number and are never declared twice.
+class Generator
+{
+public:
+    explicit Generator(const ProgramSpec &spec) : spec(spec), rng(spec.seed) {}
+
+    std::string run()
+    {
+        // One variable of each type so the first statements have something to read
+        out += "int i0 = 7;\nfloat f0 = 1.5;\nstring s0 = \"start\";\nbool b0 = true;\n";
+        ints.push_back("i0");
+        floats.push_back("f0");
+        strings.push_back("s0");
+        bools.push_back("b0");
+
+        for (unsigned n = 0; n < spec.statements; ++n)
+        {
+            switch (spec.shape == ProgramShape::Mixed ? mixedShape() : spec.shape)
+            {
+            case ProgramShape::Declarations: declaration(); break;
+            case ProgramShape::DeepExpressions: deepExpression(); break;
+            case ProgramShape::NestedBlocks: nest(spec.depth, 0); break;
+            case ProgramShape::Prints: print(0); break;
+            case ProgramShape::Mixed: break;
+            }
+        }
+        return std::move(out);
+    }
+
+private:
+    // std::mt19937 is specified exactly; the distributions are not, so
+    // values are reduced by hand to keep programs identical everywhere
+    unsigned below(unsigned n) { return static_cast<unsigned>(rng() % n); }
+
+    ProgramShape mixedShape()
+    {
+        unsigned roll = below(20);
+        if (roll < 8)
+            return ProgramShape::Declarations;
+        if (roll < 13)
+            return ProgramShape::DeepExpressions;
+        if (roll < 15)
+            return ProgramShape::NestedBlocks;
+        return ProgramShape::Prints;
+    }
+
+    const std::string &pick(const std::vector<std::string> &names) { return names[below(names.size())]; }
+
+    std::string fresh(char prefix) { return prefix + std::to_string(nextName++); }
+
+    void indent(unsigned level) { out.append(level * 4, ' '); }
+
+    std::string intLeaf()
+    {
+        return below(3) == 0 ? std::to_string(below(1000)) : pick(ints);
+    }
+
+    std::string floatLiteral() { return std::to_string(below(100)) + "." + std::to_string(below(100)); }
+
+    // `depth` operators, each one level further in: the recursive side is
+    // always parenthesised so the tree is as deep as the text is nested
+    std::string intExpression(unsigned depth)
+    {
+        if (depth == 0)
+            return intLeaf();
+        static const char *const ops[] = {" + ", " - ", " * ", " / "};
+        const char *op = ops[below(4)];
+        std::string inner = "(" + intExpression(depth - 1) + ")";
+        if (op[1] == '/') // Only ever divide by a non-zero literal
+            return inner + op + std::to_string(1 + below(9));
+        if (below(8) == 0)
+            inner = "-" + inner;
+        return below(2) ? inner + op + intLeaf() : intLeaf() + op + inner;
+    }
+
+    std::string comparison()
+    {
+        static const char *const ops[] = {" < ", " > ", " <= ", " >= ", " == ", " != "};
+        return intLeaf() + ops[below(6)] + intLeaf();
+    }
+
+    std::string boolExpression(unsigned depth)
+    {
+        if (depth == 0)
+            return below(4) == 0 ? pick(bools) : comparison();
+        std::string inner = "(" + boolExpression(depth - 1) + ")";
+        if (below(4) == 0)
+            inner = "not " + inner;
+        const char *op = below(2) ? " and " : " or ";
+        return below(2) ? inner + op + comparison() : comparison() + op + inner;
+    }
+
+    void declaration()
+    {
+        switch (below(4))
+        {
+        case 0: {
+            std::string name = fresh('i');
+            out += "int " + name + " = " + intExpression(below(3)) + ";\n";
+            ints.push_back(name);
+            break;
+        }
+        case 1: {
+            std::string name = fresh('f');
+            out += "float " + name + " = " + pick(floats) + " * " + floatLiteral() + ";\n";
+            floats.push_back(name);
+            break;
+        }
+        case 2: {
+            std::string name = fresh('s');
+            out += "string " + name + " = \"text " + std::to_string(nextName) + "\";\n";
+            strings.push_back(name);
+            break;
+        }
+        default: {
+            std::string name = fresh('b');
+            out += "bool " + name + " = " + comparison() + ";\n";
+            bools.push_back(name);
+            break;
+        }
+        }
+    }
+
+    void deepExpression()
+    {
+        if (below(3) == 0)
+        {
+            std::string name = fresh('b');
+            out += "bool " + name + " = " + boolExpression(spec.depth) + ";\n";
+            bools.push_back(name);
+            return;
+        }
+        std::string name = fresh('i');
+        out += "int " + name + " = " + intExpression(spec.depth) + ";\n";
+        ints.push_back(name);
+    }
+
+    void print(unsigned level)
+    {
+        indent(level);
+        switch (below(5))
+        {
+        case 0: out += "print(\"line " + std::to_string(below(100000)) + "\");\n"; break;
+        case 1: out += "print(" + pick(strings) + ");\n"; break;
+        case 2: out += "print(" + pick(floats) + " + " + floatLiteral() + ");\n"; break;
+        case 3: out += "print(" + comparison() + ");\n"; break;
+        default: out += "print(" + intExpression(1 + below(2)) + ");\n"; break;
+        }
+    }
+
+    // A counter loop that runs twice around an if whose then-branch holds
+    // the next level, so running the program stays linear in `levels`
+    void nest(unsigned levels, unsigned level)
+    {
+        std::string counter = fresh('c');
+        indent(level);
+        out += "int " + counter + " = 0;\n";
+        indent(level);
+        out += "repeat (" + counter + " < 2) {\n";
+        indent(level + 1);
+        out += counter + " = " + counter + " + 1;\n";
+        indent(level + 1);
+        out += "if (" + counter + " == 1 and " + comparison() + ") {\n";
+        if (levels > 1)
+            nest(levels - 1, level + 2);
+        else
+            print(level + 2);
+        indent(level + 1);
+        out += "} else {\n";
+        indent(level + 2);
+        out += "print(" + counter + ");\n";
+        indent(level + 1);
+        out += "}\n";
+        indent(level);
+        out += "}\n";
+    }
+
+    const ProgramSpec &spec;
+    std::mt19937 rng;
+    std::string out;
+    unsigned nextName = 1;
+    std::vector<std::string> ints, floats, strings, bools;
+};
+
+} // namespace
+
+std::string generateProgram(const ProgramSpec &spec)
+{
+    return Generator(spec).run();
+}
+
+const char *nestingShapeName(NestingShape shape)
+{
+    switch (shape)
+    {
+    case NestingShape::Chain: return "chain";
+    case NestingShape::Parens: return "parens";
+    case NestingShape::Blocks: return "blocks";
+    }
+    return "?";
+}
+
+unsigned nestingLevels(NestingShape shape, unsigned depth)
+{
+    // Declaration + operators + leaf; an if and its block per level,
+    // then the print and its operand
+    return shape == NestingShape::Blocks ? 2 * depth + 2 : depth + 2;
+}
+
+std::string generateNestedProgram(NestingShape shape, unsigned depth)
+{
+    std::string out = "int a = 1;\n";
+    switch (shape)
+    {
+    case NestingShape::Chain:
+        out.reserve(out.size() + 4 * depth + 32);
+        out += "int r = a";
+        for (unsigned i = 0; i < depth; ++i)
+            out += " + a";
+        out += ";\nprint(r);\n";
+        break;
+    case NestingShape::Parens:
+        out.reserve(out.size() + 7 * depth + 32);
+        out += "int r = ";
+        for (unsigned i = 0; i < depth; ++i)
+            out += "a + (";
+        out += "a";
+        out.append(depth, ')');
+        out += ";\nprint(r);\n";
+        break;
+    case NestingShape::Blocks:
+        out.reserve(out.size() + 15 * depth + 32);
+        for (unsigned i = 0; i < depth; ++i)
+            out += "if (a > 0) {\n";
+        out += "print(a);\n";
+        for (unsigned i = 0; i < depth; ++i)
+            out += "}\n";
+        break;
+    }
+    return out;
+}
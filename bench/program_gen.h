@@ -0,0 +1,56 @@
+// bench/program_gen.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Synthetic BitLang programs for the benchmarks. Every shape stresses a
+// different part of the front end; all of them parse, pass semantic
+// analysis and terminate when run. The output depends only on the spec,
+// so the same spec gives byte-identical programs on every platform.
+enum class ProgramShape
+{
+    Declarations,    // Long runs of declarations of every type: symbol table, interner
+    DeepExpressions, // Initialisers `depth` operators deep: expression parsing and lowering
+    NestedBlocks,    // if/else and repeat nested `depth` levels: scopes, block handling
+    Prints,          // Print-heavy sequences of literals, strings and expressions
+    Mixed,           // The four above interleaved
+};
+
+constexpr ProgramShape AllProgramShapes[] = {ProgramShape::Declarations, ProgramShape::DeepExpressions,
+                                             ProgramShape::NestedBlocks, ProgramShape::Prints, ProgramShape::Mixed};
+
+const char *programShapeName(ProgramShape shape);
+
+// Parses "decls", "exprs", "nested", "prints" or "mixed"
+bool parseProgramShape(std::string_view name, ProgramShape &shape);
+
+struct ProgramSpec
+{
+    ProgramShape shape = ProgramShape::Mixed;
+    unsigned statements = 10000; // Top-level statements to emit
+    unsigned depth = 8;          // Operators per expression tree / block nesting levels
+    uint32_t seed = 1;
+};
+
+std::string generateProgram(const ProgramSpec &spec);
+
+// Programs that are nothing but nesting, for how the front end scales with
+// depth: a single statement `depth` levels deep
+enum class NestingShape
+{
+    Chain,  // int r = a + a + ... + a: left-deep, no brackets at all
+    Parens, // int r = a + (a + (... + a)): right-deep through parentheses
+    Blocks, // if (a > 0) { if (a > 0) { ... print(a); } }
+};
+
+constexpr NestingShape AllNestingShapes[] = {NestingShape::Chain, NestingShape::Parens, NestingShape::Blocks};
+
+const char *nestingShapeName(NestingShape shape);
+
+// Tree levels below the program the result has, for sizing the nesting
+// limit: a little more than `depth`
+unsigned nestingLevels(NestingShape shape, unsigned depth);
+
+std::string generateNestedProgram(NestingShape shape, unsigned depth);
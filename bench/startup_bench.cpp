@@ -0,0 +1,98 @@
+// bench/startup_bench.cpp
+//
+// Time to first output for short programs: runs the whole pipeline (parse,
+// analyze, lower, execute) on the bytecode VM and on LLVM codegen + LLJIT
+// and reports the best wall time of each. Every sample must run to the end
+// on both backends and print the same text; the bench names any that does
+// not and exits with status 1.
+//
+//   startup_bench [iterations]
+#include "compile_session.h"
+#include "jit_runner.h"
+#include "llvm_codegen.h"
+#include "timing.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+struct Sample
+{
+    const char *name;
+    const char *source;
+};
+
+static const Sample samples[] = {
+    {"hello", "string s = \"hello\";\nprint(s);\n"},
+    {"arith", "int a = 6;\nint b = 7;\nfloat f = 2.5;\nprint(a * b);\nprint(f * 4.0 - 1.0);\n"},
+    {"loop",
+     "int i = 0;\nint sum = 0;\n"
+     "repeat (i < 1000) { i = i + 1; if (i == 500) { skip; } sum = sum + i; }\n"
+     "print(sum);\n"},
+    {"branches",
+     "int n = 17;\nint steps = 0;\n"
+     "repeat (n > 1) { if (n / 2 * 2 == n) { n = n / 2; } else { n = 3 * n + 1; } steps = steps + 1; }\n"
+     "print(steps);\n"},
+};
+
+static const std::string noInput; // Keeps input() from blocking on stdin
+
+static bool runVM(const char *source, std::string &output)
+{
+    CompileSession session(source);
+    if (!session.parse() || !session.analyze())
+        return false;
+    VMResult result = runBytecode(compileToBytecode(session.astRoot), &noInput);
+    output = result.output;
+    return result.exitCode == 0;
+}
+
+static bool runJIT(const char *source, std::string &output)
+{
+    CompileSession session(source);
+    if (!session.parse() || !session.analyze())
+        return false;
+    LLVMCodeGen codegen;
+    codegen.generate(session.astRoot);
+    JITResult result = runWithJIT(codegen.takeContext(), codegen.takeModule(), &noInput);
+    output = result.output;
+    return result.ok;
+}
+
+template <class Run>
+static double bestOf(int iterations, const char *source, Run run, std::string &output, bool &ok)
+{
+    double best = 1e300;
+    for (int i = 0; i < iterations; ++i)
+    {
+        Clock::time_point start = Clock::now();
+        ok = run(source, output);
+        best = std::min(best, msSince(start));
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+    initializeJIT();
+
+    std::printf("%-10s %12s %12s %9s\n", "program", "vm ms", "llvm+jit ms", "speedup");
+    int status = 0;
+    for (const Sample &sample : samples)
+    {
+        std::string vmOut, jitOut;
+        bool vmOk = false, jitOk = false;
+        double vmMs = bestOf(iterations, sample.source, runVM, vmOut, vmOk);
+        double jitMs = bestOf(iterations, sample.source, runJIT, jitOut, jitOk);
+        std::printf("%-10s %12.3f %12.3f %8.1fx\n", sample.name, vmMs, jitMs, jitMs / vmMs);
+        if (!vmOk || !jitOk || vmOut != jitOut)
+        {
+            std::fprintf(stderr, "startup_bench: backends disagree on %s\n", sample.name);
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,151 @@
+// bench/string_bench.cpp
+//
+// The runtime's strings against std::string. Building a string up with
+// s = s + piece, as a BitLang loop does, is timed for a growing number of
+// pieces next to a string that copies both sides into a new buffer every
+// time, which is what concatenation without room to spare comes down to:
+// ns per piece should stay flat for the runtime and grow with the count for
+// the copy. Equality and ordering are timed on strings that differ only in
+// their last byte, short (inline) and long. The built string must equal
+// std::string's byte for byte, and the runtime's == and < must give the same
+// counts as std::string's; a mismatch prints a line under its row and the
+// exit status is 1.
+//
+//   string_bench [pieces] [compares] [iterations]
+#include "runtime.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static std::string text(const bl_str &s)
+{
+    return std::string(bl_str_data(&s), bl_str_length(&s));
+}
+
+// s = s + piece, count times, each time into a new buffer of exactly the
+// combined length
+static size_t copyEveryTime(const std::string &piece, unsigned count)
+{
+    char *data = nullptr;
+    size_t length = 0;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        char *joined = static_cast<char *>(std::malloc(length + piece.size()));
+        if (length)
+            std::memcpy(joined, data, length);
+        std::memcpy(joined + length, piece.data(), piece.size());
+        std::free(data);
+        data = joined;
+        length += piece.size();
+    }
+    std::free(data);
+    return length;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned pieces = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : 1000000;
+    unsigned compares = argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : 10000000;
+    int iterations = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+    int errors = 0;
+
+    const std::string piece = "piece";
+    bl_str part;
+    bl_str_make(&part, piece.data(), piece.size());
+    std::printf("concatenation: s = s + \"%s\", best of %d, ns per piece\n", piece.c_str(), iterations);
+    std::printf("%10s %12s %12s %12s\n", "pieces", "copy", "std::string", "runtime");
+    for (unsigned count = 1000; count <= pieces; count *= 10)
+    {
+        double copyMs = 1e300, stdMs = 1e300, runtimeMs = 1e300;
+        std::string expected;
+        bl_str built;
+        for (int i = 0; i < iterations; ++i)
+        {
+            // Quadratic: only while it finishes in reasonable time
+            Clock::time_point start = Clock::now();
+            if (count <= 100000)
+                copyEveryTime(piece, count);
+            copyMs = std::min(copyMs, msSince(start));
+
+            start = Clock::now();
+            expected.clear();
+            for (unsigned j = 0; j < count; ++j)
+                expected += piece;
+            stdMs = std::min(stdMs, msSince(start));
+
+            bl_free_strings();
+            start = Clock::now();
+            bl_str_make(&built, nullptr, 0);
+            for (unsigned j = 0; j < count; ++j)
+                bl_str_concat(&built, &built, &part);
+            runtimeMs = std::min(runtimeMs, msSince(start));
+        }
+        if (count <= 100000)
+            std::printf("%10u %12.1f %12.1f %12.1f\n", count, copyMs * 1e6 / count, stdMs * 1e6 / count,
+                        runtimeMs * 1e6 / count);
+        else
+            std::printf("%10u %12s %12.1f %12.1f\n", count, "-", stdMs * 1e6 / count, runtimeMs * 1e6 / count);
+        if (text(built) != expected)
+        {
+            std::printf("  built string differs from std::string's\n");
+            ++errors;
+        }
+        bl_free_strings();
+    }
+
+    std::printf("comparison: %u per run, best of %d, ns per compare\n", compares, iterations);
+    std::printf("%-16s %12s %12s %12s %12s\n", "length", "std ==", "runtime ==", "std compare", "runtime cmp");
+    for (size_t length : {8, 15, 64, 1024})
+    {
+        // Two separate copies that differ in the last byte, and a third
+        // equal to the first
+        std::string a(length, 'x'), b = a, c = a;
+        b.back() = 'y';
+        bl_str sa, sb, sc;
+        bl_str_make(&sa, a.data(), a.size());
+        bl_str_make(&sb, b.data(), b.size());
+        bl_str_make(&sc, c.data(), c.size());
+        const bl_str *right[2] = {&sb, &sc};
+        const std::string *stdRight[2] = {&b, &c};
+
+        double stdEqual = 1e300, runtimeEqual = 1e300, stdCompare = 1e300, runtimeCompare = 1e300;
+        long stdCount = 0, runtimeCount = 0, stdOrder = 0, runtimeOrder = 0;
+        for (int i = 0; i < iterations; ++i)
+        {
+            stdCount = runtimeCount = stdOrder = runtimeOrder = 0;
+            Clock::time_point start = Clock::now();
+            for (unsigned j = 0; j < compares; ++j)
+                stdCount += a == *stdRight[j & 1];
+            stdEqual = std::min(stdEqual, msSince(start));
+
+            start = Clock::now();
+            for (unsigned j = 0; j < compares; ++j)
+                runtimeCount += bl_str_equal(&sa, right[j & 1]) != 0;
+            runtimeEqual = std::min(runtimeEqual, msSince(start));
+
+            start = Clock::now();
+            for (unsigned j = 0; j < compares; ++j)
+                stdOrder += a.compare(*stdRight[j & 1]) < 0;
+            stdCompare = std::min(stdCompare, msSince(start));
+
+            start = Clock::now();
+            for (unsigned j = 0; j < compares; ++j)
+                runtimeOrder += bl_str_compare(&sa, right[j & 1]) < 0;
+            runtimeCompare = std::min(runtimeCompare, msSince(start));
+        }
+        std::string name = std::to_string(length) + (length <= BL_STR_SMALL_MAX ? " (inline)" : "");
+        std::printf("%-16s %12.2f %12.2f %12.2f %12.2f\n", name.c_str(), stdEqual * 1e6 / compares,
+                    runtimeEqual * 1e6 / compares, stdCompare * 1e6 / compares, runtimeCompare * 1e6 / compares);
+        if (stdCount != runtimeCount || stdOrder != runtimeOrder)
+        {
+            std::printf("  results differ from std::string's\n");
+            ++errors;
+        }
+    }
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,14 @@
+// bench/timing.h
+//
+// Wall-clock timing for the benchmarks
+#pragma once
+
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+// Milliseconds since `start`
+inline double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
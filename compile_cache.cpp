@@ -0,0 +1,353 @@
+// compile_cache.cpp
+#include "compile_cache.h"
+#include "emitter.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <random>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Bump when the entry layout or anything hashed into the key changes
+static const char EntryMagic[8] = {'B', 'L', 'C', 'A', 'C', 'H', 'E', '1'};
+static const char EntrySuffix[] = ".blc";
+
+// Entry file: header, the three payload strings back to back, then an
+// xxHash64 of everything before it so torn or corrupted files are rejected
+struct EntryHeader
+{
+    char magic[8];
+    uint32_t ok;
+    uint32_t diagnosticsSize;
+    uint32_t listingSize;
+    uint32_t bitcodeSize;
+};
+
+static uint64_t entryBytes(const std::string &key, const CacheEntry &entry)
+{
+    return key.size() + entry.diagnostics.size() + entry.listing.size() + entry.bitcode.size();
+}
+
+// Size and modification time of the running compiler, so a rebuilt
+// compiler does not pick up entries made by the old one
+static std::string executableIdentity()
+{
+    static int anchor;
+    std::string path = llvm::sys::fs::getMainExecutable("bitlang", &anchor);
+    llvm::sys::fs::file_status status;
+    if (path.empty() || llvm::sys::fs::status(path, status))
+        return "unknown";
+    return std::to_string(status.getSize()) + "@" +
+           std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+                              status.getLastModificationTime().time_since_epoch())
+                              .count());
+}
+
+CompileCache::CompileCache(std::string directory, uint64_t maxBytes)
+    : dir(std::move(directory)), limit(maxBytes)
+{
+    if (!dir.empty())
+    {
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+    }
+}
+
+std::string CompileCache::defaultDirectory()
+{
+    llvm::SmallString<256> path;
+    if (!llvm::sys::path::cache_directory(path))
+        return ".bitlang-cache";
+    llvm::sys::path::append(path, "bitlang");
+    return std::string(path.str());
+}
+
+std::string CompileCache::makeKey(std::string_view source, const OptOptions &options, bool astOpt,
+                                  FloatFormat floatFormat, unsigned maxNesting)
+{
+    static const std::string compiler = std::string(EntryMagic, sizeof(EntryMagic)) + " llvm-" +
+                                        LLVM_VERSION_STRING + " " + executableIdentity() + " " +
+                                        hostTargetDescription();
+
+    std::string material = compiler;
+    material += "\nO" + std::to_string(static_cast<int>(options.level));
+    material += "\npasses=" + options.passes;
+    material += "\nunroll=" + std::to_string(options.loops.unrollCount);
+    material += "\nvectorize=" + std::to_string(options.loops.vectorizeWidth);
+    material += astOpt ? "\nast-opt" : "\nno-ast-opt";
+    material += floatFormat == FloatFormat::Fixed ? "\nfloats=fixed" : "\nfloats=shortest";
+    material += "\nmax-nesting=" + std::to_string(maxNesting);
+    material += '\0';
+    material.append(source.data(), source.size());
+
+    auto digest = llvm::SHA1::hash(llvm::arrayRefFromStringRef(material));
+    return llvm::toHex(digest, /*LowerCase=*/true);
+}
+
+bool CompileCache::lookup(const std::string &key, CacheEntry &entry)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(key);
+        if (found != index.end())
+        {
+            recent.splice(recent.begin(), recent, found->second);
+            entry = found->second->second;
+            ++counters.memoryHits;
+            return true;
+        }
+    }
+
+    // Disk reads happen outside the lock so threads do not queue on I/O
+    bool hit = !dir.empty() && readEntryFile(key, entry);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!hit)
+    {
+        ++counters.misses;
+        return false;
+    }
+    ++counters.diskHits;
+    rememberLocked(key, entry);
+    return true;
+}
+
+void CompileCache::store(const std::string &key, const CacheEntry &entry)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++counters.stores;
+        rememberLocked(key, entry);
+    }
+    if (!dir.empty())
+    {
+        writeEntryFile(key, entry);
+        pruneDirectory();
+    }
+}
+
+CacheStats CompileCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void CompileCache::printStats(std::ostream &out) const
+{
+    CacheStats s = stats();
+    out << "cache: " << s.memoryHits + s.diskHits << " hit(s) (" << s.memoryHits << " memory, "
+        << s.diskHits << " disk), " << s.misses << " miss(es), " << s.stores << " store(s), "
+        << s.evictions << " eviction(s)";
+    if (!dir.empty())
+    {
+        uint64_t files = 0, bytes = 0;
+        std::error_code ec;
+        for (const fs::directory_entry &file : fs::directory_iterator(dir, ec))
+        {
+            if (file.path().extension() != EntrySuffix)
+                continue;
+            ++files;
+            bytes += file.file_size(ec);
+        }
+        out << "; " << files << " entries, " << (bytes + 1023) / 1024 << " KiB of " << limit / 1024
+            << " KiB in " << dir;
+    }
+    out << "\n";
+}
+
+// Caller holds the mutex
+void CompileCache::rememberLocked(const std::string &key, const CacheEntry &entry)
+{
+    uint64_t size = entryBytes(key, entry);
+    if (size > limit)
+        return;
+
+    auto found = index.find(key);
+    if (found != index.end())
+    {
+        memoryBytes -= entryBytes(key, found->second->second);
+        recent.erase(found->second);
+        index.erase(found);
+    }
+    recent.emplace_front(key, entry);
+    index[key] = recent.begin();
+    memoryBytes += size;
+
+    while (memoryBytes > limit)
+    {
+        const auto &oldest = recent.back();
+        memoryBytes -= entryBytes(oldest.first, oldest.second);
+        index.erase(oldest.first);
+        recent.pop_back();
+        ++counters.evictions;
+    }
+}
+
+bool CompileCache::readEntryFile(const std::string &key, CacheEntry &entry)
+{
+    fs::path path = fs::path(dir) / (key + EntrySuffix);
+    auto buffer = llvm::MemoryBuffer::getFile(path.string());
+    if (!buffer)
+        return false;
+    llvm::StringRef data = (*buffer)->getBuffer();
+
+    EntryHeader header;
+    if (data.size() < sizeof(header) + sizeof(uint64_t))
+        return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    uint64_t payload = uint64_t(header.diagnosticsSize) + header.listingSize + header.bitcodeSize;
+    if (std::memcmp(header.magic, EntryMagic, sizeof(EntryMagic)) != 0 ||
+        data.size() != sizeof(header) + payload + sizeof(uint64_t))
+        return false;
+
+    uint64_t checksum;
+    std::memcpy(&checksum, data.data() + data.size() - sizeof(checksum), sizeof(checksum));
+    if (checksum != llvm::xxHash64(data.drop_back(sizeof(checksum))))
+        return false;
+
+    const char *cursor = data.data() + sizeof(header);
+    entry.ok = header.ok != 0;
+    entry.diagnostics.assign(cursor, header.diagnosticsSize);
+    cursor += header.diagnosticsSize;
+    entry.listing.assign(cursor, header.listingSize);
+    cursor += header.listingSize;
+    entry.bitcode.assign(cursor, header.bitcodeSize);
+
+    // Entries are evicted oldest-modified first, so a hit refreshes the time
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+void CompileCache::writeEntryFile(const std::string &key, const CacheEntry &entry)
+{
+    EntryHeader header;
+    std::memcpy(header.magic, EntryMagic, sizeof(EntryMagic));
+    header.ok = entry.ok;
+    header.diagnosticsSize = static_cast<uint32_t>(entry.diagnostics.size());
+    header.listingSize = static_cast<uint32_t>(entry.listing.size());
+    header.bitcodeSize = static_cast<uint32_t>(entry.bitcode.size());
+
+    std::string data(reinterpret_cast<const char *>(&header), sizeof(header));
+    data += entry.diagnostics;
+    data += entry.listing;
+    data += entry.bitcode;
+    uint64_t checksum = llvm::xxHash64(data);
+    data.append(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+
+    // Write under a name no other writer uses, then rename over the entry:
+    // the rename is atomic, and two processes storing the same key write
+    // the same bytes, so whichever lands last is fine
+    fs::path finalPath = fs::path(dir) / (key + EntrySuffix);
+    fs::path tempPath = fs::path(dir) / (key + ".tmp" + std::to_string(std::random_device{}()));
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.write(data.data(), data.size()) || !out.flush())
+        {
+            out.close();
+            std::error_code ec;
+            fs::remove(tempPath, ec);
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tempPath, finalPath, ec);
+    if (ec)
+        fs::remove(tempPath, ec);
+}
+
+// Drop the least recently used entries once the directory is over the
+// limit, down to 90% of it so the next few stores do not prune again, and
+// clear out temporary files left by writers that died mid-store
+void CompileCache::pruneDirectory()
+{
+    struct File
+    {
+        fs::file_time_type time;
+        uint64_t size;
+        fs::path path;
+    };
+    std::vector<File> entries;
+    uint64_t total = 0;
+    fs::file_time_type staleBefore = fs::file_time_type::clock::now() - std::chrono::hours(1);
+
+    std::error_code ec;
+    for (const fs::directory_entry &file : fs::directory_iterator(dir, ec))
+    {
+        std::error_code fileError;
+        fs::file_time_type time = file.last_write_time(fileError);
+        if (fileError)
+            continue;
+        if (file.path().extension() == EntrySuffix)
+        {
+            uint64_t size = file.file_size(fileError);
+            if (fileError)
+                continue;
+            entries.push_back({time, size, file.path()});
+            total += size;
+        }
+        else if (file.path().filename().string().find(".tmp") != std::string::npos && time < staleBefore)
+        {
+            fs::remove(file.path(), fileError);
+        }
+    }
+    if (total <= limit)
+        return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const File &a, const File &b) { return a.time < b.time; });
+    uint64_t target = limit / 10 * 9;
+    uint64_t evicted = 0;
+    for (const File &file : entries)
+    {
+        if (total <= target)
+            break;
+        // Another process may have evicted it already; either way it is gone
+        fs::remove(file.path, ec);
+        total -= file.size;
+        ++evicted;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.evictions += evicted;
+}
+
+std::string moduleToBitcode(const llvm::Module &module)
+{
+    std::string bitcode;
+    llvm::raw_string_ostream out(bitcode);
+    llvm::WriteBitcodeToFile(module, out);
+    out.flush();
+    return bitcode;
+}
+
+std::unique_ptr<llvm::Module> moduleFromBitcode(const std::string &bitcode, llvm::LLVMContext &context,
+                                                std::string &error)
+{
+    llvm::Expected<std::unique_ptr<llvm::Module>> module =
+        llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, "cached.bc"), context);
+    if (!module)
+    {
+        error = "cannot read cached module: " + llvm::toString(module.takeError());
+        return nullptr;
+    }
+    // The identifier comes from the buffer name; give back the original one
+    (*module)->setModuleIdentifier((*module)->getSourceFileName());
+    return std::move(*module);
+}
@@ -0,0 +1,94 @@
+// compile_cache.h
+#pragma once
+
+#include "optimizer.h"
+#include "types.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace llvm
+{
+class LLVMContext;
+class Module;
+}
+
+// What a compilation produced, enough to skip the front and middle end the
+// next time the same program comes in with the same options.
+struct CacheEntry
+{
+    bool ok = false;         // False: semantic analysis failed, see diagnostics
+    std::string diagnostics; // Everything the front end reported
+    std::string listing;     // AST dump the driver prints
+    std::string bitcode;     // Optimised module; empty when !ok
+};
+
+struct CacheStats
+{
+    uint64_t memoryHits = 0;
+    uint64_t diskHits = 0;
+    uint64_t misses = 0;
+    uint64_t stores = 0;
+    uint64_t evictions = 0; // Entries dropped from either tier to stay under the limit
+};
+
+// Content-addressed cache of compiled programs with two tiers: an in-memory
+// LRU for a long-running process (compile_server) and a directory of entry
+// files shared by every process that points at it. Entries are written to
+// a temporary file and renamed into place, so concurrent readers see either
+// a whole entry or none; a damaged file reads as a miss. Thread-safe.
+class CompileCache
+{
+public:
+    // An empty directory keeps the cache in memory only. `maxBytes` bounds
+    // each tier separately.
+    CompileCache(std::string directory, uint64_t maxBytes);
+
+    // $XDG_CACHE_HOME/bitlang or ~/.cache/bitlang
+    static std::string defaultDirectory();
+
+    // Hex SHA-1 over the source, everything that changes the generated code
+    // (optimisation options, AST optimiser, float format), the nesting limit,
+    // which decides whether the program compiles at all, and the compiler
+    // itself: format version, LLVM version, this executable's size and mtime
+    // and the host target.
+    static std::string makeKey(std::string_view source, const OptOptions &options, bool astOpt,
+                               FloatFormat floatFormat, unsigned maxNesting);
+
+    bool lookup(const std::string &key, CacheEntry &entry);
+    void store(const std::string &key, const CacheEntry &entry);
+
+    CacheStats stats() const;
+    const std::string &directory() const { return dir; }
+
+    // One line: hits, misses and what the disk tier currently holds
+    void printStats(std::ostream &out) const;
+
+private:
+    bool readEntryFile(const std::string &key, CacheEntry &entry);
+    void writeEntryFile(const std::string &key, const CacheEntry &entry);
+    void pruneDirectory();
+    void rememberLocked(const std::string &key, const CacheEntry &entry);
+
+    using LRUList = std::list<std::pair<std::string, CacheEntry>>;
+
+    std::string dir;
+    uint64_t limit;
+
+    mutable std::mutex mutex;
+    LRUList recent; // Most recently used first
+    std::unordered_map<std::string, LRUList::iterator> index;
+    uint64_t memoryBytes = 0;
+    CacheStats counters;
+};
+
+// Bitcode round trip for cache entries
+std::string moduleToBitcode(const llvm::Module &module);
+std::unique_ptr<llvm::Module> moduleFromBitcode(const std::string &bitcode, llvm::LLVMContext &context,
+                                                std::string &error);
@@ -0,0 +1,504 @@
+// compile_server.cpp
+//
+// Long-lived compile daemon. LLVM is initialised once and every request is
+// compiled in its own CompileSession, so requests arriving on different
+// socket connections are compiled concurrently.
+//
+// Request framing (stdin or each socket connection):
+//     <source-bytes> <input-bytes> [run|norun] [options...]\n<source><input>
+// where options are O0..O3/Os, passes=<pipeline>, time-passes, unroll=<n>
+// and vectorize=<width> (the compiler's --unroll and --vectorize), vm (run
+// in the bytecode interpreter instead of LLVM), no-ast-opt and
+// float-format=shortest|fixed, so each request picks its own
+// compile-latency/runtime trade-off and output.
+// With --cache (or --cache-dir=<dir>) repeated submissions of the same
+// program and options are served from a CompileCache instead of being
+// compiled again; responses then carry "cache":"hit" or "miss".
+// Response: one JSON object per line.
+#include "ast_optimizer.h"
+#include "compile_cache.h"
+#include "compile_session.h"
+#include "jit_runner.h"
+#include "llvm_codegen.h"
+#include "optimizer.h"
+#include "vm.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Shared by every connection; null unless --cache or --cache-dir is given
+CompileCache *compileCache = nullptr;
+
+double millisSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void appendJSONString(std::string &out, const std::string &value)
+{
+    out += '"';
+    for (unsigned char c : value)
+    {
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            }
+            else
+            {
+                out += static_cast<char>(c);
+            }
+        }
+    }
+    out += '"';
+}
+
+void appendJSONLines(std::string &out, const std::string &text)
+{
+    out += '[';
+    std::istringstream lines(text);
+    std::string line;
+    bool first = true;
+    while (std::getline(lines, line))
+    {
+        if (!first)
+            out += ',';
+        appendJSONString(out, line);
+        first = false;
+    }
+    out += ']';
+}
+
+struct RequestOptions
+{
+    bool run = true;
+    bool useVM = false;
+    bool astOpt = true;
+    FloatFormat floatFormat = FloatFormat::Shortest;
+    OptOptions opt;
+};
+
+// Compile (and optionally run) one program; returns the JSON response line
+std::string handleRequest(const std::string &source, const std::string &input,
+                          const RequestOptions &options)
+{
+    const OptOptions &optOptions = options.opt;
+    Clock::time_point start = Clock::now();
+    std::ostringstream diagnostics;
+    std::string ast, ir, bytecode, output, error, passTiming;
+    bool parsed = false;
+    bool cacheHit = false;
+    int exitCode = 0;
+    double parseMs = 0, analyzeMs = 0, astOptMs = 0, codegenMs = 0, optimizeMs = 0, runMs = 0;
+
+    try
+    {
+        std::string cacheKey;
+        CacheEntry cached;
+        if (compileCache && !options.useVM)
+        {
+            cacheKey =
+                CompileCache::makeKey(source, optOptions, options.astOpt, options.floatFormat, DefaultMaxNesting);
+            cacheHit = compileCache->lookup(cacheKey, cached);
+        }
+
+        // Set on the LLVM path, from a fresh compile or from the cache
+        std::unique_ptr<llvm::LLVMContext> context;
+        std::unique_ptr<llvm::Module> module;
+
+        if (cacheHit)
+        {
+            parsed = true;
+            ast = std::move(cached.listing);
+            diagnostics << cached.diagnostics;
+            if (!cached.ok)
+                throw std::runtime_error("semantic analysis failed");
+            context = std::make_unique<llvm::LLVMContext>();
+            std::string cacheError;
+            module = moduleFromBitcode(cached.bitcode, *context, cacheError);
+            if (!module)
+                throw std::runtime_error(cacheError);
+        }
+        else
+        {
+            CompileSession session(source, diagnostics);
+
+            Clock::time_point phase = Clock::now();
+            parsed = session.parse();
+            parseMs = millisSince(phase);
+
+            if (parsed)
+            {
+                phase = Clock::now();
+                bool analyzed = session.analyze();
+                analyzeMs = millisSince(phase);
+
+                std::ostringstream astText;
+                session.astRoot->print(astText);
+                ast = astText.str();
+
+                if (!analyzed)
+                {
+                    if (compileCache && !options.useVM)
+                        compileCache->store(cacheKey, CacheEntry{false, diagnostics.str(), ast, {}});
+                    throw std::runtime_error("semantic analysis failed");
+                }
+
+                if (options.astOpt)
+                {
+                    phase = Clock::now();
+                    optimizeAst(session.astRoot, session.arena);
+                    astOptMs = millisSince(phase);
+                }
+
+                if (options.useVM)
+                {
+                    phase = Clock::now();
+                    BytecodeProgram program = compileToBytecode(session.astRoot, options.floatFormat);
+                    codegenMs = millisSince(phase);
+
+                    std::ostringstream listing;
+                    program.print(listing);
+                    bytecode = listing.str();
+
+                    if (options.run)
+                    {
+                        phase = Clock::now();
+                        VMResult result = runBytecode(program, &input);
+                        runMs = millisSince(phase);
+                        output = std::move(result.output);
+                        exitCode = result.exitCode;
+                    }
+                }
+                else
+                {
+                    phase = Clock::now();
+                    LLVMCodeGen llvmGen(optOptions.loops, options.floatFormat);
+                    llvmGen.generate(session.astRoot);
+                    std::string verifyErrors;
+                    llvm::raw_string_ostream verifyStream(verifyErrors);
+                    if (!llvmGen.verify(verifyStream))
+                        throw std::runtime_error("invalid IR generated: " + verifyStream.str());
+                    codegenMs = millisSince(phase);
+
+                    phase = Clock::now();
+                    llvm::raw_string_ostream timingStream(passTiming);
+                    std::string optError;
+                    if (!optimizeModule(llvmGen.getModule(), optOptions, optError, &timingStream))
+                        throw std::runtime_error(optError);
+                    timingStream.flush();
+                    optimizeMs = millisSince(phase);
+
+                    if (compileCache)
+                        compileCache->store(cacheKey, CacheEntry{true, diagnostics.str(), ast,
+                                                                 moduleToBitcode(llvmGen.getModule())});
+                    context = llvmGen.takeContext();
+                    module = llvmGen.takeModule();
+                }
+            }
+        }
+
+        if (module)
+        {
+            llvm::raw_string_ostream irStream(ir);
+            module->print(irStream, nullptr);
+            irStream.flush();
+
+            if (options.run)
+            {
+                Clock::time_point phase = Clock::now();
+                JITResult result = runWithJIT(std::move(context), std::move(module), &input);
+                runMs = millisSince(phase);
+                output = std::move(result.output);
+                exitCode = result.exitCode;
+                if (!result.ok)
+                    error = result.error;
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        error = e.what();
+    }
+
+    std::string json = "{\"ok\":";
+    json += (parsed && error.empty()) ? "true" : "false";
+    json += ",\"parsed\":";
+    json += parsed ? "true" : "false";
+    json += ",\"ast\":";
+    appendJSONString(json, ast);
+    json += ",\"diagnostics\":";
+    appendJSONLines(json, diagnostics.str());
+    json += ",\"ir\":";
+    appendJSONString(json, ir);
+    if (options.useVM)
+    {
+        json += ",\"bytecode\":";
+        appendJSONString(json, bytecode);
+    }
+    json += ",\"output\":";
+    appendJSONString(json, output);
+    json += ",\"exit_code\":" + std::to_string(exitCode);
+    json += ",\"error\":";
+    appendJSONString(json, error);
+    if (compileCache && !options.useVM)
+        json += cacheHit ? ",\"cache\":\"hit\"" : ",\"cache\":\"miss\"";
+    if (optOptions.timePasses)
+    {
+        json += ",\"pass_timing\":";
+        appendJSONString(json, passTiming);
+    }
+
+    char timing[256];
+    std::snprintf(timing, sizeof(timing),
+                  ",\"timing\":{\"parse_ms\":%.3f,\"analyze_ms\":%.3f,\"ast_opt_ms\":%.3f,\"codegen_ms\":%.3f,"
+                  "\"optimize_ms\":%.3f,\"run_ms\":%.3f,\"total_ms\":%.3f}}\n",
+                  parseMs, analyzeMs, astOptMs, codegenMs, optimizeMs, runMs, millisSince(start));
+    json += timing;
+    return json;
+}
+
+// Minimal buffered reader over a file descriptor
+class FdReader
+{
+public:
+    explicit FdReader(int fd) : fd(fd) {}
+
+    bool readLine(std::string &line)
+    {
+        line.clear();
+        char c;
+        while (readByte(c))
+        {
+            if (c == '\n')
+                return true;
+            line += c;
+        }
+        return !line.empty();
+    }
+
+    bool readExactly(std::string &out, size_t count)
+    {
+        out.clear();
+        out.reserve(count);
+        char c;
+        while (out.size() < count && readByte(c))
+            out += c;
+        return out.size() == count;
+    }
+
+private:
+    bool readByte(char &c)
+    {
+        if (pos == len)
+        {
+            ssize_t n = ::read(fd, buffer, sizeof(buffer));
+            if (n <= 0)
+                return false;
+            pos = 0;
+            len = static_cast<size_t>(n);
+        }
+        c = buffer[pos++];
+        return true;
+    }
+
+    int fd;
+    char buffer[65536];
+    size_t pos = 0, len = 0;
+};
+
+bool writeAll(int fd, const std::string &data)
+{
+    size_t written = 0;
+    while (written < data.size())
+    {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n <= 0)
+            return false;
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// "<source-bytes> <input-bytes> [run|norun] [O2] [passes=...] [time-passes] [unroll=n] [vectorize=n] [vm|llvm]
+//  [no-ast-opt] [float-format=shortest|fixed]"
+bool parseHeader(const std::string &header, size_t &sourceBytes, size_t &inputBytes,
+                 RequestOptions &options)
+{
+    OptOptions &optOptions = options.opt;
+    std::istringstream fields(header);
+    if (!(fields >> sourceBytes >> inputBytes))
+        return false;
+
+    std::string word;
+    while (fields >> word)
+    {
+        if (word == "run" || word == "norun")
+            options.run = word == "run";
+        else if (word == "vm" || word == "llvm")
+            options.useVM = word == "vm";
+        else if (word == "no-ast-opt")
+            options.astOpt = false;
+        else if (word == "float-format=shortest" || word == "float-format=fixed")
+            options.floatFormat = word == "float-format=fixed" ? FloatFormat::Fixed : FloatFormat::Shortest;
+        else if (word.compare(0, 7, "passes=") == 0)
+            optOptions.passes = word.substr(7);
+        else if (word == "time-passes")
+            optOptions.timePasses = true;
+        else if (word.compare(0, 7, "unroll=") == 0)
+            optOptions.loops.unrollCount = static_cast<unsigned>(std::strtoul(word.c_str() + 7, nullptr, 10));
+        else if (word.compare(0, 10, "vectorize=") == 0)
+            optOptions.loops.vectorizeWidth = static_cast<unsigned>(std::strtoul(word.c_str() + 10, nullptr, 10));
+        else if (!parseOptLevel(word, optOptions.level))
+            return false;
+    }
+    return true;
+}
+
+// Serve framed requests until the peer closes the stream
+void serveStream(int inFd, int outFd)
+{
+    FdReader reader(inFd);
+    std::string header, source, input;
+    while (reader.readLine(header))
+    {
+        size_t sourceBytes = 0, inputBytes = 0;
+        RequestOptions options;
+        if (!parseHeader(header, sourceBytes, inputBytes, options) ||
+            !reader.readExactly(source, sourceBytes) || !reader.readExactly(input, inputBytes))
+        {
+            writeAll(outFd, "{\"ok\":false,\"error\":\"malformed request header\"}\n");
+            return;
+        }
+        // LLVM may need more stack than a connection thread has
+        std::string response;
+        try
+        {
+            runWithStack(CompileStackSize, [&] { response = handleRequest(source, input, options); });
+        }
+        catch (const std::exception &e)
+        {
+            response = "{\"ok\":false,\"error\":";
+            appendJSONString(response, e.what());
+            response += "}\n";
+        }
+        if (!writeAll(outFd, response))
+            return;
+    }
+}
+
+int serveSocket(const std::string &path)
+{
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        std::perror("socket");
+        return 1;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << "Socket path too long: " << path << "\n";
+        return 1;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    ::unlink(path.c_str());
+
+    if (::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+        ::listen(listener, 64) < 0)
+    {
+        std::perror("bind/listen");
+        return 1;
+    }
+    std::cerr << "compile_server listening on " << path << "\n";
+
+    for (;;)
+    {
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0)
+            continue;
+        std::thread([client] {
+            serveStream(client, client);
+            ::close(client);
+        }).detach();
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string socketPath;
+    bool useCache = false;
+    std::string cacheDir;
+    uint64_t cacheMiB = 256;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strncmp(argv[i], "--socket=", 9) == 0)
+        {
+            socketPath = argv[i] + 9;
+        }
+        else if (std::strcmp(argv[i], "--cache") == 0)
+        {
+            useCache = true;
+        }
+        else if (std::strncmp(argv[i], "--cache-dir=", 12) == 0)
+        {
+            useCache = true;
+            cacheDir = argv[i] + 12;
+        }
+        else if (std::strncmp(argv[i], "--cache-size=", 13) == 0)
+        {
+            cacheMiB = std::strtoull(argv[i] + 13, nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--stdio") != 0)
+        {
+            std::cerr << "Usage: ./compile_server [--stdio | --socket=<path>] [--cache | --cache-dir=<dir>]\n"
+                      << "                        [--cache-size=<MiB>]\n";
+            return 1;
+        }
+    }
+
+    initializeJIT();
+
+    std::unique_ptr<CompileCache> cache;
+    if (useCache)
+    {
+        cache = std::make_unique<CompileCache>(cacheDir.empty() ? CompileCache::defaultDirectory() : cacheDir,
+                                               cacheMiB * 1024 * 1024);
+        compileCache = cache.get();
+    }
+
+    if (!socketPath.empty())
+        return serveSocket(socketPath);
+
+    serveStream(STDIN_FILENO, STDOUT_FILENO);
+    return 0;
+}
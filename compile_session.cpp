@@ -0,0 +1,206 @@
+// compile_session.cpp
+#include "compile_session.h"
+#include "parser.tab.h"
+#include "lex.yy.h"
+#include "fast_lexer.h"
+#include "rd_parser.h"
+#include "ast_visitor.h"
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+CompileSession::CompileSession(std::string source, std::ostream &diagnostics)
+    : diag(diagnostics), interner(arena), symbolTable(diagnostics, interner), ownedText(std::move(source)),
+      text(ownedText)
+{
+}
+
+CompileSession::CompileSession(std::unique_ptr<SourceFile> file, std::ostream &diagnostics)
+    : diag(diagnostics), interner(arena), symbolTable(diagnostics, interner), file(std::move(file)),
+      text(this->file->text())
+{
+}
+
+bool parseLexerKind(std::string_view name, LexerKind &kind)
+{
+    if (name == "flex")
+        kind = LexerKind::Flex;
+    else if (name == "fast")
+        kind = LexerKind::Fast;
+    else
+        return false;
+    return true;
+}
+
+bool parseParserKind(std::string_view name, ParserKind &kind)
+{
+    if (name == "bison")
+        kind = ParserKind::Bison;
+    else if (name == "rd")
+        kind = ParserKind::RecursiveDescent;
+    else
+        return false;
+    return true;
+}
+
+// A token the lexer produced ahead of the parser, see CompileSession::parse
+struct RecordedToken
+{
+    int kind;
+    YYSTYPE value;
+    YYLTYPE location;
+};
+
+// What the parser's scanner argument points at; exactly one of the lexers
+// or the recorded tokens is set
+struct TokenSource
+{
+    yyscan_t flex = nullptr;
+    FastLexer *fast = nullptr;
+    const std::vector<RecordedToken> *recorded = nullptr;
+    size_t next = 0;
+};
+
+int nextToken(YYSTYPE *yylval, YYLTYPE *yylloc, yyscan_t scanner)
+{
+    auto tokens = static_cast<TokenSource *>(scanner);
+    if (tokens->recorded)
+    {
+        // The last token is the end of input; keep returning it
+        const RecordedToken &token = (*tokens->recorded)[std::min(tokens->next++, tokens->recorded->size() - 1)];
+        *yylval = token.value;
+        *yylloc = token.location;
+        return token.kind;
+    }
+    if (tokens->fast)
+        return tokens->fast->next(*yylval, *yylloc);
+    return yylex(yylval, yylloc, tokens->flex);
+}
+
+namespace {
+
+// The child on the longest path down, so a walk from the root can find
+// where a program first gets too deep without recursing
+class DeepestChild : public ConstASTVisitor<DeepestChild, const ASTNode *>
+{
+public:
+    const ASTNode *visitNode(const ASTNode *) { return nullptr; }
+    const ASTNode *visitBinaryExpr(const BinaryExprNode *node) { return deeper({node->left, node->right}); }
+    const ASTNode *visitUnaryExpr(const UnaryExprNode *node) { return node->operand; }
+    const ASTNode *visitBuiltinCall(const BuiltinCallNode *node) { return deepest(node->args); }
+    const ASTNode *visitDeclaration(const DeclarationNode *node) { return node->expr; }
+    const ASTNode *visitArrayLiteral(const ArrayLiteralNode *node) { return deepest(node->elements); }
+    const ASTNode *visitIndexExpr(const IndexExprNode *node) { return node->index; }
+    const ASTNode *visitAssignment(const AssignmentNode *node) { return deeper({node->index, node->value}); }
+    const ASTNode *visitPrintStmt(const PrintStmtNode *node) { return node->expr; }
+    const ASTNode *visitReturnStmt(const ReturnStmtNode *node) { return node->expr; }
+    const ASTNode *visitIfStmt(const IfStmtNode *node)
+    {
+        return deeper({node->condition, node->thenBlock, node->elseBlock});
+    }
+    const ASTNode *visitRepeatStmt(const RepeatStmtNode *node) { return deeper({node->condition, node->body}); }
+    const ASTNode *visitParallelRepeat(const ParallelRepeatNode *node)
+    {
+        return deeper({node->start, node->end, node->body});
+    }
+    const ASTNode *visitBlock(const BlockNode *node) { return deepest(node->statements); }
+    const ASTNode *visitProgram(const ProgramNode *node) { return deepest(node->statements); }
+
+private:
+    template <class Nodes>
+    static const ASTNode *deepest(const Nodes &nodes)
+    {
+        const ASTNode *found = nullptr;
+        for (const ASTNode *node : nodes)
+            if (node && (!found || node->depth > found->depth))
+                found = node;
+        return found;
+    }
+    static const ASTNode *deeper(std::initializer_list<const ASTNode *> nodes) { return deepest(nodes); }
+};
+
+} // namespace
+
+bool CompileSession::parse()
+{
+    auto runParser = [&](TokenSource &tokens) {
+        return parser == ParserKind::Bison ? yyparse(&tokens, this) : rdParse(&tokens, this);
+    };
+
+    TokenSource tokens;
+    std::optional<FastLexer> fast;
+    YY_BUFFER_STATE buffer = nullptr;
+    if (lexer == LexerKind::Fast)
+    {
+        fast.emplace(text, arena, interner);
+        tokens.fast = &*fast;
+    }
+    else
+    {
+        if (yylex_init_extra(this, &tokens.flex) != 0)
+        {
+            diag << "Could not initialise the scanner\n";
+            return false;
+        }
+        buffer = yy_scan_bytes(text.data(), static_cast<int>(text.size()), tokens.flex);
+        yyset_lineno(1, tokens.flex);
+    }
+
+    int result;
+    if (timeReport)
+    {
+        // Normally the parser pulls tokens as it goes; to time the two
+        // separately, lex the whole input first and replay it
+        std::vector<RecordedToken> recorded;
+        {
+            TimeReport::Phase phase(timeReport, "lex");
+            RecordedToken token;
+            do
+            {
+                token.kind = nextToken(&token.value, &token.location, &tokens);
+                recorded.push_back(token);
+            } while (token.kind > 0);
+        }
+        timeReport->count("tokens", recorded.size() - 1);
+
+        TokenSource replay;
+        replay.recorded = &recorded;
+        TimeReport::Phase phase(timeReport, "parse");
+        result = runParser(replay);
+    }
+    else
+    {
+        result = runParser(tokens);
+    }
+
+    if (tokens.flex)
+    {
+        yy_delete_buffer(buffer, tokens.flex);
+        yylex_destroy(tokens.flex);
+    }
+    if (result != 0 || !astRoot)
+        return false;
+
+    // The parsers only count brackets; a long operator chain nests as deep
+    // as it is long without any. Report the line where the limit is crossed.
+    if (astRoot->depth - 1 > maxNesting)
+    {
+        const ASTNode *node = astRoot;
+        DeepestChild child;
+        for (unsigned level = 0; level <= maxNesting; ++level)
+            node = child.visit(node);
+        diag << "Parse error: nesting deeper than " << maxNesting << " levels at line " << node->lineNumber << "\n";
+        parseErrorLine = node->lineNumber;
+        nestingExceeded = true;
+        return false;
+    }
+    return true;
+}
+
+bool CompileSession::analyze()
+{
+    TimeReport::Phase phase(timeReport, "sema");
+    astRoot->analyze(symbolTable);
+    return symbolTable.errorCount() == 0;
+}
@@ -0,0 +1,72 @@
+// compile_session.h
+#pragma once
+
+#include "ast.h"
+#include "ast_arena.h"
+#include "interner.h"
+#include "large_stack.h"
+#include "SymbolTable.h"
+#include "source_file.h"
+#include "time_report.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Which scanner turns the source into tokens; both produce the same stream
+enum class LexerKind
+{
+    Flex, // lexer.l
+    Fast, // FastLexer: SIMD scanning, zero-copy literals
+};
+
+// Parses "flex" or "fast"
+bool parseLexerKind(std::string_view name, LexerKind &kind);
+
+// Which parser builds the tree; both build the same one
+enum class ParserKind
+{
+    Bison,            // parser.y
+    RecursiveDescent, // rd_parser.cpp
+};
+
+// Parses "bison" or "rd"
+bool parseParserKind(std::string_view name, ParserKind &kind);
+
+// Everything a single compilation owns: the source text, the AST arena and
+// the symbol table. The scanner and parser are reentrant, so independent
+// sessions can be driven from different threads at the same time.
+class CompileSession
+{
+public:
+    explicit CompileSession(std::string source, std::ostream &diagnostics = std::cerr);
+    // Lex straight out of an opened (usually mapped) file
+    explicit CompileSession(std::unique_ptr<SourceFile> file, std::ostream &diagnostics = std::cerr);
+
+    bool parse();   // Lex + parse into astRoot; false on a syntax error
+    bool analyze(); // Semantic checks, reported through diag; false on errors
+
+    std::string_view source() const { return text; }
+
+    LexerKind lexer = LexerKind::Fast;
+    ParserKind parser = ParserKind::Bison;
+    int parseErrorLine = 0; // Where parse() stopped on a syntax error
+    bool nestingExceeded = false; // The error was maxNesting being crossed
+    // Deepest nesting parse() accepts, counted in tree levels below the
+    // program
+    unsigned maxNesting = DefaultMaxNesting;
+    // When set, parse() lexes everything before parsing so the two are
+    // timed apart, and each phase adds its time and counters here
+    TimeReport *timeReport = nullptr;
+    std::ostream &diag;
+    AstArena arena;                  // Owns every node; freed in one go with the session
+    Interner interner;               // Identifier spellings -> IdentId, filled by the lexer
+    ProgramNode *astRoot = nullptr;
+    SymbolTable symbolTable;
+
+private:
+    std::string ownedText;
+    std::unique_ptr<SourceFile> file;
+    std::string_view text; // ownedText or the file; string literals point into it
+};
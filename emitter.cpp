@@ -0,0 +1,232 @@
+// emitter.cpp
+#include "emitter.h"
+
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#if LLVM_VERSION_MAJOR >= 17
+#include <llvm/TargetParser/Host.h>
+#include <llvm/TargetParser/SubtargetFeature.h>
+#else
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/Support/Host.h>
+#endif
+
+#include <cstdlib>
+#include <mutex>
+
+bool parseEmitKind(const std::string &text, EmitKind &kind)
+{
+    if (text == "ll")
+        kind = EmitKind::LLVM;
+    else if (text == "bc")
+        kind = EmitKind::Bitcode;
+    else if (text == "obj")
+        kind = EmitKind::Object;
+    else if (text == "asm")
+        kind = EmitKind::Assembly;
+    else if (text == "exe")
+        kind = EmitKind::Executable;
+    else
+        return false;
+    return true;
+}
+
+std::string defaultOutputPath(EmitKind kind)
+{
+    switch (kind)
+    {
+    case EmitKind::LLVM:
+        return "output.ll";
+    case EmitKind::Bitcode:
+        return "output.bc";
+    case EmitKind::Object:
+        return "output.o";
+    case EmitKind::Assembly:
+        return "output.s";
+    case EmitKind::Executable:
+        return "output";
+    }
+    return "output";
+}
+
+static std::string hostFeatures()
+{
+    llvm::SubtargetFeatures features;
+#if LLVM_VERSION_MAJOR >= 19
+    for (const auto &feature : llvm::sys::getHostCPUFeatures())
+        features.AddFeature(feature.getKey(), feature.getValue());
+#else
+    llvm::StringMap<bool> hostFeatures;
+    if (llvm::sys::getHostCPUFeatures(hostFeatures))
+        for (const auto &feature : hostFeatures)
+            features.AddFeature(feature.getKey(), feature.getValue());
+#endif
+    return features.getString();
+}
+
+std::unique_ptr<llvm::TargetMachine> createHostTargetMachine(OptLevel level, std::string &error)
+{
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+
+    std::string triple = llvm::sys::getProcessTriple();
+    const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (!target)
+        return nullptr;
+
+#if LLVM_VERSION_MAJOR >= 18
+    llvm::CodeGenOptLevel codegenLevel = level == OptLevel::O0 ? llvm::CodeGenOptLevel::None
+                                       : level == OptLevel::O3 ? llvm::CodeGenOptLevel::Aggressive
+                                                               : llvm::CodeGenOptLevel::Default;
+#else
+    llvm::CodeGenOpt::Level codegenLevel = level == OptLevel::O0 ? llvm::CodeGenOpt::None
+                                         : level == OptLevel::O3 ? llvm::CodeGenOpt::Aggressive
+                                                                 : llvm::CodeGenOpt::Default;
+#endif
+
+    // PIC so the object links into the position-independent executables
+    // that cc produces by default
+    std::unique_ptr<llvm::TargetMachine> tm(target->createTargetMachine(
+        triple, llvm::sys::getHostCPUName(), hostFeatures(), llvm::TargetOptions(),
+        llvm::Reloc::PIC_, {}, codegenLevel));
+    if (!tm)
+        error = "cannot create a target machine for " + triple;
+    return tm;
+}
+
+std::string hostTargetDescription()
+{
+    return llvm::sys::getProcessTriple() + " " + llvm::sys::getHostCPUName().str() + " " + hostFeatures();
+}
+
+void prepareModuleForTarget(llvm::Module &module, llvm::TargetMachine &tm)
+{
+    module.setTargetTriple(tm.getTargetTriple().str());
+    module.setDataLayout(tm.createDataLayout());
+}
+
+static bool emitNative(llvm::Module &module, bool assembly, const std::string &path,
+                       llvm::TargetMachine &tm, std::string &error)
+{
+    std::error_code ec;
+    llvm::raw_fd_ostream out(path, ec, llvm::sys::fs::OF_None);
+    if (ec)
+    {
+        error = "cannot open " + path + ": " + ec.message();
+        return false;
+    }
+
+#if LLVM_VERSION_MAJOR >= 18
+    llvm::CodeGenFileType fileType = assembly ? llvm::CodeGenFileType::AssemblyFile
+                                              : llvm::CodeGenFileType::ObjectFile;
+#else
+    llvm::CodeGenFileType fileType = assembly ? llvm::CGFT_AssemblyFile : llvm::CGFT_ObjectFile;
+#endif
+
+    // Machine code emission still runs on the legacy pass manager
+    llvm::legacy::PassManager passes;
+    if (tm.addPassesToEmitFile(passes, out, nullptr, fileType))
+    {
+        error = "target cannot emit this file type";
+        return false;
+    }
+    passes.run(module);
+    out.flush();
+    return true;
+}
+
+// libbitlang_rt.a: $BITLANG_RUNTIME, else next to the running compiler as
+// the build leaves it
+static std::string runtimeLibrary()
+{
+    const char *configured = std::getenv("BITLANG_RUNTIME");
+    if (configured && *configured)
+        return configured;
+    static int anchor;
+    llvm::SmallString<256> path(llvm::sys::path::parent_path(llvm::sys::fs::getMainExecutable("bitlang", &anchor)));
+    llvm::sys::path::append(path, "libbitlang_rt.a");
+    return path.str().str();
+}
+
+static bool linkExecutable(const std::string &objectPath, const std::string &path, std::string &error)
+{
+    std::string runtime = runtimeLibrary();
+    if (!llvm::sys::fs::exists(runtime))
+    {
+        error = "runtime library " + runtime + " not found (set BITLANG_RUNTIME)";
+        return false;
+    }
+
+    const char *cc = std::getenv("CC");
+    llvm::ErrorOr<std::string> driver = llvm::sys::findProgramByName(cc && *cc ? cc : "cc");
+    if (!driver)
+    {
+        error = "no C compiler driver found to link with (set CC)";
+        return false;
+    }
+
+    llvm::StringRef args[] = {*driver, objectPath, runtime, "-pthread", "-o", path};
+    std::string message;
+    int status = llvm::sys::ExecuteAndWait(*driver, args, {}, {}, 0, 0, &message);
+    if (status != 0)
+    {
+        error = "linking failed" + (message.empty() ? std::string() : ": " + message);
+        return false;
+    }
+    return true;
+}
+
+bool emitModule(llvm::Module &module, EmitKind kind, const std::string &path,
+                llvm::TargetMachine &tm, std::string &error)
+{
+    switch (kind)
+    {
+    case EmitKind::LLVM:
+    case EmitKind::Bitcode:
+    {
+        std::error_code ec;
+        llvm::raw_fd_ostream out(path, ec, kind == EmitKind::LLVM ? llvm::sys::fs::OF_Text
+                                                                  : llvm::sys::fs::OF_None);
+        if (ec)
+        {
+            error = "cannot open " + path + ": " + ec.message();
+            return false;
+        }
+        if (kind == EmitKind::LLVM)
+            module.print(out, nullptr);
+        else
+            llvm::WriteBitcodeToFile(module, out);
+        return true;
+    }
+    case EmitKind::Object:
+    case EmitKind::Assembly:
+        return emitNative(module, kind == EmitKind::Assembly, path, tm, error);
+    case EmitKind::Executable:
+    {
+        llvm::SmallString<128> objectPath;
+        if (std::error_code ec = llvm::sys::fs::createTemporaryFile("bitlang", "o", objectPath))
+        {
+            error = "cannot create temporary object file: " + ec.message();
+            return false;
+        }
+        bool ok = emitNative(module, false, objectPath.str().str(), tm, error) &&
+                  linkExecutable(objectPath.str().str(), path, error);
+        llvm::sys::fs::remove(objectPath);
+        return ok;
+    }
+    }
+    return false;
+}
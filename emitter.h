@@ -0,0 +1,48 @@
+// emitter.h
+#pragma once
+
+#include "optimizer.h"
+
+#include <llvm/Target/TargetMachine.h>
+
+#include <memory>
+#include <string>
+
+namespace llvm
+{
+class Module;
+}
+
+enum class EmitKind
+{
+    LLVM,     // Textual IR (.ll)
+    Bitcode,  // .bc
+    Object,   // Native object file (.o)
+    Assembly, // Native assembly (.s)
+    Executable
+};
+
+// Accepts ll, bc, obj, asm and exe
+bool parseEmitKind(const std::string &text, EmitKind &kind);
+
+// Output name used when no -o is given, e.g. output.o
+std::string defaultOutputPath(EmitKind kind);
+
+// TargetMachine for the machine we are running on, using the host CPU and
+// every feature it reports (what -march=native does). Returns null and sets
+// `error` if the native target is unavailable.
+std::unique_ptr<llvm::TargetMachine> createHostTargetMachine(OptLevel level, std::string &error);
+
+// "<triple> <cpu> <features>" of the machine createHostTargetMachine targets
+std::string hostTargetDescription();
+
+// Stamp the module with the target's triple and data layout; do this
+// before optimising so the passes see the real target.
+void prepareModuleForTarget(llvm::Module &module, llvm::TargetMachine &tm);
+
+// Write the module in the requested form. Executables are linked by the
+// system C compiler driver ($CC, else cc) against the BitLang runtime
+// (libbitlang_rt.a next to the compiler, or $BITLANG_RUNTIME) and the C
+// library.
+bool emitModule(llvm::Module &module, EmitKind kind, const std::string &path,
+                llvm::TargetMachine &tm, std::string &error);
@@ -0,0 +1,509 @@
+// fast_lexer.cpp
+#include "fast_lexer.h"
+#include "parser.tab.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+// ---- Character classes --------------------------------------------------
+
+inline bool isBlank(unsigned char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(unsigned char c)
+{
+    return static_cast<unsigned>(c - '0') < 10;
+}
+
+inline bool isIdentStart(unsigned char c)
+{
+    return static_cast<unsigned>((c | 0x20) - 'a') < 26 || c == '_';
+}
+
+inline bool isIdentChar(unsigned char c)
+{
+    return isIdentStart(c) || isDigit(c);
+}
+
+inline unsigned lowestBit(uint32_t mask)
+{
+    return static_cast<unsigned>(__builtin_ctz(mask));
+}
+
+// ---- SIMD blocks ----------------------------------------------------------
+//
+// Each helper returns a bitmask with bit i set when byte i of the block is
+// in the class. Ranges are tested with one signed compare after shifting
+// the range down to start at -128.
+
+#if defined(__AVX2__)
+#define BITLANG_LEXER_SIMD 1
+struct Block
+{
+    static constexpr size_t Width = 32;
+    static constexpr uint32_t All = 0xFFFFFFFFu;
+
+    __m256i bytes;
+
+    static Block load(const char *p) { return {_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))}; }
+
+    static uint32_t mask(__m256i v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+
+    static __m256i inRange(__m256i v, char lo, char hi)
+    {
+        __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8(static_cast<char>(128 - lo)));
+        return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi - lo + 1 - 128)), shifted);
+    }
+
+    __m256i equals(char c) const { return _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(c)); }
+
+    uint32_t blanks() const
+    {
+        return mask(_mm256_or_si256(_mm256_or_si256(equals(' '), equals('\t')), equals('\r')));
+    }
+
+    uint32_t identChars() const
+    {
+        __m256i letters = inRange(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i digits = inRange(bytes, '0', '9');
+        return mask(_mm256_or_si256(_mm256_or_si256(letters, digits), equals('_')));
+    }
+
+    uint32_t stringStops() const
+    {
+        return mask(_mm256_or_si256(_mm256_or_si256(equals('"'), equals('\\')), equals('\n')));
+    }
+};
+#elif defined(__SSE2__) || defined(_M_X64)
+#define BITLANG_LEXER_SIMD 1
+struct Block
+{
+    static constexpr size_t Width = 16;
+    static constexpr uint32_t All = 0xFFFFu;
+
+    __m128i bytes;
+
+    static Block load(const char *p) { return {_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))}; }
+
+    static uint32_t mask(__m128i v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+
+    static __m128i inRange(__m128i v, char lo, char hi)
+    {
+        __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(128 - lo)));
+        return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(hi - lo + 1 - 128)));
+    }
+
+    __m128i equals(char c) const { return _mm_cmpeq_epi8(bytes, _mm_set1_epi8(c)); }
+
+    uint32_t blanks() const { return mask(_mm_or_si128(_mm_or_si128(equals(' '), equals('\t')), equals('\r'))); }
+
+    uint32_t identChars() const
+    {
+        __m128i letters = inRange(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i digits = inRange(bytes, '0', '9');
+        return mask(_mm_or_si128(_mm_or_si128(letters, digits), equals('_')));
+    }
+
+    uint32_t stringStops() const
+    {
+        return mask(_mm_or_si128(_mm_or_si128(equals('"'), equals('\\')), equals('\n')));
+    }
+};
+#endif
+
+// The scanners below only load whole blocks that lie inside the source, so
+// they never read past the end of a mapped file; the last few bytes are
+// scanned one at a time.
+
+// First byte at or after `p` that is not a blank, or `end`
+const char *skipBlanks(const char *p, const char *end)
+{
+    // Most runs are a single space
+    if (p == end || !isBlank(*p))
+        return p;
+#ifdef BITLANG_LEXER_SIMD
+    while (static_cast<size_t>(end - p) >= Block::Width)
+    {
+        uint32_t other = ~Block::load(p).blanks() & Block::All;
+        if (other)
+            return p + lowestBit(other);
+        p += Block::Width;
+    }
+#endif
+    while (p != end && isBlank(*p))
+        ++p;
+    return p;
+}
+
+// First byte at or after `p` that cannot continue an identifier, or `end`
+const char *skipIdentChars(const char *p, const char *end)
+{
+#ifdef BITLANG_LEXER_SIMD
+    while (static_cast<size_t>(end - p) >= Block::Width)
+    {
+        uint32_t other = ~Block::load(p).identChars() & Block::All;
+        if (other)
+            return p + lowestBit(other);
+        p += Block::Width;
+    }
+#endif
+    while (p != end && isIdentChar(*p))
+        ++p;
+    return p;
+}
+
+// First '"', '\\' or newline at or after `p`, or `end`
+const char *findStringStop(const char *p, const char *end)
+{
+#ifdef BITLANG_LEXER_SIMD
+    while (static_cast<size_t>(end - p) >= Block::Width)
+    {
+        uint32_t stops = Block::load(p).stringStops();
+        if (stops)
+            return p + lowestBit(stops);
+        p += Block::Width;
+    }
+#endif
+    while (p != end && *p != '"' && *p != '\\' && *p != '\n')
+        ++p;
+    return p;
+}
+
+// ---- Keywords -------------------------------------------------------------
+//
+// A perfect hash over (first two characters, last character, length), with
+// the multiplier searched for at compile time: a keyword lookup is one
+// multiply, one table load and one compare of at most eight bytes.
+
+struct Keyword
+{
+    std::string_view text;
+    int token;
+};
+
+constexpr Keyword keywords[] = {
+    {"int", INT},       {"float", FLOAT},   {"string", STRING}, {"bool", BOOL},     {"true", TRUE},
+    {"false", FALSE},   {"print", PRINT},   {"input", INPUT},   {"clear", CLEAR},   {"typeof", TYPEOF},
+    {"randint", RANDINT}, {"if", IF},       {"else", ELSE},     {"repeat", REPEAT}, {"return", RETURN},
+    {"stop", BREAK},    {"skip", CONTINUE}, {"and", AND},       {"or", OR},         {"not", NOT},
+    {"parallel", PARALLEL}, {"reduce", REDUCE},
+};
+constexpr size_t KeywordCount = sizeof(keywords) / sizeof(keywords[0]);
+
+constexpr unsigned KeywordHashBits = 6;
+constexpr size_t KeywordSlots = size_t(1) << KeywordHashBits;
+
+constexpr uint32_t keywordHash(std::string_view word, uint32_t multiplier)
+{
+    uint32_t key = uint32_t(uint8_t(word[0])) | uint32_t(uint8_t(word[1])) << 8 |
+                   uint32_t(uint8_t(word[word.size() - 1])) << 16 | uint32_t(word.size()) << 24;
+    return (key * multiplier) >> (32 - KeywordHashBits);
+}
+
+constexpr size_t shortestKeyword()
+{
+    size_t shortest = SIZE_MAX;
+    for (const Keyword &keyword : keywords)
+        shortest = keyword.text.size() < shortest ? keyword.text.size() : shortest;
+    return shortest;
+}
+
+constexpr size_t longestKeyword()
+{
+    size_t longest = 0;
+    for (const Keyword &keyword : keywords)
+        longest = keyword.text.size() > longest ? keyword.text.size() : longest;
+    return longest;
+}
+
+constexpr size_t MinKeywordLength = shortestKeyword();
+constexpr size_t MaxKeywordLength = longestKeyword();
+static_assert(MinKeywordLength >= 2, "the keyword hash reads two leading characters");
+
+constexpr bool keywordHashIsPerfect(uint32_t multiplier)
+{
+    bool used[KeywordSlots] = {};
+    for (const Keyword &keyword : keywords)
+    {
+        uint32_t slot = keywordHash(keyword.text, multiplier);
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t findKeywordMultiplier()
+{
+    for (uint32_t multiplier = 0x9E3779B1u, tries = 0; tries < 100000; multiplier += 2, ++tries)
+        if (keywordHashIsPerfect(multiplier))
+            return multiplier;
+    return 0;
+}
+
+constexpr uint32_t KeywordMultiplier = findKeywordMultiplier();
+static_assert(KeywordMultiplier != 0, "no collision-free keyword hash; widen KeywordHashBits");
+
+struct KeywordTable
+{
+    int8_t slots[KeywordSlots]; // Index into keywords, or -1
+};
+
+constexpr KeywordTable buildKeywordTable()
+{
+    KeywordTable table = {};
+    for (size_t i = 0; i < KeywordSlots; ++i)
+        table.slots[i] = -1;
+    for (size_t i = 0; i < KeywordCount; ++i)
+        table.slots[keywordHash(keywords[i].text, KeywordMultiplier)] = static_cast<int8_t>(i);
+    return table;
+}
+
+constexpr KeywordTable keywordTable = buildKeywordTable();
+
+// Token for a keyword, or -1 for an ordinary identifier
+inline int keywordToken(std::string_view word)
+{
+    if (word.size() < MinKeywordLength || word.size() > MaxKeywordLength)
+        return -1;
+    int index = keywordTable.slots[keywordHash(word, KeywordMultiplier)];
+    return index >= 0 && keywords[index].text == word ? keywords[index].token : -1;
+}
+
+} // namespace
+
+std::string_view decodeStringLiteral(AstArena &arena, std::string_view body)
+{
+    char *out = arena.allocateArray<char>(body.size() + 1);
+    size_t size = 0;
+    for (size_t i = 0; i < body.size(); ++i)
+    {
+        char c = body[i];
+        if (c == '\\' && i + 1 < body.size())
+        {
+            switch (body[++i])
+            {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            default: c = body[i]; break; // \" \\ \' and unknown escapes stand for themselves
+            }
+        }
+        out[size++] = c;
+    }
+    out[size] = '\0';
+    return std::string_view(out, size);
+}
+
+FastLexer::FastLexer(std::string_view source, AstArena &arena, Interner &interner)
+    : cursor(source.data()), end(source.data() + source.size()), arena(arena), interner(interner)
+{
+}
+
+int FastLexer::next(YYSTYPE &value, YYLTYPE &location)
+{
+    cursor = skipBlanks(cursor, end);
+    location.first_line = location.last_line = line;
+    if (cursor == end)
+        return 0;
+
+    const char *start = cursor;
+    unsigned char c = static_cast<unsigned char>(*cursor);
+
+    if (isIdentStart(c))
+    {
+        cursor = skipIdentChars(cursor + 1, end);
+        std::string_view word(start, static_cast<size_t>(cursor - start));
+        int token = keywordToken(word);
+        if (token == TRUE || token == FALSE)
+            value.bval = token == TRUE;
+        if (token >= 0)
+            return token;
+        value.ident = interner.intern(word);
+        return IDENTIFIER;
+    }
+    if (isDigit(c))
+        return lexNumber(value, location);
+
+    ++cursor;
+    switch (c)
+    {
+    case '\n':
+        // One NEWLINE token per run; like flex, it carries the line after it
+        ++line;
+        while (cursor != end && *cursor == '\n')
+        {
+            ++cursor;
+            ++line;
+        }
+        location.first_line = location.last_line = line;
+        return NEWLINE;
+    case '"':
+        return lexString(value, location);
+    case '\'':
+        return lexCharOrUnknown(value, location);
+    case '=':
+        if (cursor != end && *cursor == '=')
+        {
+            ++cursor;
+            return EQ;
+        }
+        return ASSIGN;
+    case '!':
+        if (cursor != end && *cursor == '=')
+        {
+            ++cursor;
+            return NEQ;
+        }
+        return UNKNOWN;
+    case '<':
+        if (cursor != end && *cursor == '=')
+        {
+            ++cursor;
+            return LEQ;
+        }
+        return LT;
+    case '>':
+        if (cursor != end && *cursor == '=')
+        {
+            ++cursor;
+            return GEQ;
+        }
+        return GT;
+    case '+': return PLUS;
+    case '-': return MINUS;
+    case '*': return STAR;
+    case '/': return SLASH;
+    case '(': return LPAREN;
+    case ')': return RPAREN;
+    case '{': return LBRACE;
+    case '}': return RBRACE;
+    case '[': return LBRACKET;
+    case ']': return RBRACKET;
+    case ';': return SEMICOLON;
+    case ',': return COMMA;
+    default: return UNKNOWN;
+    }
+}
+
+// `cursor` is just past the opening quote. An unterminated literal is, as
+// with flex, an UNKNOWN token for the quote alone.
+int FastLexer::lexString(YYSTYPE &value, YYLTYPE &location)
+{
+    const char *p = cursor;
+    int newlines = 0;
+    bool escaped = false;
+    for (;;)
+    {
+        p = findStringStop(p, end);
+        if (p == end)
+            return UNKNOWN;
+        if (*p == '"')
+            break;
+        if (*p == '\n')
+        {
+            ++newlines;
+            ++p;
+            continue;
+        }
+        // A backslash escapes any character but a newline
+        if (p + 1 == end || p[1] == '\n')
+            return UNKNOWN;
+        escaped = true;
+        p += 2;
+    }
+
+    std::string_view body(cursor, static_cast<size_t>(p - cursor));
+    cursor = p + 1;
+    line += newlines;
+    location.first_line = location.last_line = line;
+
+    // Only literals with escapes need their own copy
+    std::string_view text = escaped ? decodeStringLiteral(arena, body) : body;
+    value.sval = TokenText{text.data(), static_cast<uint32_t>(text.size())};
+    return STRING_LITERAL;
+}
+
+// `cursor` is just past the opening quote: 'c' or '\c', where c may be any
+// character (a newline too, unless escaped)
+int FastLexer::lexCharOrUnknown(YYSTYPE &value, YYLTYPE &location)
+{
+    size_t left = static_cast<size_t>(end - cursor);
+    if (left >= 2 && cursor[0] != '\\' && cursor[1] == '\'')
+    {
+        value.cval = cursor[0];
+        if (cursor[0] == '\n')
+        {
+            ++line;
+            location.first_line = location.last_line = line;
+        }
+        cursor += 2;
+        return CHAR_LITERAL;
+    }
+    if (left >= 3 && cursor[0] == '\\' && cursor[1] != '\n' && cursor[2] == '\'')
+    {
+        // The value is the backslash itself, as lexer.l has always done
+        value.cval = cursor[0];
+        cursor += 3;
+        return CHAR_LITERAL;
+    }
+    return UNKNOWN;
+}
+
+// Integer or, with a '.' and at least one digit after it, float literal.
+// Values match atoi/atof on the same text.
+int FastLexer::lexNumber(YYSTYPE &value, YYLTYPE &)
+{
+    const char *start = cursor;
+    unsigned long long integer = 0;
+    bool overflow = false;
+    while (cursor != end && isDigit(*cursor))
+    {
+        unsigned digit = static_cast<unsigned>(*cursor - '0');
+        if (integer > (static_cast<unsigned long long>(LONG_MAX) - digit) / 10)
+            overflow = true;
+        else
+            integer = integer * 10 + digit;
+        ++cursor;
+    }
+
+    if (end - cursor >= 2 && cursor[0] == '.' && isDigit(cursor[1]))
+    {
+        cursor += 2;
+        while (cursor != end && isDigit(*cursor))
+            ++cursor;
+        // strtod needs a terminator the mapped source does not have
+        char buffer[64];
+        size_t length = static_cast<size_t>(cursor - start);
+        if (length < sizeof(buffer))
+        {
+            std::memcpy(buffer, start, length);
+            buffer[length] = '\0';
+            value.fval = static_cast<float>(std::strtod(buffer, nullptr));
+        }
+        else
+        {
+            value.fval = static_cast<float>(std::strtod(std::string(start, length).c_str(), nullptr));
+        }
+        return FLOAT_LITERAL;
+    }
+
+    // atoi is strtol (saturating at LONG_MAX) narrowed to int
+    long saturated = overflow ? LONG_MAX : static_cast<long>(integer);
+    value.ival = static_cast<int>(saturated);
+    return INTEGER_LITERAL;
+}
@@ -0,0 +1,42 @@
+// fast_lexer.h
+#pragma once
+
+#include "ast_arena.h"
+#include "interner.h"
+
+#include <string_view>
+
+union YYSTYPE;
+struct YYLTYPE;
+
+// Hand-written scanner producing exactly the tokens, semantic values and
+// line numbers of the flex scanner in lexer.l, which stays available with
+// --lexer=flex. It works directly on the session's source (usually a
+// mapped file): blank and identifier runs are skipped 16 or 32 bytes at a
+// time with SSE2/AVX2, keywords are found with a perfect hash built at
+// compile time, and string literals without escapes are handed to the
+// parser as views into the source rather than copies.
+class FastLexer
+{
+public:
+    // `source` must outlive the tree built from the tokens
+    FastLexer(std::string_view source, AstArena &arena, Interner &interner);
+
+    // Next token, as yylex would return it; 0 at the end of the input
+    int next(YYSTYPE &value, YYLTYPE &location);
+
+private:
+    int lexString(YYSTYPE &value, YYLTYPE &location);
+    int lexCharOrUnknown(YYSTYPE &value, YYLTYPE &location);
+    int lexNumber(YYSTYPE &value, YYLTYPE &location);
+
+    const char *cursor;
+    const char *end;
+    int line = 1;
+    AstArena &arena;
+    Interner &interner;
+};
+
+// Copy the body of a string literal (the text between the quotes) into
+// `arena`, resolving backslash escapes. Shared with lexer.l.
+std::string_view decodeStringLiteral(AstArena &arena, std::string_view body);
@@ -0,0 +1,77 @@
+// interner.h
+#pragma once
+#include "ast_arena.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Dense integer handle for an identifier; equal names get equal ids
+using IdentId = uint32_t;
+
+// Maps identifier spellings to IdentIds. The lexer interns every identifier
+// once, so later passes compare and index by integer instead of hashing
+// strings. Spellings are stored in the compilation's arena.
+class Interner
+{
+public:
+    explicit Interner(AstArena &storage) : storage(storage), slots(64, Empty) {}
+
+    IdentId intern(std::string_view text)
+    {
+        uint32_t hash = hashOf(text);
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            uint32_t slot = slots[i];
+            if (slot == Empty)
+                break;
+            if (hashes[slot] == hash && names[slot] == text)
+                return slot;
+        }
+
+        IdentId id = static_cast<IdentId>(names.size());
+        names.push_back(storage.copyString(text));
+        hashes.push_back(hash);
+        if (names.size() * 2 > slots.size())
+            rehash(slots.size() * 2);
+        else
+            insertSlot(id, hash);
+        return id;
+    }
+
+    std::string_view name(IdentId id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+
+private:
+    static constexpr uint32_t Empty = UINT32_MAX;
+
+    static uint32_t hashOf(std::string_view text)
+    {
+        uint32_t hash = 2166136261u; // FNV-1a
+        for (unsigned char c : text)
+            hash = (hash ^ c) * 16777619u;
+        return hash;
+    }
+
+    void insertSlot(IdentId id, uint32_t hash)
+    {
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        while (slots[i] != Empty)
+            i = (i + 1) & mask;
+        slots[i] = id;
+    }
+
+    void rehash(size_t capacity)
+    {
+        slots.assign(capacity, Empty);
+        for (IdentId id = 0; id < names.size(); ++id)
+            insertSlot(id, hashes[id]);
+    }
+
+    AstArena &storage;
+    std::vector<uint32_t> slots; // open addressing, holds ids
+    std::vector<std::string_view> names;
+    std::vector<uint32_t> hashes;
+};
@@ -0,0 +1,114 @@
+// jit_runner.cpp
+#include "jit_runner.h"
+#include "runtime.h"
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include <mutex>
+
+namespace {
+
+// Where the runtime's output buffer goes while a program runs
+void appendToCapture(void* context, const char* data, size_t size) {
+    static_cast<std::string*>(context)->append(data, size);
+}
+
+template <typename T>
+void addSymbol(llvm::orc::SymbolMap& symbols, llvm::orc::LLJIT& jit, const char* name, T* address) {
+#if LLVM_VERSION_MAJOR >= 17
+    symbols[jit.mangleAndIntern(name)] = llvm::orc::ExecutorSymbolDef(
+        llvm::orc::ExecutorAddr::fromPtr(address), llvm::JITSymbolFlags::Exported);
+#else
+    symbols[jit.mangleAndIntern(name)] = llvm::JITEvaluatedSymbol(
+        llvm::pointerToJITTargetAddress(address), llvm::JITSymbolFlags::Exported);
+#endif
+}
+
+} // namespace
+
+void initializeJIT() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+}
+
+JITResult runWithJIT(std::unique_ptr<llvm::LLVMContext> context,
+                     std::unique_ptr<llvm::Module> module,
+                     const std::string* input) {
+    JITResult result;
+    initializeJIT();
+
+    auto jitOrErr = llvm::orc::LLJITBuilder().create();
+    if (!jitOrErr) {
+        result.error = llvm::toString(jitOrErr.takeError());
+        return result;
+    }
+    std::unique_ptr<llvm::orc::LLJIT> jit = std::move(*jitOrErr);
+    llvm::orc::JITDylib& mainLib = jit->getMainJITDylib();
+
+    // Everything else comes from the host process; the runtime, which the
+    // compiler does not export, is added by hand.
+    auto processSymbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        jit->getDataLayout().getGlobalPrefix());
+    if (!processSymbols) {
+        result.error = llvm::toString(processSymbols.takeError());
+        return result;
+    }
+    mainLib.addGenerator(std::move(*processSymbols));
+
+    llvm::orc::SymbolMap redirected;
+    addSymbol(redirected, *jit, "bl_print_i32", &bl_print_i32);
+    addSymbol(redirected, *jit, "bl_print_f32", &bl_print_f32);
+    addSymbol(redirected, *jit, "bl_print_f32_fixed", &bl_print_f32_fixed);
+    addSymbol(redirected, *jit, "bl_print_str", &bl_print_str);
+    addSymbol(redirected, *jit, "bl_print_bool", &bl_print_bool);
+    addSymbol(redirected, *jit, "bl_print_char", &bl_print_char);
+    addSymbol(redirected, *jit, "bl_array_index_error", &bl_array_index_error);
+    addSymbol(redirected, *jit, "bl_division_error", &bl_division_error);
+    addSymbol(redirected, *jit, "bl_flush", &bl_flush);
+    addSymbol(redirected, *jit, "bl_input_i32", &bl_input_i32);
+    addSymbol(redirected, *jit, "bl_input_f32", &bl_input_f32);
+    addSymbol(redirected, *jit, "bl_input_str", &bl_input_str);
+    addSymbol(redirected, *jit, "bl_str_concat", &bl_str_concat);
+    addSymbol(redirected, *jit, "bl_str_equal", &bl_str_equal);
+    addSymbol(redirected, *jit, "bl_str_compare", &bl_str_compare);
+    addSymbol(redirected, *jit, "bl_parallel_repeat", &bl_parallel_repeat);
+    addSymbol(redirected, *jit, "bl_parallel_chunks", &bl_parallel_chunks);
+    if (auto err = mainLib.define(llvm::orc::absoluteSymbols(std::move(redirected)))) {
+        result.error = llvm::toString(std::move(err));
+        return result;
+    }
+
+    module->setDataLayout(jit->getDataLayout());
+    if (auto err = jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context)))) {
+        result.error = llvm::toString(std::move(err));
+        return result;
+    }
+
+    auto mainSym = jit->lookup("main");
+    if (!mainSym) {
+        result.error = llvm::toString(mainSym.takeError());
+        return result;
+    }
+#if LLVM_VERSION_MAJOR >= 17
+    auto mainFn = mainSym->toPtr<int (*)()>();
+#else
+    auto mainFn = reinterpret_cast<int (*)()>(mainSym->getAddress());
+#endif
+
+    bl_set_output(appendToCapture, &result.output);
+    if (input)
+        bl_set_input(input->data(), input->size());
+    result.exitCode = mainFn();
+    bl_set_output(nullptr, nullptr);
+    bl_set_input(nullptr, 0);
+    bl_free_strings();
+
+    result.ok = true;
+    return result;
+}
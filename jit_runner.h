@@ -0,0 +1,27 @@
+// jit_runner.h
+#pragma once
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+#include <memory>
+#include <string>
+
+// Outcome of executing a generated program in-process
+struct JITResult {
+    bool ok = false;
+    int exitCode = 0;
+    std::string output; // everything the program printed
+    std::string error;  // JIT setup / lookup failure, if any
+};
+
+// One-time native target setup; safe to call more than once.
+void initializeJIT();
+
+// Compile the module with LLJIT and call its main(). The program's output
+// is captured into JITResult::output instead of going to stdout, so no
+// .ll file, opt or lli process is involved. When input is given, input()
+// reads from it rather than from the process stdin.
+JITResult runWithJIT(std::unique_ptr<llvm::LLVMContext> context,
+                     std::unique_ptr<llvm::Module> module,
+                     const std::string* input = nullptr);
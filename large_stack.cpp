@@ -0,0 +1,60 @@
+// large_stack.cpp
+#include "large_stack.h"
+
+#include <exception>
+#include <string>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#define BITLANG_HAVE_PTHREAD_STACKSIZE 1
+#endif
+
+#ifdef BITLANG_HAVE_PTHREAD_STACKSIZE
+namespace {
+
+struct StackedWork
+{
+    const std::function<void()> *work;
+    std::exception_ptr error;
+};
+
+void *runStackedWork(void *argument)
+{
+    auto stacked = static_cast<StackedWork *>(argument);
+    try
+    {
+        (*stacked->work)();
+    }
+    catch (...)
+    {
+        stacked->error = std::current_exception();
+    }
+    return nullptr;
+}
+
+} // namespace
+#endif
+
+void runWithStack(size_t stackBytes, const std::function<void()> &work)
+{
+#ifdef BITLANG_HAVE_PTHREAD_STACKSIZE
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    int result = pthread_attr_setstacksize(&attributes, stackBytes);
+    StackedWork stacked{&work, nullptr};
+    pthread_t thread;
+    if (result == 0)
+        result = pthread_create(&thread, &attributes, runStackedWork, &stacked);
+    pthread_attr_destroy(&attributes);
+    if (result != 0)
+        throw std::system_error(result, std::generic_category(),
+                                "cannot start a thread with " + std::to_string(stackBytes >> 20) + " MiB of stack");
+    pthread_join(thread, nullptr);
+    if (stacked.error)
+        std::rethrow_exception(stacked.error);
+#else
+    (void)stackBytes;
+    work();
+#endif
+}
@@ -0,0 +1,30 @@
+// large_stack.h
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Every pass over the tree, from the recursive-descent parser to both code
+// generators, keeps its place in the tree in vectors on the heap (see
+// walkTree), so a program's nesting costs no stack. LLVM's own passes still
+// recurse in places on deeply nested control flow, so a compilation runs on
+// a thread with a fixed stack of its own rather than on whatever the caller
+// has.
+
+// Levels of nesting (blocks, parentheses, prefix operators and operands of
+// left-associative chains alike) a program may use unless told otherwise
+constexpr unsigned DefaultMaxNesting = 100000;
+
+// Highest limit that may be asked for; Bison's parse stack grows to it
+constexpr unsigned MaxNestingLimit = 1u << 21;
+
+// Stack of the thread a compilation runs on. At -O2 LLVM takes about 500
+// bytes per level of nested ifs, so this covers the default limit.
+constexpr size_t CompileStackSize = 64u << 20;
+
+// Run `work` to completion on a thread with `stackBytes` of stack,
+// rethrowing whatever it throws. The stack is reserved address space; only
+// the pages a deep program touches are ever backed by memory. Throws
+// std::system_error if the thread cannot be created. Where threads with a
+// chosen stack size are not available, `work` runs on the caller's stack.
+void runWithStack(size_t stackBytes, const std::function<void()> &work);
@@ -1,239 +1,1470 @@
-// llvm_codegen.cpp
-#include "llvm_codegen.h"
-#include <llvm/IR/Type.h>
-#include <llvm/IR/Function.h>
-#include <llvm/IR/Constants.h>
-#include <llvm/IR/GlobalVariable.h>
-
-LLVMCodeGen::LLVMCodeGen() : builder(context) {
-    module = std::make_unique<llvm::Module>("MyModule", context);
-}
-
-void LLVMCodeGen::generate(const ProgramNode* root) {
-    llvm::FunctionType* mainType = llvm::FunctionType::get(builder.getInt32Ty(), false);
-    mainFunc = llvm::Function::Create(mainType, llvm::Function::ExternalLinkage, "main", module.get());
-    currentBlock = llvm::BasicBlock::Create(context, "entry", mainFunc);
-    builder.SetInsertPoint(currentBlock);
-
-    for (const auto& stmt : root->statements) {
-        generateStmt(stmt.get());
-    }
-
-    builder.CreateRet(builder.getInt32(0));
-    llvm::verifyFunction(*mainFunc);
-}
-
-void LLVMCodeGen::dumpIR(const std::string& filename) {
-    std::error_code EC;
-    llvm::raw_fd_ostream out(filename, EC);
-    module->print(out, nullptr);
-}
-
-llvm::Value* LLVMCodeGen::generateExpr(const ASTNode* expr) {
-    if (auto lit = dynamic_cast<const LiteralNode*>(expr)) {
-        if (lit->type == LiteralNode::Type::Int)
-            return llvm::ConstantInt::get(builder.getInt32Ty(), std::stoi(lit->value));
-        if (lit->type == LiteralNode::Type::Float)
-            return llvm::ConstantFP::get(builder.getFloatTy(), std::stof(lit->value));
-        if (lit->type == LiteralNode::Type::Bool)
-            return llvm::ConstantInt::get(builder.getInt1Ty(), lit->value == "true" ? 1 : 0);
-        if (lit->type == LiteralNode::Type::String)
-            return builder.CreateGlobalStringPtr(lit->value);
-    } else if (auto ident = dynamic_cast<const IdentifierNode*>(expr)) {
-        llvm::AllocaInst* ptr = namedValues[ident->name];
-        return builder.CreateLoad(ptr->getAllocatedType(), ptr);
-    } else if (auto builtin = dynamic_cast<const BuiltinCallNode*>(expr)) {
-        if (builtin->funcName == "input") {
-            llvm::FunctionType* scanfType = llvm::FunctionType::get(builder.getInt32Ty(), true);
-            llvm::FunctionCallee scanfFunc = module->getOrInsertFunction("scanf", scanfType);
-
-            std::string format = "%d";  // default int
-            llvm::Type* allocType = builder.getInt32Ty();
-
-            if (!builtin->args.empty()) {
-                auto typeHint = dynamic_cast<const LiteralNode*>(builtin->args[0].get());
-                if (typeHint && typeHint->type == LiteralNode::Type::String) {
-                    std::string hint = typeHint->value;
-                    if (hint == "int") {
-                        format = "%d";
-                        allocType = builder.getInt32Ty();
-                    } else if (hint == "float") {
-                        format = "%f";
-                        allocType = builder.getFloatTy();
-                    } else if (hint == "bool") {
-                        format = "%d";
-                        allocType = builder.getInt1Ty();
-                    } else if (hint == "string") {
-                        format = "%s";
-                        allocType = llvm::ArrayType::get(builder.getInt8Ty(), 256);
-                    }
-                }
-            }
-
-            llvm::AllocaInst* temp = builder.CreateAlloca(allocType);
-
-            llvm::Value* formatStr = builder.CreateGlobalStringPtr(format);
-            if (format == "%s") {
-                builder.CreateCall(scanfFunc, {formatStr, temp});
-                return temp; // pointer to string
-            } else {
-                builder.CreateCall(scanfFunc, {formatStr, temp});
-                return builder.CreateLoad(allocType, temp);
-            }
-        }
-    } else if (auto bin = dynamic_cast<const BinaryExprNode*>(expr)) {
-        auto L = generateExpr(bin->left.get());
-        auto R = generateExpr(bin->right.get());
-        llvm::Type* ty = L->getType();  // 🔁 MODIFIED
-
-        switch (bin->op) {
-            case BinaryExprNode::Op::Add:
-                return ty->isFloatingPointTy() ? builder.CreateFAdd(L, R) : builder.CreateAdd(L, R); // 🔁
-            case BinaryExprNode::Op::Sub:
-                return ty->isFloatingPointTy() ? builder.CreateFSub(L, R) : builder.CreateSub(L, R); // 🔁
-            case BinaryExprNode::Op::Mul:
-                return ty->isFloatingPointTy() ? builder.CreateFMul(L, R) : builder.CreateMul(L, R); // 🔁
-            case BinaryExprNode::Op::Div:
-                return ty->isFloatingPointTy() ? builder.CreateFDiv(L, R) : builder.CreateSDiv(L, R); // 🔁
-
-            case BinaryExprNode::Op::Eq:
-                return ty->isFloatingPointTy() ? builder.CreateFCmpUEQ(L, R) : builder.CreateICmpEQ(L, R); // 🔁
-            case BinaryExprNode::Op::Neq:
-                return ty->isFloatingPointTy() ? builder.CreateFCmpUNE(L, R) : builder.CreateICmpNE(L, R); // 🔁
-            case BinaryExprNode::Op::Lt:
-                return ty->isFloatingPointTy() ? builder.CreateFCmpULT(L, R) : builder.CreateICmpSLT(L, R); // 🔁
-            case BinaryExprNode::Op::Gt:
-                return ty->isFloatingPointTy() ? builder.CreateFCmpUGT(L, R) : builder.CreateICmpSGT(L, R); // 🔁
-            case BinaryExprNode::Op::Leq:
-                return ty->isFloatingPointTy() ? builder.CreateFCmpULE(L, R) : builder.CreateICmpSLE(L, R); // 🔁
-            case BinaryExprNode::Op::Geq:
-                return ty->isFloatingPointTy() ? builder.CreateFCmpUGE(L, R) : builder.CreateICmpSGE(L, R); // 🔁
-
-            case BinaryExprNode::Op::And:
-            case BinaryExprNode::Op::Or:
-                return bin->op == BinaryExprNode::Op::And ? builder.CreateAnd(L, R) : builder.CreateOr(L, R);
-            default: return nullptr;
-        }
-    } else if (auto un = dynamic_cast<const UnaryExprNode*>(expr)) {
-        llvm::Value* val = generateExpr(un->operand.get());
-        if (un->op == UnaryExprNode::Op::Minus)
-            return val->getType()->isFloatingPointTy() ? builder.CreateFNeg(val) : builder.CreateNeg(val); // 🔁
-        if (un->op == UnaryExprNode::Op::Not)
-            return builder.CreateNot(val);
-    }
-    return nullptr;
-}
-
-void LLVMCodeGen::generateStmt(const ASTNode* stmt) {
-    if (auto decl = dynamic_cast<const DeclarationNode*>(stmt)) {
-        llvm::AllocaInst* alloc;
-        if (decl->typeName == "int") {
-            alloc = builder.CreateAlloca(builder.getInt32Ty(), nullptr, decl->identifier);
-        } else if (decl->typeName == "float") {
-            alloc = builder.CreateAlloca(builder.getFloatTy(), nullptr, decl->identifier);
-        } else if (decl->typeName == "bool") {
-            alloc = builder.CreateAlloca(builder.getInt1Ty(), nullptr, decl->identifier);
-        } else {
-            alloc = builder.CreateAlloca(builder.getInt32Ty(), nullptr, decl->identifier);
-        }
-        llvm::Value* initVal = generateExpr(decl->expr.get());
-        builder.CreateStore(initVal, alloc);
-        namedValues[decl->identifier] = alloc;
-
-    } else if (auto print = dynamic_cast<const PrintStmtNode*>(stmt)) {
-        llvm::FunctionType* printfType = llvm::FunctionType::get(builder.getInt32Ty(), true);
-        llvm::FunctionCallee printfFunc = module->getOrInsertFunction("printf", printfType);
-
-        llvm::Value* val = generateExpr(print->expr.get());
-        llvm::Type* ty = val->getType();
-
-        llvm::Value* formatStr;
-
-        // Handle printing of string literals separately
-        if (auto lit = dynamic_cast<const LiteralNode*>(print->expr.get())) {
-            if (lit->type == LiteralNode::Type::String) {
-                formatStr = builder.CreateGlobalStringPtr("%s\n");
-                builder.CreateCall(printfFunc, {formatStr, val});
-        return;
-    }
-}
-
-
-        if (ty->isFloatTy()) {
-            // Promote float to double for printf varargs
-            val = builder.CreateFPExt(val, builder.getDoubleTy());
-            formatStr = builder.CreateGlobalStringPtr("%f\n");
-
-        } else if (ty->isDoubleTy()) {
-            formatStr = builder.CreateGlobalStringPtr("%f\n");
-
-        } else if (ty->isIntegerTy(1) || ty->isIntegerTy(32)) {
-            formatStr = builder.CreateGlobalStringPtr("%d\n");
-
-        } else {
-            formatStr = builder.CreateGlobalStringPtr("[unsupported type]\n");
-        }
-
-        builder.CreateCall(printfFunc, {formatStr, val});
-
-    } else if (auto assign = dynamic_cast<const AssignmentNode*>(stmt)) {
-        llvm::Value* val = generateExpr(assign->value.get());
-        builder.CreateStore(val, namedValues[assign->name]);
-
-    } else if (auto ifStmt = dynamic_cast<const IfStmtNode*>(stmt)) {
-        llvm::Value* condVal = generateExpr(ifStmt->condition.get());
-        if (condVal->getType()->isIntegerTy() && condVal->getType()->getIntegerBitWidth() != 1) {
-            condVal = builder.CreateICmpNE(condVal, llvm::ConstantInt::get(condVal->getType(), 0));
-        }
-        llvm::Function* func = builder.GetInsertBlock()->getParent();
-
-        llvm::BasicBlock* thenBB = llvm::BasicBlock::Create(context, "then", func);
-        llvm::BasicBlock* elseBB = ifStmt->elseBlock ? llvm::BasicBlock::Create(context, "else") : nullptr;
-        llvm::BasicBlock* mergeBB = llvm::BasicBlock::Create(context, "ifcont");
-
-        if (elseBB)
-            builder.CreateCondBr(condVal, thenBB, elseBB);
-        else
-            builder.CreateCondBr(condVal, thenBB, mergeBB);
-
-        builder.SetInsertPoint(thenBB);
-        generateStmt(ifStmt->thenBlock.get());
-        builder.CreateBr(mergeBB);
-
-        if (elseBB) {
-            elseBB->insertInto(func);
-            builder.SetInsertPoint(elseBB);
-            generateStmt(ifStmt->elseBlock.get());
-            builder.CreateBr(mergeBB);
-        }
-
-        mergeBB->insertInto(func);
-        builder.SetInsertPoint(mergeBB);
-
-    } else if (auto repeat = dynamic_cast<const RepeatStmtNode*>(stmt)) {
-        llvm::Function* func = builder.GetInsertBlock()->getParent();
-
-        llvm::BasicBlock* loopBB = llvm::BasicBlock::Create(context, "loop", func);
-        llvm::BasicBlock* afterBB = llvm::BasicBlock::Create(context, "afterloop");
-
-        builder.CreateBr(loopBB);
-        builder.SetInsertPoint(loopBB);
-
-        generateStmt(repeat->body.get());
-
-        llvm::Value* condVal = generateExpr(repeat->condition.get());
-        if (condVal->getType()->isIntegerTy() && condVal->getType()->getIntegerBitWidth() != 1) {
-            condVal = builder.CreateICmpNE(condVal, llvm::ConstantInt::get(condVal->getType(), 0));
-        }
-        builder.CreateCondBr(condVal, loopBB, afterBB);
-
-        afterBB->insertInto(func);
-        builder.SetInsertPoint(afterBB);
-
-    } else if (auto block = dynamic_cast<const BlockNode*>(stmt)) {
-        for (const auto& s : block->statements) {
-            generateStmt(s.get());
-        }
-    }
-}
-
+// llvm_codegen.cpp
+#include "llvm_codegen.h"
+#include "runtime.h"
+#include <algorithm>
+#include <llvm/ADT/SetVector.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Type.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Metadata.h>
+
+LLVMCodeGen::LLVMCodeGen(const LoopHints& loopHints, FloatFormat floatFormat)
+    : context(std::make_unique<llvm::LLVMContext>()), builder(*context), loopHints(loopHints),
+      floatFormat(floatFormat) {
+    module = std::make_unique<llvm::Module>("MyModule", *context);
+    stringType = llvm::StructType::create(*context, {builder.getInt64Ty(), builder.getInt64Ty()}, "bl.str");
+}
+
+void LLVMCodeGen::generate(const ProgramNode* root) {
+    llvm::FunctionType* mainType = llvm::FunctionType::get(builder.getInt32Ty(), false);
+    mainFunc = llvm::Function::Create(mainType, llvm::Function::ExternalLinkage, "main", module.get());
+    function = mainFunc;
+    currentBlock = llvm::BasicBlock::Create(*context, "entry", mainFunc);
+    builder.SetInsertPoint(currentBlock);
+    sealBlock(currentBlock);
+    startRegion(currentBlock);
+    slotTypes.assign(root->slotCount, nullptr);
+    slotNames.assign(root->slotCount, llvm::StringRef());
+    arrays.assign(root->slotCount, ArrayVar());
+
+    walkTree(static_cast<const ASTNode*>(root),
+             [this](const ASTNode* node, unsigned stage) { return visit(node, stage); });
+
+    builder.CreateCall(runtimeFunction("bl_flush"));
+    builder.CreateRet(builder.getInt32(0));
+    if (indexErrorBB)
+        indexErrorBB->insertInto(mainFunc);
+    if (divisionErrorBB)
+        divisionErrorBB->insertInto(mainFunc);
+
+    currentDef.clear();
+    incompletePhis.clear();
+    sealedBlocks.clear();
+    places.clear();
+    regionStarts.clear();
+    definitions.clear();
+    defined.clear();
+    arrays.clear();
+    arrayLeaves.clear();
+    arraySplats.clear();
+    strings.clear();
+    stringGlobals.clear();
+    indexErrorBB = nullptr;
+    badIndex = badLength = nullptr;
+    divisionErrorBB = nullptr;
+}
+
+bool LLVMCodeGen::verify(llvm::raw_ostream& errors) {
+    return !llvm::verifyModule(*module, &errors);
+}
+
+void LLVMCodeGen::dumpIR(const std::string& filename) {
+    std::error_code EC;
+    llvm::raw_fd_ostream out(filename, EC);
+    printIR(out);
+}
+
+void LLVMCodeGen::printIR(llvm::raw_ostream& out) {
+    module->print(out, nullptr);
+}
+
+// Storage type of a variable of the given BitLang type
+llvm::Type* LLVMCodeGen::llvmType(TypeId type) {
+    switch (type.kind()) {
+        case TypeKind::Float:  return builder.getFloatTy();
+        case TypeKind::Bool:   return builder.getInt1Ty();
+        case TypeKind::Char:   return builder.getInt8Ty();
+        case TypeKind::String: return stringType;
+        default:               return builder.getInt32Ty();
+    }
+}
+
+// The value of a literal, laid out as the runtime's bl_str_make would on
+// this (64-bit) host: the text itself if it is short, or else the address
+// of a private global holding it
+llvm::Constant* LLVMCodeGen::stringConstant(llvm::StringRef text) {
+    static_assert(sizeof(const char*) == sizeof(uint64_t), "a large string's first word is its data pointer");
+    llvm::Constant*& value = strings[text];
+    if (value)
+        return value;
+    bl_str str;
+    bl_str_make(&str, text.data(), text.size());
+    llvm::Constant* words[2] = {builder.getInt64(str.words[0]), builder.getInt64(str.words[1])};
+    if (text.size() > BL_STR_SMALL_MAX) {
+        llvm::Constant* global = builder.CreateGlobalStringPtr(text, "str", 0, module.get());
+        words[0] = llvm::ConstantExpr::getPtrToInt(global, builder.getInt64Ty());
+    }
+    return value = llvm::ConstantStruct::get(stringType, words);
+}
+
+// Where the runtime finds the string str
+llvm::Value* LLVMCodeGen::stringAddress(llvm::Value* str) {
+    if (auto constant = llvm::dyn_cast<llvm::Constant>(str)) {
+        llvm::Constant*& global = stringGlobals[constant];
+        if (!global) {
+            auto var = new llvm::GlobalVariable(*module, stringType, true, llvm::GlobalValue::PrivateLinkage,
+                                                constant, "strval");
+            var->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+            var->setAlignment(llvm::Align(alignof(bl_str)));
+            global = var;
+        }
+        return global;
+    }
+    llvm::AllocaInst* slot = stringSlot("strarg");
+    builder.CreateAlignedStore(str, slot, slot->getAlign());
+    return slot;
+}
+
+// Room for a string in the entry block, so that code in a loop reuses it
+llvm::AllocaInst* LLVMCodeGen::stringSlot(const llvm::Twine& name) {
+    llvm::AllocaInst* slot = entryAlloca(stringType, name);
+    slot->setAlignment(llvm::Align(alignof(bl_str)));
+    return slot;
+}
+
+// Room for a value of type in the entry block of the function being generated
+llvm::AllocaInst* LLVMCodeGen::entryAlloca(llvm::Type* type, const llvm::Twine& name) {
+    llvm::BasicBlock& entry = function->getEntryBlock();
+    llvm::IRBuilder<> atEntry(&entry, entry.begin());
+    return atEntry.CreateAlloca(type, nullptr, name);
+}
+
+// A function of the runtime library (runtime.h); void without a result type
+llvm::FunctionCallee LLVMCodeGen::runtimeFunction(const char* name, llvm::ArrayRef<llvm::Type*> params,
+                                                  llvm::Type* result) {
+    return module->getOrInsertFunction(
+        name, llvm::FunctionType::get(result ? result : builder.getVoidTy(), params, false));
+}
+
+// ===== SSA construction =====
+
+void LLVMCodeGen::writeVariable(uint32_t slot, llvm::BasicBlock* block, llvm::Value* value) {
+    currentDef[{block, slot}] = value;
+}
+
+llvm::Value* LLVMCodeGen::readVariable(uint32_t slot, llvm::BasicBlock* block) {
+    auto found = currentDef.find({block, slot});
+    if (found != currentDef.end())
+        return found->second;
+    return readVariableRecursive(slot, block);
+}
+
+llvm::PHINode* LLVMCodeGen::newPhi(uint32_t slot, llvm::BasicBlock* block) {
+    llvm::IRBuilder<> atStart(block, block->begin());
+    return atStart.CreatePHI(slotTypes[slot], 2, slotNames[slot]);
+}
+
+// The paper recurses into the predecessors; a variable last assigned before
+// a long run of if statements would then take a level of recursion for each
+// one. Here the blocks are walked from a worklist instead, a phi goes on each
+// one with several predecessors on the way, and the phis get their operands
+// once all of those blocks have a definition, the earliest first.
+llvm::Value* LLVMCodeGen::readVariableRecursive(uint32_t slot, llvm::BasicBlock* block) {
+    llvm::SmallVector<llvm::BasicBlock*, 8> work{block};
+    llvm::SmallVector<llvm::BasicBlock*, 8> chain;
+    llvm::SmallVector<llvm::PHINode*, 8> phis;
+    while (!work.empty()) {
+        llvm::BasicBlock* at = work.pop_back_val();
+        chain.clear();
+        llvm::Value* value;
+        for (;;) {
+            auto found = currentDef.find({at, slot});
+            if (found != currentDef.end()) {
+                value = found->second;
+                break;
+            }
+            if (!sealedBlocks.count(at)) {
+                // A loop header whose back edge is not there yet
+                llvm::PHINode* phi = newPhi(slot, at);
+                incompletePhis[at].push_back({slot, phi});
+                value = phi;
+                chain.push_back(at);
+                break;
+            }
+            llvm::BasicBlock* last = lastDefinition(slot, at);
+            if (last != at) {
+                chain.push_back(at);
+                at = last;
+                continue;
+            }
+            // A block with a single predecessor has the value that one has
+            llvm::BasicBlock* pred = at->getSinglePredecessor();
+            if (!pred) {
+                // Recorded before the predecessors are looked at, so a
+                // cycle through this block ends at the phi
+                llvm::PHINode* phi = newPhi(slot, at);
+                phis.push_back(phi);
+                for (llvm::BasicBlock* from : llvm::predecessors(at))
+                    work.push_back(from);
+                value = phi;
+                chain.push_back(at);
+                break;
+            }
+            chain.push_back(at);
+            at = pred;
+        }
+        for (llvm::BasicBlock* b : chain)
+            writeVariable(slot, b, value);
+    }
+    for (auto phi = phis.rbegin(); phi != phis.rend(); ++phi)
+        addPhiOperands(slot, *phi);
+    return currentDef[{block, slot}];
+}
+
+llvm::Value* LLVMCodeGen::addPhiOperands(uint32_t slot, llvm::PHINode* phi) {
+    // All operands are read before any is added: a phi without operands
+    // uses nothing, so removing trivial phis further up cannot remove it.
+    // The handles follow the values read first if later reads replace them.
+    llvm::SmallVector<std::pair<llvm::BasicBlock*, llvm::WeakTrackingVH>, 4> incoming;
+    for (llvm::BasicBlock* pred : llvm::predecessors(phi->getParent()))
+        incoming.push_back({pred, readVariable(slot, pred)});
+    for (auto& [pred, value] : incoming)
+        phi->addIncoming(value, pred);
+    return tryRemoveTrivialPhi(phi);
+}
+
+// A phi that merges only itself and one other value is that value. Taking
+// it out can make phis that used it trivial in turn, which are handled from
+// a worklist for the same reason as above.
+llvm::Value* LLVMCodeGen::tryRemoveTrivialPhi(llvm::PHINode* phi) {
+    llvm::WeakTrackingVH result = phi;
+    llvm::SmallVector<llvm::WeakVH, 8> work{phi};
+    while (!work.empty()) {
+        llvm::WeakVH next = work.pop_back_val();
+        if (!next)
+            continue; // Removed already
+        llvm::PHINode* candidate = llvm::cast<llvm::PHINode>(next);
+        llvm::Value* same = nullptr;
+        bool trivial = true;
+        for (llvm::Value* op : candidate->incoming_values()) {
+            if (op == same || op == candidate)
+                continue;
+            if (same) {
+                trivial = false;
+                break;
+            }
+            same = op;
+        }
+        if (!trivial)
+            continue;
+        if (!same)
+            same = llvm::UndefValue::get(candidate->getType()); // Only reachable through itself, or not at all
+
+        for (llvm::User* user : candidate->users())
+            if (user != candidate && llvm::isa<llvm::PHINode>(user))
+                work.push_back(user);
+        candidate->replaceAllUsesWith(same);
+        candidate->eraseFromParent();
+    }
+    return result;
+}
+
+void LLVMCodeGen::startRegion(llvm::BasicBlock* block) {
+    places[block] = {static_cast<uint32_t>(regionStarts.size()), 0};
+    regionStarts.push_back(block);
+}
+
+// merge follows the if or loop that started at the end of before, and sets
+// whatever was declared or assigned in it
+void LLVMCodeGen::continueRegion(llvm::BasicBlock* merge, llvm::BasicBlock* before, size_t firstDefined) {
+    Place place = places.lookup(before);
+    places[merge] = {place.region, place.index + 1};
+    for (size_t i = firstDefined; i < defined.size(); ++i)
+        noteDefinition(defined[i], merge);
+}
+
+void LLVMCodeGen::noteDefinition(uint32_t slot, llvm::BasicBlock* block) {
+    Place place = places.lookup(block);
+    std::vector<std::pair<uint32_t, llvm::BasicBlock*>>& blocks = definitions[{place.region, slot}];
+    if (blocks.empty() || blocks.back().second != block)
+        blocks.push_back({place.index, block});
+}
+
+// The last block of block's region, up to block itself, that sets slot; the
+// block the region starts with if there is none
+llvm::BasicBlock* LLVMCodeGen::lastDefinition(uint32_t slot, llvm::BasicBlock* block) {
+    Place place = places.lookup(block);
+    auto found = definitions.find({place.region, slot});
+    if (found != definitions.end()) {
+        const auto& blocks = found->second;
+        auto after = std::upper_bound(blocks.begin(), blocks.end(), place.index,
+                                      [](uint32_t index, const auto& def) { return index < def.first; });
+        if (after != blocks.begin())
+            return std::prev(after)->second;
+    }
+    return regionStarts[place.region];
+}
+
+void LLVMCodeGen::sealBlock(llvm::BasicBlock* block) {
+    sealedBlocks.insert(block);
+    auto pending = incompletePhis.find(block);
+    if (pending == incompletePhis.end())
+        return;
+    std::vector<std::pair<uint32_t, llvm::PHINode*>> phis = std::move(pending->second);
+    incompletePhis.erase(pending);
+    for (auto& [slot, phi] : phis)
+        addPhiOperands(slot, phi);
+}
+
+llvm::Value* LLVMCodeGen::pop() {
+    llvm::Value* value = values.back();
+    values.pop_back();
+    return value;
+}
+
+// ===== Expressions =====
+
+const ASTNode* LLVMCodeGen::visitLiteral(const LiteralNode* lit, unsigned) {
+    llvm::Value* value = nullptr;
+    switch (lit->literalType) {
+        case LiteralNode::Type::Int:
+            value = llvm::ConstantInt::get(builder.getInt32Ty(), lit->intValue);
+            break;
+        case LiteralNode::Type::Float:
+            value = llvm::ConstantFP::get(builder.getFloatTy(), lit->floatValue);
+            break;
+        case LiteralNode::Type::Bool:
+            value = llvm::ConstantInt::get(builder.getInt1Ty(), lit->boolValue ? 1 : 0);
+            break;
+        case LiteralNode::Type::Char:
+            value = llvm::ConstantInt::get(builder.getInt8Ty(), lit->charValue);
+            break;
+        case LiteralNode::Type::String:
+            value = stringConstant(llvm::StringRef(lit->stringValue.data(), lit->stringValue.size()));
+            break;
+    }
+    values.push_back(value);
+    return nullptr;
+}
+
+const ASTNode* LLVMCodeGen::visitIdentifier(const IdentifierNode* ident, unsigned) {
+    values.push_back(readVariable(ident->slot, builder.GetInsertBlock()));
+    return nullptr;
+}
+
+const ASTNode* LLVMCodeGen::visitIndexExpr(const IndexExprNode* index, unsigned stage) {
+    if (stage == 0)
+        return index->index;
+    const ArrayVar& array = arrays[index->slot];
+    llvm::Value* at = pop();
+    checkIndex(at, array.type.length());
+    values.push_back(loadElements(array.data, at, 1, llvmType(array.type.element())));
+    return nullptr;
+}
+
+const ASTNode* LLVMCodeGen::visitBuiltinCall(const BuiltinCallNode* builtin, unsigned stage) {
+    if (builtin->funcName != "input")
+        return reduceArray(builtin, stage);
+
+    // Sema typed the call from its hint or from the variable it feeds; the
+    // runtime reader has an entry point per type, and a bool is read as an int
+    llvm::Value* value;
+    switch (builtin->type.kind()) {
+        case TypeKind::Float:
+            value = builder.CreateCall(runtimeFunction("bl_input_f32", {}, builder.getFloatTy()));
+            break;
+        case TypeKind::String: {
+            llvm::AllocaInst* result = stringSlot("input");
+            builder.CreateCall(runtimeFunction("bl_input_str", {result->getType()}), {result});
+            value = builder.CreateAlignedLoad(stringType, result, result->getAlign());
+            break;
+        }
+        case TypeKind::Bool: {
+            llvm::Value* val = builder.CreateCall(runtimeFunction("bl_input_i32", {}, builder.getInt32Ty()));
+            value = builder.CreateICmpNE(val, builder.getInt32(0));
+            break;
+        }
+        default:
+            value = builder.CreateCall(runtimeFunction("bl_input_i32", {}, builder.getInt32Ty()));
+            break;
+    }
+    values.push_back(value);
+    return nullptr;
+}
+
+// Operands first, left to right, then the operator
+const ASTNode* LLVMCodeGen::visitBinaryExpr(const BinaryExprNode* bin, unsigned stage) {
+    switch (stage) {
+        case 0:
+            return bin->left;
+        case 1:
+            return bin->right;
+    }
+    llvm::Value* R = pop();
+    llvm::Value* L = pop();
+    values.push_back(binaryOperation(bin, L, R));
+    return nullptr;
+}
+
+const ASTNode* LLVMCodeGen::visitUnaryExpr(const UnaryExprNode* un, unsigned stage) {
+    if (stage == 0)
+        return un->operand;
+    llvm::Value* val = pop();
+    values.push_back(unaryOperation(un, val));
+    return nullptr;
+}
+
+// An array literal that is an operand of an element-wise expression: its
+// elements in storage of their own, a constant global if they all are
+const ASTNode* LLVMCodeGen::visitArrayLiteral(const ArrayLiteralNode* literal, unsigned stage) {
+    if (stage < literal->elements.size())
+        return literal->elements[stage];
+    llvm::Type* elementType = llvmType(literal->type.element());
+    llvm::Value* data = constantArray(llvm::ArrayRef<llvm::Value*>(values).take_back(stage), elementType);
+    if (data) {
+        values.resize(values.size() - stage);
+    } else {
+        data = newArray(literal->type, "literal");
+        storeLiteral(data, stage, elementType);
+    }
+    values.push_back(data);
+    return nullptr;
+}
+
+llvm::Value* LLVMCodeGen::binaryOperation(const BinaryExprNode* bin, llvm::Value* L, llvm::Value* R) {
+    if (bin->left->type == TypeId::String)
+        return stringOperation(bin->op, L, R);
+    bool isFloat = bin->left->type == TypeId::Float; // operand type recorded by sema
+
+    switch (bin->op) {
+        case BinaryExprNode::Op::Add:
+            return isFloat ? builder.CreateFAdd(L, R) : builder.CreateAdd(L, R);
+        case BinaryExprNode::Op::Sub:
+            return isFloat ? builder.CreateFSub(L, R) : builder.CreateSub(L, R);
+        case BinaryExprNode::Op::Mul:
+            return isFloat ? builder.CreateFMul(L, R) : builder.CreateMul(L, R);
+        case BinaryExprNode::Op::Div:
+            return isFloat ? builder.CreateFDiv(L, R) : divideInt(L, R);
+
+        case BinaryExprNode::Op::Eq:
+            return isFloat ? builder.CreateFCmpUEQ(L, R) : builder.CreateICmpEQ(L, R);
+        case BinaryExprNode::Op::Neq:
+            return isFloat ? builder.CreateFCmpUNE(L, R) : builder.CreateICmpNE(L, R);
+        case BinaryExprNode::Op::Lt:
+            return isFloat ? builder.CreateFCmpULT(L, R) : builder.CreateICmpSLT(L, R);
+        case BinaryExprNode::Op::Gt:
+            return isFloat ? builder.CreateFCmpUGT(L, R) : builder.CreateICmpSGT(L, R);
+        case BinaryExprNode::Op::Leq:
+            return isFloat ? builder.CreateFCmpULE(L, R) : builder.CreateICmpSLE(L, R);
+        case BinaryExprNode::Op::Geq:
+            return isFloat ? builder.CreateFCmpUGE(L, R) : builder.CreateICmpSGE(L, R);
+
+        case BinaryExprNode::Op::And:
+            return builder.CreateAnd(L, R);
+        case BinaryExprNode::Op::Or:
+            return builder.CreateOr(L, R);
+    }
+    return nullptr;
+}
+
+// The runtime joins and compares strings
+llvm::Value* LLVMCodeGen::stringOperation(BinaryExprNode::Op op, llvm::Value* L, llvm::Value* R) {
+    llvm::Value* left = stringAddress(L);
+    llvm::Value* right = stringAddress(R);
+    llvm::Type* ptr = stringType->getPointerTo();
+    if (op == BinaryExprNode::Op::Add) {
+        llvm::AllocaInst* result = stringSlot("concat");
+        builder.CreateCall(runtimeFunction("bl_str_concat", {ptr, ptr, ptr}), {result, left, right});
+        return builder.CreateAlignedLoad(stringType, result, result->getAlign());
+    }
+
+    bool equality = op == BinaryExprNode::Op::Eq || op == BinaryExprNode::Op::Neq;
+    llvm::FunctionCallee callee =
+        runtimeFunction(equality ? "bl_str_equal" : "bl_str_compare", {ptr, ptr}, builder.getInt32Ty());
+    // Neither writes memory, so LLVM may share or hoist the calls
+    llvm::cast<llvm::Function>(callee.getCallee())->setOnlyReadsMemory();
+    llvm::Value* result = builder.CreateCall(callee, {left, right});
+    llvm::Value* zero = builder.getInt32(0);
+    switch (op) {
+        case BinaryExprNode::Op::Eq:  return builder.CreateICmpNE(result, zero);
+        case BinaryExprNode::Op::Neq: return builder.CreateICmpEQ(result, zero);
+        case BinaryExprNode::Op::Lt:  return builder.CreateICmpSLT(result, zero);
+        case BinaryExprNode::Op::Gt:  return builder.CreateICmpSGT(result, zero);
+        case BinaryExprNode::Op::Leq: return builder.CreateICmpSLE(result, zero);
+        case BinaryExprNode::Op::Geq: return builder.CreateICmpSGE(result, zero);
+        default:                      return nullptr; // Sema allows nothing else
+    }
+}
+
+llvm::Value* LLVMCodeGen::unaryOperation(const UnaryExprNode* un, llvm::Value* val) {
+    if (un->op == UnaryExprNode::Op::Minus)
+        return un->type == TypeId::Float ? builder.CreateFNeg(val) : builder.CreateNeg(val);
+    return builder.CreateNot(val);
+}
+
+// ===== Statements =====
+
+const ASTNode* LLVMCodeGen::visitDeclaration(const DeclarationNode* decl, unsigned stage) {
+    if (decl->declType.isArray()) {
+        if (stage == 0) {
+            llvm::StringRef name(decl->identifier.data(), decl->identifier.size());
+            arrays[decl->slot] = {newArray(decl->declType, name), decl->declType};
+        }
+        return storeArray(arrays[decl->slot].data, decl->expr, decl->declType, stage);
+    }
+    if (stage == 0) {
+        slotTypes[decl->slot] = llvmType(decl->declType);
+        slotNames[decl->slot] = llvm::StringRef(decl->identifier.data(), decl->identifier.size());
+        return decl->expr;
+    }
+    llvm::Value* initVal = pop();
+    writeVariable(decl->slot, builder.GetInsertBlock(), initVal);
+    noteDefinition(decl->slot, builder.GetInsertBlock());
+    defined.push_back(decl->slot);
+    return nullptr;
+}
+
+const ASTNode* LLVMCodeGen::visitPrintStmt(const PrintStmtNode* print, unsigned stage) {
+    if (stage == 0)
+        return print->expr;
+    llvm::Value* val = pop();
+    const char* entry;
+
+    switch (print->expr->type.kind()) {
+        case TypeKind::Float:
+            entry = floatFormat == FloatFormat::Fixed ? "bl_print_f32_fixed" : "bl_print_f32";
+            break;
+        case TypeKind::String:
+            val = stringAddress(val);
+            entry = "bl_print_str";
+            break;
+        case TypeKind::Char:
+            val = builder.CreateSExt(val, builder.getInt32Ty());
+            entry = "bl_print_char";
+            break;
+        case TypeKind::Bool:
+            val = builder.CreateZExt(val, builder.getInt32Ty());
+            entry = "bl_print_bool";
+            break;
+        default:
+            entry = "bl_print_i32";
+            break;
+    }
+
+    builder.CreateCall(runtimeFunction(entry, {val->getType()}), {val});
+    return nullptr;
+}
+
+const ASTNode* LLVMCodeGen::visitAssignment(const AssignmentNode* assign, unsigned stage) {
+    const ArrayVar& array = arrays[assign->slot];
+    if (assign->index) {
+        // Index and value first, then the check, in the order the VM does them
+        switch (stage) {
+            case 0:
+                return assign->index;
+            case 1:
+                return assign->value;
+        }
+        llvm::Value* element = pop();
+        llvm::Value* at = pop();
+        checkIndex(at, array.type.length());
+        storeElements(array.data, at, element);
+        return nullptr;
+    }
+    if (array.data)
+        return storeArray(array.data, assign->value, array.type, stage);
+    if (stage == 0)
+        return assign->value;
+    llvm::Value* val = pop();
+    writeVariable(assign->slot, builder.GetInsertBlock(), val);
+    noteDefinition(assign->slot, builder.GetInsertBlock());
+    defined.push_back(assign->slot);
+    return nullptr;
+}
+
+const ASTNode* LLVMCodeGen::visitIfStmt(const IfStmtNode* ifStmt, unsigned stage) {
+    switch (stage) {
+        case 0:
+            return ifStmt->condition;
+        case 1:
+            break;
+        case 2: {
+            Construct& construct = constructs.back();
+            branchTo(construct.merge);
+            if (!construct.next) {
+                finishIf();
+                return nullptr;
+            }
+            construct.next->insertInto(builder.GetInsertBlock()->getParent());
+            builder.SetInsertPoint(construct.next);
+            return ifStmt->elseBlock;
+        }
+        default:
+            branchTo(constructs.back().merge);
+            finishIf();
+            return nullptr;
+    }
+
+    llvm::Value* condVal = pop();
+    if (condVal->getType()->isIntegerTy() && condVal->getType()->getIntegerBitWidth() != 1) {
+        condVal = builder.CreateICmpNE(condVal, llvm::ConstantInt::get(condVal->getType(), 0));
+    }
+    llvm::BasicBlock* before = builder.GetInsertBlock();
+    size_t firstDefined = defined.size();
+    llvm::Function* func = before->getParent();
+
+    llvm::BasicBlock* thenBB = llvm::BasicBlock::Create(*context, "then", func);
+    llvm::BasicBlock* elseBB = ifStmt->elseBlock ? llvm::BasicBlock::Create(*context, "else") : nullptr;
+    llvm::BasicBlock* mergeBB = llvm::BasicBlock::Create(*context, "ifcont");
+
+    if (elseBB)
+        builder.CreateCondBr(condVal, thenBB, elseBB);
+    else
+        builder.CreateCondBr(condVal, thenBB, mergeBB);
+    sealBlock(thenBB);
+    startRegion(thenBB);
+    if (elseBB) {
+        sealBlock(elseBB);
+        startRegion(elseBB);
+    }
+
+    builder.SetInsertPoint(thenBB);
+    constructs.push_back({before, firstDefined, elseBB, mergeBB});
+    return ifStmt->thenBlock;
+}
+
+void LLVMCodeGen::finishIf() {
+    Construct construct = constructs.back();
+    constructs.pop_back();
+    construct.merge->insertInto(builder.GetInsertBlock()->getParent());
+    continueRegion(construct.merge, construct.before, construct.firstDefined);
+    sealBlock(construct.merge);
+    builder.SetInsertPoint(construct.merge);
+}
+
+// repeat runs its body before the first test, so it is already the
+// rotated loop LLVM's passes expect and needs no guard: the block before
+// it is the preheader, the body starts at the header, the condition block
+// is the only latch (the body's end and every skip branch to it) and the
+// exit is reached from inside the loop only.
+const ASTNode* LLVMCodeGen::visitRepeatStmt(const RepeatStmtNode* repeat, unsigned stage) {
+    switch (stage) {
+        case 0: {
+            llvm::BasicBlock* before = builder.GetInsertBlock();
+            size_t firstDefined = defined.size();
+            llvm::Function* func = before->getParent();
+
+            llvm::BasicBlock* loopBB = llvm::BasicBlock::Create(*context, "loop", func);
+            llvm::BasicBlock* condBB = llvm::BasicBlock::Create(*context, "loopcond");
+            llvm::BasicBlock* afterBB = llvm::BasicBlock::Create(*context, "afterloop");
+
+            branchTo(loopBB);
+            startRegion(loopBB);
+            builder.SetInsertPoint(loopBB);
+
+            loops.push_back({condBB, afterBB});
+            constructs.push_back({before, firstDefined, loopBB, afterBB});
+            return repeat->body;
+        }
+        case 1: {
+            llvm::BasicBlock* condBB = loops.back().next;
+            loops.pop_back();
+            branchTo(condBB);
+
+            // The body is complete, and with it every skip to the condition
+            condBB->insertInto(builder.GetInsertBlock()->getParent());
+            sealBlock(condBB);
+            startRegion(condBB);
+            builder.SetInsertPoint(condBB);
+            if (!llvm::pred_empty(condBB))
+                return repeat->condition;
+            builder.CreateUnreachable(); // The body always stops
+            finishRepeat();
+            return nullptr;
+        }
+    }
+
+    const Construct& construct = constructs.back();
+    llvm::Value* condVal = pop();
+    if (condVal->getType()->isIntegerTy() && condVal->getType()->getIntegerBitWidth() != 1) {
+        condVal = builder.CreateICmpNE(condVal, llvm::ConstantInt::get(condVal->getType(), 0));
+    }
+    llvm::BranchInst* backEdge = builder.CreateCondBr(condVal, construct.next, construct.merge);
+    if (llvm::MDNode* hints = loopMetadata())
+        backEdge->setMetadata(llvm::LLVMContext::MD_loop, hints);
+    finishRepeat();
+    return nullptr;
+}
+
+void LLVMCodeGen::finishRepeat() {
+    Construct construct = constructs.back();
+    constructs.pop_back();
+    sealBlock(construct.next);
+
+    construct.merge->insertInto(builder.GetInsertBlock()->getParent());
+    continueRegion(construct.merge, construct.before, construct.firstDefined);
+    sealBlock(construct.merge);
+    builder.SetInsertPoint(construct.merge);
+}
+
+// The llvm.loop node for a latch: distinct, first operand itself, then
+// one node per hint. Null with no hints set.
+llvm::MDNode* LLVMCodeGen::loopMetadata() {
+    llvm::SmallVector<llvm::Metadata*, 4> operands{nullptr};
+    auto hint = [&](const char* name, llvm::Constant* value) {
+        llvm::SmallVector<llvm::Metadata*, 2> fields{llvm::MDString::get(*context, name)};
+        if (value)
+            fields.push_back(llvm::ConstantAsMetadata::get(value));
+        operands.push_back(llvm::MDNode::get(*context, fields));
+    };
+
+    if (loopHints.unrollCount == 1)
+        hint("llvm.loop.unroll.disable", nullptr);
+    else if (loopHints.unrollCount > 1)
+        hint("llvm.loop.unroll.count", builder.getInt32(loopHints.unrollCount));
+
+    if (loopHints.vectorizeWidth == 1) {
+        hint("llvm.loop.vectorize.enable", builder.getFalse());
+    } else if (loopHints.vectorizeWidth > 1) {
+        hint("llvm.loop.vectorize.enable", builder.getTrue());
+        hint("llvm.loop.vectorize.width", builder.getInt32(loopHints.vectorizeWidth));
+    }
+
+    if (operands.size() == 1)
+        return nullptr;
+    llvm::MDNode* loopID = llvm::MDNode::getDistinct(*context, operands);
+    loopID->replaceOperandWith(0, loopID);
+    return loopID;
+}
+
+// ===== Parallel repeat =====
+
+// Adds the slots below `below` that node reads or sets, in the order they
+// come in: inside a parallel repeat's body, the variables from outside it
+static void outerSlots(const ASTNode* root, uint32_t below, llvm::SetVector<uint32_t>& slots) {
+    auto use = [&](uint32_t slot) {
+        if (slot < below)
+            slots.insert(slot);
+    };
+    // Children go on in reverse, so the first comes off next
+    auto pushAll = [](llvm::SmallVectorImpl<const ASTNode*>& pending, const NodeList& nodes) {
+        for (size_t i = nodes.size(); i-- > 0;)
+            pending.push_back(nodes[i]);
+    };
+    llvm::SmallVector<const ASTNode*, 32> pending{root};
+    while (!pending.empty()) {
+        const ASTNode* node = pending.pop_back_val();
+        switch (node->kind) {
+            case NodeKind::Identifier:
+                use(static_cast<const IdentifierNode*>(node)->slot);
+                break;
+            case NodeKind::IndexExpr: {
+                auto index = static_cast<const IndexExprNode*>(node);
+                use(index->slot);
+                pending.push_back(index->index);
+                break;
+            }
+            case NodeKind::BinaryExpr:
+                pending.push_back(static_cast<const BinaryExprNode*>(node)->right);
+                pending.push_back(static_cast<const BinaryExprNode*>(node)->left);
+                break;
+            case NodeKind::UnaryExpr:
+                pending.push_back(static_cast<const UnaryExprNode*>(node)->operand);
+                break;
+            case NodeKind::ArrayLiteral:
+                pushAll(pending, static_cast<const ArrayLiteralNode*>(node)->elements);
+                break;
+            case NodeKind::BuiltinCall:
+                pushAll(pending, static_cast<const BuiltinCallNode*>(node)->args);
+                break;
+            case NodeKind::Declaration:
+                pending.push_back(static_cast<const DeclarationNode*>(node)->expr);
+                break;
+            case NodeKind::Assignment: {
+                auto assign = static_cast<const AssignmentNode*>(node);
+                use(assign->slot);
+                pending.push_back(assign->value);
+                if (assign->index)
+                    pending.push_back(assign->index);
+                break;
+            }
+            case NodeKind::IfStmt: {
+                auto ifStmt = static_cast<const IfStmtNode*>(node);
+                if (ifStmt->elseBlock)
+                    pending.push_back(ifStmt->elseBlock);
+                pending.push_back(ifStmt->thenBlock);
+                pending.push_back(ifStmt->condition);
+                break;
+            }
+            case NodeKind::RepeatStmt:
+                pending.push_back(static_cast<const RepeatStmtNode*>(node)->condition);
+                pending.push_back(static_cast<const RepeatStmtNode*>(node)->body);
+                break;
+            case NodeKind::Block:
+                pushAll(pending, static_cast<const BlockNode*>(node)->statements);
+                break;
+            default:
+                break; // Sema keeps print, input and nested parallel loops out of the body
+        }
+    }
+}
+
+// The body becomes a function of its own, a bl_parallel_body running the
+// iterations of one chunk, which the runtime calls from its threads
+// (runtime.h). Variables from outside reach it through a context struct in
+// main's frame: scalars by value, as the body cannot change them, and arrays
+// by the address of their first element. A reduction is a variable of the
+// body that starts from 0, or 1 if it is multiplied into, and each chunk
+// leaves what it came to in its own slot of a partials array; main then
+// folds those into the variable in chunk order, so a float sum comes out
+// the same however the chunks were spread over the threads.
+const ASTNode* LLVMCodeGen::visitParallelRepeat(const ParallelRepeatNode* loop, unsigned stage) {
+    switch (stage) {
+        case 0:
+            return loop->start;
+        case 1:
+            return loop->end;
+        case 2:
+            break;
+        default:
+            finishParallelLoop(loop);
+            return nullptr;
+    }
+
+    ParallelLoop state;
+    state.end = pop();
+    state.begin = pop();
+    llvm::Type* i32 = builder.getInt32Ty();
+
+    for (const ASTNode* var : loop->reductions) {
+        uint32_t slot = static_cast<const IdentifierNode*>(var)->slot;
+        state.reductions.push_back(slot);
+        state.partialFields.push_back(slotTypes[slot]);
+    }
+    llvm::SetVector<uint32_t> used;
+    outerSlots(loop->body, loop->slot, used);
+    llvm::SmallVector<llvm::Type*, 8> contextFields;
+    llvm::SmallVector<llvm::Value*, 8> contextValues;
+    for (uint32_t slot : used) {
+        if (llvm::is_contained(state.reductions, slot))
+            continue;
+        llvm::Value* value = arrays[slot].data ? arrays[slot].data : readVariable(slot, builder.GetInsertBlock());
+        state.shared.push_back(slot);
+        contextFields.push_back(value->getType());
+        contextValues.push_back(value);
+    }
+    llvm::StructType* contextType = llvm::StructType::get(*context, contextFields);
+    state.partialType = llvm::StructType::get(*context, state.partialFields);
+
+    state.contextSlot = entryAlloca(contextType, "context");
+    for (size_t field = 0; field < contextValues.size(); ++field)
+        builder.CreateStore(contextValues[field], builder.CreateStructGEP(contextType, state.contextSlot, field));
+    state.partials = entryAlloca(llvm::ArrayType::get(state.partialType, BL_PARALLEL_CHUNKS), "partials");
+    llvm::AllocaInst* error = entryAlloca(llvm::ArrayType::get(i32, 2), "error");
+    state.errorPtr = builder.CreateConstInBoundsGEP2_32(error->getAllocatedType(), error, 0, 0);
+
+    startParallelBody(loop, state, contextType);
+    parallelLoops.push_back(std::move(state));
+    return loop->body;
+}
+
+// The body is generated: calls it, and goes on in main
+void LLVMCodeGen::finishParallelLoop(const ParallelRepeatNode* loop) {
+    ParallelLoop state = std::move(parallelLoops.back());
+    parallelLoops.pop_back();
+    finishParallelBody(loop, state);
+    llvm::ArrayRef<uint32_t> reductions = state.reductions;
+    llvm::ArrayRef<llvm::Type*> partialFields = state.partialFields;
+    llvm::AllocaInst* partials = state.partials;
+    llvm::Value* errorPtr = state.errorPtr;
+
+    llvm::Type* i32 = builder.getInt32Ty();
+    llvm::Type* bytePtr = llvm::PointerType::getUnqual(builder.getInt8Ty());
+    llvm::FunctionCallee run = runtimeFunction(
+        "bl_parallel_repeat", {state.body->getType(), bytePtr, i32, i32, bytePtr, i32, errorPtr->getType()}, i32);
+    llvm::Value* partialSize =
+        llvm::ConstantExpr::getTrunc(llvm::ConstantExpr::getSizeOf(state.partialType), i32);
+    llvm::Value* failed = builder.CreateCall(
+        run, {state.body, builder.CreateBitCast(state.contextSlot, bytePtr), state.begin, state.end,
+              builder.CreateBitCast(partials, bytePtr), partialSize, errorPtr});
+
+    // An error in the body is reported as main's own would be
+    llvm::BasicBlock* before = builder.GetInsertBlock();
+    llvm::BasicBlock* failedBB = llvm::BasicBlock::Create(*context, "parallelerror", function);
+    llvm::BasicBlock* doneBB = llvm::BasicBlock::Create(*context, "paralleldone", function);
+    builder.CreateCondBr(builder.CreateICmpEQ(failed, builder.getInt32(0)), doneBB, failedBB,
+                         llvm::MDBuilder(*context).createBranchWeights(1 << 20, 1));
+    builder.SetInsertPoint(failedBB);
+    llvm::Value* index = builder.CreateLoad(i32, errorPtr, "index");
+    llvm::Value* length = builder.CreateLoad(i32, builder.CreateConstInBoundsGEP1_32(i32, errorPtr, 1), "length");
+    builder.CreateCondBr(builder.CreateICmpEQ(length, builder.getInt32(BL_DIVISION_ERROR)), divisionError(),
+                         indexError());
+    badIndex->addIncoming(index, failedBB);
+    badLength->addIncoming(length, failedBB);
+    continueRegion(doneBB, before, defined.size());
+    sealBlock(doneBB);
+    builder.SetInsertPoint(doneBB);
+    if (reductions.empty())
+        return;
+
+    // v = v op partials[0].v op partials[1].v ..., for each reduction v
+    llvm::SmallVector<llvm::Value*, 4> initial;
+    for (uint32_t slot : reductions)
+        initial.push_back(readVariable(slot, doneBB));
+    llvm::Value* chunks =
+        builder.CreateCall(runtimeFunction("bl_parallel_chunks", {i32, i32}, i32), {state.begin, state.end});
+    llvm::BasicBlock* headBB = llvm::BasicBlock::Create(*context, "combine", function);
+    llvm::BasicBlock* chunkBB = llvm::BasicBlock::Create(*context, "combinechunk", function);
+    llvm::BasicBlock* combinedBB = llvm::BasicBlock::Create(*context, "combined", function);
+    builder.CreateBr(headBB);
+    builder.SetInsertPoint(headBB);
+    llvm::PHINode* chunk = builder.CreatePHI(i32, 2, "chunk");
+    chunk->addIncoming(builder.getInt32(0), doneBB);
+    llvm::SmallVector<llvm::PHINode*, 4> combined;
+    for (size_t r = 0; r < reductions.size(); ++r) {
+        combined.push_back(builder.CreatePHI(slotTypes[reductions[r]], 2, slotNames[reductions[r]]));
+        combined.back()->addIncoming(initial[r], doneBB);
+    }
+    builder.CreateCondBr(builder.CreateICmpSLT(chunk, chunks), chunkBB, combinedBB);
+
+    builder.SetInsertPoint(chunkBB);
+    for (size_t r = 0; r < reductions.size(); ++r) {
+        llvm::Value* at = builder.CreateInBoundsGEP(partials->getAllocatedType(), partials,
+                                                    {builder.getInt32(0), chunk, builder.getInt32(r)});
+        llvm::Value* partial = builder.CreateLoad(partialFields[r], at);
+        bool isFloat = partialFields[r]->isFloatTy();
+        llvm::Value* next = loop->isProduct(r)
+                                ? (isFloat ? builder.CreateFMul(combined[r], partial) : builder.CreateMul(combined[r], partial))
+                                : (isFloat ? builder.CreateFAdd(combined[r], partial) : builder.CreateAdd(combined[r], partial));
+        combined[r]->addIncoming(next, chunkBB);
+    }
+    chunk->addIncoming(builder.CreateAdd(chunk, builder.getInt32(1)), chunkBB);
+    builder.CreateBr(headBB);
+
+    builder.SetInsertPoint(combinedBB);
+    continueRegion(combinedBB, doneBB, defined.size());
+    sealBlock(combinedBB);
+    for (size_t r = 0; r < reductions.size(); ++r) {
+        writeVariable(reductions[r], combinedBB, combined[r]);
+        noteDefinition(reductions[r], combinedBB);
+        defined.push_back(reductions[r]);
+    }
+}
+
+// The bl_parallel_body of loop: its iterations from begin to end, which the
+// runtime never calls with an empty range, so the loop is rotated like a
+// repeat's. Generated with main's SSA and loop state set aside in `state`:
+// this starts the function, up to where the loop's body goes, and
+// finishParallelBody ends it and goes back to main.
+void LLVMCodeGen::startParallelBody(const ParallelRepeatNode* loop, ParallelLoop& state,
+                                    llvm::StructType* contextType) {
+    llvm::Type* i32 = builder.getInt32Ty();
+    llvm::Type* bytePtr = llvm::PointerType::getUnqual(builder.getInt8Ty());
+    llvm::FunctionType* type =
+        llvm::FunctionType::get(i32, {bytePtr, i32, i32, bytePtr, llvm::PointerType::getUnqual(i32)}, false);
+    llvm::Function* body =
+        llvm::Function::Create(type, llvm::Function::InternalLinkage, "parallel.body", module.get());
+    llvm::Argument* contextArg = body->getArg(0);
+    llvm::Argument* beginArg = body->getArg(1);
+    contextArg->setName("context");
+    beginArg->setName("begin");
+    body->getArg(2)->setName("end");
+    body->getArg(3)->setName("partial");
+    body->getArg(4)->setName("error");
+    state.body = body;
+
+    state.outerFunction = function;
+    state.outerBlock = builder.GetInsertBlock();
+    state.outerIndexError = indexErrorBB;
+    state.outerDivisionError = divisionErrorBB;
+    state.outerBadIndex = badIndex;
+    state.outerBadLength = badLength;
+    state.outerLoops = std::move(loops);
+    state.outerDefined = defined.size();
+    function = body;
+    indexErrorBB = nullptr;
+    badIndex = badLength = nullptr;
+    divisionErrorBB = nullptr;
+    errorOut = body->getArg(4);
+    loops.clear();
+
+    state.entry = llvm::BasicBlock::Create(*context, "entry", body);
+    builder.SetInsertPoint(state.entry);
+    sealBlock(state.entry);
+    startRegion(state.entry);
+    llvm::Value* contextPtr = builder.CreateBitCast(contextArg, contextType->getPointerTo());
+    for (size_t field = 0; field < state.shared.size(); ++field) {
+        uint32_t slot = state.shared[field];
+        llvm::Value* value = builder.CreateLoad(contextType->getElementType(field),
+                                                builder.CreateStructGEP(contextType, contextPtr, field),
+                                                slotNames[slot]);
+        if (arrays[slot].data) {
+            state.outerArrays.push_back(arrays[slot].data);
+            arrays[slot].data = value;
+        } else {
+            writeVariable(slot, state.entry, value);
+        }
+    }
+    for (size_t r = 0; r < state.reductions.size(); ++r) {
+        llvm::Type* varType = slotTypes[state.reductions[r]];
+        llvm::Constant* identity = loop->isProduct(r) ? (varType->isFloatTy() ? llvm::ConstantFP::get(varType, 1.0)
+                                                                               : llvm::ConstantInt::get(varType, 1))
+                                                      : llvm::Constant::getNullValue(varType);
+        writeVariable(state.reductions[r], state.entry, identity);
+    }
+    slotTypes[loop->slot] = i32;
+    slotNames[loop->slot] = loop->name;
+    writeVariable(loop->slot, state.entry, beginArg);
+
+    state.loopBB = llvm::BasicBlock::Create(*context, "iteration", body);
+    state.nextBB = llvm::BasicBlock::Create(*context, "nextiteration");
+    state.exitBB = llvm::BasicBlock::Create(*context, "chunkend");
+    branchTo(state.loopBB);
+    startRegion(state.loopBB);
+    builder.SetInsertPoint(state.loopBB);
+    loops.push_back({state.nextBB, state.exitBB});
+}
+
+void LLVMCodeGen::finishParallelBody(const ParallelRepeatNode* loop, ParallelLoop& state) {
+    llvm::Function* body = state.body;
+    llvm::BasicBlock* loopBB = state.loopBB;
+    llvm::BasicBlock* nextBB = state.nextBB;
+    llvm::BasicBlock* exitBB = state.exitBB;
+    loops.pop_back();
+    branchTo(nextBB);
+
+    nextBB->insertInto(body);
+    sealBlock(nextBB);
+    startRegion(nextBB);
+    builder.SetInsertPoint(nextBB);
+    if (llvm::pred_empty(nextBB)) {
+        builder.CreateUnreachable(); // Every iteration loops forever
+    } else {
+        llvm::Value* next = builder.CreateNSWAdd(readVariable(loop->slot, nextBB), builder.getInt32(1));
+        writeVariable(loop->slot, nextBB, next);
+        llvm::BranchInst* backEdge =
+            builder.CreateCondBr(builder.CreateICmpSLT(next, body->getArg(2)), loopBB, exitBB);
+        if (llvm::MDNode* hints = loopMetadata())
+            backEdge->setMetadata(llvm::LLVMContext::MD_loop, hints);
+    }
+    sealBlock(loopBB);
+
+    exitBB->insertInto(body);
+    continueRegion(exitBB, state.entry, state.outerDefined);
+    sealBlock(exitBB);
+    builder.SetInsertPoint(exitBB);
+    llvm::Value* partial = builder.CreateBitCast(body->getArg(3), state.partialType->getPointerTo());
+    for (size_t r = 0; r < state.reductions.size(); ++r)
+        builder.CreateStore(readVariable(state.reductions[r], exitBB),
+                            builder.CreateStructGEP(state.partialType, partial, r));
+    builder.CreateRet(builder.getInt32(0));
+    if (indexErrorBB)
+        indexErrorBB->insertInto(body);
+    if (divisionErrorBB)
+        divisionErrorBB->insertInto(body);
+
+    for (size_t field = 0, array = 0; field < state.shared.size(); ++field)
+        if (arrays[state.shared[field]].data)
+            arrays[state.shared[field]].data = state.outerArrays[array++];
+    function = state.outerFunction;
+    indexErrorBB = state.outerIndexError;
+    divisionErrorBB = state.outerDivisionError;
+    badIndex = state.outerBadIndex;
+    badLength = state.outerBadLength;
+    errorOut = nullptr;
+    loops = std::move(state.outerLoops);
+    defined.resize(state.outerDefined);
+    builder.SetInsertPoint(state.outerBlock);
+}
+
+// ===== Arrays =====
+
+// Storage for an array in the entry block, so that a declaration in a loop
+// reuses it; returns a pointer to the first element. Aligned for whole
+// chunks.
+llvm::Value* LLVMCodeGen::newArray(TypeId type, llvm::StringRef name) {
+    llvm::BasicBlock& entry = function->getEntryBlock();
+    llvm::IRBuilder<> atEntry(&entry, entry.begin());
+    llvm::Type* elementType = llvmType(type.element());
+    llvm::AllocaInst* storage = atEntry.CreateAlloca(llvm::ArrayType::get(elementType, type.length()), nullptr, name);
+    storage->setAlignment(llvm::Align(ArrayChunk * 4));
+    return atEntry.CreateBitCast(storage, llvm::PointerType::getUnqual(elementType));
+}
+
+// A private global holding values, if they are all constants; null if not
+llvm::Value* LLVMCodeGen::constantArray(llvm::ArrayRef<llvm::Value*> values, llvm::Type* elementType) {
+    llvm::SmallVector<llvm::Constant*, 16> elements;
+    for (llvm::Value* value : values) {
+        auto constant = llvm::dyn_cast<llvm::Constant>(value);
+        if (!constant)
+            return nullptr;
+        elements.push_back(constant);
+    }
+    llvm::ArrayType* type = llvm::ArrayType::get(elementType, elements.size());
+    auto global = new llvm::GlobalVariable(*module, type, true, llvm::GlobalValue::PrivateLinkage,
+                                           llvm::ConstantArray::get(type, elements), "array");
+    global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    global->setAlignment(llvm::Align(ArrayChunk * 4));
+    return builder.CreateBitCast(global, llvm::PointerType::getUnqual(elementType));
+}
+
+// Stores the value of an array expression, or copies of a scalar, into the
+// array starting at dest, as steps of the statement it is in
+const ASTNode* LLVMCodeGen::storeArray(llvm::Value* dest, const ASTNode* expr, TypeId type, unsigned stage) {
+    if (auto literal = dynCast<ArrayLiteralNode>(expr)) {
+        // Every element is computed before any is stored, so that
+        // a = [a[1], a[0]] swaps
+        if (stage < literal->elements.size())
+            return literal->elements[stage];
+        llvm::Type* elementType = llvmType(type.element());
+        if (llvm::Value* constant = constantArray(llvm::ArrayRef<llvm::Value*>(values).take_back(stage), elementType)) {
+            llvm::Align align(ArrayChunk * 4);
+            builder.CreateMemCpy(dest, align, constant, align, stage * 4);
+            values.resize(values.size() - stage);
+            return nullptr;
+        }
+        storeLiteral(dest, stage, elementType);
+        return nullptr;
+    }
+
+    uint32_t chunks = type.length() / ArrayChunk;
+    if (const ASTNode* leaf = prepareLeaves(expr, chunks > 0, stage))
+        return leaf;
+    forEachChunk(chunks, nullptr, [&](llvm::Value* index, llvm::Value*) {
+        storeElements(dest, index, elementChunk(expr, index, ArrayChunk));
+        return nullptr;
+    });
+    for (uint32_t i = chunks * ArrayChunk; i < type.length(); ++i)
+        storeElements(dest, builder.getInt32(i), elementChunk(expr, builder.getInt32(i), 1));
+    return nullptr;
+}
+
+// Stores the last `count` values generated, the elements of a literal,
+// into the array starting at dest, and drops them
+void LLVMCodeGen::storeLiteral(llvm::Value* dest, size_t count, llvm::Type* elementType) {
+    size_t first = values.size() - count;
+    for (size_t i = 0; i < count; ++i)
+        storeElements(dest, builder.getInt32(i), values[first + i]);
+    values.resize(first);
+}
+
+// sum, min or max of an array expression. Integer sums and every min and
+// max keep a chunk of partial results and reduce it at the end. A float sum
+// adds the elements strictly in order instead (an ordered vector.reduce.fadd
+// per chunk), so that it rounds the same way as the bytecode VM's loop.
+const ASTNode* LLVMCodeGen::reduceArray(const BuiltinCallNode* call, unsigned stage) {
+    const ASTNode* array = call->args[0];
+    TypeId type = array->type;
+    uint32_t chunks = type.length() / ArrayChunk;
+    if (const ASTNode* leaf = prepareLeaves(array, chunks > 0, stage))
+        return leaf;
+    bool isFloat = type.element() == TypeId::Float;
+    llvm::Type* elementType = llvmType(type.element());
+    enum { Sum, Min, Max } kind = call->funcName == "sum" ? Sum : call->funcName == "min" ? Min : Max;
+
+    llvm::Value* identity;
+    if (kind == Sum)
+        identity = llvm::Constant::getNullValue(elementType);
+    else if (isFloat)
+        identity = llvm::ConstantFP::getInfinity(elementType, kind == Max);
+    else
+        identity = builder.getInt32(kind == Min ? INT32_MAX : INT32_MIN);
+
+    // Works on scalars and on chunks alike
+    auto combine = [&](llvm::Value* a, llvm::Value* b) -> llvm::Value* {
+        switch (kind) {
+            case Sum: return isFloat ? builder.CreateFAdd(a, b) : builder.CreateAdd(a, b);
+            case Min: return isFloat ? builder.CreateMinNum(a, b) : builder.CreateBinaryIntrinsic(llvm::Intrinsic::smin, a, b);
+            case Max: return isFloat ? builder.CreateMaxNum(a, b) : builder.CreateBinaryIntrinsic(llvm::Intrinsic::smax, a, b);
+        }
+        return nullptr;
+    };
+
+    llvm::Value* result = identity;
+    if (chunks > 0 && isFloat && kind == Sum) {
+        result = forEachChunk(chunks, identity, [&](llvm::Value* index, llvm::Value* sum) {
+            return builder.CreateFAddReduce(sum, elementChunk(array, index, ArrayChunk));
+        });
+    } else if (chunks > 0) {
+        llvm::Value* partial = forEachChunk(chunks, builder.CreateVectorSplat(ArrayChunk, identity),
+                                            [&](llvm::Value* index, llvm::Value* partial) {
+                                                return combine(partial, elementChunk(array, index, ArrayChunk));
+                                            });
+        switch (kind) {
+            case Sum: result = builder.CreateAddReduce(partial); break;
+            case Min: result = isFloat ? builder.CreateFPMinReduce(partial) : builder.CreateIntMinReduce(partial, true); break;
+            case Max: result = isFloat ? builder.CreateFPMaxReduce(partial) : builder.CreateIntMaxReduce(partial, true); break;
+        }
+    }
+    for (uint32_t i = chunks * ArrayChunk; i < type.length(); ++i)
+        result = combine(result, elementChunk(array, builder.getInt32(i), 1));
+    values.push_back(result);
+    return nullptr;
+}
+
+// Evaluates the leaves of an element-wise expression, once and in order,
+// before any element is: array operands to their storage, anything else
+// (a variable, an element, a reduction) to a scalar. Steps of the node the
+// expression is in: returns the next leaf to generate, or nullptr once
+// arrayLeaves has them all.
+const ASTNode* LLVMCodeGen::prepareLeaves(const ASTNode* expr, bool chunked, unsigned stage) {
+    if (stage == 0) {
+        // Right to left onto pendingLeaves, so the first comes off first
+        pendingLeaves.push_back(nullptr);
+        scratch.push_back(expr);
+        while (!scratch.empty()) {
+            const ASTNode* node = scratch.back();
+            scratch.pop_back();
+            if (!node->type.isArray() || node->kind == NodeKind::ArrayLiteral)
+                pendingLeaves.push_back(node);
+            else if (auto ident = dynCast<IdentifierNode>(node))
+                arrayLeaves[node] = arrays[ident->slot].data;
+            else if (auto bin = dynCast<BinaryExprNode>(node)) {
+                scratch.push_back(bin->left);
+                scratch.push_back(bin->right);
+            } else if (auto un = dynCast<UnaryExprNode>(node))
+                scratch.push_back(un->operand);
+        }
+    } else {
+        const ASTNode* leaf = pendingLeaves.back();
+        pendingLeaves.pop_back();
+        llvm::Value* value = pop();
+        arrayLeaves[leaf] = value;
+        if (chunked && !leaf->type.isArray())
+            arraySplats[leaf] = builder.CreateVectorSplat(ArrayChunk, value);
+    }
+    if (const ASTNode* leaf = pendingLeaves.back())
+        return leaf;
+    pendingLeaves.pop_back();
+    return nullptr;
+}
+
+// Elements [index, index + width) of a prepared element-wise expression: a
+// vector of width elements, or a scalar for width 1
+llvm::Value* LLVMCodeGen::elementChunk(const ASTNode* expr, llvm::Value* index, unsigned width) {
+    walkTree(expr, [&](const ASTNode* node, unsigned stage) -> const ASTNode* {
+        if (!node->type.isArray()) {
+            values.push_back(width > 1 ? arraySplats.lookup(node) : arrayLeaves.lookup(node));
+            return nullptr;
+        }
+        bool isFloat = node->type.element() == TypeId::Float;
+        if (auto bin = dynCast<BinaryExprNode>(node)) {
+            if (stage < 2)
+                return stage == 0 ? bin->left : bin->right;
+            llvm::Value* R = pop();
+            llvm::Value* L = pop();
+            switch (bin->op) {
+                case BinaryExprNode::Op::Add: values.push_back(isFloat ? builder.CreateFAdd(L, R) : builder.CreateAdd(L, R)); break;
+                case BinaryExprNode::Op::Sub: values.push_back(isFloat ? builder.CreateFSub(L, R) : builder.CreateSub(L, R)); break;
+                case BinaryExprNode::Op::Mul: values.push_back(isFloat ? builder.CreateFMul(L, R) : builder.CreateMul(L, R)); break;
+                default: values.push_back(isFloat ? builder.CreateFDiv(L, R) : divideInt(L, R)); break;
+            }
+        } else if (auto un = dynCast<UnaryExprNode>(node)) {
+            if (stage == 0)
+                return un->operand;
+            llvm::Value* operand = pop();
+            values.push_back(isFloat ? builder.CreateFNeg(operand) : builder.CreateNeg(operand));
+        } else {
+            values.push_back(loadElements(arrayLeaves.lookup(node), index, width, llvmType(node->type.element())));
+        }
+        return nullptr;
+    });
+    return pop();
+}
+
+llvm::Value* LLVMCodeGen::loadElements(llvm::Value* array, llvm::Value* index, unsigned width,
+                                       llvm::Type* elementType) {
+    llvm::Value* at = builder.CreateInBoundsGEP(elementType, array, index);
+    if (width == 1)
+        return builder.CreateAlignedLoad(elementType, at, llvm::Align(4));
+    llvm::Type* chunkType = llvm::FixedVectorType::get(elementType, width);
+    return builder.CreateAlignedLoad(chunkType, builder.CreateBitCast(at, llvm::PointerType::getUnqual(chunkType)),
+                                     llvm::Align(width * 4));
+}
+
+// value is one element or a chunk of them
+void LLVMCodeGen::storeElements(llvm::Value* array, llvm::Value* index, llvm::Value* value) {
+    llvm::Type* type = value->getType();
+    llvm::Type* elementType = type->getScalarType();
+    llvm::Value* at = builder.CreateInBoundsGEP(elementType, array, index);
+    if (type == elementType) {
+        builder.CreateAlignedStore(value, at, llvm::Align(4));
+        return;
+    }
+    unsigned width = llvm::cast<llvm::FixedVectorType>(type)->getNumElements();
+    builder.CreateAlignedStore(value, builder.CreateBitCast(at, llvm::PointerType::getUnqual(type)),
+                               llvm::Align(width * 4));
+}
+
+// Runs body for chunks 0 .. chunks - 1, passing the index of the first
+// element of each and threading carried (a reduction's partial result, or
+// null) through. A few chunks are generated one after another; more make
+// a loop of its own, which the body must not read variables in: its blocks
+// are not part of the SSA construction, so prepareLeaves does that first.
+llvm::Value* LLVMCodeGen::forEachChunk(uint32_t chunks, llvm::Value* carried,
+                                       llvm::function_ref<llvm::Value*(llvm::Value*, llvm::Value*)> body) {
+    constexpr uint32_t MaxStraightChunks = 4;
+    if (chunks <= MaxStraightChunks) {
+        for (uint32_t i = 0; i < chunks; ++i)
+            carried = body(builder.getInt32(i * ArrayChunk), carried);
+        return carried;
+    }
+
+    llvm::BasicBlock* before = builder.GetInsertBlock();
+    llvm::BasicBlock* loopBB = llvm::BasicBlock::Create(*context, "chunk", function);
+    llvm::BasicBlock* doneBB = llvm::BasicBlock::Create(*context, "chunkdone");
+    builder.CreateBr(loopBB);
+    builder.SetInsertPoint(loopBB);
+    llvm::PHINode* index = builder.CreatePHI(builder.getInt32Ty(), 2, "i");
+    index->addIncoming(builder.getInt32(0), before);
+    llvm::PHINode* partial = nullptr;
+    if (carried) {
+        partial = builder.CreatePHI(carried->getType(), 2);
+        partial->addIncoming(carried, before);
+    }
+    // A region of its own, for the blocks of any division checks in body;
+    // body reads no variables, its leaves being prepared before the loop
+    startRegion(loopBB);
+    llvm::Value* next = body(index, partial);
+    llvm::BasicBlock* latch = builder.GetInsertBlock();
+    llvm::Value* nextIndex = builder.CreateNUWAdd(index, builder.getInt32(ArrayChunk));
+    index->addIncoming(nextIndex, latch);
+    if (partial)
+        partial->addIncoming(next, latch);
+    builder.CreateCondBr(builder.CreateICmpULT(nextIndex, builder.getInt32(chunks * ArrayChunk)), loopBB, doneBB);
+
+    // Straight on from before as far as the variables are concerned
+    doneBB->insertInto(function);
+    continueRegion(doneBB, before, defined.size());
+    sealBlock(doneBB);
+    builder.SetInsertPoint(doneBB);
+    return partial ? next : nullptr;
+}
+
+// Branches to the index error block unless index is below length. A
+// constant index in range (sema rejects the others it sees) needs no check.
+void LLVMCodeGen::checkIndex(llvm::Value* index, uint32_t length) {
+    if (auto constant = llvm::dyn_cast<llvm::ConstantInt>(index))
+        if (constant->getZExtValue() < length)
+            return;
+
+    llvm::BasicBlock* errorBB = indexError();
+    llvm::BasicBlock* before = builder.GetInsertBlock();
+    llvm::BasicBlock* inBoundsBB = llvm::BasicBlock::Create(*context, "inbounds", function);
+    llvm::Value* inBounds = builder.CreateICmpULT(index, builder.getInt32(length));
+    builder.CreateCondBr(inBounds, inBoundsBB, errorBB,
+                         llvm::MDBuilder(*context).createBranchWeights(1 << 20, 1));
+    badIndex->addIncoming(index, before);
+    badLength->addIncoming(builder.getInt32(length), before);
+
+    continueRegion(inBoundsBB, before, defined.size());
+    sealBlock(inBoundsBB);
+    builder.SetInsertPoint(inBoundsBB);
+}
+
+// The block an out-of-range index goes to, with phis for the index and the
+// length; created on first use, and placed last when the function is done.
+// main reports the error and returns 1. The body of a parallel repeat hands
+// both back to the runtime instead, which passes on the first chunk's.
+llvm::BasicBlock* LLVMCodeGen::indexError() {
+    if (indexErrorBB)
+        return indexErrorBB;
+    llvm::Type* i32 = builder.getInt32Ty();
+    indexErrorBB = llvm::BasicBlock::Create(*context, "indexerror");
+    llvm::IRBuilder<> atError(indexErrorBB);
+    badIndex = atError.CreatePHI(i32, 2, "index");
+    badLength = atError.CreatePHI(i32, 2, "length");
+    if (errorOut) {
+        atError.CreateAlignedStore(badIndex, errorOut, llvm::Align(4));
+        atError.CreateAlignedStore(badLength, atError.CreateConstInBoundsGEP1_32(i32, errorOut, 1), llvm::Align(4));
+    } else {
+        atError.CreateCall(runtimeFunction("bl_array_index_error", {i32, i32}), {badIndex, badLength});
+        atError.CreateCall(runtimeFunction("bl_flush"));
+    }
+    atError.CreateRet(builder.getInt32(1));
+    return indexErrorBB;
+}
+
+// Integer L / R, scalars or vectors of them. A zero divisor, in any lane,
+// goes to the division error block, as the VM's DivInt stops the program;
+// a divisor of -1 negates, wrapping INT_MIN / -1 to INT_MIN like DivInt
+// instead of trapping. A constant divisor that is neither needs no check.
+llvm::Value* LLVMCodeGen::divideInt(llvm::Value* L, llvm::Value* R) {
+    llvm::Constant* divisor = llvm::dyn_cast<llvm::Constant>(R);
+    if (divisor && divisor->getType()->isVectorTy())
+        divisor = divisor->getSplatValue();
+    if (auto constant = llvm::dyn_cast_or_null<llvm::ConstantInt>(divisor))
+        if (!constant->isZero() && !constant->isMinusOne())
+            return builder.CreateSDiv(L, R);
+
+    llvm::Value* isZero = builder.CreateICmpEQ(R, llvm::Constant::getNullValue(R->getType()));
+    if (R->getType()->isVectorTy())
+        isZero = builder.CreateOrReduce(isZero);
+    llvm::BasicBlock* errorBB = divisionError();
+    llvm::BasicBlock* before = builder.GetInsertBlock();
+    llvm::BasicBlock* nonZeroBB = llvm::BasicBlock::Create(*context, "nonzero", function);
+    builder.CreateCondBr(isZero, errorBB, nonZeroBB, llvm::MDBuilder(*context).createBranchWeights(1, 1 << 20));
+    continueRegion(nonZeroBB, before, defined.size());
+    sealBlock(nonZeroBB);
+    builder.SetInsertPoint(nonZeroBB);
+
+    llvm::Value* isMinusOne = builder.CreateICmpEQ(R, llvm::Constant::getAllOnesValue(R->getType()));
+    llvm::Value* divisorOrOne = builder.CreateSelect(isMinusOne, llvm::ConstantInt::get(R->getType(), 1), R);
+    return builder.CreateSelect(isMinusOne, builder.CreateNeg(L), builder.CreateSDiv(L, divisorOrOne));
+}
+
+// The block a division by zero goes to; created on first use, and placed
+// last when the function is done. main reports the error and returns 1;
+// the body of a parallel repeat returns it to the runtime as an index
+// error would, with BL_DIVISION_ERROR for the length.
+llvm::BasicBlock* LLVMCodeGen::divisionError() {
+    if (divisionErrorBB)
+        return divisionErrorBB;
+    llvm::Type* i32 = builder.getInt32Ty();
+    divisionErrorBB = llvm::BasicBlock::Create(*context, "divisionerror");
+    llvm::IRBuilder<> atError(divisionErrorBB);
+    if (errorOut) {
+        atError.CreateAlignedStore(builder.getInt32(0), errorOut, llvm::Align(4));
+        atError.CreateAlignedStore(builder.getInt32(BL_DIVISION_ERROR),
+                                   atError.CreateConstInBoundsGEP1_32(i32, errorOut, 1), llvm::Align(4));
+    } else {
+        atError.CreateCall(runtimeFunction("bl_division_error"));
+        atError.CreateCall(runtimeFunction("bl_flush"));
+    }
+    atError.CreateRet(builder.getInt32(1));
+    return divisionErrorBB;
+}
+
+// Ends the current block with a jump to target. Code after a stop or skip
+// sits in a block nothing reaches; it ends in unreachable instead, so it
+// adds no edge, and no undefined values to the target's phis.
+void LLVMCodeGen::branchTo(llvm::BasicBlock* target) {
+    llvm::BasicBlock* block = builder.GetInsertBlock();
+    if (block != &block->getParent()->getEntryBlock() && llvm::pred_empty(block))
+        builder.CreateUnreachable();
+    else
+        builder.CreateBr(target);
+}
+
+// stop/skip end the current block; anything after them in the source
+// goes into a fresh block with no predecessors, which LLVM drops.
+void LLVMCodeGen::branchOut(llvm::BasicBlock* target) {
+    branchTo(target);
+    llvm::Function* func = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* rest = llvm::BasicBlock::Create(*context, "unreachable", func);
+    sealBlock(rest);
+    startRegion(rest);
+    builder.SetInsertPoint(rest);
+}
+
+const ASTNode* LLVMCodeGen::visitBreak(const BreakNode*, unsigned) {
+    branchOut(loops.back().exit);
+    return nullptr;
+}
+
+const ASTNode* LLVMCodeGen::visitContinue(const ContinueNode*, unsigned) {
+    branchOut(loops.back().next);
+    return nullptr;
+}
+
+const ASTNode* LLVMCodeGen::visitBlock(const BlockNode* block, unsigned stage) {
+    return stage < block->statements.size() ? block->statements[stage] : nullptr;
+}
+
+const ASTNode* LLVMCodeGen::visitProgram(const ProgramNode* root, unsigned stage) {
+    return stage < root->statements.size() ? root->statements[stage] : nullptr;
+}
@@ -1,33 +1,239 @@
-// llvm_codegen.h
-#pragma once
-
-#include "ast.h"
-#include <llvm/IR/IRBuilder.h>
-#include <llvm/IR/LLVMContext.h>
-#include <llvm/IR/Module.h>
-#include <llvm/IR/Verifier.h>
-#include <llvm/Support/raw_ostream.h>
-
-#include <memory>
-#include <map>
-#include <string>
-
-class LLVMCodeGen {
-public:
-    LLVMCodeGen();
-    void generate(const ProgramNode* root);         // Build LLVM IR from AST
-    void dumpIR(const std::string& filename);       // Save IR to file (e.g. output.ll)
-
-private:
-    llvm::LLVMContext context;
-    llvm::IRBuilder<> builder;
-    std::unique_ptr<llvm::Module> module;
-    llvm::Function* mainFunc;
-    llvm::BasicBlock* currentBlock;
-
-    std::map<std::string, llvm::AllocaInst*> namedValues;
-
-    // Helpers
-    llvm::Value* generateExpr(const ASTNode* expr);
-    void generateStmt(const ASTNode* stmt);
-};
+// llvm_codegen.h
+#pragma once
+
+#include "ast.h"
+#include "ast_visitor.h"
+#include "optimizer.h"
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ValueHandle.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class LLVMCodeGen : private ConstASTVisitor<LLVMCodeGen, const ASTNode*, unsigned> {
+public:
+    explicit LLVMCodeGen(const LoopHints& loopHints = {}, FloatFormat floatFormat = FloatFormat::Shortest);
+    void generate(const ProgramNode* root);         // Build LLVM IR from AST
+    bool verify(llvm::raw_ostream& errors);         // False, with the reasons, if the IR is malformed
+    void dumpIR(const std::string& filename);       // Save IR to file (e.g. output.ll)
+    void printIR(llvm::raw_ostream& out);           // Textual IR to any stream
+
+    llvm::Module& getModule() { return *module; }
+
+    // Hand the generated module (and the context it lives in) to another
+    // owner such as the JIT. The generator must not be used afterwards.
+    std::unique_ptr<llvm::Module> takeModule() { return std::move(module); }
+    std::unique_ptr<llvm::LLVMContext> takeContext() { return std::move(context); }
+
+private:
+    std::unique_ptr<llvm::LLVMContext> context;
+    llvm::IRBuilder<> builder;
+    std::unique_ptr<llvm::Module> module;
+    llvm::Function* mainFunc;
+    llvm::Function* function;       // Being generated: main, or the body of a parallel repeat
+    llvm::BasicBlock* currentBlock;
+    LoopHints loopHints;
+    FloatFormat floatFormat;
+
+    // Variables are SSA values from the start, built on the fly as in Braun
+    // et al., "Simple and Efficient Construction of Static Single Assignment
+    // Form": every block remembers the value last assigned to each slot, and
+    // a read without one there asks the predecessors, with a phi where they
+    // may disagree. A block is sealed once all its predecessors exist; reads
+    // in it before that leave phis to be completed when it is.
+    std::vector<llvm::Type*> slotTypes;        // indexed by the declaration slot sema assigned
+    std::vector<llvm::StringRef> slotNames;
+    llvm::DenseMap<std::pair<llvm::BasicBlock*, uint32_t>, llvm::WeakTrackingVH> currentDef;
+    llvm::DenseMap<llvm::BasicBlock*, std::vector<std::pair<uint32_t, llvm::PHINode*>>> incompletePhis;
+    llvm::SmallPtrSet<llvm::BasicBlock*, 32> sealedBlocks;
+
+    // The paper walks back block by block. The main program is one long
+    // function, though, and a variable read after a run of if statements
+    // would be looked up in every block since it was last set, for each
+    // variable: quadratic in the length of the program. The statements of
+    // one block list form a region, its blocks being the one it starts with
+    // and the one after each if or loop in it. Each region keeps, per slot,
+    // where in it the slot was set, an if or loop counting as setting what
+    // it assigns inside, so a read jumps straight to the last of those or,
+    // with none, to the start of the region.
+    struct Place {
+        uint32_t region;
+        uint32_t index; // 0 for the block the region starts with
+    };
+    llvm::DenseMap<llvm::BasicBlock*, Place> places;
+    std::vector<llvm::BasicBlock*> regionStarts;
+    llvm::DenseMap<std::pair<uint32_t, uint32_t>, std::vector<std::pair<uint32_t, llvm::BasicBlock*>>>
+        definitions;                 // (region, slot) -> (index, block), in order
+    std::vector<uint32_t> defined;   // slots declared or assigned so far, in order
+
+    // Arrays are not SSA values but memory: each declaration, and each
+    // array literal an expression reads, gets an alloca in the entry block.
+    // Element-wise expressions and reductions run over it ArrayChunk
+    // elements at a time as LLVM vectors, so the arithmetic is SSE/AVX code
+    // even at -O0, and indexing is a load or store of one element.
+    static constexpr unsigned ArrayChunk = 8; // 256 bits of i32 or float
+    struct ArrayVar {
+        llvm::Value* data = nullptr; // First element; null for scalars
+        TypeId type;
+    };
+    std::vector<ArrayVar> arrays;    // indexed by slot
+    // Per leaf of the element-wise expression being generated: the first
+    // element of an array operand, or a scalar that stands for copies of
+    // itself, and that scalar splatted to a chunk
+    llvm::DenseMap<const ASTNode*, llvm::Value*> arrayLeaves;
+    llvm::DenseMap<const ASTNode*, llvm::Value*> arraySplats;
+    // Where an out-of-range index goes in the function being generated; see
+    // indexError
+    llvm::BasicBlock* indexErrorBB = nullptr;
+    llvm::PHINode* badIndex = nullptr;
+    llvm::PHINode* badLength = nullptr;
+    llvm::Value* errorOut = nullptr; // A parallel repeat body's error argument; null in main
+    llvm::BasicBlock* divisionErrorBB = nullptr; // Where an integer division by zero goes
+
+    // Strings are values of the runtime's bl_str, two i64 words that hold
+    // short text inline and otherwise point at it (runtime.h). The runtime
+    // takes them by pointer: a literal's is a constant global of its own,
+    // and any other is stored to an entry-block slot first.
+    llvm::StructType* stringType;
+    llvm::StringMap<llvm::Constant*> strings;                       // literal text -> value
+    llvm::DenseMap<llvm::Constant*, llvm::Constant*> stringGlobals; // literal value -> its global
+
+    // Branch targets of the enclosing repeat loops, innermost last
+    struct LoopTargets {
+        llvm::BasicBlock* next; // skip: evaluate the condition again
+        llvm::BasicBlock* exit; // stop
+    };
+    std::vector<LoopTargets> loops;
+
+    // The tree is generated as steps of walkTree (see the visit methods),
+    // so what a node needs from one step to the next is kept here
+    std::vector<llvm::Value*> values; // of the expressions generated, innermost last
+    // An if or repeat whose arms or body are being generated
+    struct Construct {
+        llvm::BasicBlock* before; // where it started
+        size_t firstDefined;      // defined.size() there
+        llvm::BasicBlock* next;   // the else arm, or the loop header
+        llvm::BasicBlock* merge;  // where it ends
+    };
+    std::vector<Construct> constructs;
+    // A parallel repeat whose body is being generated: what main goes on
+    // with after it, and main's state, set aside meanwhile
+    struct ParallelLoop {
+        llvm::Value* begin;
+        llvm::Value* end;
+        llvm::SmallVector<uint32_t, 4> reductions;
+        llvm::SmallVector<llvm::Type*, 4> partialFields;
+        llvm::SmallVector<uint32_t, 8> shared;
+        llvm::StructType* partialType;
+        llvm::AllocaInst* contextSlot;
+        llvm::AllocaInst* partials;
+        llvm::Value* errorPtr;
+        llvm::Function* body;
+        llvm::BasicBlock* entry;
+        llvm::BasicBlock* loopBB;
+        llvm::BasicBlock* nextBB;
+        llvm::BasicBlock* exitBB;
+
+        llvm::Function* outerFunction;
+        llvm::BasicBlock* outerBlock;
+        llvm::BasicBlock* outerIndexError;
+        llvm::BasicBlock* outerDivisionError;
+        llvm::PHINode* outerBadIndex;
+        llvm::PHINode* outerBadLength;
+        std::vector<LoopTargets> outerLoops;
+        size_t outerDefined;
+        llvm::SmallVector<llvm::Value*, 4> outerArrays;
+    };
+    std::vector<ParallelLoop> parallelLoops;
+    // Leaves still to generate, the next on top, above a nullptr for each
+    // element-wise expression they belong to; see prepareLeaves
+    std::vector<const ASTNode*> pendingLeaves;
+    std::vector<const ASTNode*> scratch;
+
+    // Helpers
+    llvm::Type* llvmType(TypeId type);
+    llvm::Value* pop();
+    llvm::Value* binaryOperation(const BinaryExprNode* bin, llvm::Value* L, llvm::Value* R);
+    llvm::Value* unaryOperation(const UnaryExprNode* un, llvm::Value* val);
+    void branchTo(llvm::BasicBlock* target);
+    void branchOut(llvm::BasicBlock* target);
+    llvm::MDNode* loopMetadata();
+    llvm::Constant* stringConstant(llvm::StringRef text);
+    llvm::Value* stringAddress(llvm::Value* str);
+    llvm::Value* stringOperation(BinaryExprNode::Op op, llvm::Value* L, llvm::Value* R);
+    llvm::AllocaInst* stringSlot(const llvm::Twine& name);
+    llvm::AllocaInst* entryAlloca(llvm::Type* type, const llvm::Twine& name);
+    llvm::FunctionCallee runtimeFunction(const char* name, llvm::ArrayRef<llvm::Type*> params = {},
+                                         llvm::Type* result = nullptr);
+
+    // Arrays
+    llvm::Value* newArray(TypeId type, llvm::StringRef name);
+    llvm::Value* constantArray(llvm::ArrayRef<llvm::Value*> values, llvm::Type* elementType);
+    const ASTNode* storeArray(llvm::Value* dest, const ASTNode* expr, TypeId type, unsigned stage);
+    void storeLiteral(llvm::Value* dest, size_t count, llvm::Type* elementType);
+    const ASTNode* reduceArray(const BuiltinCallNode* call, unsigned stage);
+    const ASTNode* prepareLeaves(const ASTNode* expr, bool chunked, unsigned stage);
+    llvm::Value* elementChunk(const ASTNode* expr, llvm::Value* index, unsigned width);
+    llvm::Value* loadElements(llvm::Value* array, llvm::Value* index, unsigned width, llvm::Type* elementType);
+    void storeElements(llvm::Value* array, llvm::Value* index, llvm::Value* value);
+    llvm::Value* forEachChunk(uint32_t chunks, llvm::Value* carried,
+                              llvm::function_ref<llvm::Value*(llvm::Value* index, llvm::Value* carried)> body);
+    void checkIndex(llvm::Value* index, uint32_t length);
+    llvm::BasicBlock* indexError();
+    llvm::Value* divideInt(llvm::Value* L, llvm::Value* R);
+    llvm::BasicBlock* divisionError();
+
+    // Parallel repeat
+    void startParallelBody(const ParallelRepeatNode* loop, ParallelLoop& state, llvm::StructType* contextType);
+    void finishParallelBody(const ParallelRepeatNode* loop, ParallelLoop& state);
+    void finishParallelLoop(const ParallelRepeatNode* loop);
+
+    // SSA construction
+    void writeVariable(uint32_t slot, llvm::BasicBlock* block, llvm::Value* value);
+    llvm::Value* readVariable(uint32_t slot, llvm::BasicBlock* block);
+    llvm::PHINode* newPhi(uint32_t slot, llvm::BasicBlock* block);
+    llvm::Value* readVariableRecursive(uint32_t slot, llvm::BasicBlock* block);
+    llvm::Value* addPhiOperands(uint32_t slot, llvm::PHINode* phi);
+    llvm::Value* tryRemoveTrivialPhi(llvm::PHINode* phi);
+    void sealBlock(llvm::BasicBlock* block);
+    void startRegion(llvm::BasicBlock* block);
+    void continueRegion(llvm::BasicBlock* merge, llvm::BasicBlock* before, size_t firstDefined);
+    void noteDefinition(uint32_t slot, llvm::BasicBlock* block);
+    llvm::BasicBlock* lastDefinition(uint32_t slot, llvm::BasicBlock* block);
+
+    // Per-node lowering, dispatched on the node kind by ConstASTVisitor, as
+    // steps of walkTree: each gets the node's stage and returns the child to
+    // generate next, or nullptr once the node is done. Expressions then push
+    // their value onto `values`, having taken their operands' off it. Nodes
+    // without a visit method (return) generate nothing.
+    friend class ConstASTVisitor<LLVMCodeGen, const ASTNode*, unsigned>;
+    const ASTNode* visitLiteral(const LiteralNode* lit, unsigned stage);
+    const ASTNode* visitIdentifier(const IdentifierNode* ident, unsigned stage);
+    const ASTNode* visitBuiltinCall(const BuiltinCallNode* builtin, unsigned stage);
+    const ASTNode* visitBinaryExpr(const BinaryExprNode* bin, unsigned stage);
+    const ASTNode* visitUnaryExpr(const UnaryExprNode* un, unsigned stage);
+    const ASTNode* visitIndexExpr(const IndexExprNode* index, unsigned stage);
+    const ASTNode* visitArrayLiteral(const ArrayLiteralNode* literal, unsigned stage);
+    const ASTNode* visitDeclaration(const DeclarationNode* decl, unsigned stage);
+    const ASTNode* visitPrintStmt(const PrintStmtNode* print, unsigned stage);
+    const ASTNode* visitAssignment(const AssignmentNode* assign, unsigned stage);
+    const ASTNode* visitIfStmt(const IfStmtNode* ifStmt, unsigned stage);
+    const ASTNode* visitRepeatStmt(const RepeatStmtNode* repeat, unsigned stage);
+    const ASTNode* visitParallelRepeat(const ParallelRepeatNode* loop, unsigned stage);
+    const ASTNode* visitBreak(const BreakNode* stop, unsigned stage);
+    const ASTNode* visitContinue(const ContinueNode* skip, unsigned stage);
+    const ASTNode* visitBlock(const BlockNode* block, unsigned stage);
+    const ASTNode* visitProgram(const ProgramNode* root, unsigned stage);
+    void finishIf();
+    void finishRepeat();
+};
@@ -1,60 +1,694 @@
-#include "ast_interface.h"
-#include "ast.h"
-#include "SymbolTable.h"
-#include "llvm_codegen.h"  // NEW
-
-#include <iostream>
-#include <fstream>
-
-extern "C" int yyparse();
-extern FILE *yyin;
-extern std::unique_ptr<ProgramNode> astRoot;
-extern SymbolTable symbolTable;
-
-int main(int argc, char **argv)
-{
-    if (argc < 2)
-    {
-        std::cerr << "Usage: ./compiler <source-file>\n";
-        return 1;
-    }
-
-    yyin = fopen(argv[1], "r");
-    if (!yyin)
-    {
-        std::cerr << "Could not open file " << argv[1] << "\n";
-        return 1;
-    }
-
-    if (yyparse() == 0 && astRoot)
-    {
-        std::cout << "Parsed successfully!\n";
-
-        std::cout << "Running semantic analysis...\n";
-        try
-        {
-            std::string resultType = astRoot->analyze(symbolTable);
-            //std::cout << "Semantic analysis result: " << resultType << "\n";
-            std::cout << "Semantic analysis completed successfully.\n";
-
-            astRoot->print();
-
-            std::cout << "Generating LLVM IR...\n";
-            LLVMCodeGen llvmGen;
-            llvmGen.generate(astRoot.get());
-            llvmGen.dumpIR("output.ll");
-            std::cout << "LLVM IR written to output.ll\n";
-        }
-        catch (const std::exception &e)
-        {
-            std::cerr << "Semantic error: " << e.what() << "\n";
-        }
-    }
-    else
-    {
-        std::cerr << "Parsing failed.\n";
-    }
-
-    fclose(yyin);
-    return 0;
-}
+#include "ast_interface.h"
+#include "ast.h"
+#include "compile_session.h"
+#include "llvm_codegen.h"  // NEW
+#include "jit_runner.h"
+#include "optimizer.h"
+#include "emitter.h"
+#include "vm.h"
+#include "ast_optimizer.h"
+#include "compile_cache.h"
+#include "rd_parser.h"
+#include "time_report.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_os_ostream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static void printUsage()
+{
+    std::cerr << "Usage: ./compiler [--run] [-O0|-O1|-O2|-O3|-Os] [--passes=<pipeline>] [--time-passes]\n"
+              << "                  [--unroll=<n>] [--vectorize=<width>] [--time-report[=json]]\n"
+              << "                  [--emit=ll|bc|obj|asm|exe] [-o <file>] [--backend=llvm|vm] [--no-ast-opt]\n"
+              << "                  [--lexer=fast|flex] [--parser=bison|rd|compare] [--float-format=shortest|fixed]\n"
+              << "                  [--cache] [--cache-dir=<dir>] [--cache-size=<MiB>] [--cache-stats]\n"
+              << "                  [--jobs=<n>] [--files-from=<list>] [--max-nesting=<n>] <source-file>...\n"
+              << "  --run              execute the program in-process (LLVM JIT) instead of writing output.ll\n"
+              << "  --backend=vm       skip LLVM: compile to bytecode and run it in the interpreter\n"
+              << "  --no-ast-opt       skip constant folding and dead-code removal on the AST\n"
+              << "  --lexer=<kind>     hand-written SIMD scanner (fast, default) or the flex one (flex)\n"
+              << "  --parser=<kind>    Bison parser (bison, default) or the hand-written one (rd);\n"
+              << "                     compare parses with both and reports any difference\n"
+              << "  --float-format=<f> print floats as the shortest text that reads back the same (shortest,\n"
+              << "                     default) or with printf's six decimals as before (fixed)\n"
+              << "  --emit=<kind>      output LLVM IR (ll, default), bitcode (bc), a native object (obj),\n"
+              << "                     native assembly (asm) or a linked executable (exe) for this CPU\n"
+              << "  -o <file>          output path (default output.ll/.bc/.o/.s or output; with --run only\n"
+              << "                     if -o or --emit is given)\n"
+              << "  -O<level>          optimise the module in-process (default -O0)\n"
+              << "  --passes=<list>    custom pass pipeline in opt syntax, e.g. mem2reg,instcombine\n"
+              << "  --time-passes      print time spent in each pass to stderr\n"
+              << "  --unroll=<n>       ask the optimiser to unroll every loop n times (1: never)\n"
+              << "  --vectorize=<w>    ask it to vectorize every loop at width w, a power of two (1: never)\n"
+              << "  --time-report      print wall/CPU time and memory of each phase (lex, parse, sema, ...)\n"
+              << "                     and counters like tokens and IR instructions to stderr; =json for\n"
+              << "                     one JSON object per file\n"
+              << "  --cache            reuse optimised modules of programs compiled before (llvm backend),\n"
+              << "                     stored in " << CompileCache::defaultDirectory() << "\n"
+              << "  --cache-dir=<dir>  cache in <dir> instead (implies --cache)\n"
+              << "  --cache-size=<n>   keep the cache under n MiB (default 256)\n"
+              << "  --cache-stats      print cache hits, misses and size to stderr\n"
+              << "  --jobs=<n>         compile several files on n threads (0: one per core; default 1);\n"
+              << "                     results print in command-line order, outputs go next to each source\n"
+              << "  --files-from=<f>   also compile the files listed in f, one per line (- for stdin)\n"
+              << "  --max-nesting=<n>  reject programs nested more than n levels deep, counting blocks,\n"
+              << "                     parentheses and each operator of a chain (default " << DefaultMaxNesting << ")\n";
+}
+
+// Everything the command line decides about one compilation
+struct DriverOptions
+{
+    std::string outputPath;
+    bool runJIT = false;
+    OptOptions opt;
+    EmitKind emitKind = EmitKind::LLVM;
+    bool useVM = false;
+    bool astOpt = true;
+    FloatFormat floatFormat = FloatFormat::Shortest;
+    LexerKind lexer = LexerKind::Fast;
+    ParserKind parser = ParserKind::Bison;
+    const std::string *input = nullptr; // What input() reads; null for the process's stdin
+    bool timeReport = false;
+    bool timeReportJSON = false;
+    unsigned maxNesting = DefaultMaxNesting;
+};
+
+// Write the requested output and/or run the program. Shared by fresh and
+// cached compilations; `targetMachine` is created here if optimisation did
+// not already need one.
+static int finishModule(std::unique_ptr<llvm::LLVMContext> ownedContext, std::unique_ptr<llvm::Module> ownedModule,
+                        std::unique_ptr<llvm::TargetMachine> targetMachine, const DriverOptions &options,
+                        std::ostream &out, std::ostream &err, TimeReport *report)
+{
+    // Parameter destruction order is unspecified; locals guarantee the
+    // module goes before the context that owns its types
+    std::unique_ptr<llvm::LLVMContext> context = std::move(ownedContext);
+    std::unique_ptr<llvm::Module> module = std::move(ownedModule);
+
+    std::string error;
+    if (!options.outputPath.empty())
+    {
+        TimeReport::Phase phase(report, "emit");
+        if (!targetMachine)
+        {
+            targetMachine = createHostTargetMachine(options.opt.level, error);
+            if (!targetMachine)
+            {
+                err << error << "\n";
+                return 1;
+            }
+            prepareModuleForTarget(*module, *targetMachine);
+        }
+        if (!emitModule(*module, options.emitKind, options.outputPath, *targetMachine, error))
+        {
+            err << error << "\n";
+            return 1;
+        }
+        out << (options.emitKind == EmitKind::LLVM ? "LLVM IR" : "Output") << " written to "
+                  << options.outputPath << "\n";
+    }
+
+    if (!options.runJIT)
+        return 0;
+    TimeReport::Phase phase(report, "run");
+    JITResult result = runWithJIT(std::move(context), std::move(module), options.input);
+    phase.stop();
+    if (!result.ok)
+    {
+        err << "JIT error: " << result.error << "\n";
+        return 1;
+    }
+    out << result.output << std::flush;
+    return result.exitCode;
+}
+
+// Replay a cache hit: the front end's output, then emission/JIT from the
+// stored module
+static int finishCached(const char *sourcePath, const CacheEntry &entry, const DriverOptions &options,
+                        std::ostream &out, std::ostream &err, TimeReport *report)
+{
+    out << "Using cached compilation of " << sourcePath << "\n";
+    err << entry.diagnostics;
+    out << entry.listing;
+    if (!entry.ok)
+    {
+        err << "Semantic analysis failed; no code generated.\n";
+        return 1;
+    }
+
+    auto context = std::make_unique<llvm::LLVMContext>();
+    std::string error;
+    TimeReport::Phase phase(report, "cache-load");
+    std::unique_ptr<llvm::Module> module = moduleFromBitcode(entry.bitcode, *context, error);
+    phase.stop();
+    if (!module)
+    {
+        err << error << "\n";
+        return 1;
+    }
+    return finishModule(std::move(context), std::move(module), nullptr, options, out, err, report);
+}
+
+// Compile (and maybe run) one file, writing what the driver prints to `out`
+// and `err`; returns the process exit code for it. Each phase is timed into
+// `report` when it is set.
+static int compileSource(const char *sourcePath, const DriverOptions &options, CompileCache *cache,
+                         std::ostream &out, std::ostream &err, TimeReport *report)
+{
+    std::unique_ptr<SourceFile> source = SourceFile::open(sourcePath);
+    if (!source)
+    {
+        err << "Could not open file " << sourcePath << "\n";
+        return 1;
+    }
+    if (report)
+        report->count("source-bytes", source->text().size());
+
+    std::string cacheKey;
+    if (cache)
+    {
+        TimeReport::Phase phase(report, "cache-lookup");
+        cacheKey = CompileCache::makeKey(source->text(), options.opt, options.astOpt, options.floatFormat,
+                                         options.maxNesting);
+        CacheEntry entry;
+        bool hit = cache->lookup(cacheKey, entry);
+        phase.stop();
+        if (hit)
+            return finishCached(sourcePath, entry, options, out, err, report);
+    }
+
+    // Diagnostics are collected so a cache entry can replay them
+    std::ostringstream diagnostics;
+    CompileSession session(std::move(source), diagnostics);
+    session.lexer = options.lexer;
+    session.parser = options.parser;
+    session.timeReport = report;
+    session.maxNesting = options.maxNesting;
+    bool parsed = session.parse();
+    if (report)
+    {
+        report->count("ast-nodes", session.arena.nodeCount());
+        report->count("arena-bytes", session.arena.bytesReserved());
+    }
+    if (!parsed)
+    {
+        err << diagnostics.str() << "Parsing failed.\n";
+        return 1;
+    }
+    out << "Parsed successfully!\n";
+
+    out << "Running semantic analysis...\n";
+    try
+    {
+        bool analyzed = session.analyze();
+        if (report)
+        {
+            report->count("symbol-lookups", session.symbolTable.lookupCount());
+            report->count("scopes-entered", session.symbolTable.scopesEntered());
+            report->count("variables", session.symbolTable.slotCount());
+        }
+        err << diagnostics.str();
+        if (analyzed)
+            out << "Semantic analysis completed successfully.\n";
+
+        std::ostringstream listing;
+        {
+            TimeReport::Phase phase(report, "print");
+            session.astRoot->print(listing);
+            out << listing.str();
+        }
+
+        // Code generation relies on the types sema recorded in the tree
+        if (!analyzed)
+        {
+            if (cache)
+                cache->store(cacheKey, CacheEntry{false, diagnostics.str(), listing.str(), {}});
+            err << "Semantic analysis failed with " << session.symbolTable.errorCount()
+                      << " error(s); no code generated.\n";
+            return 1;
+        }
+
+        if (options.astOpt)
+        {
+            TimeReport::Phase phase(report, "ast-opt");
+            AstOptStats stats = optimizeAst(session.astRoot, session.arena);
+            phase.stop();
+            if (report)
+                report->count("ast-rewrites", stats.total());
+        }
+
+        if (options.useVM)
+        {
+            TimeReport::Phase compilePhase(report, "bytecode");
+            BytecodeProgram bytecode = compileToBytecode(session.astRoot, options.floatFormat);
+            compilePhase.stop();
+            TimeReport::Phase runPhase(report, "run");
+            VMResult result = runBytecode(bytecode, options.input);
+            runPhase.stop();
+            out << result.output << std::flush;
+            return result.exitCode;
+        }
+
+        out << "Generating LLVM IR...\n";
+        TimeReport::Phase codegenPhase(report, "codegen");
+        LLVMCodeGen llvmGen(options.opt.loops, options.floatFormat);
+        llvmGen.generate(session.astRoot);
+        codegenPhase.stop();
+        if (report)
+            report->count("ir-instructions", llvmGen.getModule().getInstructionCount());
+
+        {
+            TimeReport::Phase phase(report, "verify");
+            llvm::raw_os_ostream verifyErrors(err);
+            if (!llvmGen.verify(verifyErrors))
+            {
+                verifyErrors.flush();
+                err << "Invalid IR generated; this is a compiler bug.\n";
+                return 1;
+            }
+        }
+
+        // The host target drives both the optimiser's cost models and
+        // native emission; a JIT-only -O0 run does not need it
+        std::string error;
+        std::unique_ptr<llvm::TargetMachine> targetMachine;
+        if (!options.outputPath.empty() || options.opt.level != OptLevel::O0 || !options.opt.passes.empty())
+        {
+            targetMachine = createHostTargetMachine(options.opt.level, error);
+            if (!targetMachine)
+            {
+                err << error << "\n";
+                return 1;
+            }
+            prepareModuleForTarget(llvmGen.getModule(), *targetMachine);
+        }
+
+        // --time-passes output belongs with the rest of this file's stderr
+        bool optimized;
+        {
+            TimeReport::Phase phase(report, "optimize");
+            llvm::raw_os_ostream timingOut(err);
+            optimized = optimizeModule(llvmGen.getModule(), options.opt, error, &timingOut, targetMachine.get());
+        }
+        if (!optimized)
+        {
+            err << error << "\n";
+            return 1;
+        }
+        if (report)
+            report->count("ir-instructions-optimized", llvmGen.getModule().getInstructionCount());
+
+        if (cache)
+        {
+            TimeReport::Phase phase(report, "cache-store");
+            cache->store(cacheKey, CacheEntry{true, diagnostics.str(), listing.str(),
+                                              moduleToBitcode(llvmGen.getModule())});
+        }
+
+        return finishModule(llvmGen.takeContext(), llvmGen.takeModule(), std::move(targetMachine), options, out,
+                            err, report);
+    }
+    catch (const std::exception &e)
+    {
+        err << "Semantic error: " << e.what() << "\n";
+    }
+    return 1;
+}
+
+// compileSource on a stack of its own; see CompileStackSize
+static int compileFile(const char *sourcePath, const DriverOptions &options, CompileCache *cache,
+                       std::ostream &out, std::ostream &err)
+{
+    std::unique_ptr<TimeReport> report;
+    if (options.timeReport)
+        report = std::make_unique<TimeReport>(sourcePath);
+    int exitCode = 1;
+    try
+    {
+        runWithStack(CompileStackSize,
+                     [&] { exitCode = compileSource(sourcePath, options, cache, out, err, report.get()); });
+    }
+    catch (const std::exception &e)
+    {
+        err << "Could not compile " << sourcePath << ": " << e.what() << "\n";
+    }
+    if (report)
+        report->print(err, options.timeReportJSON);
+    return exitCode;
+}
+
+// Where a batch writes the output for `source`: next to it, with the
+// extension of the output kind (a/b.prog -> a/b.ll, or a/b for executables)
+static std::string batchOutputPath(const std::string &source, EmitKind kind)
+{
+    llvm::SmallString<256> path(source);
+    llvm::sys::path::replace_extension(path, llvm::sys::path::extension(defaultOutputPath(kind)));
+    if (path.str() == source)
+        path += ".out";
+    return std::string(path.str());
+}
+
+// One file's share of a batch: everything it printed, held until every
+// file before it has been printed
+struct BatchResult
+{
+    std::string out;
+    std::string err;
+    int exitCode = 0;
+    bool done = false;
+};
+
+// Compile every file on `jobs` worker threads. Each compilation has its own
+// session, LLVMContext and output file, and input() reads nothing; results
+// are printed in the order the files were given, whatever order they
+// finish in.
+static int compileBatch(const std::vector<std::string> &sources, const DriverOptions &options, CompileCache *cache,
+                        unsigned jobs)
+{
+    static const std::string noInput;
+    std::vector<BatchResult> results(sources.size());
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::atomic<size_t> nextFile{0};
+
+    auto worker = [&] {
+        for (size_t i; (i = nextFile++) < sources.size();)
+        {
+            DriverOptions fileOptions = options;
+            fileOptions.input = &noInput;
+            if (!options.outputPath.empty())
+                fileOptions.outputPath = batchOutputPath(sources[i], options.emitKind);
+
+            std::ostringstream out, err;
+            int exitCode = compileFile(sources[i].c_str(), fileOptions, cache, out, err);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            results[i] = BatchResult{out.str(), err.str(), exitCode, true};
+            finished.notify_one();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned j = 0; j < std::min<size_t>(jobs, sources.size()); ++j)
+        workers.emplace_back(worker);
+
+    std::vector<std::pair<size_t, int>> failed; // File index, exit code
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        BatchResult result;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&] { return results[i].done; });
+            result = std::move(results[i]);
+        }
+        std::cout << "==> " << sources[i] << " <==\n" << result.out << std::flush;
+        std::cerr << result.err << std::flush;
+        if (result.exitCode != 0)
+            failed.emplace_back(i, result.exitCode);
+    }
+    for (std::thread &thread : workers)
+        thread.join();
+
+    std::cerr << sources.size() << " file(s), " << sources.size() - failed.size() << " succeeded, " << failed.size()
+              << " failed\n";
+    for (const auto &[index, exitCode] : failed)
+        std::cerr << "  failed: " << sources[index] << " (exit " << exitCode << ")\n";
+    return failed.empty() ? 0 : 1;
+}
+
+// One path per line; blank lines are skipped. "-" reads standard input.
+static bool readFileList(const std::string &listPath, std::vector<std::string> &sources)
+{
+    std::ifstream file;
+    if (listPath != "-")
+    {
+        file.open(listPath);
+        if (!file)
+            return false;
+    }
+    std::istream &in = listPath == "-" ? std::cin : file;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty())
+            sources.push_back(line);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> sources;
+    bool batch = false;
+    unsigned jobs = 1;
+    DriverOptions options;
+    bool emitRequested = false;
+    bool useCache = false;
+    bool cacheStats = false;
+    bool compare = false;
+    std::string cacheDir;
+    uint64_t cacheMiB = 256;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--run") == 0)
+        {
+            options.runJIT = true;
+        }
+        else if (std::strncmp(argv[i], "-O", 2) == 0)
+        {
+            if (!parseOptLevel(argv[i], options.opt.level))
+            {
+                std::cerr << "Unknown optimisation level " << argv[i] << "\n";
+                printUsage();
+                return 1;
+            }
+        }
+        else if (std::strncmp(argv[i], "--passes=", 9) == 0)
+        {
+            options.opt.passes = argv[i] + 9;
+        }
+        else if (std::strcmp(argv[i], "--time-passes") == 0)
+        {
+            options.opt.timePasses = true;
+        }
+        else if (std::strncmp(argv[i], "--unroll=", 9) == 0)
+        {
+            char *end = nullptr;
+            unsigned long count = std::strtoul(argv[i] + 9, &end, 10);
+            if (end == argv[i] + 9 || *end != '\0' || count == 0 || count > 1024)
+            {
+                std::cerr << "Invalid unroll count " << argv[i] + 9 << " (1 to 1024)\n";
+                printUsage();
+                return 1;
+            }
+            options.opt.loops.unrollCount = static_cast<unsigned>(count);
+        }
+        else if (std::strncmp(argv[i], "--vectorize=", 12) == 0)
+        {
+            char *end = nullptr;
+            unsigned long width = std::strtoul(argv[i] + 12, &end, 10);
+            if (end == argv[i] + 12 || *end != '\0' || width == 0 || width > 64 || (width & (width - 1)))
+            {
+                std::cerr << "Invalid vector width " << argv[i] + 12 << " (1, 2, 4, ... 64)\n";
+                printUsage();
+                return 1;
+            }
+            options.opt.loops.vectorizeWidth = static_cast<unsigned>(width);
+        }
+        else if (std::strcmp(argv[i], "--time-report") == 0 || std::strcmp(argv[i], "--time-report=json") == 0)
+        {
+            options.timeReport = true;
+            options.timeReportJSON = argv[i][13] == '=';
+        }
+        else if (std::strncmp(argv[i], "--emit=", 7) == 0)
+        {
+            if (!parseEmitKind(argv[i] + 7, options.emitKind))
+            {
+                std::cerr << "Unknown output kind " << argv[i] + 7 << "\n";
+                printUsage();
+                return 1;
+            }
+            emitRequested = true;
+        }
+        else if (std::strcmp(argv[i], "--backend=vm") == 0 || std::strcmp(argv[i], "--backend=llvm") == 0)
+        {
+            options.useVM = std::strcmp(argv[i] + 10, "vm") == 0;
+        }
+        else if (std::strcmp(argv[i], "--no-ast-opt") == 0)
+        {
+            options.astOpt = false;
+        }
+        else if (std::strcmp(argv[i], "--float-format=shortest") == 0 ||
+                 std::strcmp(argv[i], "--float-format=fixed") == 0)
+        {
+            options.floatFormat = std::strcmp(argv[i] + 15, "fixed") == 0 ? FloatFormat::Fixed : FloatFormat::Shortest;
+        }
+        else if (std::strncmp(argv[i], "--lexer=", 8) == 0)
+        {
+            if (!parseLexerKind(argv[i] + 8, options.lexer))
+            {
+                std::cerr << "Unknown lexer " << argv[i] + 8 << "\n";
+                printUsage();
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--parser=compare") == 0)
+        {
+            compare = true;
+        }
+        else if (std::strncmp(argv[i], "--parser=", 9) == 0)
+        {
+            if (!parseParserKind(argv[i] + 9, options.parser))
+            {
+                std::cerr << "Unknown parser " << argv[i] + 9 << "\n";
+                printUsage();
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--cache") == 0)
+        {
+            useCache = true;
+        }
+        else if (std::strncmp(argv[i], "--cache-dir=", 12) == 0)
+        {
+            useCache = true;
+            cacheDir = argv[i] + 12;
+        }
+        else if (std::strncmp(argv[i], "--cache-size=", 13) == 0)
+        {
+            char *end = nullptr;
+            cacheMiB = std::strtoull(argv[i] + 13, &end, 10);
+            if (end == argv[i] + 13 || *end != '\0')
+            {
+                std::cerr << "Invalid cache size " << argv[i] + 13 << "\n";
+                printUsage();
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--cache-stats") == 0)
+        {
+            cacheStats = true;
+        }
+        else if (std::strncmp(argv[i], "--jobs=", 7) == 0)
+        {
+            char *end = nullptr;
+            unsigned long count = std::strtoul(argv[i] + 7, &end, 10);
+            if (end == argv[i] + 7 || *end != '\0')
+            {
+                std::cerr << "Invalid job count " << argv[i] + 7 << "\n";
+                printUsage();
+                return 1;
+            }
+            jobs = count ? static_cast<unsigned>(count) : std::max(1u, std::thread::hardware_concurrency());
+        }
+        else if (std::strncmp(argv[i], "--files-from=", 13) == 0)
+        {
+            batch = true;
+            if (!readFileList(argv[i] + 13, sources))
+            {
+                std::cerr << "Could not open file list " << argv[i] + 13 << "\n";
+                return 1;
+            }
+        }
+        else if (std::strncmp(argv[i], "--max-nesting=", 14) == 0)
+        {
+            char *end = nullptr;
+            unsigned long levels = std::strtoul(argv[i] + 14, &end, 10);
+            if (end == argv[i] + 14 || *end != '\0' || levels == 0 || levels > MaxNestingLimit)
+            {
+                std::cerr << "Invalid nesting limit " << argv[i] + 14 << " (1 to " << MaxNestingLimit << ")\n";
+                printUsage();
+                return 1;
+            }
+            options.maxNesting = static_cast<unsigned>(levels);
+        }
+        else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            options.outputPath = argv[++i];
+        }
+        else if (argv[i][0] == '-')
+        {
+            std::cerr << "Unknown option " << argv[i] << "\n";
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            sources.push_back(argv[i]);
+        }
+    }
+
+    batch = batch || sources.size() > 1;
+    if (sources.empty())
+    {
+        if (batch)
+            return 0; // An empty file list
+        printUsage();
+        return 1;
+    }
+    if (compare)
+    {
+        bool agree = true;
+        for (const std::string &sourcePath : sources)
+        {
+            std::unique_ptr<SourceFile> source = SourceFile::open(sourcePath);
+            if (!source)
+            {
+                std::cerr << "Could not open file " << sourcePath << "\n";
+                return 1;
+            }
+            if (batch)
+                std::cout << "==> " << sourcePath << " <==\n";
+            try
+            {
+                runWithStack(CompileStackSize, [&] {
+                    agree &= compareParsers(source->text(), options.lexer, std::cout, options.maxNesting);
+                });
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Could not compare parsers on " << sourcePath << ": " << e.what() << "\n";
+                return 1;
+            }
+        }
+        return agree ? 0 : 1;
+    }
+    if (batch && !options.outputPath.empty())
+    {
+        std::cerr << "-o takes a single source file; batches write each output next to its source\n";
+        return 1;
+    }
+    if (options.useVM && (emitRequested || !options.outputPath.empty()))
+    {
+        std::cerr << "--emit and -o need the llvm backend\n";
+        return 1;
+    }
+    if (options.outputPath.empty() && !options.useVM && (!options.runJIT || emitRequested))
+        options.outputPath = defaultOutputPath(options.emitKind);
+
+    // Only LLVM compilations are cached; the VM path is already cheap
+    std::unique_ptr<CompileCache> cache;
+    if (useCache && !options.useVM)
+        cache = std::make_unique<CompileCache>(cacheDir.empty() ? CompileCache::defaultDirectory() : cacheDir,
+                                               cacheMiB * 1024 * 1024);
+
+    int exitCode = batch ? compileBatch(sources, options, cache.get(), jobs)
+                         : compileFile(sources[0].c_str(), options, cache.get(), std::cout, std::cerr);
+    if (cache && cacheStats)
+        cache->printStats(std::cerr);
+    return exitCode;
+}
@@ -0,0 +1,95 @@
+// optimizer.cpp
+#include "optimizer.h"
+
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassInstrumentation.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/IR/PassTimingInfo.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+bool parseOptLevel(const std::string &text, OptLevel &level)
+{
+    std::string name = !text.empty() && text[0] == '-' ? text.substr(1) : text;
+    if (name == "O0")
+        level = OptLevel::O0;
+    else if (name == "O1")
+        level = OptLevel::O1;
+    else if (name == "O2")
+        level = OptLevel::O2;
+    else if (name == "O3")
+        level = OptLevel::O3;
+    else if (name == "Os")
+        level = OptLevel::Os;
+    else
+        return false;
+    return true;
+}
+
+static llvm::OptimizationLevel toLLVM(OptLevel level)
+{
+    switch (level)
+    {
+    case OptLevel::O0:
+        return llvm::OptimizationLevel::O0;
+    case OptLevel::O1:
+        return llvm::OptimizationLevel::O1;
+    case OptLevel::O2:
+        return llvm::OptimizationLevel::O2;
+    case OptLevel::O3:
+        return llvm::OptimizationLevel::O3;
+    case OptLevel::Os:
+        return llvm::OptimizationLevel::Os;
+    }
+    return llvm::OptimizationLevel::O0;
+}
+
+bool optimizeModule(llvm::Module &module, const OptOptions &options, std::string &error,
+                    llvm::raw_ostream *timingOut, llvm::TargetMachine *tm)
+{
+    // -O0 without a custom pipeline leaves codegen's IR untouched
+    if (options.level == OptLevel::O0 && options.passes.empty())
+        return true;
+
+    llvm::PassInstrumentationCallbacks instrumentation;
+    llvm::TimePassesHandler passTimer(options.timePasses);
+    if (options.timePasses)
+    {
+        passTimer.setOutStream(timingOut ? *timingOut : llvm::errs());
+        passTimer.registerCallbacks(instrumentation);
+    }
+
+    llvm::LoopAnalysisManager loopAM;
+    llvm::FunctionAnalysisManager functionAM;
+    llvm::CGSCCAnalysisManager cgsccAM;
+    llvm::ModuleAnalysisManager moduleAM;
+
+    llvm::PassBuilder builder(tm, llvm::PipelineTuningOptions(), {}, &instrumentation);
+    builder.registerModuleAnalyses(moduleAM);
+    builder.registerCGSCCAnalyses(cgsccAM);
+    builder.registerFunctionAnalyses(functionAM);
+    builder.registerLoopAnalyses(loopAM);
+    builder.crossRegisterProxies(loopAM, functionAM, cgsccAM, moduleAM);
+
+    llvm::ModulePassManager pipeline;
+    if (!options.passes.empty())
+    {
+        if (llvm::Error err = builder.parsePassPipeline(pipeline, options.passes))
+        {
+            error = "invalid pass pipeline '" + options.passes + "': " + llvm::toString(std::move(err));
+            return false;
+        }
+    }
+    else
+    {
+        pipeline = builder.buildPerModuleDefaultPipeline(toLLVM(options.level));
+    }
+
+    pipeline.run(module, moduleAM);
+
+    if (options.timePasses)
+        passTimer.print();
+    return true;
+}
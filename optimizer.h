@@ -0,0 +1,47 @@
+// optimizer.h
+#pragma once
+
+#include <string>
+
+namespace llvm
+{
+class Module;
+class TargetMachine;
+class raw_ostream;
+}
+
+enum class OptLevel
+{
+    O0,
+    O1,
+    O2,
+    O3,
+    Os
+};
+
+// Hints the code generator attaches to every loop as llvm.loop metadata
+// for the unroll and vectorize passes of -O1 and up: 0 leaves the choice
+// to the pass, 1 turns the transformation off
+struct LoopHints
+{
+    unsigned unrollCount = 0;
+    unsigned vectorizeWidth = 0;
+};
+
+struct OptOptions
+{
+    OptLevel level = OptLevel::O0;
+    std::string passes;      // Custom pipeline in opt's -passes= syntax; replaces the level pipeline
+    bool timePasses = false; // Report wall/CPU time per pass
+    LoopHints loops;
+};
+
+// Accepts "O2" or "-O2" style names
+bool parseOptLevel(const std::string &text, OptLevel &level);
+
+// Run the new PassManager over `module` in-process. Returns false and sets
+// `error` when a custom pipeline does not parse. With timePasses set, the
+// per-pass report goes to `timingOut` (stderr if null). `tm`, when given,
+// supplies target cost models to the pipeline.
+bool optimizeModule(llvm::Module &module, const OptOptions &options, std::string &error,
+                    llvm::raw_ostream *timingOut = nullptr, llvm::TargetMachine *tm = nullptr);
@@ -4,41 +4,38 @@
 #include <stdlib.h>
 #include <string.h>
 
-#ifdef __cplusplus
 #include <string>
 #include <iostream>
 #include <memory>
 #include "ast.h"
 #include "ast_interface.h"
-
-extern "C" {
-#endif
-int yylex();
-int yyparse();
-void yyerror(const char *s);
-int yywrap(void);
-
-#ifdef __cplusplus
-}
-
-extern int yylineno;
-extern std::unique_ptr<ASTNode> root;
-#endif
+#include "compile_session.h"
 %}
 
+%define api.pure full
 %define parse.error verbose
 %locations
 
+/* The scanner handle and the session are threaded through every call so
+   that several compilations can run at once. */
+%param { yyscan_t scanner }
+%parse-param { CompileSession *session }
+
 %code requires {
     #include "ast.h"
     #include "ast_interface.h"
+
+    class CompileSession;
+    typedef void *yyscan_t;
 }
 
 %union {
     int ival;
     float fval;
     char cval;
-    char* sval;
+    TokenText sval;
+    IdentId ident;
+    TypeId typeId;
     int bval;
     ASTNode* node;
     BlockNode* block;
@@ -47,29 +44,43 @@ extern std::unique_ptr<ASTNode> root;
     IfStmtNode* ifStmtNodePtr;
     RepeatStmtNode* repeatStmtNodePtr;
     ReturnStmtNode* returnStmtNodePtr;
-    std::vector<std::unique_ptr<ASTNode>>* stmtList;
+    NodeList* stmtList;
 }
 
 %token <ival> INTEGER_LITERAL
 %token <fval> FLOAT_LITERAL
-%token <sval> STRING_LITERAL IDENTIFIER
+%token <sval> STRING_LITERAL
+%token <ident> IDENTIFIER
 %token <cval> CHAR_LITERAL
 %token <bval> TRUE FALSE
 
 %token INT FLOAT STRING BOOL
 %token PRINT INPUT CLEAR TYPEOF RANDINT
-%token IF ELSE REPEAT RETURN BREAK CONTINUE
+%token IF ELSE REPEAT PARALLEL REDUCE RETURN BREAK CONTINUE
 %token PLUS MINUS STAR SLASH ASSIGN
 %token EQ NEQ LEQ GEQ LT GT
-%token LPAREN RPAREN LBRACE RBRACE SEMICOLON COMMA
+%token LPAREN RPAREN LBRACE RBRACE LBRACKET RBRACKET SEMICOLON COMMA
 %token AND OR NOT
 %token NEWLINE
 %token UNKNOWN
 
-%type <node> expression statement declaration print_stmt if_stmt repeat_stmt return_stmt assignment_stmt
+%code {
+    // `scanner` is the session's token source; nextToken forwards to the
+    // flex scanner or the hand-written one, see CompileSession::parse
+    int nextToken(YYSTYPE *yylval, YYLTYPE *yylloc, yyscan_t scanner);
+    #define yylex nextToken
+
+    // The state stack lives on the heap, so let it grow as far as the
+    // session's nesting limit needs (one level can take several states);
+    // running out is reported as too deep a nesting by yyerror
+    #define YYMAXDEPTH (8L * session->maxNesting + 10000)
+    void yyerror(YYLTYPE *loc, yyscan_t scanner, CompileSession *session, const char *s);
+}
+
+%type <node> expression statement declaration print_stmt if_stmt repeat_stmt parallel_stmt return_stmt assignment_stmt
 %type <block> block
-%type <stmtList> statement_list
-%type <sval> type
+%type <stmtList> statement_list expression_list reduce_list
+%type <typeId> type
 
 %left OR
 %left AND
@@ -81,8 +92,8 @@ extern std::unique_ptr<ASTNode> root;
 %%
 
 program:
-    program statement          { addToProgram(std::unique_ptr<ASTNode>($2)); }
-  | /* empty */                 { astRoot = makeProgram(); }
+    program statement          { addToProgram(session->arena, session->astRoot, $2); }
+  | /* empty */                 { session->astRoot = makeProgram(session->arena); }
   ;
 
 statement:
@@ -91,86 +102,128 @@ statement:
   | print_stmt end             { $$ = $1; }
   | if_stmt                    { $$ = $1; }
   | repeat_stmt                { $$ = $1; }
+  | parallel_stmt              { $$ = $1; }
   | return_stmt end            { $$ = $1; }
-  | BREAK end                  { $$ = makeBreak(@1.first_line).release(); } 
-  | CONTINUE end               { $$ = makeContinue(@1.first_line).release(); }
+  | BREAK end                  { $$ = makeBreak(session->arena, @1.first_line); } 
+  | CONTINUE end               { $$ = makeContinue(session->arena, @1.first_line); }
   | NEWLINE                    { $$ = nullptr; }
   ;
 
 statement_list:
     statement_list statement {
-        if ($2) $1->push_back(std::unique_ptr<ASTNode>($2));
+        if ($2) $1->push_back(session->arena, $2);
         $$ = $1;
     }
   | /* empty */ {
-        $$ = new std::vector<std::unique_ptr<ASTNode>>();
+        $$ = makeStatementList(session->arena);
     }
   ;
 
 declaration:
-    type IDENTIFIER ASSIGN expression { $$ = makeDeclaration($1, $2, std::unique_ptr<ASTNode>($4), @2.first_line).release(); }
+    type IDENTIFIER ASSIGN expression { $$ = makeDeclaration(session->arena, $1, $2, session->interner.name($2), $4, @2.first_line); }
   ;
 
 type:
-    INT                         { $$ = strdup("int"); }
-  | FLOAT                       { $$ = strdup("float"); }
-  | STRING                      { $$ = strdup("string"); }
-  | BOOL                        { $$ = strdup("bool"); }
+    INT                         { $$ = TypeId::Int; }
+  | FLOAT                       { $$ = TypeId::Float; }
+  | STRING                      { $$ = TypeId::String; }
+  | BOOL                        { $$ = TypeId::Bool; }
+  | INT LBRACKET INTEGER_LITERAL RBRACKET   { $$ = TypeId::array(TypeId::Int, $3); }
+  | FLOAT LBRACKET INTEGER_LITERAL RBRACKET { $$ = TypeId::array(TypeId::Float, $3); }
   ;
 
 print_stmt:
-    PRINT LPAREN expression RPAREN { $$ = makePrintStmt(std::unique_ptr<ASTNode>($3), @1.first_line).release(); }
+    PRINT LPAREN expression RPAREN { $$ = makePrintStmt(session->arena, $3, @1.first_line); }
   ;
 
 if_stmt:
-    IF LPAREN expression RPAREN block              { $$ = makeIfStmt(std::unique_ptr<ASTNode>($3), std::unique_ptr<BlockNode>($5), nullptr, @1.first_line).release(); }
-  | IF LPAREN expression RPAREN block ELSE block   { $$ = makeIfStmt(std::unique_ptr<ASTNode>($3), std::unique_ptr<BlockNode>($5), std::unique_ptr<BlockNode>($7), @1.first_line).release(); }
+    IF LPAREN expression RPAREN block              { $$ = makeIfStmt(session->arena, $3, $5, nullptr, @1.first_line); }
+  | IF LPAREN expression RPAREN block ELSE block   { $$ = makeIfStmt(session->arena, $3, $5, $7, @1.first_line); }
   ;
 
 repeat_stmt:
-    REPEAT LPAREN expression RPAREN block          { $$ = makeRepeatStmt(std::unique_ptr<ASTNode>($3), std::unique_ptr<BlockNode>($5) ,@1.first_line).release(); }
+    REPEAT LPAREN expression RPAREN block          { $$ = makeRepeatStmt(session->arena, $3, $5, @1.first_line); }
+  ;
+
+parallel_stmt:
+    PARALLEL REPEAT LPAREN IDENTIFIER ASSIGN expression COMMA expression RPAREN block {
+        $$ = makeParallelRepeat(session->arena, $4, session->interner.name($4), $6, $8,
+                                makeStatementList(session->arena), $10, @1.first_line);
+    }
+  | PARALLEL REPEAT LPAREN IDENTIFIER ASSIGN expression COMMA expression RPAREN REDUCE LPAREN reduce_list RPAREN block {
+        $$ = makeParallelRepeat(session->arena, $4, session->interner.name($4), $6, $8, $12, $14, @1.first_line);
+    }
+  ;
+
+reduce_list:
+    IDENTIFIER {
+        $$ = makeStatementList(session->arena);
+        $$->push_back(session->arena, makeIdentifier(session->arena, $1, session->interner.name($1), @1.first_line));
+    }
+  | reduce_list COMMA IDENTIFIER {
+        $1->push_back(session->arena, makeIdentifier(session->arena, $3, session->interner.name($3), @3.first_line));
+        $$ = $1;
+    }
   ;
 
 return_stmt:
-    RETURN expression                              { $$ = makeReturnStmt(std::unique_ptr<ASTNode>($2) ,@1.first_line).release(); }
+    RETURN expression                              { $$ = makeReturnStmt(session->arena, $2, @1.first_line); }
   ;
 
 assignment_stmt:
     IDENTIFIER ASSIGN expression {
-        $$ = makeAssignment($1, std::unique_ptr<ASTNode>($3) ,@1.first_line).release();
+        $$ = makeAssignment(session->arena, $1, session->interner.name($1), $3, @1.first_line);
+    }
+  | IDENTIFIER LBRACKET expression RBRACKET ASSIGN expression {
+        $$ = makeElementAssignment(session->arena, $1, session->interner.name($1), $3, $6, @1.first_line);
     }
   ;
 
 block:
     LBRACE statement_list RBRACE {
-        $$ = makeBlock(std::unique_ptr<std::vector<std::unique_ptr<ASTNode>>>($2) ,@1.first_line).release();
+        $$ = makeBlock(session->arena, $2, @1.first_line);
     }
   ;
 
 expression:
-    INTEGER_LITERAL              { $$ = makeIntLiteral($1, @1.first_line).release(); }
-  | FLOAT_LITERAL                { $$ = makeFloatLiteral($1, @1.first_line).release(); }
-  | STRING_LITERAL               { $$ = makeStringLiteral($1, @1.first_line).release(); }
-  | CHAR_LITERAL                 { $$ = makeCharLiteral($1, @1.first_line).release(); }
-  | TRUE                         { $$ = makeBoolLiteral(true, @1.first_line).release(); }
-  | FALSE                        { $$ = makeBoolLiteral(false, @1.first_line).release(); }
-  | IDENTIFIER                   { $$ = makeIdentifier($1, @1.first_line).release(); }
-  | expression PLUS expression   { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Add, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
-  | expression MINUS expression  { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Sub, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
-  | expression STAR expression   { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Mul, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
-  | expression SLASH expression  { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Div, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
+    INTEGER_LITERAL              { $$ = makeIntLiteral(session->arena, $1, @1.first_line); }
+  | FLOAT_LITERAL                { $$ = makeFloatLiteral(session->arena, $1, @1.first_line); }
+  | STRING_LITERAL               { $$ = makeStringLiteral(session->arena, $1.view(), @1.first_line); }
+  | CHAR_LITERAL                 { $$ = makeCharLiteral(session->arena, $1, @1.first_line); }
+  | TRUE                         { $$ = makeBoolLiteral(session->arena, true, @1.first_line); }
+  | FALSE                        { $$ = makeBoolLiteral(session->arena, false, @1.first_line); }
+  | IDENTIFIER                   { $$ = makeIdentifier(session->arena, $1, session->interner.name($1), @1.first_line); }
+  | expression PLUS expression   { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::Add, $3, @2.first_line); }
+  | expression MINUS expression  { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::Sub, $3, @2.first_line); }
+  | expression STAR expression   { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::Mul, $3, @2.first_line); }
+  | expression SLASH expression  { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::Div, $3, @2.first_line); }
   | LPAREN expression RPAREN     { $$ = $2; }
-  | expression EQ expression     { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Eq, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
-  | expression NEQ expression    { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Neq, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
-  | expression LT expression     { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Lt, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
-  | expression GT expression     { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Gt, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
-  | expression LEQ expression    { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Leq, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
-  | expression GEQ expression    { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Geq, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
-  | expression AND expression    { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::And, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
-  | expression OR expression     { $$ = makeBinaryExpr(std::unique_ptr<ASTNode>($1), BinaryExprNode::Op::Or, std::unique_ptr<ASTNode>($3), @2.first_line).release(); }
-  | NOT expression               { $$ = makeUnaryExpr(UnaryExprNode::Op::Not, std::unique_ptr<ASTNode>($2), @1.first_line).release(); }
-  | MINUS expression             { $$ = makeUnaryExpr(UnaryExprNode::Op::Minus, std::unique_ptr<ASTNode>($2), @1.first_line).release(); }
-  | INPUT LPAREN RPAREN          { $$ = makeBuiltinCall("input", {}, @1.first_line).release(); }
+  | expression EQ expression     { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::Eq, $3, @2.first_line); }
+  | expression NEQ expression    { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::Neq, $3, @2.first_line); }
+  | expression LT expression     { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::Lt, $3, @2.first_line); }
+  | expression GT expression     { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::Gt, $3, @2.first_line); }
+  | expression LEQ expression    { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::Leq, $3, @2.first_line); }
+  | expression GEQ expression    { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::Geq, $3, @2.first_line); }
+  | expression AND expression    { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::And, $3, @2.first_line); }
+  | expression OR expression     { $$ = makeBinaryExpr(session->arena, $1, BinaryExprNode::Op::Or, $3, @2.first_line); }
+  | NOT expression               { $$ = makeUnaryExpr(session->arena, UnaryExprNode::Op::Not, $2, @1.first_line); }
+  | MINUS expression             { $$ = makeUnaryExpr(session->arena, UnaryExprNode::Op::Minus, $2, @1.first_line); }
+  | INPUT LPAREN RPAREN          { $$ = makeBuiltinCall(session->arena, "input", NodeList(), @1.first_line); }
+  | INPUT LPAREN expression_list RPAREN {
+        $$ = makeBuiltinCall(session->arena, "input", *$3, @1.first_line);
+    }
+  | IDENTIFIER LPAREN expression_list RPAREN {
+        $$ = makeBuiltinCall(session->arena, session->interner.name($1), *$3, @1.first_line);
+    }
+  | IDENTIFIER LBRACKET expression RBRACKET {
+        $$ = makeIndexExpr(session->arena, $1, session->interner.name($1), $3, @1.first_line);
+    }
+  | LBRACKET expression_list RBRACKET { $$ = makeArrayLiteral(session->arena, $2, @1.first_line); }
+  ;
+
+expression_list:
+    expression                       { $$ = makeStatementList(session->arena); $$->push_back(session->arena, $1); }
+  | expression_list COMMA expression { $1->push_back(session->arena, $3); $$ = $1; }
   ;
 
 end:
@@ -180,6 +233,12 @@ end:
 
 %%
 
-void yyerror(const char *s) {
-    fprintf(stderr, "Parse error: %s at line %d\n", s, yylineno);
+void yyerror(YYLTYPE *loc, yyscan_t scanner, CompileSession *session, const char *s) {
+    if (strcmp(s, "memory exhausted") == 0) {
+        session->diag << "Parse error: nesting deeper than " << session->maxNesting << " levels at line " << loc->first_line << "\n";
+        session->nestingExceeded = true;
+    } else {
+        session->diag << "Parse error: " << s << " at line " << loc->first_line << "\n";
+    }
+    session->parseErrorLine = loc->first_line;
 }
@@ -0,0 +1,27 @@
+// rd_parser.h
+#pragma once
+
+#include "compile_session.h"
+
+#include <iosfwd>
+#include <string_view>
+
+typedef void *yyscan_t;
+
+// Hand-written parser for the grammar in parser.y: recursive descent for
+// statements and precedence climbing for expressions, with the precedence
+// and associativity of the Bison declarations (comparisons do not chain,
+// unary minus binds looser than * and /). It builds the same tree through
+// the same ast_interface.h factories, records the same line numbers and,
+// like yyparse, stops at the first syntax error. Selected with
+// --parser=rd.
+//
+// `scanner` is the token source CompileSession::parse hands to yyparse;
+// the result is 0 on success, also like yyparse.
+int rdParse(yyscan_t scanner, CompileSession *session);
+
+// Parse `source` with both parsers and report to `report` whether they
+// accept it alike and, if so, build identical trees (node kinds, values
+// and line numbers). Returns true when they agree.
+bool compareParsers(std::string_view source, LexerKind lexer, std::ostream &report,
+                    unsigned maxNesting = DefaultMaxNesting);
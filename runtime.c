@@ -0,0 +1,1319 @@
+// runtime.c
+//
+// Plain C so that cc can link it into executables without the C++ library.
+#define _POSIX_C_SOURCE 200809L
+
+#include "runtime.h"
+
+#include <errno.h>
+#include <float.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+enum
+{
+    OutputCapacity = 1 << 16
+};
+
+typedef struct
+{
+    size_t used;
+    bl_output_sink sink; // Null: standard output
+    void *context;
+    char data[OutputCapacity];
+} Output;
+
+static _Thread_local Output output;
+
+static void writeOut(const char *data, size_t size)
+{
+    if (output.sink)
+    {
+        output.sink(output.context, data, size);
+        return;
+    }
+    while (size > 0)
+    {
+        ssize_t written = write(STDOUT_FILENO, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return; // Nowhere left to report it
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+}
+
+void bl_flush(void)
+{
+    if (output.used == 0)
+        return;
+    writeOut(output.data, output.used);
+    output.used = 0;
+}
+
+// Where the next `size` bytes go, flushing first if they do not fit
+static char *reserve(size_t size)
+{
+    if (OutputCapacity - output.used < size)
+        bl_flush();
+    return output.data + output.used;
+}
+
+static void append(const char *data, size_t size)
+{
+    if (size > OutputCapacity)
+    {
+        bl_flush();
+        writeOut(data, size);
+        return;
+    }
+    memcpy(reserve(size), data, size);
+    output.used += size;
+}
+
+void bl_print_i32(int32_t value)
+{
+    char *out = reserve(BL_FORMAT_MAX + 1);
+    size_t length = bl_format_i32(out, value);
+    out[length] = '\n';
+    output.used += length + 1;
+}
+
+void bl_print_f32(float value)
+{
+    char *out = reserve(BL_FORMAT_MAX + 1);
+    size_t length = bl_format_f32(out, value);
+    out[length] = '\n';
+    output.used += length + 1;
+}
+
+void bl_print_f32_fixed(float value)
+{
+    char *out = reserve(BL_FORMAT_MAX + 1);
+    size_t length = bl_format_f32_fixed(out, value);
+    out[length] = '\n';
+    output.used += length + 1;
+}
+
+void bl_print_str(const bl_str *text)
+{
+    append(bl_str_data(text), bl_str_length(text));
+    append("\n", 1);
+}
+
+void bl_print_bool(int32_t value)
+{
+    append(value ? "1\n" : "0\n", 2);
+}
+
+void bl_print_char(int32_t value)
+{
+    char text[2] = {(char)value, '\n'};
+    append(text, 2);
+}
+
+void bl_array_index_error(int32_t index, int32_t length)
+{
+    char text[96];
+    int size = snprintf(text, sizeof text, "Runtime error: array index %d out of bounds (length %d)\n", (int)index,
+                        (int)length);
+    append(text, (size_t)size);
+}
+
+void bl_division_error(void)
+{
+    static const char text[] = "Runtime error: division by zero\n";
+    append(text, sizeof text - 1);
+}
+
+void bl_set_output(bl_output_sink sink, void *context)
+{
+    bl_flush();
+    output.sink = sink;
+    output.context = context;
+}
+
+// ===== Strings =====
+
+_Static_assert(sizeof(bl_str) == 16, "generated code treats a string as two 64-bit words");
+
+enum
+{
+    StringBufferMinimum = 64
+};
+
+// Where the text of large strings is kept, freed all at once. A buffer
+// starts with the text of the string it was made for, and used is where
+// the longest string starting there ends.
+typedef struct StringBuffer
+{
+    struct StringBuffer *previous;
+    const void *owner; // &stringBuffers of the thread that made it
+    size_t used;
+    size_t capacity;
+    char data[];
+} StringBuffer;
+
+static _Thread_local StringBuffer *stringBuffers;
+
+void bl_str_make(bl_str *result, const char *data, size_t length)
+{
+    bl_str s;
+    memset(&s, 0, sizeof s);
+    if (length <= BL_STR_SMALL_MAX)
+    {
+        if (length)
+            memcpy(s.small.text, data, length);
+        s.small.size = (uint8_t)length;
+    }
+    else
+    {
+        s.large.data = data;
+        s.large.length = (uint32_t)length;
+        s.large.size = BL_STR_LARGE;
+    }
+    *result = s;
+}
+
+// A large string of length bytes at the start of a new buffer with room
+// for capacity, for the caller to fill in; null, and "", if there is no
+// memory for it
+static char *newLargeString(bl_str *result, size_t length, size_t capacity)
+{
+    memset(result, 0, sizeof *result);
+    if (length > UINT32_MAX)
+        return NULL;
+    if (capacity < StringBufferMinimum)
+        capacity = StringBufferMinimum;
+    StringBuffer *buffer = malloc(sizeof *buffer + capacity);
+    if (!buffer)
+        return NULL;
+    buffer->previous = stringBuffers;
+    buffer->owner = &stringBuffers;
+    buffer->used = length;
+    buffer->capacity = capacity;
+    stringBuffers = buffer;
+    result->large.data = buffer->data;
+    result->large.length = (uint32_t)length;
+    result->large.buffered = 1;
+    result->large.size = BL_STR_LARGE;
+    return buffer->data;
+}
+
+void bl_str_concat(bl_str *result, const bl_str *left, const bl_str *right)
+{
+    size_t leftLength = bl_str_length(left), rightLength = bl_str_length(right);
+    size_t length = leftLength + rightLength;
+    const char *rightText = bl_str_data(right);
+    bl_str s;
+    if (length <= BL_STR_SMALL_MAX)
+    {
+        // Both small too
+        memset(&s, 0, sizeof s);
+        memcpy(s.small.text, left->small.text, leftLength);
+        memcpy(s.small.text + leftLength, rightText, rightLength);
+        s.small.size = (uint8_t)length;
+        *result = s;
+        return;
+    }
+    if (left->large.size == BL_STR_LARGE && left->large.buffered && length <= UINT32_MAX)
+    {
+        StringBuffer *buffer = (StringBuffer *)(left->large.data - offsetof(StringBuffer, data));
+        if (buffer->owner == &stringBuffers && buffer->used == leftLength &&
+            buffer->capacity - leftLength >= rightLength)
+        {
+            // Nothing after left in its buffer: right goes there. Every
+            // string in the buffer keeps its text, as they only ever grow.
+            // Only in this thread's own buffers: the body of a parallel
+            // repeat reads the caller's strings from other threads.
+            memcpy(buffer->data + leftLength, rightText, rightLength);
+            buffer->used = length;
+            s = *left;
+            s.large.length = (uint32_t)length;
+            *result = s;
+            return;
+        }
+    }
+    char *text = newLargeString(&s, length, length <= SIZE_MAX / 2 ? length * 2 : length);
+    if (text)
+    {
+        memcpy(text, bl_str_data(left), leftLength);
+        memcpy(text + leftLength, rightText, rightLength);
+    }
+    *result = s;
+}
+
+int32_t bl_str_equal(const bl_str *a, const bl_str *b)
+{
+    if (a->words[0] == b->words[0] && a->words[1] == b->words[1])
+        return 1;
+    // Different small strings differ in their words; only two large ones
+    // can hold the same text at different places
+    if (a->large.size != BL_STR_LARGE || b->large.size != BL_STR_LARGE || a->large.length != b->large.length)
+        return 0;
+    return memcmp(a->large.data, b->large.data, a->large.length) == 0;
+}
+
+// Long text goes to memcmp, which the C library vectorizes for the CPU it
+// runs on (AVX2 and up where there is one), and which orders by the first
+// differing byte as unsigned, as here
+int32_t bl_str_compare(const bl_str *a, const bl_str *b)
+{
+    size_t aLength = bl_str_length(a), bLength = bl_str_length(b);
+    size_t common = aLength < bLength ? aLength : bLength;
+    int order;
+#ifdef __SSE2__
+    if (a->small.size != BL_STR_LARGE && b->small.size != BL_STR_LARGE)
+    {
+        // Both inline: one compare of the whole values, which finds the first
+        // differing byte without a call; past the text only the padding and
+        // size are compared, and the mask drops them
+        __m128i same = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(const void *)a),
+                                      _mm_loadu_si128((const __m128i *)(const void *)b));
+        unsigned differ = ((unsigned)_mm_movemask_epi8(same) ^ 0xFFFFu) & ((1u << common) - 1);
+        if (differ)
+        {
+            unsigned at = (unsigned)__builtin_ctz(differ);
+            return (int32_t)(unsigned char)a->small.text[at] - (int32_t)(unsigned char)b->small.text[at];
+        }
+        order = 0;
+    }
+    else
+#endif
+        order = common ? memcmp(bl_str_data(a), bl_str_data(b), common) : 0;
+    if (order)
+        return order < 0 ? -1 : 1;
+    return (aLength > bLength) - (aLength < bLength);
+}
+
+void bl_free_strings(void)
+{
+    while (stringBuffers)
+    {
+        StringBuffer *previous = stringBuffers->previous;
+        free(stringBuffers);
+        stringBuffers = previous;
+    }
+}
+
+// ===== Number formatting =====
+
+static const char digitPairs[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                                 "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                                 "8081828384858687888990919293949596979899";
+
+static unsigned decimalLength(uint64_t value)
+{
+    unsigned length = 1;
+    for (; value >= 10000; value /= 10000)
+        length += 4;
+    return length + (value >= 10) + (value >= 100) + (value >= 1000);
+}
+
+// The last `count` digits of value, with leading zeros, two at a time
+// from the table
+static void writeDigits(char *out, uint64_t value, unsigned count)
+{
+    char *at = out + count;
+    for (; count >= 2; count -= 2)
+    {
+        at -= 2;
+        memcpy(at, digitPairs + 2 * (value % 100), 2);
+        value /= 100;
+    }
+    if (count)
+        *--at = (char)('0' + value % 10);
+}
+
+static size_t writeNatural(char *out, uint64_t value)
+{
+    unsigned length = decimalLength(value);
+    writeDigits(out, value, length);
+    return length;
+}
+
+size_t bl_format_i32(char *out, int32_t value)
+{
+    size_t length = 0;
+    if (value < 0)
+        out[length++] = '-';
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    return length + writeNatural(out + length, magnitude);
+}
+
+// Shortest round-trip digits: Ryu (Ulf Adams, "Ryu: Fast Float-to-String
+// Conversion", PLDI 2018) for binary32. Of the decimals that read back as
+// the float, it finds one with the fewest digits, the closest to the
+// exact value if there are several, using 64-bit multiplications by
+// precomputed powers of five.
+typedef struct
+{
+    uint32_t digits;
+    int32_t exponent; // The float is digits * 10^exponent
+} Decimal;
+
+enum
+{
+    MantissaBits = 23,
+    ExponentBias = 127,
+    Pow5InvBitCount = 59,
+    Pow5BitCount = 61
+};
+
+// pow5InvSplit[q] = floor(2^(pow5Bits(q) - 1 + 59) / 5^q) + 1 and
+// pow5Split[i] = the top 61 bits of 5^i
+static const uint64_t pow5InvSplit[31] = {
+    576460752303423489u, 461168601842738791u, 368934881474191033u, 295147905179352826u, 472236648286964522u,
+    377789318629571618u, 302231454903657294u, 483570327845851670u, 386856262276681336u, 309485009821345069u,
+    495176015714152110u, 396140812571321688u, 316912650057057351u, 507060240091291761u, 405648192073033409u,
+    324518553658426727u, 519229685853482763u, 415383748682786211u, 332306998946228969u, 531691198313966350u,
+    425352958651173080u, 340282366920938464u, 544451787073501542u, 435561429658801234u, 348449143727040987u,
+    557518629963265579u, 446014903970612463u, 356811923176489971u, 570899077082383953u, 456719261665907162u,
+    365375409332725730u,
+};
+
+static const uint64_t pow5Split[47] = {
+    1152921504606846976u, 1441151880758558720u, 1801439850948198400u, 2251799813685248000u,
+    1407374883553280000u, 1759218604441600000u, 2199023255552000000u, 1374389534720000000u,
+    1717986918400000000u, 2147483648000000000u, 1342177280000000000u, 1677721600000000000u,
+    2097152000000000000u, 1310720000000000000u, 1638400000000000000u, 2048000000000000000u,
+    1280000000000000000u, 1600000000000000000u, 2000000000000000000u, 1250000000000000000u,
+    1562500000000000000u, 1953125000000000000u, 1220703125000000000u, 1525878906250000000u,
+    1907348632812500000u, 1192092895507812500u, 1490116119384765625u, 1862645149230957031u,
+    1164153218269348144u, 1455191522836685180u, 1818989403545856475u, 2273736754432320594u,
+    1421085471520200371u, 1776356839400250464u, 2220446049250313080u, 1387778780781445675u,
+    1734723475976807094u, 2168404344971008868u, 1355252715606880542u, 1694065894508600678u,
+    2117582368135750847u, 1323488980084844279u, 1654361225106055349u, 2067951531382569187u,
+    1292469707114105741u, 1615587133892632177u, 2019483917365790221u,
+};
+
+// ceil(log2(5^e)), 1 for e = 0
+static int32_t pow5Bits(int32_t e)
+{
+    return (int32_t)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e)) and floor(log10(5^e))
+static uint32_t log10Pow2(int32_t e)
+{
+    return ((uint32_t)e * 78913) >> 18;
+}
+
+static uint32_t log10Pow5(int32_t e)
+{
+    return ((uint32_t)e * 732923) >> 20;
+}
+
+static bool multipleOfPow5(uint32_t value, uint32_t p)
+{
+    uint32_t count = 0;
+    for (; value % 5 == 0; value /= 5)
+        ++count;
+    return count >= p;
+}
+
+static bool multipleOfPow2(uint32_t value, uint32_t p)
+{
+    return (value & ((1u << p) - 1)) == 0;
+}
+
+// (m * factor) >> shift, for shift > 32
+static uint32_t mulShift(uint32_t m, uint64_t factor, int32_t shift)
+{
+    uint64_t low = (uint64_t)m * (uint32_t)factor;
+    uint64_t high = (uint64_t)m * (uint32_t)(factor >> 32);
+    return (uint32_t)(((low >> 32) + high) >> (shift - 32));
+}
+
+// Finite and non-zero
+static Decimal shortestDecimal(uint32_t ieeeMantissa, uint32_t ieeeExponent)
+{
+    int32_t e2;
+    uint32_t m2;
+    if (ieeeExponent == 0)
+    {
+        e2 = 1 - ExponentBias - MantissaBits - 2;
+        m2 = ieeeMantissa;
+    }
+    else
+    {
+        e2 = (int32_t)ieeeExponent - ExponentBias - MantissaBits - 2;
+        m2 = (1u << MantissaBits) | ieeeMantissa;
+    }
+    bool acceptBounds = (m2 & 1) == 0; // Round half to even when reading back
+
+    // The float and the halfway points to its neighbours, times 4
+    uint32_t mv = 4 * m2;
+    uint32_t mp = 4 * m2 + 2;
+    uint32_t mmShift = ieeeMantissa != 0 || ieeeExponent <= 1; // The gap below is smaller at a power of two
+    uint32_t mm = 4 * m2 - 1 - mmShift;
+
+    // The three scaled to decimal, and whether the digits dropped on the
+    // way were all zeros
+    uint32_t vr, vp, vm;
+    int32_t e10;
+    bool vmIsTrailingZeros = false, vrIsTrailingZeros = false;
+    uint32_t lastRemovedDigit = 0;
+    if (e2 >= 0)
+    {
+        uint32_t q = log10Pow2(e2);
+        e10 = (int32_t)q;
+        int32_t k = Pow5InvBitCount + pow5Bits((int32_t)q) - 1;
+        int32_t i = -e2 + (int32_t)q + k;
+        vr = mulShift(mv, pow5InvSplit[q], i);
+        vp = mulShift(mp, pow5InvSplit[q], i);
+        vm = mulShift(mm, pow5InvSplit[q], i);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10)
+        {
+            // One digit fewer is dropped below; which one it is decides rounding
+            int32_t l = Pow5InvBitCount + pow5Bits((int32_t)q - 1) - 1;
+            lastRemovedDigit = mulShift(mv, pow5InvSplit[q - 1], -e2 + (int32_t)q - 1 + l) % 10;
+        }
+        if (q <= 9)
+        {
+            // At most one of the three is a multiple of 5
+            if (mv % 5 == 0)
+                vrIsTrailingZeros = multipleOfPow5(mv, q);
+            else if (acceptBounds)
+                vmIsTrailingZeros = multipleOfPow5(mm, q);
+            else
+                vp -= multipleOfPow5(mp, q);
+        }
+    }
+    else
+    {
+        uint32_t q = log10Pow5(-e2);
+        e10 = (int32_t)q + e2;
+        int32_t i = -e2 - (int32_t)q;
+        int32_t k = pow5Bits(i) - Pow5BitCount;
+        int32_t j = (int32_t)q - k;
+        vr = mulShift(mv, pow5Split[i], j);
+        vp = mulShift(mp, pow5Split[i], j);
+        vm = mulShift(mm, pow5Split[i], j);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10)
+        {
+            j = (int32_t)q - 1 - (pow5Bits(i + 1) - Pow5BitCount);
+            lastRemovedDigit = mulShift(mv, pow5Split[i + 1], j) % 10;
+        }
+        if (q <= 1)
+        {
+            // mv has two trailing zero bits, mp one, mm one exactly when mmShift is set
+            vrIsTrailingZeros = true;
+            if (acceptBounds)
+                vmIsTrailingZeros = mmShift == 1;
+            else
+                --vp;
+        }
+        else if (q < 31)
+            vrIsTrailingZeros = multipleOfPow2(mv, q - 1);
+    }
+
+    // Drop digits while the interval still holds a shorter number
+    int32_t removed = 0;
+    uint32_t digits;
+    if (vmIsTrailingZeros || vrIsTrailingZeros)
+    {
+        for (; vp / 10 > vm / 10; ++removed)
+        {
+            vmIsTrailingZeros &= vm % 10 == 0;
+            vrIsTrailingZeros &= lastRemovedDigit == 0;
+            lastRemovedDigit = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+        }
+        if (vmIsTrailingZeros)
+        {
+            for (; vm % 10 == 0; ++removed)
+            {
+                vrIsTrailingZeros &= lastRemovedDigit == 0;
+                lastRemovedDigit = vr % 10;
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+            }
+        }
+        if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0)
+            lastRemovedDigit = 4; // Exactly halfway: round to even
+        digits = vr + ((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5);
+    }
+    else
+    {
+        // The common case: no exact halfway point to care about
+        for (; vp / 10 > vm / 10; ++removed)
+        {
+            lastRemovedDigit = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+        }
+        digits = vr + (vr == vm || lastRemovedDigit >= 5);
+    }
+    Decimal result = {digits, e10 + removed};
+    return result;
+}
+
+// "inf" or "nan" after the sign, if the exponent says so
+static size_t formatSpecial(char *out, uint32_t ieeeMantissa)
+{
+    memcpy(out, ieeeMantissa ? "nan" : "inf", 3);
+    return 3;
+}
+
+size_t bl_format_f32(char *out, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof bits);
+    uint32_t ieeeMantissa = bits & ((1u << MantissaBits) - 1);
+    uint32_t ieeeExponent = (bits >> MantissaBits) & 0xff;
+    if (ieeeExponent == 0xff && ieeeMantissa)
+        return formatSpecial(out, ieeeMantissa);
+
+    size_t length = 0;
+    if (bits >> 31)
+        out[length++] = '-';
+    if (ieeeExponent == 0xff)
+        return length + formatSpecial(out + length, 0);
+    if (ieeeExponent == 0 && ieeeMantissa == 0)
+    {
+        memcpy(out + length, "0.0", 3);
+        return length + 3;
+    }
+
+    Decimal decimal = shortestDecimal(ieeeMantissa, ieeeExponent);
+    char first[9];
+    int32_t count = (int32_t)writeNatural(first, decimal.digits);
+    int32_t point = decimal.exponent + count; // Digits before the decimal point
+    char *at = out + length;
+
+    if (point > -4 && point <= 16)
+    {
+        if (point <= 0)
+        {
+            // 0.000ddd
+            memcpy(at, "0.000", (size_t)(2 - point));
+            at += 2 - point;
+            memcpy(at, first, (size_t)count);
+            at += count;
+        }
+        else if (point >= count)
+        {
+            // ddd000.0
+            memcpy(at, first, (size_t)count);
+            at += count;
+            memset(at, '0', (size_t)(point - count));
+            at += point - count;
+            memcpy(at, ".0", 2);
+            at += 2;
+        }
+        else
+        {
+            // dd.ddd
+            memcpy(at, first, (size_t)point);
+            at += point;
+            *at++ = '.';
+            memcpy(at, first + point, (size_t)(count - point));
+            at += count - point;
+        }
+        return (size_t)(at - out);
+    }
+
+    // d.ddde+XX
+    *at++ = first[0];
+    if (count > 1)
+    {
+        *at++ = '.';
+        memcpy(at, first + 1, (size_t)(count - 1));
+        at += count - 1;
+    }
+    int32_t exponent = point - 1;
+    *at++ = 'e';
+    *at++ = exponent < 0 ? '-' : '+';
+    memcpy(at, digitPairs + 2 * (exponent < 0 ? -exponent : exponent), 2);
+    at += 2;
+    return (size_t)(at - out);
+}
+
+// printf's "%f" is exact: the float's binary value rounded to six decimals,
+// half to even. Floats below 2^24 times 10^6 fit in 64 bits, so the
+// fraction is one shift and a rounding step; larger ones are whole numbers,
+// built up in base 10^9 limbs as the exponent doubles them.
+size_t bl_format_f32_fixed(char *out, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof bits);
+    uint32_t ieeeMantissa = bits & ((1u << MantissaBits) - 1);
+    uint32_t ieeeExponent = (bits >> MantissaBits) & 0xff;
+
+    size_t length = 0;
+    if (bits >> 31)
+        out[length++] = '-';
+    if (ieeeExponent == 0xff)
+        return length + formatSpecial(out + length, ieeeMantissa);
+
+    uint64_t m = ieeeExponent ? (1u << MantissaBits) | ieeeMantissa : ieeeMantissa;
+    int32_t e = (ieeeExponent ? (int32_t)ieeeExponent : 1) - ExponentBias - MantissaBits;
+    if (e >= 0)
+    {
+        // Below 2^128: at most five limbs
+        uint32_t limbs[5] = {(uint32_t)(m % 1000000000), (uint32_t)(m / 1000000000)};
+        int used = limbs[1] ? 2 : 1;
+        while (e > 0)
+        {
+            int32_t shift = e < 32 ? e : 32;
+            uint64_t carry = 0;
+            for (int i = 0; i < used; ++i)
+            {
+                uint64_t limb = ((uint64_t)limbs[i] << shift) + carry;
+                limbs[i] = (uint32_t)(limb % 1000000000);
+                carry = limb / 1000000000;
+            }
+            while (carry)
+            {
+                limbs[used++] = (uint32_t)(carry % 1000000000);
+                carry /= 1000000000;
+            }
+            e -= shift;
+        }
+        length += writeNatural(out + length, limbs[used - 1]);
+        for (int i = used - 2; i >= 0; --i, length += 9)
+            writeDigits(out + length, limbs[i], 9);
+        memcpy(out + length, ".000000", 7);
+        return length + 7;
+    }
+
+    uint32_t shift = (uint32_t)-e;
+    uint64_t scaled = m * 1000000; // Below 2^44
+    uint64_t units = 0;            // The value in millionths, rounded
+    if (shift < 64)
+    {
+        units = scaled >> shift;
+        uint64_t rest = scaled & ((UINT64_C(1) << shift) - 1);
+        uint64_t half = UINT64_C(1) << (shift - 1);
+        units += rest > half || (rest == half && (units & 1));
+    }
+    length += writeNatural(out + length, units / 1000000);
+    out[length++] = '.';
+    writeDigits(out + length, units % 1000000, 6);
+    return length + 6;
+}
+
+// ===== Input =====
+
+enum
+{
+    InputCapacity = 1 << 16
+};
+
+typedef struct
+{
+    const char *next; // First byte not consumed
+    const char *end;  // End of the bytes at hand
+    bool ended;       // Nothing follows end: a bl_set_input buffer, a mapped file or end of file
+    bool started;     // Standard input has been opened (mapped, or buffer allocated)
+    char *buffer;     // What standard input is read into
+    size_t capacity;  // Of buffer: InputCapacity, or more for a longer token
+    const char *map;  // Or all of standard input, when it is a regular file
+    size_t mapSize;
+} Input;
+
+static _Thread_local Input input;
+
+static bool isSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static bool isDigit(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+// A regular file is mapped whole, which reads it without a copy; anything
+// else gets a buffer that read(2) fills as it is consumed
+static void openStandardInput(void)
+{
+    input.started = true;
+    struct stat info;
+    off_t offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+    if (offset >= 0 && fstat(STDIN_FILENO, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > offset)
+    {
+        void *map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+        if (map != MAP_FAILED)
+        {
+            posix_madvise(map, (size_t)info.st_size, POSIX_MADV_SEQUENTIAL);
+            input.map = map;
+            input.mapSize = (size_t)info.st_size;
+            input.next = input.map + offset;
+            input.end = input.map + input.mapSize;
+            input.ended = true;
+            return;
+        }
+    }
+    input.buffer = malloc(InputCapacity);
+    input.capacity = InputCapacity;
+    input.next = input.end = input.buffer;
+    input.ended = !input.buffer;
+}
+
+// Reads more of standard input after the bytes at hand, which move to the
+// front of the buffer first (a bigger one if they fill it), so pointers
+// into it are stale after a true return. False at the end of the input.
+static bool moreInput(void)
+{
+    if (!input.started)
+    {
+        openStandardInput();
+        if (input.next != input.end)
+            return true;
+    }
+    if (input.ended)
+        return false;
+    size_t unread = (size_t)(input.end - input.next);
+    if (unread == input.capacity)
+    {
+        char *bigger = realloc(input.buffer, input.capacity * 2);
+        if (!bigger)
+            return false;
+        input.buffer = bigger;
+        input.capacity *= 2;
+    }
+    else
+        memmove(input.buffer, input.next, unread);
+    input.next = input.buffer;
+    input.end = input.buffer + unread;
+
+    bl_flush(); // The read may wait for a person to answer what was printed
+    ssize_t got;
+    do
+        got = read(STDIN_FILENO, input.buffer + unread, input.capacity - unread);
+    while (got < 0 && errno == EINTR);
+    if (got <= 0)
+    {
+        input.ended = true;
+        return false;
+    }
+    input.end += got;
+    return true;
+}
+
+// The first byte that is not white space, reading more as needed; null at
+// the end of the input
+static const char *skipSpace(void)
+{
+    for (;;)
+    {
+        const char *p = input.next;
+        while (p < input.end && isSpace(*p))
+            ++p;
+        input.next = p;
+        if (p < input.end)
+            return p;
+        if (!moreInput())
+            return NULL;
+    }
+}
+
+// Each reader below parses the token at input.next up to input.end. One
+// that gets to input.end may be cut short, so it asks for more input and,
+// if some came, parses the token again from its start in the moved buffer.
+
+int32_t bl_input_i32(void)
+{
+    for (;;)
+    {
+        const char *p = skipSpace();
+        if (!p)
+            return 0;
+        bool negative = *p == '-';
+        if (*p == '-' || *p == '+')
+            ++p;
+        const char *digits = p;
+        uint32_t value = 0; // Wraps as scanf's does through long
+        while (p < input.end && isDigit(*p))
+            value = value * 10 + (uint32_t)(*p++ - '0');
+        if (p == input.end && moreInput())
+            continue;
+        if (p == digits)
+            return 0; // Not a number; it stays for the next read, as with scanf
+        input.next = p;
+        return (int32_t)(negative ? 0u - value : value);
+    }
+}
+
+static const double exactPowersOf10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// strtof on the token at text, for what the fast path does not take: inf,
+// nan, hexadecimal and the rare decimals below
+static float slowFloat(const char *text, const char *end, const char **stop, bool *cut)
+{
+    const char *tokenEnd = text;
+    while (tokenEnd < end && !isSpace(*tokenEnd))
+        ++tokenEnd;
+    *cut = tokenEnd == end;
+    size_t length = (size_t)(tokenEnd - text);
+    char local[128];
+    char *copy = length < sizeof local ? local : malloc(length + 1);
+    if (!copy)
+    {
+        *stop = text;
+        return 0;
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    char *after;
+    float value = strtof(copy, &after);
+    *stop = text + (after - copy);
+    if (copy != local)
+        free(copy);
+    return value;
+}
+
+// Most decimals have at most 19 significant digits, a mantissa below 2^53
+// and a small exponent, so that the mantissa and the power of ten are
+// exact doubles and one multiplication or division rounds the decimal
+// correctly to double. Rounding that to float gives the float nearest the
+// decimal, unless it fell exactly halfway between two floats, where the
+// first rounding may have decided the second; those go to strtof.
+static float parseFloat(const char *text, const char *end, const char **stop, bool *cut)
+{
+    const char *p = text;
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+')
+        ++p;
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int exponent = 0;
+    bool digits = false;
+    bool dropped = false; // A non-zero digit past the 19th
+    for (; p < end && isDigit(*p); ++p)
+    {
+        digits = true;
+        if (significant < 19)
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            significant += mantissa != 0;
+        }
+        else
+        {
+            ++exponent;
+            dropped |= *p != '0';
+        }
+    }
+    if (p < end && *p == '.')
+    {
+        for (++p; p < end && isDigit(*p); ++p)
+        {
+            digits = true;
+            if (significant < 19)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                significant += mantissa != 0;
+                --exponent;
+            }
+            else
+                dropped |= *p != '0';
+        }
+    }
+    if (!digits || dropped || (p < end && (*p | 0x20) == 'x'))
+        return slowFloat(text, end, stop, cut);
+
+    *cut = p == end;
+    if (p < end && (*p | 0x20) == 'e')
+    {
+        const char *q = p + 1;
+        bool negativeExponent = q < end && *q == '-';
+        if (q < end && (*q == '-' || *q == '+'))
+            ++q;
+        int written = 0;
+        for (; q < end && isDigit(*q); ++q)
+            if (written < 100000)
+                written = written * 10 + (*q - '0');
+        *cut = q == end;
+        if (q > p + 1 && isDigit(q[-1]))
+        {
+            exponent += negativeExponent ? -written : written;
+            p = q;
+        }
+    }
+    *stop = p;
+
+    if (mantissa == 0)
+        return negative ? -0.0f : 0.0f;
+    if (mantissa <= UINT64_C(1) << 53 && exponent >= -22 && exponent <= 22)
+    {
+        double value = (double)mantissa;
+        value = exponent < 0 ? value / exactPowersOf10[-exponent] : value * exactPowersOf10[exponent];
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof bits);
+        // The 29 bits float drops from the mantissa, at a midpoint
+        if (value >= FLT_MIN && value <= FLT_MAX && (bits & 0x1FFFFFFF) != 0x10000000)
+            return (float)(negative ? -value : value);
+    }
+    bool slowCut;
+    return slowFloat(text, end, stop, &slowCut);
+}
+
+float bl_input_f32(void)
+{
+    for (;;)
+    {
+        const char *p = skipSpace();
+        if (!p)
+            return 0;
+        const char *stop;
+        bool cut;
+        float value = parseFloat(p, input.end, &stop, &cut);
+        if (cut && moreInput())
+            continue;
+        input.next = stop;
+        return value;
+    }
+}
+
+void bl_input_str(bl_str *result)
+{
+    for (;;)
+    {
+        const char *p = skipSpace();
+        if (!p)
+        {
+            bl_str_make(result, NULL, 0);
+            return;
+        }
+        const char *q = p;
+        while (q < input.end && !isSpace(*q))
+            ++q;
+        if (q == input.end && moreInput())
+            continue;
+        input.next = q;
+        // The token is copied out of the input, which moves on
+        size_t length = (size_t)(q - p);
+        if (length <= BL_STR_SMALL_MAX)
+            bl_str_make(result, p, length);
+        else
+        {
+            char *text = newLargeString(result, length, length);
+            if (text)
+                memcpy(text, p, length);
+        }
+        return;
+    }
+}
+
+void bl_set_input(const char *data, size_t size)
+{
+    if (input.map)
+    {
+        // Leave the file where reading stopped, as a read(2) loop would
+        lseek(STDIN_FILENO, input.next - input.map, SEEK_SET);
+        munmap((void *)input.map, input.mapSize);
+    }
+    free(input.buffer);
+    memset(&input, 0, sizeof input);
+    if (data)
+    {
+        input.next = data;
+        input.end = data + size;
+        input.ended = true;
+    }
+}
+
+// ===== Parallel repeat =====
+
+enum
+{
+    MaxWorkers = 256
+};
+
+int32_t bl_parallel_chunks(int32_t begin, int32_t end)
+{
+    int64_t count = (int64_t)end - begin;
+    if (count <= 0)
+        return 0;
+    return count < BL_PARALLEL_CHUNKS ? (int32_t)count : BL_PARALLEL_CHUNKS;
+}
+
+int32_t bl_parallel_bound(int32_t begin, int32_t end, int32_t chunk)
+{
+    int32_t chunks = bl_parallel_chunks(begin, end);
+    if (chunks == 0)
+        return begin;
+    return (int32_t)(begin + ((int64_t)end - begin) * chunk / chunks);
+}
+
+// A thread's share of the chunks still to run, [next, end) packed as
+// next << 32 | end so that taking from either end is one compare-exchange.
+// The owner takes chunks from the front; a thread whose own range is empty
+// steals the back half of another's.
+typedef struct
+{
+    _Atomic uint64_t range;
+    char padding[64 - sizeof(uint64_t)]; // A cache line each
+} ChunkRange;
+
+typedef struct
+{
+    pthread_t thread;
+    uint32_t index; // Its range in ranges; the caller's is 0
+    uint64_t seen;  // The last job it looked at
+} Worker;
+
+// The workers wait on start for a job: a new generation. Those it needs,
+// helpers of them, work through it with the thread that posted it, and the
+// last to finish signals finished. busy is held by that thread for the
+// whole job, so a second caller (another program of compile_server) runs
+// its chunks itself instead of waiting.
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t finished;
+    pthread_mutex_t busy;
+    uint32_t started; // Worker threads running
+    uint64_t generation;
+    uint32_t helpers;
+    uint32_t active; // Helpers still in the job
+
+    // The job
+    bl_parallel_body body;
+    void *context;
+    int32_t begin;
+    int32_t end;
+    char *partials;
+    uint32_t partialSize;
+    _Atomic int32_t failedChunk; // Lowest chunk that failed, or the chunk count
+    int32_t error[2];            // Its error, under lock
+
+    Worker workers[MaxWorkers];
+    ChunkRange ranges[MaxWorkers];
+} Pool;
+
+static Pool pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .finished = PTHREAD_COND_INITIALIZER,
+    .busy = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static _Atomic uint32_t workerCount; // 0 until decided, see bl_parallel_workers
+static _Thread_local bool inParallel; // A worker, or a caller running a job
+
+void bl_parallel_set_workers(uint32_t count)
+{
+    atomic_store(&workerCount, count > MaxWorkers ? MaxWorkers : count);
+}
+
+uint32_t bl_parallel_workers(void)
+{
+    uint32_t count = atomic_load(&workerCount);
+    if (count)
+        return count;
+    const char *configured = getenv("BITLANG_WORKERS");
+    char *end = NULL;
+    unsigned long wanted = configured ? strtoul(configured, &end, 10) : 0;
+    if (!configured || end == configured || *end != '\0' || wanted == 0)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        wanted = processors > 0 ? (unsigned long)processors : 1;
+    }
+    count = wanted > MaxWorkers ? MaxWorkers : (uint32_t)wanted;
+    atomic_store(&workerCount, count);
+    return count;
+}
+
+static int32_t runChunks(bl_parallel_body body, void *context, int32_t begin, int32_t end, char *partials,
+                         uint32_t partialSize, int32_t *error)
+{
+    int32_t chunks = bl_parallel_chunks(begin, end);
+    for (int32_t chunk = 0; chunk < chunks; ++chunk)
+        if (body(context, bl_parallel_bound(begin, end, chunk), bl_parallel_bound(begin, end, chunk + 1),
+                 partials + (size_t)chunk * partialSize, error))
+            return 1;
+    return 0;
+}
+
+static void runChunk(int32_t chunk)
+{
+    // Chunks past one that failed do not matter any more
+    if (chunk > atomic_load_explicit(&pool.failedChunk, memory_order_relaxed))
+        return;
+    int32_t error[2];
+    if (!pool.body(pool.context, bl_parallel_bound(pool.begin, pool.end, chunk),
+                   bl_parallel_bound(pool.begin, pool.end, chunk + 1),
+                   pool.partials + (size_t)chunk * pool.partialSize, error))
+        return;
+    pthread_mutex_lock(&pool.lock);
+    if (chunk < atomic_load_explicit(&pool.failedChunk, memory_order_relaxed))
+    {
+        atomic_store_explicit(&pool.failedChunk, chunk, memory_order_relaxed);
+        pool.error[0] = error[0];
+        pool.error[1] = error[1];
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// The next chunk of the thread's own range, or -1 when it is empty
+static int32_t takeOwn(ChunkRange *own)
+{
+    uint64_t range = atomic_load_explicit(&own->range, memory_order_acquire);
+    for (;;)
+    {
+        uint32_t next = (uint32_t)(range >> 32), end = (uint32_t)range;
+        if (next >= end)
+            return -1;
+        if (atomic_compare_exchange_weak_explicit(&own->range, &range, range + ((uint64_t)1 << 32),
+                                                  memory_order_acq_rel, memory_order_acquire))
+            return (int32_t)next;
+    }
+}
+
+// Moves the back half of the fullest other range into the thread's own,
+// which is empty; false when there is nothing left to take
+static bool steal(uint32_t self, uint32_t threads)
+{
+    for (;;)
+    {
+        uint32_t victim = self, most = 0;
+        uint64_t seen = 0;
+        for (uint32_t t = 0; t < threads; ++t)
+        {
+            uint64_t range = atomic_load_explicit(&pool.ranges[t].range, memory_order_acquire);
+            uint32_t next = (uint32_t)(range >> 32), end = (uint32_t)range;
+            if (t != self && next < end && end - next > most)
+            {
+                victim = t;
+                most = end - next;
+                seen = range;
+            }
+        }
+        if (victim == self)
+            return false;
+        uint32_t next = (uint32_t)(seen >> 32), end = (uint32_t)seen;
+        uint32_t middle = next + (end - next) / 2; // The whole of a single chunk
+        if (atomic_compare_exchange_strong_explicit(&pool.ranges[victim].range, &seen,
+                                                    (uint64_t)next << 32 | middle, memory_order_acq_rel,
+                                                    memory_order_acquire))
+        {
+            atomic_store_explicit(&pool.ranges[self].range, (uint64_t)middle << 32 | end, memory_order_release);
+            return true;
+        }
+    }
+}
+
+static void work(uint32_t self, uint32_t threads)
+{
+    for (;;)
+    {
+        int32_t chunk = takeOwn(&pool.ranges[self]);
+        if (chunk >= 0)
+            runChunk(chunk);
+        else if (!steal(self, threads))
+            return;
+    }
+}
+
+static void *workerMain(void *argument)
+{
+    Worker *worker = argument;
+    inParallel = true;
+    pthread_mutex_lock(&pool.lock);
+    for (;;)
+    {
+        while (worker->seen == pool.generation)
+            pthread_cond_wait(&pool.start, &pool.lock);
+        worker->seen = pool.generation;
+        if (worker->index > pool.helpers)
+            continue;
+        uint32_t threads = pool.helpers + 1;
+        pthread_mutex_unlock(&pool.lock);
+
+        work(worker->index, threads);
+        bl_free_strings(); // Nothing the body built outlives it
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.active == 0)
+            pthread_cond_signal(&pool.finished);
+    }
+    return NULL;
+}
+
+int32_t bl_parallel_repeat(bl_parallel_body body, void *context, int32_t begin, int32_t end, void *partials,
+                           uint32_t partialSize, int32_t *error)
+{
+    int32_t chunks = bl_parallel_chunks(begin, end);
+    uint32_t threads = bl_parallel_workers();
+    if ((int32_t)threads > chunks)
+        threads = (uint32_t)chunks;
+    if (threads <= 1 || inParallel || pthread_mutex_trylock(&pool.busy) != 0)
+        return runChunks(body, context, begin, end, partials, partialSize, error);
+
+    pthread_mutex_lock(&pool.lock);
+    // Workers are started as they are first needed, and stay
+    while (pool.started < threads - 1)
+    {
+        Worker *worker = &pool.workers[pool.started];
+        worker->index = pool.started + 1;
+        worker->seen = pool.generation;
+        if (pthread_create(&worker->thread, NULL, workerMain, worker) != 0)
+            break;
+        pthread_detach(worker->thread);
+        ++pool.started;
+    }
+    if (threads > pool.started + 1)
+        threads = pool.started + 1;
+    if (threads <= 1)
+    {
+        pthread_mutex_unlock(&pool.lock);
+        pthread_mutex_unlock(&pool.busy);
+        return runChunks(body, context, begin, end, partials, partialSize, error);
+    }
+
+    pool.body = body;
+    pool.context = context;
+    pool.begin = begin;
+    pool.end = end;
+    pool.partials = partials;
+    pool.partialSize = partialSize;
+    atomic_store_explicit(&pool.failedChunk, chunks, memory_order_relaxed);
+    for (uint32_t t = 0; t < threads; ++t)
+    {
+        uint64_t first = (uint64_t)chunks * t / threads, last = (uint64_t)chunks * (t + 1) / threads;
+        atomic_store_explicit(&pool.ranges[t].range, first << 32 | last, memory_order_relaxed);
+    }
+    pool.helpers = pool.active = threads - 1;
+    ++pool.generation;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.lock);
+
+    inParallel = true;
+    work(0, threads);
+    inParallel = false;
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.active > 0)
+        pthread_cond_wait(&pool.finished, &pool.lock);
+    int32_t failed = atomic_load_explicit(&pool.failedChunk, memory_order_relaxed) < chunks;
+    if (failed)
+    {
+        error[0] = pool.error[0];
+        error[1] = pool.error[1];
+    }
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool.busy);
+    return failed;
+}
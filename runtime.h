@@ -0,0 +1,170 @@
+// runtime.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The BitLang runtime: what generated code calls for strings, output,
+// input and parallel loops instead of the C library. Prints are formatted straight into a buffer
+// that goes out with one write(2) when it fills and at bl_flush, which main
+// calls before it returns; input() parses values straight out of a large
+// buffer of standard input. The buffers belong to the calling thread, so
+// programs running on different threads of one process (compile_server)
+// keep their output and input apart. Linked into the compiler for the JIT,
+// and built on its own as libbitlang_rt.a for --emit=exe.
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A string value: 16 bytes, passed around like a number. Up to 15 bytes
+// of text are kept inline, zero padded, with the length in the last byte;
+// longer text lives elsewhere and the last byte is BL_STR_LARGE. Strings
+// of up to 15 bytes are always small, so two equal strings are either
+// small with equal words or both large. The text has no terminator.
+enum
+{
+    BL_STR_SMALL_MAX = 15,
+    BL_STR_LARGE = 0x80
+};
+typedef union bl_str
+{
+    struct
+    {
+        char text[BL_STR_SMALL_MAX];
+        uint8_t size; // The length, up to BL_STR_SMALL_MAX
+    } small;
+    struct
+    {
+        const char *data;
+        uint32_t length;
+        uint8_t buffered; // data starts a buffer of the runtime's, see bl_str_concat
+        char padding[16 - sizeof(const char *) - sizeof(uint32_t) - 2];
+        uint8_t size; // BL_STR_LARGE
+    } large;
+    uint64_t words[2];
+} bl_str;
+
+static inline const char *bl_str_data(const bl_str *s)
+{
+    return s->small.size == BL_STR_LARGE ? s->large.data : s->small.text;
+}
+
+static inline size_t bl_str_length(const bl_str *s)
+{
+    return s->small.size == BL_STR_LARGE ? s->large.length : s->small.size;
+}
+
+// A string of the length bytes at data: a copy when they fit inline, and
+// otherwise the bytes themselves, which must outlive it
+void bl_str_make(bl_str *result, const char *data, size_t length);
+
+// left followed by right; result may be either of them. Text that does not
+// fit inline goes to a buffer with room to spare, and when left is the
+// last thing in its buffer right is copied in after it instead, so that
+// s = s + x in a loop takes time and memory linear in the final length.
+void bl_str_concat(bl_str *result, const bl_str *left, const bl_str *right);
+// Nonzero if a and b hold the same text
+int32_t bl_str_equal(const bl_str *a, const bl_str *b);
+// Negative, zero or positive as a sorts before, with or after b: by the
+// first byte that differs, as unsigned, or else the shorter first
+int32_t bl_str_compare(const bl_str *a, const bl_str *b);
+
+// Frees the text of every string the calling thread has built or read.
+// Its strings are invalid afterwards; a program that exits need not call it.
+void bl_free_strings(void);
+
+// Each prints the value and a newline
+void bl_print_i32(int32_t value);       // As printf("%d")
+void bl_print_f32(float value);         // Shortest round trip, see bl_format_f32
+void bl_print_f32_fixed(float value);   // As printf("%f"), for --float-format=fixed
+void bl_print_str(const bl_str *text);
+void bl_print_bool(int32_t value); // 0 or 1
+void bl_print_char(int32_t value); // %c
+
+// "Runtime error: array index <index> out of bounds (length <length>)"
+void bl_array_index_error(int32_t index, int32_t length);
+// "Runtime error: division by zero", for an integer division
+void bl_division_error(void);
+
+// The text the prints above write, without the newline, for the VM to
+// share: each writes at most BL_FORMAT_MAX bytes to out, no terminator,
+// and returns how many
+enum
+{
+    BL_FORMAT_MAX = 48
+};
+size_t bl_format_i32(char *out, int32_t value);
+// The shortest decimal that reads back as exactly value: fixed notation
+// for 1e-4 <= |value| < 1e16 ("0.1", "250.0"), scientific past that
+// ("1e+16", "1.5e-05"), and inf, -inf and nan
+size_t bl_format_f32(char *out, float value);
+// Six decimals, exactly rounded, byte for byte what printf("%f") prints
+size_t bl_format_f32_fixed(char *out, float value);
+
+// Writes out everything buffered so far
+void bl_flush(void);
+
+// Sends the calling thread's output to sink rather than standard output;
+// a null sink restores standard output. What is buffered goes to the old
+// destination first.
+typedef void (*bl_output_sink)(void *context, const char *data, size_t size);
+void bl_set_output(bl_output_sink sink, void *context);
+
+// Each reads the next value, after white space, as scanf("%d"), ("%f") or
+// ("%s") would, and 0 or "" if there is none. Standard input is mapped
+// whole when it is a regular file and otherwise read 64 KiB at a time,
+// flushing the output first in case someone is answering a prompt.
+int32_t bl_input_i32(void);
+float bl_input_f32(void);
+void bl_input_str(bl_str *result); // Valid until bl_free_strings
+
+// Makes the calling thread's reads come from size bytes at data, which must
+// outlive them; a null data goes back to standard input.
+void bl_set_input(const char *data, size_t size);
+
+// parallel repeat (i = begin, end) runs in bl_parallel_chunks(begin, end)
+// chunks of consecutive iterations, chunk k being the i from
+// bl_parallel_bound(begin, end, k) up to bl_parallel_bound(begin, end, k + 1).
+// The chunks depend on begin and end only, never on the number of threads,
+// so reductions combined chunk by chunk in order round the same way however
+// the chunks were run, and the VM, running them one after another, gets the
+// same results.
+enum
+{
+    BL_PARALLEL_CHUNKS = 1024
+};
+int32_t bl_parallel_chunks(int32_t begin, int32_t end);
+int32_t bl_parallel_bound(int32_t begin, int32_t end, int32_t chunk);
+
+// Runs the iterations [begin, end) of one chunk, leaving its reductions'
+// partial results at partial. Nonzero if an array index was out of bounds,
+// with the index and the array's length in error[0] and error[1], or on an
+// integer division by zero, with BL_DIVISION_ERROR in error[1].
+enum
+{
+    BL_DIVISION_ERROR = -1
+};
+typedef int32_t (*bl_parallel_body)(void *context, int32_t begin, int32_t end, void *partial, int32_t *error);
+
+// Runs every chunk of [begin, end) through body, chunk k with partial at
+// partials + k * partialSize, on the calling thread and the workers. Each
+// thread starts on a range of chunks of its own and, when that runs out,
+// steals the back half of the fullest range left. Nonzero if a chunk
+// failed; error is then that of the lowest-numbered one, where running the
+// iterations in order would have stopped, and later chunks may not have run.
+// Called from inside a body, or while another thread has a job running, it
+// runs the chunks on the calling thread alone.
+int32_t bl_parallel_repeat(bl_parallel_body body, void *context, int32_t begin, int32_t end, void *partials,
+                           uint32_t partialSize, int32_t *error);
+
+// Threads a parallel repeat runs on, counting the caller: $BITLANG_WORKERS,
+// or else one per processor online. The worker threads start as they are
+// first needed.
+uint32_t bl_parallel_workers(void);
+// Overrides that for later parallel repeats (0 goes back to it), e.g. for
+// a benchmark
+void bl_parallel_set_workers(uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,14 +1,74 @@
 from flask import Flask, request, jsonify, send_file
 import subprocess
+import socket
+import json
 import os
 import time
+import threading
 
 app = Flask(__name__)
 
 # === Paths ===
 BUILD_DIR = "build"
-TEST_PROG = os.path.join(BUILD_DIR, "test.prog")
 PROJECT_DIR = os.path.abspath(".")  # /mnt/.../OurMiniCompiler9
+COMPILE_SERVER = os.path.join(BUILD_DIR, "compile_server")
+SOCKET_PATH = os.path.join("/tmp", "bitlang-compile-server.sock")
+CACHE_DIR = os.path.join(BUILD_DIR, "compile-cache")
+
+# === Persistent compile daemon ===
+# LLVM stays initialised inside compile_server; every request is a framed
+# message on its own socket connection, so requests compile concurrently.
+# Resubmitted programs (the examples, mostly) are answered from its cache.
+daemon = None
+daemon_lock = threading.Lock()
+
+def ensure_daemon():
+    global daemon
+    with daemon_lock:
+        if daemon is not None and daemon.poll() is None:
+            return
+        if not os.path.exists(COMPILE_SERVER):
+            # One-time build instead of a cmake run per request
+            os.makedirs(BUILD_DIR, exist_ok=True)
+            subprocess.run(["cmake", PROJECT_DIR], cwd=BUILD_DIR, check=True)
+            subprocess.run(["cmake", "--build", ".", "--target", "compile_server"], cwd=BUILD_DIR, check=True)
+        # A daemon that died leaves its socket file behind; waiting for the
+        # file would then race the new one unlinking and binding it again
+        try:
+            os.unlink(SOCKET_PATH)
+        except FileNotFoundError:
+            pass
+        daemon = subprocess.Popen([COMPILE_SERVER, f"--socket={SOCKET_PATH}", f"--cache-dir={CACHE_DIR}"])
+        for _ in range(100):
+            with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as probe:
+                try:
+                    probe.connect(SOCKET_PATH)
+                    return
+                except (FileNotFoundError, ConnectionRefusedError):
+                    pass
+            if daemon.poll() is not None:
+                break
+            time.sleep(0.05)
+
+OPT_LEVELS = {"O0", "O1", "O2", "O3", "Os"}
+
+def compile_with_daemon(code, program_input="", opt_level="O0", backend="llvm"):
+    ensure_daemon()
+    if opt_level not in OPT_LEVELS:
+        opt_level = "O0"
+    backend = "vm" if backend == "vm" else "llvm"
+    source = code.encode()
+    stdin_bytes = program_input.encode()
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as conn:
+        conn.connect(SOCKET_PATH)
+        conn.sendall(f"{len(source)} {len(stdin_bytes)} run {opt_level} {backend}\n".encode() + source + stdin_bytes)
+        response = b""
+        while not response.endswith(b"\n"):
+            chunk = conn.recv(65536)
+            if not chunk:
+                break
+            response += chunk
+    return json.loads(response)
 
 @app.route("/")
 def serve_html():
@@ -21,106 +81,34 @@ def compile_code():
         data = request.get_json()
         code = data.get("code", "")
 
-        with open(TEST_PROG, "w") as f:
-            f.write(code)
-
         start = time.time()
-
-        # === 1. Run cmake .. ===
-        cmake_config = subprocess.run(
-            ["cmake", os.path.abspath(".")],
-            cwd=BUILD_DIR,
-            capture_output=True,
-            text=True
-        )
-        cmake_out = cmake_config.stdout + cmake_config.stderr
-        print("✅ cmake done")
-
-        # === 2. Run cmake --build . ===
-        build = subprocess.run(
-            ["cmake", "--build", "."],
-            cwd=BUILD_DIR,
-            capture_output=True,
-            text=True
-        )
-        build_out = build.stdout + build.stderr
-        print("✅ build done")
-
-        full_command_output = f"$ cmake ..\n{cmake_out}\n\n$ cmake --build .\n{build_out}"
-
-        # === 3. Extract AST & Semantic ===
-        ast_semantic_part = ""
-        try:
-            lines = build_out.splitlines()
-            collected_parts = []
-
-            # 1. Get "Parsed successfully" + 1 lines after
-            try:
-                parsed_idx = next(i for i, line in enumerate(lines) if "Parsed successfully" in line.strip())
-                collected_parts.extend(lines[parsed_idx : parsed_idx + 2])
-            except StopIteration:
-                pass
-
-            # 2. Get "100%] Built target run" + all lines after it
-            try:
-                run_idx = next(i for i, line in enumerate(lines) if "[100%] Built target run" in line.strip())
-                collected_parts.extend(lines[run_idx:])
-            except StopIteration:
-                pass
-
-            # 3. Get from "Semantic analysis completed successfully" to "Generating LLVM IR"
-            try:
-                sem_ok_idx = next(i for i, line in enumerate(lines) if "Semantic analysis completed successfully" in line.strip())
-                gen_llvm_idx = next(i for i, line in enumerate(lines[sem_ok_idx:], start=sem_ok_idx)
-                                    if "Generating LLVM IR" in line.strip())
-                collected_parts.extend(lines[sem_ok_idx : gen_llvm_idx + 1])
-            except StopIteration:
-                pass
-
-            # Final assembly
-            ast_semantic_part = "\n".join(collected_parts)
-        except Exception as e:
-            ast_semantic_part = "❌ AST & Semantic block not found."
-
-        # === 4. Read output.ll (LLVM IR) ===
-        try:
-            with open(os.path.join(BUILD_DIR, "output.ll")) as f:
-                llvm_ir = f.read()
-        except:
-            llvm_ir = "❌ LLVM IR not generated."
-
-        # === 5. Extract final output from build log ===
-        try:
-            idx = build_out.index("Generating LLVM IR")
-            output_part = build_out[idx:]
-            output_lines = output_part.splitlines()
-            final_output_lines = []
-            found_ir = False
-            for line in output_lines:
-                if "LLVM IR written to output.ll" in line:
-                    found_ir = True
-                    continue
-                if found_ir:
-                    final_output_lines.append(line)
-            execution_result = "\n".join(final_output_lines).strip()
-        except:
-            execution_result = "❌ Could not extract final output."
-
+        result = compile_with_daemon(code, data.get("input", ""), data.get("opt", "O0"),
+                                     data.get("backend", "llvm"))
         end = time.time()
+        print("✅ compile done")
+
+        timing = result.get("timing", {})
+        diagnostics = "\n".join(result.get("diagnostics", []))
+        status = "Parsed successfully!" if result.get("parsed") else "Parsing failed."
+        ast_semantic_part = f"{status}\n{diagnostics}\n{result.get('ast', '')}".strip()
+        full_command_output = (
+            "compile_server (persistent)\n"
+            + "\n".join(f"{phase}: {ms:.3f}" for phase, ms in timing.items())
+        )
 
-        print("Returning:\n"
-            f"🔹 command_log:\n{full_command_output}\n\n"
-            f"🔹 ast_semantic:\n{ast_semantic_part.strip()}\n\n"
-            f"🔹 llvm_ir:\n{llvm_ir}\n\n"
-            f"🔹 execution_result:\n{execution_result.strip()}\n\n"
-            f"🔹 compile_time: {round((end - start) * 1000)}ms\n")
+        llvm_ir = result.get("ir") or "❌ LLVM IR not generated."
+        execution_result = result.get("output", "")
+        if result.get("error"):
+            execution_result += f"\n❌ {result['error']}"
 
         # === Response ===
         return jsonify({
             "command_log": full_command_output,
-            "ast_semantic": ast_semantic_part.strip(),
+            "ast_semantic": ast_semantic_part,
             "llvm_ir": llvm_ir,
-            "execution_result": execution_result,
+            "execution_result": execution_result.strip(),
+            "diagnostics": result.get("diagnostics", []),
+            "timing": timing,
             "compile_time": f"{round((end - start) * 1000)}ms"
         })
 
@@ -0,0 +1,58 @@
+// source_file.cpp
+#include "source_file.h"
+
+#include <fstream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BITLANG_HAVE_MMAP 1
+#endif
+
+std::unique_ptr<SourceFile> SourceFile::open(const std::string &path)
+{
+    std::unique_ptr<SourceFile> file(new SourceFile());
+
+#ifdef BITLANG_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        size_t size = static_cast<size_t>(info.st_size);
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED)
+        {
+            // The lexer reads front to back exactly once
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            ::close(fd);
+            file->mapping = mapped;
+            file->mappedSize = size;
+            file->contents = std::string_view(static_cast<const char *>(mapped), size);
+            return file;
+        }
+    }
+    ::close(fd);
+#endif
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return nullptr;
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    file->buffer = contents.str();
+    file->contents = file->buffer;
+    return file;
+}
+
+SourceFile::~SourceFile()
+{
+#ifdef BITLANG_HAVE_MMAP
+    if (mapping)
+        munmap(mapping, mappedSize);
+#endif
+}
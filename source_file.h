@@ -0,0 +1,33 @@
+// source_file.h
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Read-only contents of a source file. Where the platform has mmap the file
+// is mapped instead of read, so nothing is copied before lexing and tokens
+// can point straight into the mapping; elsewhere (and for empty files or
+// pipes that cannot be mapped) the contents are read into memory.
+class SourceFile
+{
+public:
+    // Null if the file cannot be opened
+    static std::unique_ptr<SourceFile> open(const std::string &path);
+
+    ~SourceFile();
+    SourceFile(const SourceFile &) = delete;
+    SourceFile &operator=(const SourceFile &) = delete;
+
+    std::string_view text() const { return contents; }
+    bool isMapped() const { return mapping != nullptr; }
+
+private:
+    SourceFile() = default;
+
+    std::string_view contents;
+    void *mapping = nullptr;
+    size_t mappedSize = 0;
+    std::string buffer; // Used when the file is not mapped
+};
@@ -0,0 +1,168 @@
+// time_report.cpp
+#include "time_report.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <ostream>
+#include <string_view>
+
+#include <sys/resource.h>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define BITLANG_HAVE_MALLINFO2 1
+#endif
+
+static double threadCpuMs()
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    timespec now;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) == 0)
+        return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+#endif
+    return std::clock() * 1e3 / CLOCKS_PER_SEC;
+}
+
+static int64_t heapInUse()
+{
+#ifdef BITLANG_HAVE_MALLINFO2
+    struct mallinfo2 info = mallinfo2();
+    return static_cast<int64_t>(info.uordblks + info.hblkhd); // Small blocks plus mmapped ones
+#else
+    return 0;
+#endif
+}
+
+static uint64_t peakRssKiB()
+{
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return static_cast<uint64_t>(usage.ru_maxrss); // KiB on Linux
+}
+
+bool TimeReport::measuresHeap()
+{
+#ifdef BITLANG_HAVE_MALLINFO2
+    return true;
+#else
+    return false;
+#endif
+}
+
+TimeReport::Phase::Phase(TimeReport *report, const char *name) : report(report), name(name)
+{
+    if (!report)
+        return;
+    heapStart = heapInUse();
+    cpuStart = threadCpuMs();
+    wallStart = std::chrono::steady_clock::now();
+}
+
+void TimeReport::Phase::stop()
+{
+    if (!report)
+        return;
+    PhaseStats stats;
+    stats.name = name;
+    stats.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+    stats.cpuMs = threadCpuMs() - cpuStart;
+    stats.heapDelta = heapInUse() - heapStart;
+    stats.peakRssKiB = peakRssKiB();
+    report->phaseStats.push_back(std::move(stats));
+    report = nullptr;
+}
+
+void TimeReport::count(const char *name, uint64_t value)
+{
+    for (auto &counter : counters)
+    {
+        if (std::string_view(counter.first) == name)
+        {
+            counter.second = value;
+            return;
+        }
+    }
+    counters.emplace_back(name, value);
+}
+
+static void printJSONString(std::ostream &out, const std::string &value)
+{
+    out << '"';
+    for (unsigned char c : value)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        }
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+void TimeReport::print(std::ostream &out, bool json) const
+{
+    PhaseStats total;
+    total.name = "total";
+    for (const PhaseStats &phase : phaseStats)
+    {
+        total.wallMs += phase.wallMs;
+        total.cpuMs += phase.cpuMs;
+        total.heapDelta += phase.heapDelta;
+        total.peakRssKiB = std::max(total.peakRssKiB, phase.peakRssKiB);
+    }
+
+    char line[160];
+    if (json)
+    {
+        auto printPhase = [&](const PhaseStats &phase) {
+            out << "{\"name\":";
+            printJSONString(out, phase.name);
+            std::snprintf(line, sizeof(line),
+                          ",\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"heap_delta_bytes\":%lld,\"peak_rss_kib\":%llu}",
+                          phase.wallMs, phase.cpuMs, static_cast<long long>(phase.heapDelta),
+                          static_cast<unsigned long long>(phase.peakRssKiB));
+            out << line;
+        };
+        out << "{\"file\":";
+        printJSONString(out, source);
+        out << ",\"phases\":[";
+        for (size_t i = 0; i < phaseStats.size(); ++i)
+        {
+            if (i)
+                out << ',';
+            printPhase(phaseStats[i]);
+        }
+        out << "],\"total\":";
+        printPhase(total);
+        out << ",\"counters\":{";
+        for (size_t i = 0; i < counters.size(); ++i)
+            out << (i ? ",\"" : "\"") << counters[i].first << "\":" << counters[i].second;
+        out << "}}\n";
+        return;
+    }
+
+    out << "===- Time report: " << source << " -===\n";
+    std::snprintf(line, sizeof(line), "  %-12s %10s %10s %14s %12s\n", "phase", "wall ms", "cpu ms",
+                  measuresHeap() ? "heap delta" : "heap (n/a)", "peak RSS KiB");
+    out << line;
+    auto printPhase = [&](const PhaseStats &phase) {
+        std::snprintf(line, sizeof(line), "  %-12s %10.3f %10.3f %14lld %12llu\n", phase.name.c_str(),
+                      phase.wallMs, phase.cpuMs, static_cast<long long>(phase.heapDelta),
+                      static_cast<unsigned long long>(phase.peakRssKiB));
+        out << line;
+    };
+    for (const PhaseStats &phase : phaseStats)
+        printPhase(phase);
+    printPhase(total);
+    for (const auto &[name, value] : counters)
+    {
+        std::snprintf(line, sizeof(line), "  %-26s %12llu\n", name, static_cast<unsigned long long>(value));
+        out << line;
+    }
+}
@@ -0,0 +1,68 @@
+// time_report.h
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Per-phase cost of one compilation, for --time-report: wall and CPU time,
+// how much the heap grew and the process's peak RSS when the phase ended,
+// plus named counters (tokens, AST nodes, IR instructions, ...) to relate
+// the numbers to the size of the program. CPU time is the calling thread's;
+// heap and RSS figures are process-wide, so in a batch on several threads
+// they include whatever the other workers did meanwhile.
+class TimeReport
+{
+public:
+    struct PhaseStats
+    {
+        std::string name;
+        double wallMs = 0;
+        double cpuMs = 0;
+        int64_t heapDelta = 0; // Change in bytes malloc has handed out; negative if the phase freed more
+        uint64_t peakRssKiB = 0;
+    };
+
+    // Measures from construction to stop() or destruction. A null report
+    // makes it a no-op, so callers need not check whether timing is on.
+    class Phase
+    {
+    public:
+        Phase(TimeReport *report, const char *name);
+        ~Phase() { stop(); }
+        Phase(const Phase &) = delete;
+        Phase &operator=(const Phase &) = delete;
+
+        void stop();
+
+    private:
+        TimeReport *report;
+        const char *name;
+        std::chrono::steady_clock::time_point wallStart;
+        double cpuStart = 0;
+        int64_t heapStart = 0;
+    };
+
+    explicit TimeReport(std::string source) : source(std::move(source)) {}
+
+    // Sets or overwrites a counter; counters print in the order first set
+    void count(const char *name, uint64_t value);
+
+    const std::vector<PhaseStats> &phases() const { return phaseStats; }
+
+    // A table, or with `json` one object on a single line:
+    // {"file":...,"phases":[{"name":...,"wall_ms":...,"cpu_ms":...,
+    //  "heap_delta_bytes":...,"peak_rss_kib":...},...],"total":{...},
+    //  "counters":{...}}
+    void print(std::ostream &out, bool json) const;
+
+    // Whether malloc statistics are available; heap deltas are 0 otherwise
+    static bool measuresHeap();
+
+private:
+    std::string source;
+    std::vector<PhaseStats> phaseStats;
+    std::vector<std::pair<const char *, uint64_t>> counters;
+};
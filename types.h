@@ -0,0 +1,110 @@
+// types.h
+#pragma once
+#include <cstdint>
+#include <string>
+
+enum class TypeKind : uint8_t
+{
+    Error,   // Already reported; suppresses follow-on diagnostics
+    Void,    // Statements
+    Int,
+    Float,
+    String,
+    Char,
+    Bool,
+    Unknown, // No type yet, e.g. input() before its context is known
+    Array    // int[N] or float[N]: element kind and length in the upper bits
+};
+
+// A BitLang type as a 32-bit value. Scalars only use the low byte for their
+// kind; the remaining bits are kept free for composite types so that
+// comparing and copying types stays a single integer operation. An array
+// keeps its element kind in the second byte and its length in the top two.
+class TypeId
+{
+public:
+    static constexpr uint32_t MaxArrayLength = 0xffff;
+
+    TypeId() = default; // Trivial, so TypeId can live in the parser's %union
+    constexpr explicit TypeId(TypeKind kind) : bits(static_cast<uint32_t>(kind)) {}
+
+    // An array of `length` elements. A length outside 1..MaxArrayLength is
+    // stored as 0, which sema rejects where the type is declared.
+    static constexpr TypeId array(TypeId element, int length)
+    {
+        uint32_t stored = length >= 1 && static_cast<uint32_t>(length) <= MaxArrayLength ? length : 0;
+        return TypeId(static_cast<uint32_t>(TypeKind::Array) | static_cast<uint32_t>(element.kind()) << 8 |
+                      stored << 16);
+    }
+
+    constexpr TypeKind kind() const { return static_cast<TypeKind>(bits & 0xff); }
+
+    constexpr bool operator==(TypeId other) const { return bits == other.bits; }
+    constexpr bool operator!=(TypeId other) const { return bits != other.bits; }
+
+    constexpr bool isError() const { return kind() == TypeKind::Error; }
+    constexpr bool isNumeric() const { return kind() == TypeKind::Int || kind() == TypeKind::Float; }
+    constexpr bool isArray() const { return kind() == TypeKind::Array; }
+
+    // Only meaningful for arrays
+    constexpr TypeId element() const { return TypeId(static_cast<TypeKind>(bits >> 8 & 0xff)); }
+    constexpr uint32_t length() const { return bits >> 16; }
+
+    // Spelling used in source and diagnostics
+    std::string name() const
+    {
+        switch (kind())
+        {
+        case TypeKind::Error:
+            return "error";
+        case TypeKind::Void:
+            return "void";
+        case TypeKind::Int:
+            return "int";
+        case TypeKind::Float:
+            return "float";
+        case TypeKind::String:
+            return "string";
+        case TypeKind::Char:
+            return "char";
+        case TypeKind::Bool:
+            return "bool";
+        case TypeKind::Unknown:
+            return "unknown";
+        case TypeKind::Array:
+            return element().name() + "[" + std::to_string(length()) + "]";
+        }
+        return "unknown";
+    }
+
+    static const TypeId Error;
+    static const TypeId Void;
+    static const TypeId Int;
+    static const TypeId Float;
+    static const TypeId String;
+    static const TypeId Char;
+    static const TypeId Bool;
+    static const TypeId Unknown;
+
+private:
+    constexpr explicit TypeId(uint32_t bits) : bits(bits) {}
+
+    uint32_t bits;
+};
+
+// How print writes a float: the shortest text that reads back as the same
+// float, or the six decimals of printf's "%f" that BitLang used to print
+enum class FloatFormat : uint8_t
+{
+    Shortest,
+    Fixed
+};
+
+inline constexpr TypeId TypeId::Error{TypeKind::Error};
+inline constexpr TypeId TypeId::Void{TypeKind::Void};
+inline constexpr TypeId TypeId::Int{TypeKind::Int};
+inline constexpr TypeId TypeId::Float{TypeKind::Float};
+inline constexpr TypeId TypeId::String{TypeKind::String};
+inline constexpr TypeId TypeId::Char{TypeKind::Char};
+inline constexpr TypeId TypeId::Bool{TypeKind::Bool};
+inline constexpr TypeId TypeId::Unknown{TypeKind::Unknown};
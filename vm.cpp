@@ -0,0 +1,998 @@
+// vm.cpp
+#include "vm.h"
+#include "ast_visitor.h"
+#include "runtime.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <unordered_map>
+
+// ===== Compiler =====
+
+namespace
+{
+
+// Compiles the tree as steps of walkTree: each visit gets the node's stage
+// and returns the child to compile next, or nullptr once the node is done.
+class BytecodeCompiler : public ConstASTVisitor<BytecodeCompiler, const ASTNode *, unsigned>
+{
+public:
+    BytecodeCompiler(BytecodeProgram &program, uint32_t slotCount, FloatFormat floatFormat)
+        : program(program), firstTemp(slotCount), nextTemp(slotCount), floatFormat(floatFormat)
+    {
+        program.registerCount = slotCount;
+    }
+
+    // Temporaries never outlive the statement that computes them
+    const ASTNode *statement(const NodeList &statements, unsigned stage)
+    {
+        if (stage == statements.size())
+            return nullptr;
+        nextTemp = firstTemp;
+        return statements[stage];
+    }
+
+    // ===== Expressions: push the register holding the value =====
+
+    const ASTNode *visitLiteral(const LiteralNode *lit, unsigned)
+    {
+        uint32_t reg = newTemp();
+        switch (lit->literalType)
+        {
+        case LiteralNode::Type::Int:
+            emit(BytecodeOp::LoadInt, reg, static_cast<uint32_t>(lit->intValue));
+            break;
+        case LiteralNode::Type::Float:
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &lit->floatValue, sizeof bits);
+            emit(BytecodeOp::LoadFloat, reg, bits);
+            break;
+        }
+        case LiteralNode::Type::Bool:
+            emit(BytecodeOp::LoadInt, reg, lit->boolValue ? 1 : 0);
+            break;
+        case LiteralNode::Type::Char:
+            emit(BytecodeOp::LoadInt, reg, static_cast<uint32_t>(lit->charValue));
+            break;
+        case LiteralNode::Type::String:
+            program.strings.emplace_back(lit->stringValue);
+            emit(BytecodeOp::LoadString, reg, static_cast<uint32_t>(program.strings.size() - 1));
+            break;
+        }
+        values.push_back(reg);
+        return nullptr;
+    }
+
+    const ASTNode *visitIdentifier(const IdentifierNode *ident, unsigned)
+    {
+        values.push_back(ident->slot);
+        return nullptr;
+    }
+
+    const ASTNode *visitIndexExpr(const IndexExprNode *index, unsigned stage)
+    {
+        if (stage == 0)
+            return index->index;
+        uint32_t at = pop();
+        uint32_t reg = newTemp();
+        emit(BytecodeOp::LoadElem, reg, index->slot, at);
+        values.push_back(reg);
+        return nullptr;
+    }
+
+    const ASTNode *visitBuiltinCall(const BuiltinCallNode *call, unsigned stage)
+    {
+        if (call->funcName != "input")
+            return reduce(call, stage);
+
+        // Sema typed input() from its hint or context
+        BytecodeOp op = BytecodeOp::InputInt;
+        switch (call->type.kind())
+        {
+        case TypeKind::Float:
+            op = BytecodeOp::InputFloat;
+            break;
+        case TypeKind::String:
+            op = BytecodeOp::InputString;
+            break;
+        case TypeKind::Bool:
+            op = BytecodeOp::InputBool;
+            break;
+        default:
+            break;
+        }
+        uint32_t reg = newTemp();
+        emit(op, reg);
+        values.push_back(reg);
+        return nullptr;
+    }
+
+    const ASTNode *visitBinaryExpr(const BinaryExprNode *bin, unsigned stage)
+    {
+        switch (stage)
+        {
+        case 0:
+            return bin->left;
+        case 1:
+            return bin->right;
+        }
+        uint32_t rhs = pop();
+        uint32_t lhs = pop();
+        values.push_back(binary(bin, lhs, rhs));
+        return nullptr;
+    }
+
+    const ASTNode *visitUnaryExpr(const UnaryExprNode *un, unsigned stage)
+    {
+        if (stage == 0)
+            return un->operand;
+        uint32_t operand = pop();
+        values.push_back(unary(un, operand));
+        return nullptr;
+    }
+
+    // An array literal as an operand: a fresh array holding its elements
+    const ASTNode *visitArrayLiteral(const ArrayLiteralNode *literal, unsigned stage)
+    {
+        if (stage == 0)
+        {
+            uint32_t reg = newTemp();
+            emit(BytecodeOp::ArrayAddr, reg, newArray(literal->type.length()));
+            values.push_back(reg);
+        }
+        if (stage < literal->elements.size())
+            return literal->elements[stage];
+        storeElements(values[values.size() - stage - 1], stage);
+        return nullptr;
+    }
+
+    uint32_t binary(const BinaryExprNode *bin, uint32_t lhs, uint32_t rhs)
+    {
+        uint32_t reg = newTemp();
+        if (bin->left->type == TypeId::String)
+            emit(stringOp(bin->op), reg, lhs, rhs);
+        else
+            emit(binaryOp(bin->op, bin->left->type == TypeId::Float), reg, lhs, rhs);
+        return reg;
+    }
+
+    // Sema allows + and the comparisons on strings
+    static BytecodeOp stringOp(BinaryExprNode::Op binOp)
+    {
+        switch (binOp)
+        {
+        case BinaryExprNode::Op::Eq:
+            return BytecodeOp::EqString;
+        case BinaryExprNode::Op::Neq:
+            return BytecodeOp::NeString;
+        case BinaryExprNode::Op::Lt:
+            return BytecodeOp::LtString;
+        case BinaryExprNode::Op::Gt:
+            return BytecodeOp::GtString;
+        case BinaryExprNode::Op::Leq:
+            return BytecodeOp::LeString;
+        case BinaryExprNode::Op::Geq:
+            return BytecodeOp::GeString;
+        default:
+            return BytecodeOp::AddString;
+        }
+    }
+
+    static BytecodeOp binaryOp(BinaryExprNode::Op binOp, bool isFloat)
+    {
+        BytecodeOp op = BytecodeOp::And;
+        switch (binOp)
+        {
+        case BinaryExprNode::Op::Add:
+            op = isFloat ? BytecodeOp::AddFloat : BytecodeOp::AddInt;
+            break;
+        case BinaryExprNode::Op::Sub:
+            op = isFloat ? BytecodeOp::SubFloat : BytecodeOp::SubInt;
+            break;
+        case BinaryExprNode::Op::Mul:
+            op = isFloat ? BytecodeOp::MulFloat : BytecodeOp::MulInt;
+            break;
+        case BinaryExprNode::Op::Div:
+            op = isFloat ? BytecodeOp::DivFloat : BytecodeOp::DivInt;
+            break;
+        case BinaryExprNode::Op::Eq:
+            op = isFloat ? BytecodeOp::EqFloat : BytecodeOp::EqInt;
+            break;
+        case BinaryExprNode::Op::Neq:
+            op = isFloat ? BytecodeOp::NeFloat : BytecodeOp::NeInt;
+            break;
+        case BinaryExprNode::Op::Lt:
+            op = isFloat ? BytecodeOp::LtFloat : BytecodeOp::LtInt;
+            break;
+        case BinaryExprNode::Op::Gt:
+            op = isFloat ? BytecodeOp::GtFloat : BytecodeOp::GtInt;
+            break;
+        case BinaryExprNode::Op::Leq:
+            op = isFloat ? BytecodeOp::LeFloat : BytecodeOp::LeInt;
+            break;
+        case BinaryExprNode::Op::Geq:
+            op = isFloat ? BytecodeOp::GeFloat : BytecodeOp::GeInt;
+            break;
+        case BinaryExprNode::Op::And:
+            op = BytecodeOp::And;
+            break;
+        case BinaryExprNode::Op::Or:
+            op = BytecodeOp::Or;
+            break;
+        }
+        return op;
+    }
+
+    uint32_t unary(const UnaryExprNode *un, uint32_t operand)
+    {
+        uint32_t reg = newTemp();
+        if (un->op == UnaryExprNode::Op::Not)
+            emit(BytecodeOp::Not, reg, operand);
+        else
+            emit(un->type == TypeId::Float ? BytecodeOp::NegFloat : BytecodeOp::NegInt, reg, operand);
+        return reg;
+    }
+
+    // ===== Statements =====
+
+    const ASTNode *visitDeclaration(const DeclarationNode *decl, unsigned stage)
+    {
+        if (decl->declType.isArray())
+        {
+            uint32_t length = decl->declType.length();
+            if (stage == 0)
+            {
+                if (arrayLengths.size() <= decl->slot)
+                    arrayLengths.resize(decl->slot + 1, 0);
+                arrayLengths[decl->slot] = length;
+                emit(BytecodeOp::ArrayAddr, decl->slot, newArray(length));
+            }
+            return storeArray(decl->slot, decl->expr, length, stage);
+        }
+        if (stage == 0)
+            return decl->expr;
+        storeTo(decl->slot, pop(), decl->declType);
+        return nullptr;
+    }
+
+    const ASTNode *visitAssignment(const AssignmentNode *assign, unsigned stage)
+    {
+        if (assign->index)
+        {
+            switch (stage)
+            {
+            case 0:
+                return assign->index;
+            case 1:
+                return assign->value;
+            }
+            uint32_t value = pop();
+            uint32_t at = pop();
+            emit(BytecodeOp::StoreElem, assign->slot, at, value);
+            return nullptr;
+        }
+        if (assign->slot < arrayLengths.size() && arrayLengths[assign->slot])
+            return storeArray(assign->slot, assign->value, arrayLengths[assign->slot], stage);
+        if (stage == 0)
+            return assign->value;
+        storeTo(assign->slot, pop(), assign->value->type);
+        return nullptr;
+    }
+
+    const ASTNode *visitPrintStmt(const PrintStmtNode *print, unsigned stage)
+    {
+        if (stage == 0)
+            return print->expr;
+        uint32_t value = pop();
+        BytecodeOp op = BytecodeOp::PrintInt; // ints and bools print as %d
+        switch (print->expr->type.kind())
+        {
+        case TypeKind::Float:
+            op = floatFormat == FloatFormat::Fixed ? BytecodeOp::PrintFixed : BytecodeOp::PrintFloat;
+            break;
+        case TypeKind::String:
+            op = BytecodeOp::PrintString;
+            break;
+        case TypeKind::Char:
+            op = BytecodeOp::PrintChar;
+            break;
+        default:
+            break;
+        }
+        emit(op, 0, value);
+        return nullptr;
+    }
+
+    // The if's jump still to patch is on top of `jumps`: past the then arm,
+    // then past the else arm
+    const ASTNode *visitIfStmt(const IfStmtNode *ifStmt, unsigned stage)
+    {
+        switch (stage)
+        {
+        case 0:
+            return ifStmt->condition;
+        case 1:
+            jumps.push_back(emit(BytecodeOp::JumpIfFalse, 0, pop()));
+            return ifStmt->thenBlock;
+        case 2:
+            if (ifStmt->elseBlock)
+            {
+                size_t toEnd = emit(BytecodeOp::Jump, 0);
+                patch(jumps.back(), here());
+                jumps.back() = toEnd;
+                return ifStmt->elseBlock;
+            }
+            break;
+        }
+        patch(jumps.back(), here());
+        jumps.pop_back();
+        return nullptr;
+    }
+
+    // Same shape as LLVMCodeGen: body first, then the condition
+    const ASTNode *visitRepeatStmt(const RepeatStmtNode *repeat, unsigned stage)
+    {
+        switch (stage)
+        {
+        case 0:
+            loops.push_back({here()});
+            return repeat->body;
+        case 1:
+            for (size_t jump : loops.back().skips)
+                patch(jump, here());
+            nextTemp = firstTemp;
+            return repeat->condition;
+        }
+        emit(BytecodeOp::JumpIfTrue, loops.back().top, pop());
+        for (size_t jump : loops.back().stops)
+            patch(jump, here());
+        loops.pop_back();
+        return nullptr;
+    }
+
+    // The chunks the runtime splits the loop into (runtime.h), one after the
+    // other. Each reduction starts again from its identity at a chunk and is
+    // folded into the variable at its end, as LLVMCodeGen folds the chunks'
+    // partials in order, so float results match the compiled program's.
+    const ASTNode *visitParallelRepeat(const ParallelRepeatNode *loop, unsigned stage)
+    {
+        switch (stage)
+        {
+        case 0:
+            return loop->start;
+        case 1:
+            return loop->end;
+        case 2:
+            return parallelBody(loop);
+        }
+
+        ParallelLoop state = parallelLoops.back();
+        parallelLoops.pop_back();
+        Loop inner = std::move(loops.back());
+        loops.pop_back();
+        firstTemp = state.outerFirstTemp;
+
+        for (size_t jump : inner.skips)
+            patch(jump, here());
+        emit(BytecodeOp::AddInt, loop->slot, loop->slot, state.one);
+        emit(BytecodeOp::LtInt, state.more, loop->slot, state.last);
+        emit(BytecodeOp::JumpIfTrue, inner.top, state.more);
+        for (size_t r = 0; r < loop->reductions.size(); ++r)
+        {
+            auto var = static_cast<const IdentifierNode *>(loop->reductions[r]);
+            bool isFloat = var->type == TypeId::Float;
+            BytecodeOp op = loop->isProduct(r) ? (isFloat ? BytecodeOp::MulFloat : BytecodeOp::MulInt)
+                                               : (isFloat ? BytecodeOp::AddFloat : BytecodeOp::AddInt);
+            emit(op, var->slot, state.saved + r, var->slot);
+        }
+        emit(BytecodeOp::AddInt, state.chunk, state.chunk, state.one);
+        emit(BytecodeOp::LtInt, state.more, state.chunk, state.chunks);
+        emit(BytecodeOp::JumpIfTrue, state.top, state.more);
+        patch(state.toEnd, here());
+        return nullptr;
+    }
+
+    const ASTNode *visitBreak(const BreakNode *, unsigned)
+    {
+        loops.back().stops.push_back(emit(BytecodeOp::Jump, 0));
+        return nullptr;
+    }
+
+    const ASTNode *visitContinue(const ContinueNode *, unsigned)
+    {
+        loops.back().skips.push_back(emit(BytecodeOp::Jump, 0));
+        return nullptr;
+    }
+
+    const ASTNode *visitBlock(const BlockNode *block, unsigned stage) { return statement(block->statements, stage); }
+
+    const ASTNode *visitProgram(const ProgramNode *root, unsigned stage)
+    {
+        if (const ASTNode *next = statement(root->statements, stage))
+            return next;
+        emit(BytecodeOp::Halt);
+        return nullptr;
+    }
+
+    // return has no effect at the top level, as in LLVMCodeGen
+    const ASTNode *visitNode(const ASTNode *, unsigned) { return nullptr; }
+
+private:
+    struct Loop
+    {
+        uint32_t top;              // Where the body starts
+        std::vector<size_t> stops; // Jumps to patch to the loop exit
+        std::vector<size_t> skips; // ... and to the condition
+    };
+
+    // Registers and jumps of a parallel repeat whose body is being compiled
+    struct ParallelLoop
+    {
+        uint32_t chunks, chunk, last, one, more;
+        uint32_t saved; // The variables' values before the chunk, one per reduction
+        uint32_t top;   // Where a chunk starts
+        size_t toEnd;
+        uint32_t outerFirstTemp;
+    };
+
+    BytecodeProgram &program;
+    uint32_t firstTemp;
+    uint32_t nextTemp;
+    FloatFormat floatFormat;
+    std::vector<uint32_t> values; // Registers of the expressions compiled, innermost last
+    std::vector<size_t> jumps;    // See visitIfStmt
+    std::vector<Loop> loops;
+    std::vector<ParallelLoop> parallelLoops;
+    std::vector<uint32_t> arrayLengths; // By slot, 0 for scalars; set at the declaration
+    // Leaves of the array expression being compiled: the register of each
+    // array operand and of each scalar that stands for copies of itself
+    std::unordered_map<const ASTNode *, uint32_t> leaves;
+    // Leaves still to compile, the next on top, above a nullptr for each
+    // array expression they belong to; see prepareLeaves
+    std::vector<const ASTNode *> pendingLeaves;
+    std::vector<const ASTNode *> scratch;
+
+    uint32_t pop()
+    {
+        uint32_t reg = values.back();
+        values.pop_back();
+        return reg;
+    }
+
+    // Both bounds are compiled: sets up the chunks and the first iteration
+    // of one, and returns the body
+    const ASTNode *parallelBody(const ParallelRepeatNode *loop)
+    {
+        uint32_t end = pop();
+        uint32_t start = pop();
+        uint32_t bounds = newTemp(), boundsEnd = newTemp(); // Consecutive, for ChunkCount and ChunkBound
+        emit(BytecodeOp::Move, bounds, start);
+        emit(BytecodeOp::Move, boundsEnd, end);
+        ParallelLoop state;
+        state.chunks = newTemp();
+        state.chunk = newTemp();
+        state.last = newTemp();
+        state.one = newTemp();
+        state.more = newTemp();
+        state.saved = nextTemp;
+        for (size_t r = 0; r < loop->reductions.size(); ++r)
+            newTemp();
+
+        emit(BytecodeOp::ChunkCount, state.chunks, bounds);
+        emit(BytecodeOp::LoadInt, state.chunk, 0);
+        emit(BytecodeOp::LoadInt, state.one, 1);
+        emit(BytecodeOp::LtInt, state.more, state.chunk, state.chunks);
+        state.toEnd = emit(BytecodeOp::JumpIfFalse, 0, state.more);
+        state.top = here();
+        emit(BytecodeOp::ChunkBound, loop->slot, bounds, state.chunk);
+        emit(BytecodeOp::AddInt, state.more, state.chunk, state.one);
+        emit(BytecodeOp::ChunkBound, state.last, bounds, state.more);
+        for (size_t r = 0; r < loop->reductions.size(); ++r)
+        {
+            auto var = static_cast<const IdentifierNode *>(loop->reductions[r]);
+            bool isFloat = var->type == TypeId::Float;
+            uint32_t identity = loop->isProduct(r) ? (isFloat ? 0x3f800000u : 1) : 0; // 1.0f, 1 or 0
+            emit(BytecodeOp::Move, state.saved + r, var->slot);
+            emit(isFloat ? BytecodeOp::LoadFloat : BytecodeOp::LoadInt, var->slot, identity);
+        }
+
+        // Chunks are never empty, so the body comes first, as in a repeat.
+        // Its statements get temporaries above the loop's own.
+        state.outerFirstTemp = firstTemp;
+        firstTemp = nextTemp;
+        parallelLoops.push_back(state);
+        loops.push_back({here()});
+        return loop->body;
+    }
+
+    uint32_t newArray(uint32_t length)
+    {
+        program.arrays.push_back(length);
+        return static_cast<uint32_t>(program.arrays.size() - 1);
+    }
+
+    // Stores the value of an array expression, or copies of a scalar, into
+    // the array in register dest, as steps of the statement it is in
+    const ASTNode *storeArray(uint32_t dest, const ASTNode *expr, uint32_t length, unsigned stage)
+    {
+        if (auto literal = dynCast<ArrayLiteralNode>(expr))
+        {
+            // Every element is computed before any is stored, so that
+            // a = [a[1], a[0]] swaps
+            if (stage < literal->elements.size())
+                return literal->elements[stage];
+            storeElements(dest, stage);
+            return nullptr;
+        }
+        if (const ASTNode *leaf = prepareLeaves(expr, stage))
+            return leaf;
+        forEachElement(length, [&](uint32_t at) { emit(BytecodeOp::StoreElem, dest, at, elementAt(expr, at)); });
+        return nullptr;
+    }
+
+    // Stores the last `count` values computed into the array in register
+    // dest, in order, and drops them
+    void storeElements(uint32_t dest, size_t count)
+    {
+        size_t first = values.size() - count;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t at = newTemp();
+            emit(BytecodeOp::LoadInt, at, i);
+            emit(BytecodeOp::StoreElem, dest, at, values[first + i]);
+        }
+        values.resize(first);
+    }
+
+    // sum, min or max of an array expression
+    const ASTNode *reduce(const BuiltinCallNode *call, unsigned stage)
+    {
+        const ASTNode *array = call->args[0];
+        if (const ASTNode *leaf = prepareLeaves(array, stage))
+            return leaf;
+
+        bool isFloat = array->type.element() == TypeId::Float;
+        BytecodeOp op;
+        uint32_t identity;
+        if (call->funcName == "sum")
+        {
+            op = isFloat ? BytecodeOp::AddFloat : BytecodeOp::AddInt;
+            identity = 0; // 0.0f has the same bits
+        }
+        else if (call->funcName == "min")
+        {
+            op = isFloat ? BytecodeOp::MinFloat : BytecodeOp::MinInt;
+            identity = isFloat ? 0x7f800000u : 0x7fffffffu; // +inf, INT32_MAX
+        }
+        else
+        {
+            op = isFloat ? BytecodeOp::MaxFloat : BytecodeOp::MaxInt;
+            identity = isFloat ? 0xff800000u : 0x80000000u; // -inf, INT32_MIN
+        }
+
+        uint32_t acc = newTemp();
+        emit(isFloat ? BytecodeOp::LoadFloat : BytecodeOp::LoadInt, acc, identity);
+        // Element by element in order, which is also the order codegen adds floats in
+        forEachElement(array->type.length(), [&](uint32_t at) { emit(op, acc, acc, elementAt(array, at)); });
+        values.push_back(acc);
+        return nullptr;
+    }
+
+    // Compiles the leaves of an element-wise expression left to right, as
+    // steps of the node it is in: returns the next leaf to compile, or
+    // nullptr once `leaves` has them all. An array variable needs no code.
+    const ASTNode *prepareLeaves(const ASTNode *expr, unsigned stage)
+    {
+        if (stage == 0)
+        {
+            // Right to left onto pendingLeaves, so the first comes off first
+            pendingLeaves.push_back(nullptr);
+            scratch.push_back(expr);
+            while (!scratch.empty())
+            {
+                const ASTNode *node = scratch.back();
+                scratch.pop_back();
+                if (!node->type.isArray() || node->kind == NodeKind::ArrayLiteral)
+                    pendingLeaves.push_back(node);
+                else if (auto ident = dynCast<IdentifierNode>(node))
+                    leaves[node] = ident->slot;
+                else if (auto bin = dynCast<BinaryExprNode>(node))
+                {
+                    scratch.push_back(bin->left);
+                    scratch.push_back(bin->right);
+                }
+                else if (auto un = dynCast<UnaryExprNode>(node))
+                    scratch.push_back(un->operand);
+            }
+        }
+        else
+        {
+            leaves[pendingLeaves.back()] = pop();
+            pendingLeaves.pop_back();
+        }
+        if (const ASTNode *leaf = pendingLeaves.back())
+            return leaf;
+        pendingLeaves.pop_back();
+        return nullptr;
+    }
+
+    // Element `at` of an element-wise expression whose leaves are prepared
+    uint32_t elementAt(const ASTNode *expr, uint32_t at)
+    {
+        walkTree(expr, [&](const ASTNode *node, unsigned stage) -> const ASTNode * {
+            if (!node->type.isArray())
+            {
+                values.push_back(leaves[node]);
+                return nullptr;
+            }
+            bool isFloat = node->type.element() == TypeId::Float;
+            if (stage == 0)
+                values.push_back(newTemp());
+            uint32_t reg = values[values.size() - stage - 1];
+            if (auto bin = dynCast<BinaryExprNode>(node))
+            {
+                if (stage < 2)
+                    return stage == 0 ? bin->left : bin->right;
+                uint32_t rhs = pop();
+                uint32_t lhs = pop();
+                emit(binaryOp(bin->op, isFloat), reg, lhs, rhs);
+            }
+            else if (auto un = dynCast<UnaryExprNode>(node))
+            {
+                if (stage == 0)
+                    return un->operand;
+                emit(isFloat ? BytecodeOp::NegFloat : BytecodeOp::NegInt, reg, pop());
+            }
+            else
+            {
+                emit(BytecodeOp::LoadElem, reg, leaves[node], at);
+            }
+            return nullptr;
+        });
+        return pop();
+    }
+
+    // Compiles body once inside a loop that runs it with the index register
+    // counting from 0 to length - 1
+    template <class Body>
+    void forEachElement(uint32_t length, Body body)
+    {
+        uint32_t at = newTemp(), end = newTemp(), one = newTemp(), more = newTemp();
+        emit(BytecodeOp::LoadInt, at, 0);
+        emit(BytecodeOp::LoadInt, end, length);
+        emit(BytecodeOp::LoadInt, one, 1);
+        uint32_t top = here();
+        body(at);
+        emit(BytecodeOp::AddInt, at, at, one);
+        emit(BytecodeOp::LtInt, more, at, end);
+        emit(BytecodeOp::JumpIfTrue, top, more);
+    }
+
+    uint32_t newTemp()
+    {
+        uint32_t reg = nextTemp++;
+        if (nextTemp > program.registerCount)
+            program.registerCount = nextTemp;
+        return reg;
+    }
+
+    size_t emit(BytecodeOp op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0)
+    {
+        program.code.push_back({op, a, b, c});
+        return program.code.size() - 1;
+    }
+
+    uint32_t here() const { return static_cast<uint32_t>(program.code.size()); }
+
+    void patch(size_t jump, uint32_t target) { program.code[jump].a = target; }
+
+    // A temporary is written exactly once, by the instruction that computed
+    // it, so when that was the last one emitted it can write the variable
+    // directly instead of going through a Move. A reduction's accumulator
+    // is the exception: its loop ends in a jump, whose operand a is not a
+    // register at all. A string is copied into the variable's own bl_str,
+    // as the one value points at may change under it.
+    void storeTo(uint32_t slot, uint32_t value, TypeId type)
+    {
+        if (value >= firstTemp && !program.code.empty() && program.code.back().a == value &&
+            program.code.back().op != BytecodeOp::JumpIfTrue)
+            program.code.back().a = slot;
+        else
+            emit(type == TypeId::String ? BytecodeOp::CopyString : BytecodeOp::Move, slot, value);
+    }
+};
+
+} // namespace
+
+BytecodeProgram compileToBytecode(const ProgramNode *root, FloatFormat floatFormat)
+{
+    BytecodeProgram program;
+    BytecodeCompiler compiler(program, root->slotCount, floatFormat);
+    walkTree(static_cast<const ASTNode *>(root),
+             [&](const ASTNode *node, unsigned stage) { return compiler.visit(node, stage); });
+    return program;
+}
+
+static const char *const opNames[] = {
+#define BITLANG_OP_NAME(name) #name,
+    BITLANG_BYTECODE_OPS(BITLANG_OP_NAME)
+#undef BITLANG_OP_NAME
+};
+
+void BytecodeProgram::print(std::ostream &out) const
+{
+    out << "; " << code.size() << " instructions, " << registerCount << " registers\n";
+    for (size_t i = 0; i < code.size(); ++i)
+    {
+        const Instruction &ins = code[i];
+        out << std::setw(5) << i << "  " << std::left << std::setw(12)
+            << opNames[static_cast<uint8_t>(ins.op)] << std::right
+            << ins.a << ", " << ins.b << ", " << ins.c << "\n";
+    }
+}
+
+// ===== Interpreter =====
+
+namespace
+{
+
+union VMValue
+{
+    int32_t i;
+    float f;
+    const bl_str *s;
+    VMValue *a; // An array: its length, then its elements
+};
+
+// input() reads through the runtime, from stdin or from a request's input
+// text, as compiled programs do, and strings are built by it. Their text
+// stays valid until the run is over.
+class VMRuntime
+{
+public:
+    explicit VMRuntime(const std::string *text)
+    {
+        if (text)
+            bl_set_input(text->data(), text->size());
+    }
+    ~VMRuntime()
+    {
+        bl_set_input(nullptr, 0);
+        bl_free_strings();
+    }
+    VMRuntime(const VMRuntime &) = delete;
+    VMRuntime &operator=(const VMRuntime &) = delete;
+};
+
+// A bl_output_sink that appends to the std::string at text
+void appendTo(void *text, const char *data, size_t size)
+{
+    static_cast<std::string *>(text)->append(data, size);
+}
+
+} // namespace
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BITLANG_VM_COMPUTED_GOTO 1
+#else
+#define BITLANG_VM_COMPUTED_GOTO 0
+#endif
+
+VMResult runBytecode(const BytecodeProgram &program, const std::string *input)
+{
+    VMResult result;
+    std::vector<VMValue> registers(program.registerCount, VMValue{0});
+    VMRuntime runtime(input);
+    // The literals, and a string of its own for each register
+    std::vector<bl_str> literals(program.strings.size());
+    for (size_t i = 0; i < literals.size(); ++i)
+        bl_str_make(&literals[i], program.strings[i].data(), program.strings[i].size());
+    std::vector<bl_str> strings(program.registerCount);
+    std::string &out = result.output;
+    char text[BL_FORMAT_MAX + 1];
+
+    size_t cellCount = 0;
+    for (uint32_t length : program.arrays)
+        cellCount += length + 1;
+    std::vector<VMValue> cells(cellCount, VMValue{0});
+    std::vector<VMValue *> arrays;
+    for (size_t i = 0, at = 0; i < program.arrays.size(); at += program.arrays[i++] + 1)
+    {
+        cells[at].i = static_cast<int32_t>(program.arrays[i]);
+        arrays.push_back(&cells[at]);
+    }
+    // The message is the runtime's, written as it would be by the program
+    auto runtimeError = [&](auto report) {
+        bl_set_output(appendTo, &out);
+        report();
+        bl_set_output(nullptr, nullptr);
+        result.exitCode = 1;
+        return result;
+    };
+    auto outOfBounds = [&](int32_t index, const VMValue *array) {
+        return runtimeError([&] { bl_array_index_error(index, array[0].i); });
+    };
+
+    VMValue *r = registers.data();
+    const Instruction *code = program.code.data();
+    const Instruction *pc = code;
+
+    // Threaded dispatch: each handler jumps straight to the next one's label,
+    // so the branch predictor sees one indirect jump per opcode instead of a
+    // single shared switch jump.
+#if BITLANG_VM_COMPUTED_GOTO
+    static const void *const labels[] = {
+#define BITLANG_OP_LABEL(name) &&op_##name,
+        BITLANG_BYTECODE_OPS(BITLANG_OP_LABEL)
+#undef BITLANG_OP_LABEL
+    };
+#define VM_OP(name) op_##name:
+#define VM_DISPATCH() goto *labels[static_cast<uint8_t>(pc->op)]
+#else
+#define VM_OP(name) case BytecodeOp::name:
+#define VM_DISPATCH() goto dispatch
+#endif
+#define VM_NEXT() \
+    do { ++pc; VM_DISPATCH(); } while (0)
+#define VM_JUMP(target) \
+    do { pc = code + (target); VM_DISPATCH(); } while (0)
+#define A r[pc->a]
+#define B r[pc->b]
+#define C r[pc->c]
+#define INT_OP(name, expr) \
+    VM_OP(name) A.i = (expr); VM_NEXT();
+#define WRAP(x) static_cast<int32_t>(x)
+
+#if BITLANG_VM_COMPUTED_GOTO
+    VM_DISPATCH();
+#else
+dispatch:
+    switch (pc->op)
+    {
+#endif
+    VM_OP(LoadInt) A.i = static_cast<int32_t>(pc->b); VM_NEXT();
+    VM_OP(LoadFloat) std::memcpy(&A.f, &pc->b, sizeof(float)); VM_NEXT();
+    VM_OP(LoadString) A.s = &literals[pc->b]; VM_NEXT();
+    VM_OP(Move) A = B; VM_NEXT();
+    VM_OP(CopyString)
+        strings[pc->a] = *B.s;
+        A.s = &strings[pc->a];
+        VM_NEXT();
+
+    // Integer arithmetic wraps like LLVM's add/sub/mul on i32
+    INT_OP(AddInt, WRAP(static_cast<uint32_t>(B.i) + static_cast<uint32_t>(C.i)))
+    INT_OP(SubInt, WRAP(static_cast<uint32_t>(B.i) - static_cast<uint32_t>(C.i)))
+    INT_OP(MulInt, WRAP(static_cast<uint32_t>(B.i) * static_cast<uint32_t>(C.i)))
+    VM_OP(DivInt)
+        if (C.i == 0)
+            return runtimeError(bl_division_error);
+        A.i = C.i == -1 ? WRAP(0u - static_cast<uint32_t>(B.i)) : B.i / C.i;
+        VM_NEXT();
+    VM_OP(AddFloat) A.f = B.f + C.f; VM_NEXT();
+    VM_OP(SubFloat) A.f = B.f - C.f; VM_NEXT();
+    VM_OP(MulFloat) A.f = B.f * C.f; VM_NEXT();
+    VM_OP(DivFloat) A.f = B.f / C.f; VM_NEXT();
+    VM_OP(AddString)
+        bl_str_concat(&strings[pc->a], B.s, C.s);
+        A.s = &strings[pc->a];
+        VM_NEXT();
+
+    INT_OP(EqInt, B.i == C.i)
+    INT_OP(NeInt, B.i != C.i)
+    INT_OP(LtInt, B.i < C.i)
+    INT_OP(GtInt, B.i > C.i)
+    INT_OP(LeInt, B.i <= C.i)
+    INT_OP(GeInt, B.i >= C.i)
+    // Unordered: true when either side is NaN
+    INT_OP(EqFloat, !(B.f < C.f || B.f > C.f))
+    INT_OP(NeFloat, !(B.f == C.f))
+    INT_OP(LtFloat, !(B.f >= C.f))
+    INT_OP(GtFloat, !(B.f <= C.f))
+    INT_OP(LeFloat, !(B.f > C.f))
+    INT_OP(GeFloat, !(B.f < C.f))
+    INT_OP(EqString, bl_str_equal(B.s, C.s) != 0)
+    INT_OP(NeString, bl_str_equal(B.s, C.s) == 0)
+    INT_OP(LtString, bl_str_compare(B.s, C.s) < 0)
+    INT_OP(GtString, bl_str_compare(B.s, C.s) > 0)
+    INT_OP(LeString, bl_str_compare(B.s, C.s) <= 0)
+    INT_OP(GeString, bl_str_compare(B.s, C.s) >= 0)
+    INT_OP(And, B.i & C.i)
+    INT_OP(Or, B.i | C.i)
+    INT_OP(Not, !B.i)
+    INT_OP(NegInt, WRAP(0u - static_cast<uint32_t>(B.i)))
+    VM_OP(NegFloat) A.f = -B.f; VM_NEXT();
+    INT_OP(MinInt, std::min(B.i, C.i))
+    INT_OP(MaxInt, std::max(B.i, C.i))
+    VM_OP(MinFloat) A.f = std::fmin(B.f, C.f); VM_NEXT();
+    VM_OP(MaxFloat) A.f = std::fmax(B.f, C.f); VM_NEXT();
+
+    VM_OP(ArrayAddr) A.a = arrays[pc->b]; VM_NEXT();
+    VM_OP(LoadElem)
+        if (static_cast<uint32_t>(C.i) >= static_cast<uint32_t>(B.a[0].i))
+            return outOfBounds(C.i, B.a);
+        A = B.a[1 + C.i];
+        VM_NEXT();
+    VM_OP(StoreElem)
+        if (static_cast<uint32_t>(B.i) >= static_cast<uint32_t>(A.a[0].i))
+            return outOfBounds(B.i, A.a);
+        A.a[1 + B.i] = C;
+        VM_NEXT();
+
+    VM_OP(Jump) VM_JUMP(pc->a);
+    VM_OP(JumpIfFalse)
+        if (!B.i)
+            VM_JUMP(pc->a);
+        VM_NEXT();
+    VM_OP(JumpIfTrue)
+        if (B.i)
+            VM_JUMP(pc->a);
+        VM_NEXT();
+    VM_OP(ChunkCount) A.i = bl_parallel_chunks(B.i, r[pc->b + 1].i); VM_NEXT();
+    VM_OP(ChunkBound) A.i = bl_parallel_bound(B.i, r[pc->b + 1].i, C.i); VM_NEXT();
+
+    // The runtime's formatters, so the output is the LLVM backend's
+    VM_OP(PrintInt)
+    {
+        size_t length = bl_format_i32(text, B.i);
+        text[length] = '\n';
+        out.append(text, length + 1);
+        VM_NEXT();
+    }
+    VM_OP(PrintFloat)
+    {
+        size_t length = bl_format_f32(text, B.f);
+        text[length] = '\n';
+        out.append(text, length + 1);
+        VM_NEXT();
+    }
+    VM_OP(PrintFixed)
+    {
+        size_t length = bl_format_f32_fixed(text, B.f);
+        text[length] = '\n';
+        out.append(text, length + 1);
+        VM_NEXT();
+    }
+    VM_OP(PrintString)
+        out.append(bl_str_data(B.s), bl_str_length(B.s));
+        out += '\n';
+        VM_NEXT();
+    VM_OP(PrintChar)
+        out += static_cast<char>(B.i);
+        out += '\n';
+        VM_NEXT();
+
+    VM_OP(InputInt)
+        A.i = bl_input_i32();
+        VM_NEXT();
+    VM_OP(InputFloat)
+        A.f = bl_input_f32();
+        VM_NEXT();
+    VM_OP(InputString)
+        bl_input_str(&strings[pc->a]);
+        A.s = &strings[pc->a];
+        VM_NEXT();
+    VM_OP(InputBool)
+        A.i = bl_input_i32() != 0;
+        VM_NEXT();
+
+    VM_OP(Halt)
+        return result;
+#if !BITLANG_VM_COMPUTED_GOTO
+    }
+    return result;
+#endif
+
+#undef VM_OP
+#undef VM_DISPATCH
+#undef VM_NEXT
+#undef VM_JUMP
+#undef A
+#undef B
+#undef C
+#undef INT_OP
+#undef WRAP
+}
@@ -0,0 +1,120 @@
+// vm.h
+#pragma once
+
+#include "ast.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Register bytecode backend: an alternative to LLVMCodeGen for programs
+// that run for less time than LLVM takes to start. Every declaration slot
+// sema assigned is a register; expression temporaries live above them.
+// An array register points at storage of its own, one per declaration or
+// array literal, and whole-array operations compile to loops over it. A
+// string register points at a bl_str (runtime.h): a literal's, or one of
+// its own that the string operations write.
+
+// X-macro list so the opcode enum, the interpreter's dispatch table and the
+// disassembler cannot drift apart. Operands: a is the destination (or the
+// jump target / tested register), b and c are sources.
+#define BITLANG_BYTECODE_OPS(X) \
+    X(LoadInt)     /* a = int b                      */ \
+    X(LoadFloat)   /* a = float with bit pattern b   */ \
+    X(LoadString)  /* a = strings[b]                 */ \
+    X(Move)        /* a = b                          */ \
+    X(CopyString)  /* a = b, into a's own bl_str     */ \
+    X(AddInt)      /* a = b + c (wrapping)           */ \
+    X(SubInt)                                           \
+    X(MulInt)                                           \
+    X(DivInt)                                           \
+    X(AddFloat)                                         \
+    X(SubFloat)                                         \
+    X(MulFloat)                                         \
+    X(DivFloat)                                         \
+    X(AddString)   /* a = b + c, into a's own bl_str */ \
+    X(EqInt)       /* a = b == c ? 1 : 0             */ \
+    X(NeInt)                                            \
+    X(LtInt)                                            \
+    X(GtInt)                                            \
+    X(LeInt)                                            \
+    X(GeInt)                                            \
+    X(EqFloat)     /* unordered, like LLVM's fcmp u* */ \
+    X(NeFloat)                                          \
+    X(LtFloat)                                          \
+    X(GtFloat)                                          \
+    X(LeFloat)                                          \
+    X(GeFloat)                                          \
+    X(EqString)    /* bl_str_equal, bl_str_compare   */ \
+    X(NeString)                                         \
+    X(LtString)                                         \
+    X(GtString)                                         \
+    X(LeString)                                         \
+    X(GeString)                                         \
+    X(And)                                              \
+    X(Or)                                               \
+    X(Not)                                              \
+    X(NegInt)                                           \
+    X(NegFloat)                                         \
+    X(MinInt)      /* a = min(b, c)                  */ \
+    X(MaxInt)                                           \
+    X(MinFloat)    /* NaN-ignoring, like fmin        */ \
+    X(MaxFloat)                                         \
+    X(ArrayAddr)   /* a = array storage b            */ \
+    X(LoadElem)    /* a = b[c], bounds checked       */ \
+    X(StoreElem)   /* a[b] = c, bounds checked       */ \
+    X(Jump)        /* goto a                         */ \
+    X(JumpIfFalse) /* if (!b) goto a                 */ \
+    X(JumpIfTrue)  /* if (b) goto a                  */ \
+    X(ChunkCount)  /* a = bl_parallel_chunks(b, b+1) */ \
+    X(ChunkBound)  /* a = bl_parallel_bound(b,b+1,c) */ \
+    X(PrintInt)    /* print b                        */ \
+    X(PrintFloat)  /* shortest round trip text       */ \
+    X(PrintFixed)  /* printf's %f (--float-format)   */ \
+    X(PrintString)                                      \
+    X(PrintChar)                                        \
+    X(InputInt)    /* a = value read from input      */ \
+    X(InputFloat)                                       \
+    X(InputString)                                      \
+    X(InputBool)                                        \
+    X(Halt)
+
+enum class BytecodeOp : uint8_t
+{
+#define BITLANG_OP_ENUM(name) name,
+    BITLANG_BYTECODE_OPS(BITLANG_OP_ENUM)
+#undef BITLANG_OP_ENUM
+};
+
+struct Instruction
+{
+    BytecodeOp op;
+    uint32_t a, b, c;
+};
+
+struct BytecodeProgram
+{
+    std::vector<Instruction> code;
+    std::vector<std::string> strings; // String literal pool
+    std::vector<uint32_t> arrays;     // Length of each array storage, see ArrayAddr
+    uint32_t registerCount = 0;
+
+    void print(std::ostream &out) const; // Disassembly
+};
+
+// The tree must have passed semantic analysis: types and slots are read
+// straight off the nodes.
+BytecodeProgram compileToBytecode(const ProgramNode *root, FloatFormat floatFormat = FloatFormat::Shortest);
+
+// A runtime error, such as a division by zero, ends the program as it
+// does compiled code: the runtime's message is the last of the output and
+// the exit code is 1.
+struct VMResult
+{
+    int exitCode = 0;
+    std::string output; // Everything the program printed
+};
+
+// Run with input from `input`, or from stdin when it is null
+VMResult runBytecode(const BytecodeProgram &program, const std::string *input = nullptr);